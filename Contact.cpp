@@ -1,4 +1,50 @@
 #include "Contact.h"
+#include <algorithm>
+#include <QCryptographicHash>
+#include "Normalizer.h"
+#include "PhoneNumber.h"
+
+
+
+
+
+bool Contact::Sentence::isBinary() const
+{
+	for (const auto & p: m_Params)
+	{
+		if (p.m_Name != "encoding")
+		{
+			continue;
+		}
+		for (const auto & v: p.m_Values)
+		{
+			auto lcv = v.toLower();
+			if ((lcv == "b") || (lcv == "base64"))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+
+
+
+
+Contact::Contact():
+	m_IsPrepared(false)
+{
+}
+
+
+
+
+
+std::shared_ptr<Contact> Contact::clone() const
+{
+	return std::make_shared<Contact>(*this);
+}
 
 
 
@@ -7,4 +53,134 @@
 void Contact::addSentence(const Contact::Sentence & a_Sentence)
 {
 	m_Sentences.push_back(a_Sentence);
+	m_Fingerprint.clear();
+	m_IsPrepared = false;
+}
+
+
+
+
+
+void Contact::setSentences(std::vector<Contact::Sentence> && a_Sentences)
+{
+	m_Sentences = std::move(a_Sentences);
+	m_Fingerprint.clear();
+	m_IsPrepared = false;
+}
+
+
+
+
+
+void Contact::setNormalizedValue(size_t a_SentenceIndex, const QString & a_NormalizedValue)
+{
+	m_Sentences[a_SentenceIndex].m_NormalizedValue = a_NormalizedValue;
+	m_Fingerprint.clear();
+	m_IsPrepared = false;
+}
+
+
+
+
+
+QByteArray Contact::fingerprint() const
+{
+	if (!m_Fingerprint.isEmpty())
+	{
+		return m_Fingerprint;
+	}
+	return computeFingerprint();
+}
+
+
+
+
+
+void Contact::updateFingerprint()
+{
+	m_Fingerprint = computeFingerprint();
+}
+
+
+
+
+
+void Contact::prepare()
+{
+	if (m_IsPrepared)
+	{
+		return;
+	}
+	PhoneNumber::normalizeContact(*this);
+	updateFingerprint();
+	m_IsPrepared = true;
+}
+
+
+
+
+
+QByteArray Contact::computeFingerprint() const
+{
+	// Serialize each sentence into its canonical form:
+	std::vector<QByteArray> canonical;
+	canonical.reserve(m_Sentences.size());
+	for (const auto & s: m_Sentences)
+	{
+		if ((s.m_Key == "rev") || (s.m_Key == "prodid") || (s.m_Key == "version"))
+		{
+			continue;
+		}
+		QByteArray c = s.m_Group.toLower() + '.' + s.m_Key;
+
+		// Parameters, sorted by name, each with its sorted values; the TYPE values are case-insensitive:
+		std::vector<QByteArray> params;
+		for (const auto & p: s.m_Params)
+		{
+			auto isType = (p.m_Name == "type");
+			std::vector<QByteArray> values;
+			for (const auto & v: p.m_Values)
+			{
+				values.push_back(isType ? v.toLower() : v);
+			}
+			std::sort(values.begin(), values.end());
+			QByteArray param = p.m_Name;
+			for (const auto & v: values)
+			{
+				param.append('\x1f').append(v);
+			}
+			params.push_back(param);
+		}
+		std::sort(params.begin(), params.end());
+		for (const auto & p: params)
+		{
+			c.append('\x1e').append(p);
+		}
+
+		// Value:
+		c.append('\x1d');
+		if (s.m_Key == "tel")
+		{
+			c.append(PhoneNumber::key(s).toUtf8());
+		}
+		else if (s.m_Key == "email")
+		{
+			c.append(Normalizer::email(s.m_Value).toUtf8());
+		}
+		else
+		{
+			c.append(s.m_Value.trimmed());
+		}
+		canonical.push_back(c);
+	}
+
+	// Hash the sorted sentences:
+	std::sort(canonical.begin(), canonical.end());
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	for (const auto & c: canonical)
+	{
+		hash.addData(c);
+		hash.addData("\n", 1);
+	}
+	return hash.result();
 }
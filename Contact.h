@@ -9,6 +9,7 @@
 #include <memory>
 
 #include <QByteArray>
+#include <QString>
 
 
 
@@ -52,23 +53,74 @@ public:
 		QByteArray m_Key;
 		SentenceParams m_Params;
 		QByteArray m_Value;
+
+		/** The cached normalized form of m_Value, used as the key for comparisons; empty if not available.
+		Currently only set for TEL sentences (E.164 form), by PhoneNumber::normalizeContact(). */
+		QString m_NormalizedValue;
+
+		/** Returns true if the value is binary data (has a base64 ENCODING parameter, such as PHOTO).
+		Quoted-printable values are text once decoded by the parser (and are serialized without the encoding),
+		so they are not considered binary. */
+		bool isBinary() const;
 	};
 
 
 
+	Contact();
+
 	// Force destructors in all descendants to be virtual:
 	virtual ~Contact() {}
 
+	/** Returns a new copy of this contact, including all the descendant-specific data.
+	Used for creating modified versions of contacts that have already been published (see ContactBook::replaceContact()).
+	Descendants need to override this to create an instance of their own class. */
+	virtual std::shared_ptr<Contact> clone() const;
+
 	/** Adds a new VCard sentence to the contact. */
 	void addSentence(const Sentence & a_Sentence);
 
 	/** Returns all the VCard sentences currently present in the contact. */
 	const std::vector<Sentence> & sentences() const { return m_Sentences; }
 
+	/** Replaces all the VCard sentences in the contact. */
+	void setSentences(std::vector<Sentence> && a_Sentences);
+
+	/** Sets the cached normalized value of the sentence at the specified index. */
+	void setNormalizedValue(size_t a_SentenceIndex, const QString & a_NormalizedValue);
+
+	/** Returns the canonical fingerprint of the contact's data (128-bit MD5 hash).
+	The fingerprint doesn't depend on the order of the sentences, parameters or parameter values, on the
+	formatting of the phone numbers and e-mails, nor on the volatile sentences (REV, PRODID, VERSION),
+	so two contacts with the same fingerprint represent the same data.
+	Returns the cached value, if available (see updateFingerprint()), computes it otherwise. */
+	QByteArray fingerprint() const;
+
+	/** Computes the fingerprint and caches it in the contact.
+	The cache is invalidated by any change to the sentences. */
+	void updateFingerprint();
+
+	/** Prepares the contact for publishing: normalizes the phone numbers and computes the fingerprint.
+	Does nothing if the contact is already prepared, so that an already published contact, which may be read
+	by other threads, is never modified. Any change to the sentences makes the contact unprepared again. */
+	void prepare();
+
+	/** Returns true if the contact has been prepared (see prepare()) since the last change to its sentences. */
+	bool isPrepared() const { return m_IsPrepared; }
+
 protected:
 
 	/** The VCard sentences associated with this contact. */
 	std::vector<Sentence> m_Sentences;
+
+	/** The cached fingerprint, or empty if not computed since the last change. */
+	QByteArray m_Fingerprint;
+
+	/** Set by prepare(), cleared by any change to the sentences. */
+	bool m_IsPrepared;
+
+
+	/** Computes the fingerprint of the current sentences. */
+	QByteArray computeFingerprint() const;
 };
 
 using ContactPtr = std::shared_ptr<Contact> ;
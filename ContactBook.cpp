@@ -1,4 +1,8 @@
 #include "ContactBook.h"
+#include <assert.h>
+#include <algorithm>
+#include <QDebug>
+#include <QtConcurrentMap>
 
 
 
@@ -6,7 +10,10 @@
 
 ContactBook::ContactBook(const QString & a_DisplayName):
 	Super(nullptr),
-	m_DisplayName(a_DisplayName)
+	m_DisplayName(a_DisplayName),
+	m_BatchDepth(0),
+	m_FirstPendingInsert(0),
+	m_Snapshot(std::make_shared<const ContactBookSnapshot>())
 {
 
 }
@@ -36,10 +43,292 @@ ContactPtr ContactBook::createNewContact()
 
 
 
+void ContactBook::delContact(const Contact * a_Contact)
+{
+	if (m_Positions.count(a_Contact) == 0)
+	{
+		qWarning() << __FUNCTION__ << ": Attempting to remove a contact that is not in the contact book.";
+		return;
+	}
+	Batch batch(*this);
+	m_PendingRemoved.insert(a_Contact);
+}
+
+
+
+
+
+void ContactBook::beginBatch()
+{
+	if (m_BatchDepth == 0)
+	{
+		m_FirstPendingInsert = m_Contacts.size();
+	}
+	m_BatchDepth += 1;
+}
+
+
+
+
+
+void ContactBook::endBatch()
+{
+	assert(m_BatchDepth > 0);
+	m_BatchDepth -= 1;
+	if (m_BatchDepth == 0)
+	{
+		flushBatch();
+	}
+}
+
+
+
+
+
+void ContactBook::setIndexed(bool a_IsIndexed)
+{
+	if (!a_IsIndexed)
+	{
+		m_Index.reset();
+		return;
+	}
+	if (m_Index != nullptr)
+	{
+		return;
+	}
+	m_Index.reset(new ContactBookIndex);
+	auto end = std::min(m_FirstPendingInsert, m_Contacts.size());
+	for (size_t i = 0; i < end; ++i)
+	{
+		m_Index->add(m_Contacts[i]);
+	}
+}
+
+
+
+
+
 void ContactBook::addContact(ContactPtr a_Contact)
 {
+	Batch batch(*this);
+	if (!m_Positions.emplace(a_Contact.get(), m_Contacts.size()).second)
+	{
+		qWarning() << __FUNCTION__ << ": Attempting to add a contact that is already in the contact book.";
+		assert(!"Adding a contact twice");
+		return;
+	}
 	m_Contacts.push_back(a_Contact);
-	// TODO: emit the appropriate signals
+}
+
+
+
+
+
+void ContactBook::replaceContact(const Contact * a_OldContact, ContactPtr a_NewContact)
+{
+	Batch batch(*this);
+	auto itr = m_Positions.find(a_OldContact);
+	if (itr == m_Positions.end())
+	{
+		qWarning() << __FUNCTION__ << ": Attempting to replace a contact that is not in the contact book.";
+		assert(!"Replacing an unknown contact");
+		return;
+	}
+	auto pos = itr->second;
+	m_Positions.erase(itr);
+	m_Positions[a_NewContact.get()] = pos;
+	m_Contacts[pos] = a_NewContact;
+
+	// The pending changes refer to the contact by its pointer, move them over to the new instance:
+	if (m_PendingRemoved.erase(a_OldContact) > 0)
+	{
+		m_PendingRemoved.insert(a_NewContact.get());
+	}
+	m_PendingChanged.erase(a_OldContact);
+	m_PendingChanged.insert(a_NewContact.get());
+	if (m_Index != nullptr)
+	{
+		m_Index->remove(a_OldContact);
+	}
+}
+
+
+
+
+
+std::vector<size_t> ContactBook::positionsOf(const std::unordered_set<const Contact *> & a_Contacts, size_t a_End) const
+{
+	std::vector<size_t> res;
+	res.reserve(a_Contacts.size());
+	for (const auto c: a_Contacts)
+	{
+		auto itr = m_Positions.find(c);
+		if ((itr != m_Positions.end()) && (itr->second < a_End))
+		{
+			res.push_back(itr->second);
+		}
+	}
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+
+
+
+
+std::vector<std::pair<size_t, size_t>> ContactBook::rangesOf(const std::vector<size_t> & a_Positions)
+{
+	std::vector<std::pair<size_t, size_t>> res;
+	for (size_t i = 0, size = a_Positions.size(); i < size;)
+	{
+		auto first = a_Positions[i];
+		size_t count = 1;
+		for (++i; (i < size) && (a_Positions[i] == first + count); ++i)
+		{
+			count += 1;
+		}
+		res.emplace_back(first, count);
+	}
+	return res;
+}
+
+
+
+
+
+void ContactBook::flushBatch()
+{
+	// Collect the ranges of contacts to remove (only those that were announced before are reported):
+	auto removedPositions = positionsOf(m_PendingRemoved, m_Contacts.size());
+	std::vector<std::pair<int, int>> removedRanges;  // Pairs of (first, count), in ascending order
+	size_t numRemovedBeforeInsert = 0;
+	for (const auto & r: rangesOf(removedPositions))
+	{
+		auto announcedEnd = std::min(r.first + r.second, m_FirstPendingInsert);
+		if (r.first < announcedEnd)
+		{
+			removedRanges.emplace_back(static_cast<int>(r.first), static_cast<int>(announcedEnd - r.first));
+			numRemovedBeforeInsert += announcedEnd - r.first;
+		}
+	}
+	auto firstInsert = m_FirstPendingInsert - numRemovedBeforeInsert;
+	if (m_Index != nullptr)
+	{
+		for (const auto c: m_PendingRemoved)
+		{
+			m_Index->remove(c);
+		}
+	}
+
+	// The positions of the removed and changed contacts within the last published snapshot, for publishing
+	// the new one (the previously published contacts are still at their positions until the removal below):
+	std::vector<size_t> publishedRemoved(
+		removedPositions.cbegin(),
+		std::lower_bound(removedPositions.cbegin(), removedPositions.cend(), m_FirstPendingInsert)
+	);
+	auto publishedChanged = positionsOf(m_PendingChanged, m_FirstPendingInsert);
+
+	// Remove the contacts, moving the following ones down in a single pass:
+	if (!removedPositions.empty())
+	{
+		auto dst = removedPositions[0];
+		size_t nextRemoved = 0;
+		for (auto src = dst, size = m_Contacts.size(); src < size; ++src)
+		{
+			if ((nextRemoved < removedPositions.size()) && (removedPositions[nextRemoved] == src))
+			{
+				m_Positions.erase(m_Contacts[src].get());
+				nextRemoved += 1;
+				continue;
+			}
+			m_Positions[m_Contacts[src].get()] = dst;
+			m_Contacts[dst] = std::move(m_Contacts[src]);
+			dst += 1;
+		}
+		m_Contacts.resize(dst);
+	}
+
+	// Collect the ranges of changed contacts (the new contacts are reported as inserted instead):
+	std::vector<std::pair<int, int>> changedRanges;
+	for (const auto & r: rangesOf(positionsOf(m_PendingChanged, firstInsert)))
+	{
+		changedRanges.emplace_back(static_cast<int>(r.first), static_cast<int>(r.second));
+	}
+	auto numInserted = m_Contacts.size() - firstInsert;
+
+	// Prepare the new and replacement contacts (normalize the phone numbers, compute the fingerprints),
+	// in parallel, before they are published. The contacts that are already prepared are skipped; these may be
+	// shared with other books (such as the backups) and read by other threads, so they must not be touched:
+	std::vector<ContactPtr> toPrepare;
+	for (auto i = firstInsert, size = m_Contacts.size(); i < size; ++i)
+	{
+		if (!m_Contacts[i]->isPrepared())
+		{
+			toPrepare.push_back(m_Contacts[i]);
+		}
+	}
+	for (const auto & r: changedRanges)
+	{
+		for (int i = r.first; i < r.first + r.second; ++i)
+		{
+			const auto & contact = m_Contacts[static_cast<size_t>(i)];
+			if (!contact->isPrepared())
+			{
+				toPrepare.push_back(contact);
+			}
+		}
+	}
+	if (!toPrepare.empty())
+	{
+		QtConcurrent::blockingMap(toPrepare, [](ContactPtr & a_Contact)
+			{
+				a_Contact->prepare();
+			}
+		);
+	}
+
+	// Update the indexes:
+	if (m_Index != nullptr)
+	{
+		for (const auto & r: changedRanges)
+		{
+			for (int i = r.first; i < r.first + r.second; ++i)
+			{
+				m_Index->update(m_Contacts[static_cast<size_t>(i)]);
+			}
+		}
+		for (auto i = firstInsert, size = m_Contacts.size(); i < size; ++i)
+		{
+			m_Index->add(m_Contacts[i]);
+		}
+	}
+	m_PendingRemoved.clear();
+	m_PendingChanged.clear();
+	m_FirstPendingInsert = m_Contacts.size();
+
+	// Publish the new snapshot for the readers:
+	if (!removedRanges.empty() || (numInserted > 0) || !changedRanges.empty())
+	{
+		auto prevSnapshot = std::atomic_load(&m_Snapshot);
+		ContactBookSnapshotPtr newSnapshot = std::make_shared<const ContactBookSnapshot>(
+			*prevSnapshot, m_Contacts, publishedRemoved, publishedChanged
+		);
+		std::atomic_store(&m_Snapshot, newSnapshot);
+	}
+
+	// Emit the notifications; removals are reported last-to-first, so that the indices stay valid:
+	for (auto itr = removedRanges.crbegin(), end = removedRanges.crend(); itr != end; ++itr)
+	{
+		emit contactsRemoved(itr->first, itr->second);
+	}
+	if (numInserted > 0)
+	{
+		emit contactsInserted(static_cast<int>(firstInsert), static_cast<int>(numInserted));
+	}
+	for (const auto & r: changedRanges)
+	{
+		emit contactsChanged(r.first, r.second);
+	}
 }
 
 
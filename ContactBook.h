@@ -5,15 +5,24 @@
 
 
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <QObject>
 
 #include "Contact.h"
+#include "ContactBookIndex.h"
+#include "ContactBookSnapshot.h"
 
 
 
 
 
-/** Container of multiple Contact instances, logically coming from a single source. */
+/** Container of multiple Contact instances, logically coming from a single source.
+All changes to the contained contacts are reported using the range-based contactsInserted(), contactsRemoved()
+and contactsChanged() signals. Changes can be grouped into batches (beginBatch() / endBatch(), or the Batch
+RAII helper), in which case the notifications are coalesced and emitted only once the outermost batch ends.
+The ContactBook itself is meant to be modified and read only by a single (writer) thread. Other threads read the
+contacts through snapshot(), which returns the immutable version published at the end of the last batch. */
 class ContactBook:
 	public QObject
 {
@@ -23,6 +32,27 @@ class ContactBook:
 
 public:
 
+	/** RAII helper that groups all the changes done to the contact book during its lifetime into a single batch.
+	Usage: { ContactBook::Batch batch(*contactBook); <add / remove / change many contacts> } */
+	class Batch
+	{
+	public:
+		explicit Batch(ContactBook & a_ContactBook):
+			m_ContactBook(a_ContactBook)
+		{
+			m_ContactBook.beginBatch();
+		}
+
+		~Batch()
+		{
+			m_ContactBook.endBatch();
+		}
+
+	protected:
+		ContactBook & m_ContactBook;
+	};
+
+
 	/** Creates a new instance, with the specified display name. */
 	explicit ContactBook(const QString & a_DisplayName);
 
@@ -37,9 +67,61 @@ public:
 	The default implementation creates an empty Contact instance. */
 	virtual ContactPtr createNewContact();
 
-	/** Returns a read-only reference to all the contained contacts. */
+	/** Returns a read-only reference to all the contained contacts.
+	Only usable from the writer thread, other threads need to use snapshot() instead. */
 	const std::vector<ContactPtr> & contacts() const { return m_Contacts; }
 
+	/** Returns true if the specified contact is in contacts() (including the contacts added in the current batch).
+	Takes O(1), only usable from the writer thread. */
+	bool contains(const Contact * a_Contact) const { return (m_Positions.count(a_Contact) > 0); }
+
+	/** Returns the snapshot of the contacts published at the end of the last batch.
+	Safe to call from any thread, the snapshot can be read without any locking. */
+	ContactBookSnapshotPtr snapshot() const { return std::atomic_load(&m_Snapshot); }
+
+	/** Adds the specified (fully constructed) contact to the container.
+	Unless the contact is already prepared (Contact::isPrepared()), it is prepared in-place when the batch ends,
+	so an unprepared contact must not be visible to any reader yet. A prepared contact is never modified, so it may be
+	shared with other books.
+	The contactsInserted() signal is emitted once the current batch ends.
+	Descendants that keep their own index of the contacts can override this, calling the base implementation. */
+	virtual void addContact(ContactPtr a_Contact);
+
+	/** Replaces the specified contact with a new instance, keeping its position in contacts(). Takes O(1).
+	This is the only way to modify contacts that have already been published in a snapshot, since those must not be
+	modified in-place. a_NewContact must be a new instance that no reader can see yet (typically a clone() of
+	the old contact), because its phone numbers and fingerprint are updated in-place when the batch ends
+	(Contact::prepare()).
+	The contactsChanged() signal is emitted once the current batch ends.
+	Descendants that keep their own index of the contacts can override this, calling the base implementation. */
+	virtual void replaceContact(const Contact * a_OldContact, ContactPtr a_NewContact);
+
+	/** Removes the specified contact from the container.
+	Inside a batch, the contact is only scheduled for removal and stays in contacts() until the batch ends.
+	Descendants that keep their own index of the contacts can override this, calling the base implementation. */
+	virtual void delContact(const Contact * a_Contact);
+
+	/** Starts a new batch of changes; the change notifications are postponed until the matching endBatch().
+	Batches can be nested, only the outermost batch emits the notifications. */
+	void beginBatch();
+
+	/** Ends the batch started by beginBatch().
+	If this is the outermost batch, applies the scheduled removals and emits the coalesced notifications. */
+	void endBatch();
+
+	/** Enables or disables the secondary indexes (UID, e-mail, phone, FN) over the contacts.
+	Enabling builds the indexes from all the current contacts, afterwards they are maintained incrementally
+	at the end of each batch. Disabling frees the indexes. */
+	void setIndexed(bool a_IsIndexed);
+
+	/** Returns true if the secondary indexes are enabled. */
+	bool isIndexed() const { return (m_Index != nullptr); }
+
+	/** Returns the secondary indexes over the contacts.
+	Only valid if isIndexed() returns true. Note that contacts added in a batch that hasn't ended yet are not
+	indexed yet. */
+	const ContactBookIndex & index() const { return *m_Index; }
+
 
 protected:
 
@@ -49,15 +131,59 @@ protected:
 	/** All the contained contacts. */
 	std::vector<ContactPtr> m_Contacts;
 
-	/** Adds the specified contact into m_Contacts.
-	TODO: Emits the appropriate signals. */
-	void addContact(ContactPtr a_Contact);
+	/** The index of each contact in m_Contacts, so that the contacts can be found without scanning m_Contacts.
+	Maintained by addContact(), replaceContact() and flushBatch(). */
+	std::unordered_map<const Contact *, size_t> m_Positions;
+
+	/** The nesting level of beginBatch() / endBatch() calls. */
+	int m_BatchDepth;
+
+	/** Index into m_Contacts of the first contact added in the current batch.
+	Contacts are always appended, so all contacts from this index to the end are new. */
+	size_t m_FirstPendingInsert;
+
+	/** The replacement contacts (see replaceContact()) of the current batch. */
+	std::unordered_set<const Contact *> m_PendingChanged;
+
+	/** Contacts that have been scheduled for removal in the current batch. */
+	std::unordered_set<const Contact *> m_PendingRemoved;
+
+	/** The secondary indexes over m_Contacts, or nullptr if indexing is disabled. */
+	std::unique_ptr<ContactBookIndex> m_Index;
+
+	/** The snapshot published at the end of the last batch.
+	Only ever accessed through std::atomic_load() / std::atomic_store(), since readers use it from other threads. */
+	ContactBookSnapshotPtr m_Snapshot;
+
+
+	/** Applies the scheduled removals, publishes a new snapshot and emits all the notifications collected
+	in the current batch. */
+	void flushBatch();
+
+	/** Returns the sorted positions in m_Contacts of the specified contacts, skipping those not present and those
+	at a_End or above. */
+	std::vector<size_t> positionsOf(const std::unordered_set<const Contact *> & a_Contacts, size_t a_End) const;
+
+	/** Returns the sorted positions joined into consecutive ranges, as pairs of (first, count). */
+	static std::vector<std::pair<size_t, size_t>> rangesOf(const std::vector<size_t> & a_Positions);
 
 
 signals:
 
 	void displayNameChanged(const QString & a_NewDisplayName);
 
+	/** Emitted after a_Count contacts have been inserted into contacts(), starting at index a_First. */
+	void contactsInserted(int a_First, int a_Count);
+
+	/** Emitted after a_Count contacts have been removed from contacts(), starting at (the former) index a_First.
+	When a batch removes multiple ranges, they are reported from the last one to the first one, so that the
+	indices of each reported range are valid for the listener's mirror of the data at the time of the signal. */
+	void contactsRemoved(int a_First, int a_Count);
+
+	/** Emitted after a_Count contacts, starting at index a_First, have had their data changed.
+	Reported after all removals and insertions of the batch, so the indices refer to the current contacts(). */
+	void contactsChanged(int a_First, int a_Count);
+
 public slots:
 };
 
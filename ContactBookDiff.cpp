@@ -0,0 +1,297 @@
+#include "ContactBookDiff.h"
+#include <algorithm>
+#include <QHash>
+#include "Normalizer.h"
+#include "PhoneNumber.h"
+
+
+
+
+
+/** Contacts grouped by the book they come from; the outer vector is indexed by the book index. */
+using PerBookContacts = std::vector<std::vector<ContactPtr>>;
+
+
+
+
+
+ContactBookDiff::ContactBookDiff(const std::vector<ContactBookPtr> & a_ContactBooks)
+{
+	auto numBooks = a_ContactBooks.size();
+	if (numBooks == 0)
+	{
+		return;
+	}
+
+	// Join on the fingerprints:
+	QHash<QByteArray, PerBookContacts> byFingerprint;
+	for (size_t b = 0; b < numBooks; ++b)
+	{
+		auto snapshot = a_ContactBooks[b]->snapshot();
+		snapshot->forEach([&byFingerprint, b, numBooks](const ContactPtr & a_Contact)
+			{
+				auto & group = byFingerprint[a_Contact->fingerprint()];
+				group.resize(numBooks);
+				group[b].push_back(a_Contact);
+			}
+		);
+	}
+
+	// Emit the Identical rows, collect the leftovers:
+	PerBookContacts leftovers(numBooks);
+	for (auto itr = byFingerprint.cbegin(), end = byFingerprint.cend(); itr != end; ++itr)
+	{
+		const auto & group = itr.value();
+		size_t numIdentical = group[0].size();
+		for (const auto & contacts: group)
+		{
+			numIdentical = std::min(numIdentical, contacts.size());
+		}
+		auto key = QString::fromLatin1(itr.key().toHex());
+		for (size_t i = 0; i < numIdentical; ++i)
+		{
+			Row row{stIdentical, key, {}};
+			for (const auto & contacts: group)
+			{
+				row.m_Contacts.push_back(contacts[i]);
+			}
+			m_Rows.push_back(std::move(row));
+		}
+		for (size_t b = 0; b < numBooks; ++b)
+		{
+			const auto & contacts = group[b];
+			leftovers[b].insert(leftovers[b].end(), contacts.begin() + static_cast<std::ptrdiff_t>(numIdentical), contacts.end());
+		}
+	}
+	byFingerprint.clear();
+
+	// Join the leftovers on any shared match key (UID, FN, any e-mail, any phone), using union-find over
+	// the contacts, so that a contact whose UID is present only in some of the books still matches on its name,
+	// e-mail or phone in the other books:
+	std::vector<std::pair<size_t, ContactPtr>> items;  // (book index, contact)
+	for (size_t b = 0; b < numBooks; ++b)
+	{
+		for (const auto & contact: leftovers[b])
+		{
+			items.emplace_back(b, contact);
+		}
+	}
+	leftovers.clear();
+	std::vector<size_t> parent(items.size());
+	for (size_t i = 0; i < parent.size(); ++i)
+	{
+		parent[i] = i;
+	}
+	auto findRoot = [&parent](size_t a_Item)
+	{
+		while (parent[a_Item] != a_Item)
+		{
+			parent[a_Item] = parent[parent[a_Item]];
+			a_Item = parent[a_Item];
+		}
+		return a_Item;
+	};
+	QHash<QString, size_t> firstWithKey;  // Match key -> index into items of the first contact having it
+	std::vector<bool> hasKeys(items.size(), false);
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		for (const auto & key: matchKeys(*items[i].second))
+		{
+			hasKeys[i] = true;
+			auto itr = firstWithKey.constFind(key);
+			if (itr == firstWithKey.constEnd())
+			{
+				firstWithKey.insert(key, i);
+			}
+			else
+			{
+				parent[findRoot(i)] = findRoot(itr.value());
+			}
+		}
+	}
+	firstWithKey.clear();
+
+	// Group the contacts by their union-find root, per book:
+	QHash<size_t, PerBookContacts> groups;
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		const auto & contact = items[i].second;
+		if (!hasKeys[i])
+		{
+			// Cannot match the contact to anything, it is only present in this book:
+			Row row{stMissing, QString::fromLatin1(contact->fingerprint().toHex()), std::vector<ContactPtr>(numBooks)};
+			row.m_Contacts[items[i].first] = contact;
+			m_Rows.push_back(std::move(row));
+			continue;
+		}
+		auto & group = groups[findRoot(i)];
+		group.resize(numBooks);
+		group[items[i].first].push_back(contact);
+	}
+
+	// Emit a row for each group; groups with multiple contacts in a book pair them by their primary match key:
+	for (auto itr = groups.begin(), end = groups.end(); itr != end; ++itr)
+	{
+		auto & group = itr.value();
+		size_t numRows = 0;
+		for (auto & contacts: group)
+		{
+			numRows = std::max(numRows, contacts.size());
+			if (contacts.size() < 2)
+			{
+				continue;
+			}
+			std::vector<std::pair<QString, ContactPtr>> keyed;
+			for (const auto & c: contacts)
+			{
+				keyed.emplace_back(matchKey(*c), c);
+			}
+			std::stable_sort(keyed.begin(), keyed.end(),
+				[](const std::pair<QString, ContactPtr> & a_Item1, const std::pair<QString, ContactPtr> & a_Item2)
+				{
+					return (a_Item1.first < a_Item2.first);
+				}
+			);
+			for (size_t i = 0; i < keyed.size(); ++i)
+			{
+				contacts[i] = keyed[i].second;
+			}
+		}
+		for (size_t i = 0; i < numRows; ++i)
+		{
+			Row row{stChanged, QString(), std::vector<ContactPtr>(numBooks)};
+			for (size_t b = 0; b < numBooks; ++b)
+			{
+				if (i < group[b].size())
+				{
+					row.m_Contacts[b] = group[b][i];
+					if (row.m_Key.isEmpty())
+					{
+						row.m_Key = matchKey(*group[b][i]);
+					}
+				}
+				else
+				{
+					row.m_Status = stMissing;
+				}
+			}
+			m_Rows.push_back(std::move(row));
+		}
+	}
+
+	// Sort the rows, so that the output is deterministic:
+	std::stable_sort(m_Rows.begin(), m_Rows.end(),
+		[](const Row & a_Row1, const Row & a_Row2)
+		{
+			if (a_Row1.m_Status != a_Row2.m_Status)
+			{
+				return (a_Row1.m_Status < a_Row2.m_Status);
+			}
+			return (a_Row1.m_Key < a_Row2.m_Key);
+		}
+	);
+}
+
+
+
+
+
+size_t ContactBookDiff::count(ContactBookDiff::Status a_Status) const
+{
+	return static_cast<size_t>(std::count_if(m_Rows.cbegin(), m_Rows.cend(),
+		[a_Status](const Row & a_Row)
+		{
+			return (a_Row.m_Status == a_Status);
+		}
+	));
+}
+
+
+
+
+
+QString ContactBookDiff::matchKey(const Contact & a_Contact)
+{
+	QString fn, email, phone;
+	for (const auto & s: a_Contact.sentences())
+	{
+		if (s.m_Key == "uid")
+		{
+			auto uid = s.m_Value.trimmed();
+			if (!uid.isEmpty())
+			{
+				return QString::fromLatin1("uid:") + QString::fromUtf8(uid);
+			}
+		}
+		else if ((s.m_Key == "fn") && fn.isEmpty())
+		{
+			fn = Normalizer::foldValue(s.m_Value);
+		}
+		else if ((s.m_Key == "email") && email.isEmpty())
+		{
+			email = Normalizer::email(s.m_Value);
+		}
+		else if ((s.m_Key == "tel") && phone.isEmpty())
+		{
+			phone = PhoneNumber::key(s);
+		}
+	}
+	if (!fn.isEmpty())
+	{
+		return QString::fromLatin1("fn:") + fn;
+	}
+	if (!email.isEmpty())
+	{
+		return QString::fromLatin1("email:") + email;
+	}
+	if (!phone.isEmpty())
+	{
+		return QString::fromLatin1("tel:") + phone;
+	}
+	return QString();
+}
+
+
+
+
+
+std::vector<QString> ContactBookDiff::matchKeys(const Contact & a_Contact)
+{
+	std::vector<QString> res;
+	auto addKey = [&res](const char * a_Prefix, const QString & a_Value)
+	{
+		if (a_Value.isEmpty())
+		{
+			return;
+		}
+		auto key = QString::fromLatin1(a_Prefix) + a_Value;
+		if (std::find(res.begin(), res.end(), key) == res.end())
+		{
+			res.push_back(std::move(key));
+		}
+	};
+	for (const auto & s: a_Contact.sentences())
+	{
+		if (s.m_Key == "uid")
+		{
+			addKey("uid:", QString::fromUtf8(s.m_Value.trimmed()));
+		}
+		else if (s.m_Key == "fn")
+		{
+			addKey("fn:", Normalizer::foldValue(s.m_Value));
+		}
+		else if (s.m_Key == "email")
+		{
+			addKey("email:", Normalizer::email(s.m_Value));
+		}
+		else if (s.m_Key == "tel")
+		{
+			addKey("tel:", PhoneNumber::key(s));
+		}
+	}
+	return res;
+}
+
+
+
+
@@ -0,0 +1,83 @@
+#ifndef CONTACTBOOKDIFF_H
+#define CONTACTBOOKDIFF_H
+
+
+
+
+
+#include <vector>
+#include <QString>
+
+#include "Contact.h"
+#include "ContactBook.h"
+
+
+
+
+
+/** Compares the contacts in N ContactBooks (such as a VCF export, a CardDAV server and a backup).
+Uses hash joins, so the comparison is O(total number of contacts):
+First, the contacts are joined on their canonical fingerprint (Contact::fingerprint()); a fingerprint present
+in all the books yields an Identical row. The remaining contacts are then grouped by any shared match key
+(UID, folded FN, any e-mail or any phone number, see matchKeys()), transitively, using union-find. Each group
+yields Changed rows (present in all the books with different data) or Missing rows (not present in some of
+the books).
+Works on the contact book snapshots, so it can run on a worker thread. */
+class ContactBookDiff
+{
+public:
+
+	/** The classification of a single row of the diff. */
+	enum Status
+	{
+		stIdentical,  ///< The same data is present in all the books
+		stChanged,    ///< The contact is present in all the books, but the data differ
+		stMissing,    ///< The contact is missing from some of the books
+	};
+
+
+	/** A single contact matched across the books. */
+	struct Row
+	{
+		Status m_Status;
+
+		/** The key identifying the row: the match key (see matchKey()) of its first contact, or the hex fingerprint
+		for Identical rows and for the contacts that have no match key. */
+		QString m_Key;
+
+		/** The contact in each of the books (in the order in which the books were given), nullptr if missing. */
+		std::vector<ContactPtr> m_Contacts;
+	};
+
+
+	/** Compares the current snapshots of the specified contact books. */
+	explicit ContactBookDiff(const std::vector<ContactBookPtr> & a_ContactBooks);
+
+	/** Returns all the rows of the diff. */
+	const std::vector<Row> & rows() const { return m_Rows; }
+
+	/** Returns the number of rows with the specified status. */
+	size_t count(Status a_Status) const;
+
+	/** Returns the primary match key of the contact, used for identifying the rows and for pairing multiple
+	matching contacts from a single book. This is the UID if present, otherwise the folded FN, the first
+	normalized e-mail or the first phone key, whichever is available first.
+	Returns an empty string if the contact has none of these. */
+	static QString matchKey(const Contact & a_Contact);
+
+	/** Returns all the keys on which the contact can be matched with contacts in the other books:
+	its UIDs, folded FNs, normalized e-mails and phone keys, each prefixed with its kind. */
+	static std::vector<QString> matchKeys(const Contact & a_Contact);
+
+
+protected:
+
+	/** The rows of the diff. */
+	std::vector<Row> m_Rows;
+};
+
+
+
+
+
+#endif // CONTACTBOOKDIFF_H
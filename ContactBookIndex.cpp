@@ -0,0 +1,175 @@
+#include "ContactBookIndex.h"
+#include <algorithm>
+#include "Normalizer.h"
+#include "PhoneNumber.h"
+
+
+
+
+
+/** Inserts the contact into the index under the specified key, unless the key is empty.
+Also remembers the key in a_Keys, so that the contact can be removed later on. */
+static void addKey(
+	QMultiHash<QString, ContactPtr> & a_Index,
+	std::vector<QString> & a_Keys,
+	const QString & a_Key,
+	const ContactPtr & a_Contact
+)
+{
+	if (a_Key.isEmpty())
+	{
+		return;
+	}
+	a_Index.insert(a_Key, a_Contact);
+	a_Keys.push_back(a_Key);
+}
+
+
+
+
+
+/** Removes the contact from the index, under all the specified keys. */
+static void removeKeys(
+	QMultiHash<QString, ContactPtr> & a_Index,
+	const std::vector<QString> & a_Keys,
+	const ContactPtr & a_Contact
+)
+{
+	for (const auto & key: a_Keys)
+	{
+		a_Index.remove(key, a_Contact);
+	}
+}
+
+
+
+
+
+void ContactBookIndex::add(const ContactPtr & a_Contact)
+{
+	auto & keys = m_ContactKeys[a_Contact.get()];
+	keys.m_Contact = a_Contact;
+	for (const auto & s: a_Contact->sentences())
+	{
+		if (s.m_Key == "uid")
+		{
+			addKey(m_Uids, keys.m_Uids, QString::fromUtf8(s.m_Value.trimmed()), a_Contact);
+		}
+		else if (s.m_Key == "email")
+		{
+			addKey(m_Emails, keys.m_Emails, Normalizer::email(s.m_Value), a_Contact);
+		}
+		else if (s.m_Key == "tel")
+		{
+			addKey(m_Phones, keys.m_Phones, PhoneNumber::key(s), a_Contact);
+		}
+		else if (s.m_Key == "fn")
+		{
+			addKey(m_Names, keys.m_Names, Normalizer::foldValue(s.m_Value), a_Contact);
+		}
+	}
+}
+
+
+
+
+
+void ContactBookIndex::update(const ContactPtr & a_Contact)
+{
+	remove(a_Contact.get());
+	add(a_Contact);
+}
+
+
+
+
+
+void ContactBookIndex::remove(const Contact * a_Contact)
+{
+	auto itr = m_ContactKeys.find(a_Contact);
+	if (itr == m_ContactKeys.end())
+	{
+		return;
+	}
+	const auto & keys = itr->second;
+	removeKeys(m_Uids,   keys.m_Uids,   keys.m_Contact);
+	removeKeys(m_Emails, keys.m_Emails, keys.m_Contact);
+	removeKeys(m_Phones, keys.m_Phones, keys.m_Contact);
+	removeKeys(m_Names,  keys.m_Names,  keys.m_Contact);
+	m_ContactKeys.erase(itr);
+}
+
+
+
+
+
+void ContactBookIndex::clear()
+{
+	m_Uids.clear();
+	m_Emails.clear();
+	m_Phones.clear();
+	m_Names.clear();
+	m_ContactKeys.clear();
+}
+
+
+
+
+
+std::vector<ContactPtr> ContactBookIndex::findByUid(const QByteArray & a_Uid) const
+{
+	return find(m_Uids, QString::fromUtf8(a_Uid.trimmed()));
+}
+
+
+
+
+
+std::vector<ContactPtr> ContactBookIndex::findByEmail(const QByteArray & a_Email) const
+{
+	return find(m_Emails, Normalizer::email(a_Email));
+}
+
+
+
+
+
+std::vector<ContactPtr> ContactBookIndex::findByPhone(const QByteArray & a_Phone) const
+{
+	return find(m_Phones, PhoneNumber::key(a_Phone));
+}
+
+
+
+
+
+std::vector<ContactPtr> ContactBookIndex::findByName(const QString & a_Name) const
+{
+	return find(m_Names, Normalizer::foldText(a_Name));
+}
+
+
+
+
+
+std::vector<ContactPtr> ContactBookIndex::find(const ContactBookIndex::Index & a_Index, const QString & a_Key)
+{
+	std::vector<ContactPtr> res;
+	if (a_Key.isEmpty())
+	{
+		return res;
+	}
+	for (auto itr = a_Index.constFind(a_Key), end = a_Index.constEnd(); (itr != end) && (itr.key() == a_Key); ++itr)
+	{
+		// A contact may be stored multiple times under the same key (two identical e-mails), report it only once:
+		if (std::find(res.begin(), res.end(), itr.value()) == res.end())
+		{
+			res.push_back(itr.value());
+		}
+	}
+	return res;
+}
+
+
+
+
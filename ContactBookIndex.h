@@ -0,0 +1,97 @@
+#ifndef CONTACTBOOKINDEX_H
+#define CONTACTBOOKINDEX_H
+
+
+
+
+
+#include <unordered_map>
+#include <QMultiHash>
+#include <QString>
+
+#include "Contact.h"
+
+
+
+
+
+/** Secondary hash indexes over the contacts of a single ContactBook.
+Indexes the contacts by their UID, normalized e-mail, E.164 phone number (see PhoneNumber) and folded FN
+(see Normalizer),
+so that lookups by any of these take O(1) instead of scanning all the contacts.
+The index is maintained incrementally by the owning ContactBook, which calls add(), update() and remove()
+as its contacts change. */
+class ContactBookIndex
+{
+public:
+
+	/** Adds the specified contact to all the indexes. */
+	void add(const ContactPtr & a_Contact);
+
+	/** Re-indexes the specified contact, after its data has changed. */
+	void update(const ContactPtr & a_Contact);
+
+	/** Removes the specified contact from all the indexes. */
+	void remove(const Contact * a_Contact);
+
+	/** Removes all the contacts from all the indexes. */
+	void clear();
+
+	/** Returns all the contacts that have the specified UID. */
+	std::vector<ContactPtr> findByUid(const QByteArray & a_Uid) const;
+
+	/** Returns all the contacts that have the specified e-mail address.
+	The address is normalized before the lookup, so it may be given in any form. */
+	std::vector<ContactPtr> findByEmail(const QByteArray & a_Email) const;
+
+	/** Returns all the contacts that have the specified phone number.
+	The number is normalized before the lookup, so it may be given in any form. */
+	std::vector<ContactPtr> findByPhone(const QByteArray & a_Phone) const;
+
+	/** Returns all the contacts that have the specified FN (formatted name).
+	The name is compared accent- and case-insensitive. */
+	std::vector<ContactPtr> findByName(const QString & a_Name) const;
+
+
+protected:
+
+	/** Type used for all the individual indexes, maps the normalized key -> all contacts with such key. */
+	using Index = QMultiHash<QString, ContactPtr>;
+
+	/** The keys under which a single contact is stored in the indexes.
+	Needed for removing the contact after its data has already been changed. */
+	struct ContactKeys
+	{
+		ContactPtr m_Contact;
+		std::vector<QString> m_Uids;
+		std::vector<QString> m_Emails;
+		std::vector<QString> m_Phones;
+		std::vector<QString> m_Names;
+	};
+
+
+	/** UID -> Contact. */
+	Index m_Uids;
+
+	/** Normalized e-mail address -> Contact. */
+	Index m_Emails;
+
+	/** Normalized phone number -> Contact. */
+	Index m_Phones;
+
+	/** Folded FN -> Contact. */
+	Index m_Names;
+
+	/** The keys under which each contact is currently indexed. */
+	std::unordered_map<const Contact *, ContactKeys> m_ContactKeys;
+
+
+	/** Returns all the contacts stored in the specified index under the specified key. */
+	static std::vector<ContactPtr> find(const Index & a_Index, const QString & a_Key);
+};
+
+
+
+
+
+#endif // CONTACTBOOKINDEX_H
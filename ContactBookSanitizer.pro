@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui xml network
+QT       += core gui xml network concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -29,6 +29,7 @@ SOURCES += \
 	MainWindow.cpp \
 	Session.cpp \
 	ContactBook.cpp \
+	ContactBookIndex.cpp \
 	SessionModel.cpp \
 	Device.cpp \
 	ExampleDevice.cpp \
@@ -37,15 +38,35 @@ SOURCES += \
 	Contact.cpp \
 	DisplayContact.cpp \
 	DlgAddDevice.cpp \
+	DlgRequestMetrics.cpp \
+	DlgSearch.cpp \
+	DlgSimilarNames.cpp \
 	DeviceCardDav.cpp \
+	DeviceBackup.cpp \
 	DavPropertyTree.cpp \
 	DavPropertyHandlers.cpp \
-	HorizontalContactView.cpp
+	DavRequestMetrics.cpp \
+	PollScheduler.cpp \
+	HorizontalContactView.cpp \
+	Normalizer.cpp \
+	ContactBookSnapshot.cpp \
+	DuplicateFinder.cpp \
+	PhoneNumber.cpp \
+	FuzzyNameMatcher.cpp \
+	ContactBookDiff.cpp \
+	VCardSerializer.cpp \
+	Sanitizer.cpp \
+	SanitizerRules.cpp \
+	PhotoProcessor.cpp \
+	SessionSearchIndex.cpp \
+	StreamPipeline.cpp \
+	StreamStages.cpp
 
 HEADERS  += \
 	MainWindow.h \
 	Session.h \
 	ContactBook.h \
+	ContactBookIndex.h \
 	SessionModel.h \
 	Device.h \
 	ExampleDevice.h \
@@ -55,10 +76,29 @@ HEADERS  += \
 	Contact.h \
 	DisplayContact.h \
 	DlgAddDevice.h \
+	DlgRequestMetrics.h \
+	DlgSearch.h \
+	DlgSimilarNames.h \
 	DeviceCardDav.h \
+	DeviceBackup.h \
 	DavPropertyTree.h \
 	DavPropertyHandlers.h \
-	HorizontalContactView.h
+	DavRequestMetrics.h \
+	PollScheduler.h \
+	HorizontalContactView.h \
+	Normalizer.h \
+	ContactBookSnapshot.h \
+	DuplicateFinder.h \
+	PhoneNumber.h \
+	FuzzyNameMatcher.h \
+	ContactBookDiff.h \
+	VCardSerializer.h \
+	Sanitizer.h \
+	SanitizerRules.h \
+	PhotoProcessor.h \
+	SessionSearchIndex.h \
+	StreamPipeline.h \
+	StreamStages.h
 
 FORMS    += \
 	MainWindow.ui \
@@ -0,0 +1,151 @@
+#include "ContactBookSnapshot.h"
+#include <assert.h>
+#include <algorithm>
+
+
+
+
+
+const size_t ContactBookSnapshot::CHUNK_SIZE;
+
+
+
+
+
+ContactBookSnapshot::ContactBookSnapshot():
+	m_Size(0),
+	m_Version(0)
+{
+}
+
+
+
+
+
+ContactBookSnapshot::ContactBookSnapshot(
+	const ContactBookSnapshot & a_Previous,
+	const std::vector<ContactPtr> & a_Contacts,
+	const std::vector<size_t> & a_Removed,
+	const std::vector<size_t> & a_Changed
+):
+	m_Size(a_Contacts.size()),
+	m_Version(a_Previous.m_Version + 1)
+{
+	// Walk the previous chunks, tracking the position of their contacts both in a_Previous and in a_Contacts:
+	m_Chunks.reserve(a_Previous.m_Chunks.size() + 1);
+	size_t prevPos = 0;
+	size_t newPos = 0;
+	auto removed = a_Removed.cbegin();
+	auto changed = a_Changed.cbegin();
+	for (const auto & prevChunk: a_Previous.m_Chunks)
+	{
+		auto prevEnd = prevPos + prevChunk->size();
+		auto isRemoved = ((removed != a_Removed.cend()) && (*removed < prevEnd));
+		auto isChanged = ((changed != a_Changed.cend()) && (*changed < prevEnd));
+		if (!isRemoved && !isChanged)
+		{
+			// Re-use the unchanged chunk as it is, unless the last chunk is small enough to be merged with it:
+			if (
+				!m_Chunks.empty() &&
+				(m_Chunks.back()->size() < CHUNK_SIZE / 2) &&
+				(m_Chunks.back()->size() + prevChunk->size() <= CHUNK_SIZE)
+			)
+			{
+				appendChunk(Chunk(*prevChunk));
+			}
+			else
+			{
+				m_Chunks.push_back(prevChunk);
+			}
+			newPos += prevChunk->size();
+			prevPos = prevEnd;
+			continue;
+		}
+
+		// Rebuild the chunk from the current contacts, skipping the removed ones:
+		Chunk chunk;
+		chunk.reserve(prevChunk->size());
+		for (; prevPos < prevEnd; ++prevPos)
+		{
+			if ((changed != a_Changed.cend()) && (*changed == prevPos))
+			{
+				++changed;
+			}
+			if ((removed != a_Removed.cend()) && (*removed == prevPos))
+			{
+				++removed;
+				continue;
+			}
+			chunk.push_back(a_Contacts[newPos]);
+			newPos += 1;
+		}
+		appendChunk(std::move(chunk));
+	}
+	assert(prevPos == a_Previous.m_Size);
+	assert(removed == a_Removed.cend());
+	assert(newPos <= m_Size);
+
+	// Append the new contacts, topping up the last chunk first:
+	while (newPos < m_Size)
+	{
+		Chunk chunk;
+		if (!m_Chunks.empty() && (m_Chunks.back()->size() < CHUNK_SIZE))
+		{
+			chunk = *m_Chunks.back();
+			m_Chunks.pop_back();
+		}
+		auto count = std::min(CHUNK_SIZE - chunk.size(), m_Size - newPos);
+		auto first = a_Contacts.cbegin() + static_cast<std::ptrdiff_t>(newPos);
+		chunk.insert(chunk.end(), first, first + static_cast<std::ptrdiff_t>(count));
+		m_Chunks.push_back(std::make_shared<const Chunk>(std::move(chunk)));
+		newPos += count;
+	}
+
+	// Index the chunk starts, for at():
+	m_ChunkStarts.reserve(m_Chunks.size());
+	size_t start = 0;
+	for (const auto & chunk: m_Chunks)
+	{
+		m_ChunkStarts.push_back(start);
+		start += chunk->size();
+	}
+	assert(start == m_Size);
+}
+
+
+
+
+
+const ContactPtr & ContactBookSnapshot::at(size_t a_Index) const
+{
+	assert(a_Index < m_Size);
+	auto idx = static_cast<size_t>(std::upper_bound(m_ChunkStarts.cbegin(), m_ChunkStarts.cend(), a_Index) - m_ChunkStarts.cbegin()) - 1;
+	return (*m_Chunks[idx])[a_Index - m_ChunkStarts[idx]];
+}
+
+
+
+
+
+void ContactBookSnapshot::appendChunk(Chunk && a_Chunk)
+{
+	if (a_Chunk.empty())
+	{
+		return;
+	}
+	if (!m_Chunks.empty())
+	{
+		const auto & last = *m_Chunks.back();
+		auto isSmall = ((last.size() < CHUNK_SIZE / 2) || (a_Chunk.size() < CHUNK_SIZE / 2));
+		if (isSmall && (last.size() + a_Chunk.size() <= CHUNK_SIZE))
+		{
+			Chunk merged;
+			merged.reserve(last.size() + a_Chunk.size());
+			merged.insert(merged.end(), last.cbegin(), last.cend());
+			merged.insert(merged.end(), a_Chunk.cbegin(), a_Chunk.cend());
+			m_Chunks.back() = std::make_shared<const Chunk>(std::move(merged));
+			return;
+		}
+	}
+	m_Chunks.push_back(std::make_shared<const Chunk>(std::move(a_Chunk)));
+}
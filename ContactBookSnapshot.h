@@ -0,0 +1,109 @@
+#ifndef CONTACTBOOKSNAPSHOT_H
+#define CONTACTBOOKSNAPSHOT_H
+
+
+
+
+
+#include <vector>
+#include <memory>
+#include <QtGlobal>
+
+#include "Contact.h"
+
+
+
+
+
+/** An immutable version of the contacts in a ContactBook, as published at the end of a batch.
+Readers on any thread can obtain the current snapshot using ContactBook::snapshot() and scan it without any
+locking, while the writer keeps modifying the ContactBook and publishing new snapshots.
+The contacts are stored in chunks of at most CHUNK_SIZE contacts. A new snapshot is built from the previous one
+and the list of changed positions: the chunks without any change are re-used as they are, wherever they end up
+in the new snapshot, and only the chunks with a changed or removed contact are rebuilt (merged with a neighbour
+if they get too small). Publishing a snapshot after a small change thus costs O(number of chunks), regardless
+of where in the book the change is.
+The contacts themselves are never modified once they are published, the writer replaces them instead
+(ContactBook::replaceContact()). Readers must not modify the contacts either. */
+class ContactBookSnapshot
+{
+public:
+
+	/** The maximum number of contacts stored in a single chunk. */
+	static const size_t CHUNK_SIZE = 64;
+
+	using Chunk = std::vector<ContactPtr>;
+	using ChunkPtr = std::shared_ptr<const Chunk>;
+
+
+	/** Creates an empty snapshot. */
+	ContactBookSnapshot();
+
+	/** Creates a new snapshot of the specified contacts, sharing the unchanged chunks with a_Previous.
+	a_Contacts must be the contacts of a_Previous, with the ones at a_Removed positions removed, the ones at
+	a_Changed positions replaced and any new contacts appended. Both a_Removed and a_Changed are sorted
+	positions in a_Previous. The new snapshot gets the version following a_Previous. */
+	ContactBookSnapshot(
+		const ContactBookSnapshot & a_Previous,
+		const std::vector<ContactPtr> & a_Contacts,
+		const std::vector<size_t> & a_Removed,
+		const std::vector<size_t> & a_Changed
+	);
+
+	/** Returns the number of contacts in the snapshot. */
+	size_t size() const { return m_Size; }
+
+	/** Returns true if the snapshot contains no contacts. */
+	bool empty() const { return (m_Size == 0); }
+
+	/** Returns the contact at the specified index.
+	Takes O(log(number of chunks)); readers going through many contacts should use forEach() or chunks(). */
+	const ContactPtr & at(size_t a_Index) const;
+
+	/** Returns the version of the ContactBook data that this snapshot represents.
+	The version increases with each published snapshot. */
+	quint64 version() const { return m_Version; }
+
+	/** Returns the chunks, for readers that want to process the snapshot in parallel. */
+	const std::vector<ChunkPtr> & chunks() const { return m_Chunks; }
+
+	/** Calls a_Fn for each contact in the snapshot, in order. */
+	template <typename Fn> void forEach(Fn a_Fn) const
+	{
+		for (const auto & chunk: m_Chunks)
+		{
+			for (const auto & contact: *chunk)
+			{
+				a_Fn(contact);
+			}
+		}
+	}
+
+
+protected:
+
+	/** The chunks storing the contacts, each non-empty and with at most CHUNK_SIZE contacts. */
+	std::vector<ChunkPtr> m_Chunks;
+
+	/** The index of the first contact of each chunk in m_Chunks, used by at(). */
+	std::vector<size_t> m_ChunkStarts;
+
+	/** The total number of contacts in all the chunks. */
+	size_t m_Size;
+
+	/** The version of the ContactBook data represented by this snapshot. */
+	quint64 m_Version;
+
+
+	/** Appends the chunk to m_Chunks, merging it into the last chunk if either of them is less than half full
+	and the result fits into a single chunk. */
+	void appendChunk(Chunk && a_Chunk);
+};
+
+using ContactBookSnapshotPtr = std::shared_ptr<const ContactBookSnapshot>;
+
+
+
+
+
+#endif // CONTACTBOOKSNAPSHOT_H
@@ -83,6 +83,69 @@ static void logRequest(const QNetworkRequest & a_Request, const QByteArray & a_R
 
 
 
+/** Returns the position right after the last complete </DAV:response> end tag in the data, regardless of
+the namespace prefix used ("</d:response>", "</response>").
+Returns -1 if there's no such end tag. */
+static int findCompleteResponsesEnd(const QByteArray & a_Data)
+{
+	static const char endTag[] = "response>";
+	static const int endTagLen = sizeof(endTag) - 1;
+	auto idx = a_Data.size();
+	while (idx > 0)
+	{
+		idx = a_Data.lastIndexOf(endTag, idx - 1);
+		if (idx < 0)
+		{
+			return -1;
+		}
+
+		// Skip the namespace prefix, if present:
+		auto start = idx;
+		if ((start > 0) && (a_Data[start - 1] == ':'))
+		{
+			start -= 1;
+			while ((start > 0) && (isalnum(static_cast<unsigned char>(a_Data[start - 1])) || (a_Data[start - 1] == '_')))
+			{
+				start -= 1;
+			}
+		}
+		if ((start >= 2) && (a_Data[start - 1] == '/') && (a_Data[start - 2] == '<'))
+		{
+			return idx + endTagLen;
+		}
+	}
+	return -1;
+}
+
+
+
+
+
+/** Returns the key under which the children of the specified URL are stored in the parent -> children index.
+It is the URL without the trailing slash, so that both forms of the URL share the same children. */
+static QString childrenKey(const QUrl & a_Url)
+{
+	return a_Url.adjusted(QUrl::StripTrailingSlash | QUrl::RemoveQuery | QUrl::RemoveFragment).toString();
+}
+
+
+
+
+
+/** Returns the childrenKey() of the parent of the specified URL. */
+static QString parentKey(const QUrl & a_Url)
+{
+	return a_Url
+		.adjusted(QUrl::StripTrailingSlash | QUrl::RemoveQuery | QUrl::RemoveFragment)
+		.adjusted(QUrl::RemoveFilename)
+		.adjusted(QUrl::StripTrailingSlash)
+		.toString();
+}
+
+
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // DavPropertyTree::TextProperty:
 
@@ -90,7 +153,9 @@ static DavPropertyHandlers::Registrator g_RegTextProperty[] =
 {
 	{NS_DAV,     "displayname",  std::make_shared<DavPropertyTree::TextProperty>()},
 	{NS_DAV,     "getetag",      std::make_shared<DavPropertyTree::TextProperty>()},
+	{NS_DAV,     "sync-token",   std::make_shared<DavPropertyTree::TextProperty>()},
 	{NS_CARDDAV, "address-data", std::make_shared<DavPropertyTree::TextProperty>()},
+	{NS_CALENDARSERVER, "getctag", std::make_shared<DavPropertyTree::TextProperty>()},
 };
 
 std::shared_ptr<DavPropertyTree::Property> DavPropertyTree::TextProperty::createInstance(const QDomNode & a_Node)
@@ -107,6 +172,17 @@ std::shared_ptr<DavPropertyTree::Property> DavPropertyTree::TextProperty::create
 
 
 
+std::shared_ptr<DavPropertyTree::Property> DavPropertyTree::TextProperty::createInstance(QXmlStreamReader & a_Reader)
+{
+	std::shared_ptr<DavPropertyTree::TextProperty> res(new DavPropertyTree::TextProperty);
+	res->m_Value = a_Reader.readElementText(QXmlStreamReader::IncludeChildElements);
+	return res;
+}
+
+
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // DavPropertyTree::HrefProperty:
 
@@ -133,6 +209,27 @@ std::shared_ptr<DavPropertyTree::Property> DavPropertyTree::HrefProperty::create
 
 
 
+std::shared_ptr<DavPropertyTree::Property> DavPropertyTree::HrefProperty::createInstance(QXmlStreamReader & a_Reader)
+{
+	std::shared_ptr<DavPropertyTree::HrefProperty> res(new DavPropertyTree::HrefProperty);
+	while (a_Reader.readNextStartElement())
+	{
+		if ((a_Reader.namespaceUri() == "DAV:") && (a_Reader.name() == "href") && res->m_Href.isEmpty())
+		{
+			res->m_Href = a_Reader.readElementText(QXmlStreamReader::IncludeChildElements).trimmed();
+		}
+		else
+		{
+			a_Reader.skipCurrentElement();
+		}
+	}
+	return res;
+}
+
+
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // DavPropertyTree::ResourceTypeProperty:
 
@@ -157,6 +254,21 @@ std::shared_ptr<DavPropertyTree::Property> DavPropertyTree::ResourceTypeProperty
 
 
 
+std::shared_ptr<DavPropertyTree::Property> DavPropertyTree::ResourceTypeProperty::createInstance(QXmlStreamReader & a_Reader)
+{
+	std::shared_ptr<DavPropertyTree::ResourceTypeProperty> res(new DavPropertyTree::ResourceTypeProperty);
+	while (a_Reader.readNextStartElement())
+	{
+		res->m_ResourceTypes.push_back(std::make_pair(a_Reader.namespaceUri().toString(), a_Reader.name().toString()));
+		a_Reader.skipCurrentElement();
+	}
+	return res;
+}
+
+
+
+
+
 bool DavPropertyTree::ResourceTypeProperty::hasResourceType(const QString & a_Namespace, const QString & a_LocalName) const
 {
 	for (const auto & rt: m_ResourceTypes)
@@ -195,13 +307,23 @@ void DavPropertyTree::Node::addProperty(const QString & a_Namespace, const QStri
 
 
 
+void DavPropertyTree::Node::removeProperty(const QString & a_Namespace, const QString & a_PropName)
+{
+	m_Properties.erase(std::make_pair(a_Namespace, a_PropName));
+}
+
+
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // DavPropertyTree:
 
 DavPropertyTree::DavPropertyTree(const QUrl & a_BaseUrl, const QString & a_UserName, const QString & a_Password):
 	m_BaseUrl(a_BaseUrl),
 	m_UserName(a_UserName),
-	m_Password(a_Password)
+	m_Password(a_Password),
+	m_IsResponseComplete(false)
 {
 	connect(&m_NAM, &QNetworkAccessManager::finished,               this, &DavPropertyTree::internalRequestFinished);
 	connect(&m_NAM, &QNetworkAccessManager::authenticationRequired, this, &DavPropertyTree::authenticationRequired);
@@ -211,7 +333,7 @@ DavPropertyTree::DavPropertyTree(const QUrl & a_BaseUrl, const QString & a_UserN
 
 
 
-void DavPropertyTree::sendRequest(
+QNetworkReply * DavPropertyTree::sendRequest(
 	const QUrl & a_Url,
 	const char * a_HttpMethod,
 	int a_Depth,
@@ -223,17 +345,74 @@ void DavPropertyTree::sendRequest(
 	req->setAttribute(QNetworkRequest::User, a_UserData);
 	req->setHeader(QNetworkRequest::ContentTypeHeader, "application/xml; charset=utf-8");
 	req->setRawHeader("Depth", QByteArray::number(a_Depth));
+	return sendNetworkRequest(*req, a_HttpMethod, a_RequestBody);
+}
+
+
+
+
+
+QNetworkReply * DavPropertyTree::sendResourceRequest(
+	const QUrl & a_Url,
+	const char * a_HttpMethod,
+	const QByteArray & a_RequestBody,
+	const QByteArray & a_ContentType,
+	const QList<QPair<QByteArray, QByteArray>> & a_Headers,
+	const QVariant & a_UserData
+)
+{
+	QNetworkRequest req(a_Url);
+	req.setAttribute(QNetworkRequest::User, a_UserData);
+	req.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+	if (!a_ContentType.isEmpty())
+	{
+		req.setHeader(QNetworkRequest::ContentTypeHeader, a_ContentType);
+	}
+	for (const auto & hdr: a_Headers)
+	{
+		req.setRawHeader(hdr.first, hdr.second);
+	}
+	return sendNetworkRequest(req, a_HttpMethod, a_RequestBody);
+}
+
+
+
+
 
+QNetworkReply * DavPropertyTree::sendNetworkRequest(
+	QNetworkRequest & a_Request,
+	const char * a_HttpMethod,
+	const QByteArray & a_RequestBody
+)
+{
 	// Assign a new QBuffer for the data:
 	auto bufferIndex = m_NextBufferIndex++;
 	m_Buffers[bufferIndex] = std::make_shared<QBuffer>();
 	auto buf = m_Buffers[bufferIndex];
 	buf->setData(a_RequestBody);
 	buf->open(QIODevice::ReadOnly);
-	req->setAttribute(QNetworkRequest::UserMax, bufferIndex);
-
-	// Send the request:
-	m_NAM.sendCustomRequest(*req, a_HttpMethod, buf.get());
+	a_Request.setAttribute(QNetworkRequest::UserMax, bufferIndex);
+
+	// Send the request, parse the response while it is being received:
+	auto parser = std::make_shared<ResponseParser>(a_Request.url());
+	parser->m_Method = a_HttpMethod;
+	parser->m_BytesUp = a_RequestBody.size();
+	parser->m_SinceSent.start();
+	auto reply = m_NAM.sendCustomRequest(a_Request, a_HttpMethod, buf.get());
+	m_ResponseParsers[reply] = parser;
+	connect(reply, &QNetworkReply::metaDataChanged, this,
+		[this, reply]()
+		{
+			markFirstByte(reply);
+		}
+	);
+	connect(reply, &QNetworkReply::readyRead, this,
+		[this, reply]()
+		{
+			replyReadyRead(reply);
+		}
+	);
+	return reply;
 }
 
 
@@ -242,35 +421,9 @@ void DavPropertyTree::sendRequest(
 
 void DavPropertyTree::processResponse(const QNetworkReply & a_Reply, const QByteArray & a_Response)
 {
-	try
-	{
-		internalProcessResponse(a_Reply, a_Response);
-	}
-	catch (const EDavResponseException & exc)
-	{
-		qDebug() << "Error while processing response:";
-		const auto & req = a_Reply.request();
-		qDebug() << "Request: "
-			<< req.attribute(QNetworkRequest::UserMax) << req.url();
-		qDebug() << "Response: "
-			<< a_Reply.attribute(QNetworkRequest::HttpStatusCodeAttribute)
-			<< a_Reply.attribute(QNetworkRequest::HttpReasonPhraseAttribute)
-			<< "\n"
-			<< a_Response;
-		qDebug() << "Error: "
-			<< "File " << exc.m_SrcFileName.c_str()
-			<< "line " << exc.m_SrcLine
-			<< ", Message: " << exc.m_Message;
-		emit responseError(
-			&a_Reply,
-			&a_Response,
-			a_Reply.request().attribute(QNetworkRequest::User),
-			tr("%1 (%2:%3)")
-				.arg(exc.m_Message)
-				.arg(QString::fromStdString(exc.m_SrcFileName))
-				.arg(exc.m_SrcLine)
-		);
-	}
+	ResponseParser parser(a_Reply.url());
+	feedParser(parser, a_Response, true);
+	reportParserResult(a_Reply, parser);
 }
 
 
@@ -307,6 +460,11 @@ DavPropertyTree::Node & DavPropertyTree::node(const QUrl & a_Url)
 	// The URL doesn't exist in our storage, create it:
 	auto & res = m_NodeMap[a_Url];
 	res.reset(new Node(a_Url));
+	auto parent = parentKey(a_Url);
+	if (parent != childrenKey(a_Url))
+	{
+		m_Children[parent].insert(a_Url);
+	}
 	return *res;
 }
 
@@ -339,79 +497,202 @@ QString DavPropertyTree::hrefFromUrl(const QUrl & a_Url) const
 
 QList<QUrl> DavPropertyTree::nodeChildren(const QUrl & a_NodeUrl)
 {
-	auto parentPath = a_NodeUrl.path();
+	auto itr = m_Children.constFind(childrenKey(a_NodeUrl));
+	if (itr == m_Children.constEnd())
+	{
+		return QList<QUrl>();
+	}
 	QList<QUrl> res;
-	for (auto itr = m_NodeMap.constBegin(), end = m_NodeMap.constEnd(); itr != end; ++itr)
+	res.reserve(itr->size());
+	for (const auto & url: *itr)
+	{
+		res.append(url);
+	}
+	return res;
+}
+
+
+
+
+
+void DavPropertyTree::removeNode(const QUrl & a_Url)
+{
+	// Find the URL, possibly with the trailing slash switched, same as node() does:
+	auto itr = m_NodeMap.find(a_Url);
+	if (itr == m_NodeMap.end())
 	{
-		const auto & url = itr.key();
-		if (a_NodeUrl.isParentOf(url))
+		auto anotherUrlStr = a_Url.toString();
+		if (anotherUrlStr.endsWith('/'))
 		{
-			auto childPath = url.path();
-			auto diff = childPath.mid(parentPath.length());
-			if (diff.endsWith('/'))
-			{
-				diff.remove(diff.length() - 1, 1);
-			}
-			if (!diff.contains('/'))
-			{
-				res.append(url);
-			}
+			itr = m_NodeMap.find(QUrl(anotherUrlStr.left(anotherUrlStr.length() - 1)));
+		}
+		else
+		{
+			itr = m_NodeMap.find(QUrl(anotherUrlStr + "/"));
+		}
+		if (itr == m_NodeMap.end())
+		{
+			return;
 		}
 	}
-	return res;
+
+	// Remove from the children index:
+	auto url = itr.key();
+	auto itrParent = m_Children.find(parentKey(url));
+	if (itrParent != m_Children.end())
+	{
+		itrParent->remove(url);
+		if (itrParent->isEmpty())
+		{
+			m_Children.erase(itrParent);
+		}
+	}
+	m_NodeMap.erase(itr);
 }
 
 
 
 
 
-void DavPropertyTree::internalProcessResponse(const QNetworkReply & a_Reply, const QByteArray & a_Response)
+int DavPropertyTree::parseStatusLine(const QString & a_StatusLine)
 {
-	// Only process a 207 (multistatus) response, skip all the others:
-	auto httpResponseCode = a_Reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-	if (httpResponseCode != 207)
+	if (a_StatusLine.left(7) != "HTTP/1.")
 	{
-		qDebug() << __FUNCTION__ << ": Skipping response, not a 207 multistatus, but a " << httpResponseCode;
+		qDebug() << __FUNCTION__ << ": Cannot parse status (initial match): " << a_StatusLine;
+		return -1;
+	}
+	auto firstSpace = a_StatusLine.indexOf(' ');
+	if (firstSpace < 0)
+	{
+		qDebug() << __FUNCTION__ << ": Cannot parse status (no space): " << a_StatusLine;
+		return -1;
+	}
+	auto secondSpace = a_StatusLine.indexOf(' ', firstSpace + 1);
+	if (secondSpace < 0)
+	{
+		qDebug() << __FUNCTION__ << ": Cannot parse status (second space): " << a_StatusLine;
+		return -1;
+	}
+	bool ok = false;
+	auto statusNum = a_StatusLine.mid(firstSpace + 1, secondSpace - firstSpace - 1).toInt(&ok);
+	if (!ok)
+	{
+		qDebug() << __FUNCTION__ << ": Cannot parse status (not a number): " << a_StatusLine;
+		return -1;
+	}
+	return statusNum;
+}
+
+
+
+
+
+void DavPropertyTree::feedParser(ResponseParser & a_Parser, const QByteArray & a_Data, bool a_IsFinal)
+{
+	if (a_Parser.m_HasFailed)
+	{
+		// Keep the data for the error report
+		a_Parser.m_Body.append(a_Data);
 		return;
 	}
+	a_Parser.m_Pending.append(a_Data);
 
-	// Parse the XML body:
-	QDomDocument doc;
-	QString err;
-	if (!doc.setContent(a_Response, true, &err))
+	// Feed the reader only with complete <response> elements, so that the elements are never processed
+	// while only partially received (the processing cannot be suspended and resumed):
+	auto end = a_IsFinal ? a_Parser.m_Pending.size() : findCompleteResponsesEnd(a_Parser.m_Pending);
+	if ((end <= 0) && !a_IsFinal)
 	{
-		throw EDavResponseException(
-			__FILE__, __LINE__,
-			tr("Cannot parse server response when asking for current user principal: %1").arg(err)
-		);
+		return;
 	}
+	auto toParse = a_Parser.m_Pending.left(end);
+	a_Parser.m_Pending.remove(0, end);
+	a_Parser.m_Reader.addData(toParse);
 
-	// Process the XML:
-	bool hasMultiStatus = false;
-	auto n = doc.firstChild();
-	while (!n.isNull())
+	QElapsedTimer parseTimer;
+	parseTimer.start();
+	try
+	{
+		parseAvailable(a_Parser, a_IsFinal);
+	}
+	catch (const EDavResponseException & exc)
+	{
+		qDebug() << "Error while processing response for " << a_Parser.m_Url << ":";
+		qDebug() << "Error: "
+			<< "File " << exc.m_SrcFileName.c_str()
+			<< "line " << exc.m_SrcLine
+			<< ", Message: " << exc.m_Message;
+		a_Parser.m_HasFailed = true;
+		a_Parser.m_Error = tr("%1 (%2:%3)")
+			.arg(exc.m_Message)
+			.arg(QString::fromStdString(exc.m_SrcFileName))
+			.arg(exc.m_SrcLine);
+
+		// The data parsed before this batch is gone; keep the failing batch and the rest for the error report:
+		a_Parser.m_Body = toParse + a_Parser.m_Pending;
+		a_Parser.m_Pending.clear();
+	}
+	a_Parser.m_ParseNsec += parseTimer.nsecsElapsed();
+}
+
+
+
+
+
+void DavPropertyTree::parseAvailable(ResponseParser & a_Parser, bool a_IsFinal)
+{
+	auto & reader = a_Parser.m_Reader;
+	for (;;)
 	{
-		if ((n.namespaceURI() == "DAV:") && (n.localName() == "multistatus"))
+		auto token = reader.readNext();
+		if ((token == QXmlStreamReader::Invalid) || (token == QXmlStreamReader::EndDocument))
+		{
+			break;
+		}
+		if (token != QXmlStreamReader::StartElement)
+		{
+			continue;
+		}
+		if (!a_Parser.m_HasMultiStatus)
 		{
-			// Process a "multistatus" response
-			hasMultiStatus = true;
-			auto n2 = n.firstChild();
-			while (!n2.isNull())
+			// This is the root element, it must be a "multistatus":
+			if ((reader.namespaceUri() != NS_DAV) || (reader.name() != "multistatus"))
 			{
-				if (n2.namespaceURI() == "DAV:")
-				{
-					if (n2.localName() == "response")
-					{
-						// Process a "response" element
-						processElementResponse(n2);
-					}
-				}
-				n2 = n2.nextSibling();
+				throw EDavResponseException(
+					__FILE__, __LINE__,
+					tr("Response doesn't contain a DAV:multistatus element")
+				);
 			}
+			a_Parser.m_HasMultiStatus = true;
+			continue;
 		}
-		n = n.nextSibling();
+		if ((reader.namespaceUri() == NS_DAV) && (reader.name() == "response"))
+		{
+			// Process a "response" element
+			processElementResponse(a_Parser);
+		}
+		else if ((reader.namespaceUri() == NS_DAV) && (reader.name() == "sync-token"))
+		{
+			// Process the new sync token of a sync-collection REPORT
+			processElementSyncToken(a_Parser.m_Url, reader.readElementText(QXmlStreamReader::IncludeChildElements));
+		}
+		else
+		{
+			reader.skipCurrentElement();
+		}
+	}
+
+	// Running out of data is expected, unless this is the final part of the response:
+	if (
+		reader.hasError() &&
+		(a_IsFinal || (reader.error() != QXmlStreamReader::PrematureEndOfDocumentError))
+	)
+	{
+		throw EDavResponseException(
+			__FILE__, __LINE__,
+			tr("Cannot parse server response: %1 (line %2)").arg(reader.errorString()).arg(reader.lineNumber())
+		);
 	}
-	if (!hasMultiStatus)
+	if (a_IsFinal && !a_Parser.m_HasMultiStatus)
 	{
 		throw EDavResponseException(
 			__FILE__, __LINE__,
@@ -424,107 +705,188 @@ void DavPropertyTree::internalProcessResponse(const QNetworkReply & a_Reply, con
 
 
 
-void DavPropertyTree::processElementResponse(const QDomNode & a_ResponseElement)
+void DavPropertyTree::reportParserResult(const QNetworkReply & a_Reply, ResponseParser & a_Parser)
 {
-	qDebug() << __FUNCTION__ << ": Processing <response> element.";
-
-	// Find the href for which this element is reported:
-	QString href;
-	auto n = a_ResponseElement.firstChild();
-	while (!n.isNull())
+	m_ResponseStatuses = std::move(a_Parser.m_ResponseStatuses);
+	m_ResponseUrls = std::move(a_Parser.m_ResponseUrls);
+	m_IsResponseComplete = !a_Parser.m_HasFailed;
+	if (!a_Parser.m_HasFailed)
 	{
-		if ((n.namespaceURI() == "DAV:") && (n.localName() == "href") && n.hasChildNodes())
-		{
-			href = n.firstChild().toText().data();
-			break;
-		}
-		n = n.nextSibling();
+		return;
 	}
-	if (href.isEmpty())
+	const auto & req = a_Reply.request();
+	qDebug() << "Error while processing response:";
+	qDebug() << "Request: "
+		<< req.attribute(QNetworkRequest::UserMax) << req.url();
+	qDebug() << "Response: "
+		<< a_Reply.attribute(QNetworkRequest::HttpStatusCodeAttribute)
+		<< a_Reply.attribute(QNetworkRequest::HttpReasonPhraseAttribute)
+		<< "\n"
+		<< a_Parser.m_Body;
+	emit responseError(
+		&a_Reply,
+		&a_Parser.m_Body,
+		req.attribute(QNetworkRequest::User),
+		a_Parser.m_Error
+	);
+}
+
+
+
+
+
+void DavPropertyTree::markFirstByte(QNetworkReply * a_Reply)
+{
+	auto parser = m_ResponseParsers.value(a_Reply);
+	if ((parser == nullptr) || (parser->m_TimeToFirstByteUsec >= 0))
 	{
-		qDebug() << __FUNCTION__ << ": No <DAV:href> element found in <DAV:response>, skipping the response node.";
 		return;
 	}
+	parser->m_TimeToFirstByteUsec = parser->m_SinceSent.nsecsElapsed() / 1000;
+}
 
-	// Process each member of the response:
-	n = a_ResponseElement.firstChild();
-	while (!n.isNull())
+
+
+
+
+void DavPropertyTree::recordMetrics(const QNetworkReply & a_Reply, const ResponseParser & a_Parser)
+{
+	DavRequestMetrics::Sample sample;
+	sample.m_Method = a_Parser.m_Method;
+	sample.m_RequestType = a_Reply.request().attribute(QNetworkRequest::User).toInt();
+	sample.m_HttpStatus = a_Reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	sample.m_TotalUsec = a_Parser.m_SinceSent.nsecsElapsed() / 1000;
+	sample.m_TimeToFirstByteUsec = a_Parser.m_TimeToFirstByteUsec;
+	if ((sample.m_TimeToFirstByteUsec < 0) && (sample.m_HttpStatus != 0))
 	{
-		if (n.namespaceURI() == "DAV:")
-		{
-			if (n.localName() == "propstat")
-			{
-				processElementPropstat(href, n);
-			}
-		}
-		n = n.nextSibling();
+		// A response without any body and without a separate headers notification:
+		sample.m_TimeToFirstByteUsec = sample.m_TotalUsec;
 	}
+	sample.m_ParseUsec = a_Parser.m_ParseNsec / 1000;
+	sample.m_BytesUp = a_Parser.m_BytesUp;
+	sample.m_BytesDown = a_Parser.m_BytesDown;
+	m_Metrics.addSample(sample);
 }
 
 
 
 
-void DavPropertyTree::processElementPropstat(
-	const QString & a_Href,
-	const QDomNode & a_PropstatElement
-)
+
+void DavPropertyTree::processElementResponse(ResponseParser & a_Parser)
 {
-	qDebug() << __FUNCTION__ << ": Processing <propstat> element.";
-	auto n = a_PropstatElement.firstChild();
-	QDomNode propElement, statusElement;
-	while (!n.isNull())
+	qDebug() << __FUNCTION__ << ": Processing <response> element.";
+
+	// The href comes first, followed by either the propstats, or the status for the whole resource:
+	auto & reader = a_Parser.m_Reader;
+	QString href;
+	while (reader.readNextStartElement())
 	{
-		if (n.namespaceURI() == "DAV:")
+		if (reader.namespaceUri() != NS_DAV)
+		{
+			reader.skipCurrentElement();
+			continue;
+		}
+		if (reader.name() == "href")
 		{
-			if (n.localName() == "prop")
+			auto text = reader.readElementText(QXmlStreamReader::IncludeChildElements).trimmed();
+			if (href.isEmpty())
 			{
-				propElement = n;
+				href = text;
 			}
-			else if (n.localName() == "status")
+		}
+		else if (reader.name() == "propstat")
+		{
+			if (href.isEmpty())
 			{
-				statusElement = n;
+				qDebug() << __FUNCTION__ << ": No <DAV:href> element before <DAV:propstat>, skipping the propstat.";
+				reader.skipCurrentElement();
+				continue;
 			}
+			processElementPropstat(href, reader);
+		}
+		else if (reader.name() == "status")
+		{
+			// A status for the whole resource, such as a removed member in a sync-collection REPORT:
+			auto statusNum = parseStatusLine(reader.readElementText(QXmlStreamReader::IncludeChildElements).trimmed());
+			if (href.isEmpty())
+			{
+				qDebug() << __FUNCTION__ << ": No <DAV:href> element before <DAV:status>, skipping the status.";
+				continue;
+			}
+			auto url = urlFromHref(href);
+			a_Parser.m_ResponseStatuses[url] = statusNum;
+			if (statusNum == 404)
+			{
+				qDebug() << __FUNCTION__ << ": Resource reported as removed: " << url.toString();
+				removeNode(url);
+			}
+		}
+		else
+		{
+			reader.skipCurrentElement();
 		}
-		n = n.nextSibling();
-	}
-	if (propElement.isNull() || statusElement.isNull())
-	{
-		qDebug()
-			<< __FUNCTION__ << ": Missing prop or status element inside a propstat element:"
-			<< "Prop: " << propElement.isNull()
-			<< "Status: " << statusElement.isNull();
-		return;
 	}
-	if (!statusElement.hasChildNodes())
+	if (href.isEmpty())
 	{
-		qDebug() << __FUNCTION__ << ": status element has no content.";
+		qDebug() << __FUNCTION__ << ": No <DAV:href> element found in <DAV:response>, skipped the response node.";
 		return;
 	}
+	a_Parser.m_ResponseUrls.insert(urlFromHref(href));
+}
 
-	// Parse and check the status line:
-	auto status = statusElement.firstChild().toText().data();
-	if (status.left(7) != "HTTP/1.")
-	{
-		qDebug() << __FUNCTION__ << ": Cannot parse status (initial match): " << status;
-		return;
-	}
-	auto firstSpace = status.indexOf(' ');
-	if (firstSpace < 0)
+
+
+
+
+void DavPropertyTree::processElementSyncToken(const QUrl & a_Url, const QString & a_SyncToken)
+{
+	std::shared_ptr<TextProperty> token(new TextProperty);
+	token->setValue(a_SyncToken.trimmed());
+	qDebug() << __FUNCTION__ << ": New sync token for " << a_Url.toString() << ": " << token->value();
+	node(a_Url).addProperty(NS_DAV, "sync-token", token);
+}
+
+
+
+
+
+void DavPropertyTree::processElementPropstat(const QString & a_Href, QXmlStreamReader & a_Reader)
+{
+	qDebug() << __FUNCTION__ << ": Processing <propstat> element.";
+
+	// The status follows the properties, so the properties need to be parsed before their status is known:
+	std::vector<std::tuple<QString, QString, std::shared_ptr<Property>>> props;
+	bool hasProp = false;
+	QString status;
+	while (a_Reader.readNextStartElement())
 	{
-		qDebug() << __FUNCTION__ << ": Cannot parse status (no space): " << status;
-		return;
+		if ((a_Reader.namespaceUri() == NS_DAV) && (a_Reader.name() == "prop"))
+		{
+			hasProp = true;
+			processElementProp(a_Reader, props);
+		}
+		else if ((a_Reader.namespaceUri() == NS_DAV) && (a_Reader.name() == "status"))
+		{
+			status = a_Reader.readElementText(QXmlStreamReader::IncludeChildElements).trimmed();
+		}
+		else
+		{
+			a_Reader.skipCurrentElement();
+		}
 	}
-	auto secondSpace = status.indexOf(' ', firstSpace + 1);
-	if (secondSpace < 0)
+	if (!hasProp || status.isEmpty())
 	{
-		qDebug() << __FUNCTION__ << ": Cannot parse status (second space): " << status;
+		qDebug()
+			<< __FUNCTION__ << ": Missing prop or status element inside a propstat element:"
+			<< "Prop: " << hasProp
+			<< "Status: " << status;
 		return;
 	}
-	bool ok = false;
-	auto statusNum = status.mid(firstSpace + 1, secondSpace - firstSpace - 1).toInt(&ok);
-	if (!ok)
+
+	// Check the status:
+	auto statusNum = parseStatusLine(status);
+	if (statusNum < 0)
 	{
-		qDebug() << __FUNCTION__ << ": Cannot parse status (not a number): " << status;
 		return;
 	}
 	if (statusNum / 100 != 2)
@@ -533,40 +895,46 @@ void DavPropertyTree::processElementPropstat(
 		return;
 	}
 
-	// The status is OK, process the property:
-	processElementProp(a_Href, propElement);
+	// The status is OK, store the properties:
+	auto & n = this->node(urlFromHref(a_Href));
+	for (auto & prop: props)
+	{
+		n.addProperty(std::get<0>(prop), std::get<1>(prop), std::move(std::get<2>(prop)));
+		qDebug() << __FUNCTION__ << ": Added property " << std::get<0>(prop) << ":" << std::get<1>(prop);
+	}
 }
 
 
 
 
-void DavPropertyTree::processElementProp(const QString & a_Href, const QDomNode & a_PropElement)
+void DavPropertyTree::processElementProp(
+	QXmlStreamReader & a_Reader,
+	std::vector<std::tuple<QString, QString, std::shared_ptr<Property>>> & a_Props
+)
 {
 	qDebug() << __FUNCTION__ << ": Processing <prop> element.";
-	auto & n = this->node(urlFromHref(a_Href));
-	const auto & children = a_PropElement.childNodes();
-	int size = children.size();
-	for (int i = 0; i < size; ++i)
+	while (a_Reader.readNextStartElement())
 	{
-		const auto & child = children.at(i);
-		auto handler = DavPropertyHandlers::find(child.namespaceURI(), child.localName());
+		auto ns = a_Reader.namespaceUri().toString();
+		auto localName = a_Reader.name().toString();
+		auto handler = DavPropertyHandlers::find(ns, localName);
 		if (handler == nullptr)
 		{
 			qDebug()
 				<< __FUNCTION__ << ": No handler for property "
-				<< child.namespaceURI() << ":" << child.localName();
+				<< ns << ":" << localName;
+			a_Reader.skipCurrentElement();
 			continue;
 		}
-		auto inst = handler->createInstance(child);
+		auto inst = handler->createInstance(a_Reader);
 		if (inst == nullptr)
 		{
 			qDebug()
 				<< __FUNCTION__ << ": Failed to create property instance for property "
-				<< child.namespaceURI() << ":" << child.localName();
+				<< ns << ":" << localName;
 			continue;
 		}
-		n.addProperty(child.namespaceURI(), child.localName(), inst);
-		qDebug() << __FUNCTION__ << ": Added property " << child.namespaceURI() << ":" << child.localName();
+		a_Props.emplace_back(ns, localName, inst);
 	}
 }
 
@@ -581,17 +949,63 @@ void DavPropertyTree::internalRequestFinished(QNetworkReply * a_Reply)
 	auto buffer = m_Buffers[bufferIndex];
 	m_Buffers.remove(bufferIndex);
 
-	auto baResp = a_Reply->readAll();
+	// Get the parser that has processed the data received so far:
+	auto parser = m_ResponseParsers.take(a_Reply);
+	bool isTracked = (parser != nullptr);
+	if (!isTracked)
+	{
+		parser = std::make_shared<ResponseParser>(a_Reply->url());
+	}
+	auto rest = a_Reply->readAll();
+	parser->m_BytesDown += rest.size();
+
+	m_ResponseStatuses.clear();
+	m_ResponseUrls.clear();
+	m_IsResponseComplete = false;
+	auto httpResponseCode = a_Reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if ((a_Reply->error() == QNetworkReply::NoError) && (httpResponseCode == 207))
+	{
+		feedParser(*parser, rest, true);
+		reportParserResult(*a_Reply, *parser);
+	}
+	else
+	{
+		// Only a 207 (multistatus) response is processed, skip all the others:
+		parser->m_Body.append(rest);
+		qDebug() << __FUNCTION__ << ": Skipping response, not a 207 multistatus, but a " << httpResponseCode;
+	}
 
 	// DEBUG:
 	logRequest(a_Reply->request(), buffer->buffer());
-	logReply(a_Reply, baResp);
+	logReply(a_Reply, parser->m_Body);
+	if (isTracked)
+	{
+		recordMetrics(*a_Reply, *parser);
+	}
+	emit requestFinished(a_Reply, &parser->m_Body, a_Reply->request().attribute(QNetworkRequest::User));
+}
 
-	if (a_Reply->error() == QNetworkReply::NoError)
+
+
+
+
+void DavPropertyTree::replyReadyRead(QNetworkReply * a_Reply)
+{
+	auto parser = m_ResponseParsers.value(a_Reply);
+	if (parser == nullptr)
 	{
-		processResponse(*a_Reply, baResp);
+		return;
+	}
+	markFirstByte(a_Reply);
+	auto data = a_Reply->readAll();
+	parser->m_BytesDown += data.size();
+	if (a_Reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 207)
+	{
+		// Not a multistatus, will not be parsed
+		parser->m_Body.append(data);
+		return;
 	}
-	emit requestFinished(a_Reply, &baResp, a_Reply->request().attribute(QNetworkRequest::User));
+	feedParser(*parser, data, false);
 }
 
 
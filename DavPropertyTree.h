@@ -7,13 +7,19 @@
 
 #include <unordered_map>
 #include <memory>
+#include <tuple>
+#include <vector>
 #include <atomic>
 #include <QString>
 #include <QObject>
 #include <QUrl>
 #include <QHash>
+#include <QSet>
 #include <QNetworkReply>
 #include <QDomDocument>
+#include <QXmlStreamReader>
+#include <QElapsedTimer>
+#include "DavRequestMetrics.h"
 
 
 
@@ -29,8 +35,11 @@ class QBuffer;
 /** Represents a tree of URLs that are discovered on a DAV server, together with the known properties
 for them.
 The information is built incrementally based on the passed WebDAV responses received from the server.
+The multistatus responses are parsed using QXmlStreamReader while they are being received, each <DAV:response>
+element is processed as soon as it has been received completely; no DOM is built for the response.
 The nodes for individual URLs are stored in a map of URL -> DavPropertyTree::Node, so that any
-URL can be quickly located. */
+URL can be quickly located. A parent -> children index is maintained alongside, so that the children of
+a node can be enumerated without scanning all the nodes. */
 class DavPropertyTree:
 	public QObject
 {
@@ -53,6 +62,12 @@ public:
 		/** Creates a new instance of the property, based on the specified DOM node containing the property.
 		a_Node is the DOM node representing the property in the WebDAV server response (<d:prop>). */
 		virtual std::shared_ptr<Property> createInstance(const QDomNode & a_Node) = 0;
+
+		/** Creates a new instance of the property, reading it from the streamed WebDAV server response.
+		a_Reader is positioned at the property's start element; the function must read everything up to and
+		including the property's end element, even if it fails (returns nullptr).
+		The whole property is guaranteed to be available in a_Reader. */
+		virtual std::shared_ptr<Property> createInstance(QXmlStreamReader & a_Reader) = 0;
 	};
 
 
@@ -75,6 +90,7 @@ public:
 
 		// Property overrides:
 		virtual std::shared_ptr<Property> createInstance(const QDomNode & a_Node) override;
+		virtual std::shared_ptr<Property> createInstance(QXmlStreamReader & a_Reader) override;
 	};
 
 
@@ -90,6 +106,7 @@ public:
 		QString m_Href;
 
 		virtual std::shared_ptr<Property> createInstance(const QDomNode & a_Node) override;
+		virtual std::shared_ptr<Property> createInstance(QXmlStreamReader & a_Reader) override;
 	};
 
 
@@ -104,6 +121,7 @@ public:
 		QList<std::pair<QString, QString>> m_ResourceTypes;
 
 		virtual std::shared_ptr<Property> createInstance(const QDomNode & a_Node) override;
+		virtual std::shared_ptr<Property> createInstance(QXmlStreamReader & a_Reader) override;
 
 		/** Returns true if the specified resource type is present in m_ResourceTypes. */
 		bool hasResourceType(const QString & a_Namespace, const QString & a_LocalName) const;
@@ -127,6 +145,9 @@ public:
 			std::shared_ptr<Property> a_Value
 		);
 
+		/** Removes the specified property from the node, if present. */
+		void removeProperty(const QString & a_Namespace, const QString & a_PropName);
+
 		/** Returns the specified property dyn-casted to the templated Property subclass type.
 		If the property is not found, or cannot by dyn-casted, returns nullptr.
 		Typical usage: node.findProp<HrefProperty>("DAV:", "current-user-principal") */
@@ -157,14 +178,28 @@ public:
 
 	/** Sends the specified HTTP request to the server.
 	When the request finishes, it is processed and then the requestFinished signal is emitted.
-	a_UserData is a simple value that is reported back in the requestFinished() signal. */
-	void sendRequest(const QUrl & a_Url,
+	a_UserData is a simple value that is reported back in the requestFinished() signal.
+	Returns the reply object, which can be used to match the request with its requestFinished() signal. */
+	QNetworkReply * sendRequest(const QUrl & a_Url,
 		const char * a_HttpMethod,
 		int a_Depth,
 		const QByteArray & a_RequestBody = QByteArray(),
 		const QVariant & a_UserData = QVariant()
 	);
 
+	/** Sends a request for a single resource, such as PUT or DELETE of a vCard, to the server.
+	a_Headers are added to the request verbatim (If-Match, If-None-Match etc.). The request may be pipelined
+	with the other such requests to the same server.
+	When the request finishes, the requestFinished signal is emitted, the same as for sendRequest().
+	Returns the reply object, which can be used to match the request with its requestFinished() signal. */
+	QNetworkReply * sendResourceRequest(const QUrl & a_Url,
+		const char * a_HttpMethod,
+		const QByteArray & a_RequestBody,
+		const QByteArray & a_ContentType,
+		const QList<QPair<QByteArray, QByteArray>> & a_Headers,
+		const QVariant & a_UserData
+	);
+
 	/** Processes a WebDAV server response, updates the properties based on the response.
 	Normally this shouldn't be called from the outside, unless the client code is doing all the server
 	interactions on its own. This is called internally for all responses received for sendRequest() calls. */
@@ -198,9 +233,41 @@ public:
 	querying the server. */
 	QString hrefFromUrl(const QUrl & a_Url) const;
 
-	/** Returns URLs of known immediate children of the specified node. */
+	/** Returns URLs of known immediate children of the specified node.
+	The trailing slash of a_NodeUrl is ignored. */
 	QList<QUrl> nodeChildren(const QUrl & a_NodeUrl);
 
+	/** Returns the number of requests that have been sent and haven't finished yet. */
+	int numRequestsInFlight() const { return m_Buffers.size(); }
+
+	/** Removes the node representation for the specified URL, together with all its properties.
+	Ignores a trailing slash difference, same as node(). */
+	void removeNode(const QUrl & a_Url);
+
+	/** Returns the statuses reported for whole resources (a <DAV:status> directly in a <DAV:response>, rather
+	than inside a <DAV:propstat>) in the response that has been processed last, mapped by their URL.
+	Such statuses are used by the sync-collection REPORT for the removed members (404) and for truncated
+	results (507 on the collection itself). The nodes reported as 404 are removed from the tree.
+	Intended to be queried from within the requestFinished() signal handler. */
+	const QHash<QUrl, int> & responseStatuses() const { return m_ResponseStatuses; }
+
+	/** Returns the URLs of all the resources listed (as a <DAV:response>) in the response that has been
+	processed last. Used for detecting the resources that have disappeared from a full listing.
+	Intended to be queried from within the requestFinished() signal handler. */
+	const QSet<QUrl> & responseUrls() const { return m_ResponseUrls; }
+
+	/** Returns true if the response that has been processed last was a multistatus that was parsed completely,
+	without any errors, so that responseUrls() lists all the resources in it.
+	Intended to be queried from within the requestFinished() signal handler. */
+	bool isResponseComplete() const { return m_IsResponseComplete; }
+
+	/** Returns the metrics of all the requests sent through this tree that have finished so far.
+	Each request is recorded when it finishes, before the requestFinished() signal is emitted. */
+	const DavRequestMetrics & metrics() const { return m_Metrics; }
+
+	/** Removes all the collected request metrics. */
+	void resetMetrics() { m_Metrics.clear(); }
+
 protected:
 
 	/** Type for mapping URLs to their representation as a Node instance. */
@@ -209,6 +276,72 @@ protected:
 	/** Type for storing QBuffer instances for each individual request sent. */
 	using BufferMap = QMap<unsigned, std::shared_ptr<QBuffer>>;
 
+	/** The state of parsing a single response, while it is being received. */
+	struct ResponseParser
+	{
+		/** The URL of the request, used for the top-level elements (sync-token). */
+		QUrl m_Url;
+
+		/** The parser, fed with the data up to the end of the last completely received <DAV:response>. */
+		QXmlStreamReader m_Reader;
+
+		/** The received data not yet fed to m_Reader (an incomplete <DAV:response> element). */
+		QByteArray m_Pending;
+
+		/** The response body, for the requestFinished() and responseError() signals.
+		Kept whole only for the responses that are not parsed (not a 207). A 207 body is discarded as it is parsed,
+		so that a large multistatus is never held in memory; only the data from a parsing failure on is kept. */
+		QByteArray m_Body;
+
+		/** Set once the DAV:multistatus element has been encountered. */
+		bool m_HasMultiStatus;
+
+		/** Set when the parsing fails; no further data is parsed and m_Error is reported at the end. */
+		bool m_HasFailed;
+
+		/** The description of the parsing failure. */
+		QString m_Error;
+
+		/** The statuses reported for whole resources in this response, see responseStatuses(). */
+		QHash<QUrl, int> m_ResponseStatuses;
+
+		/** The URLs of all the resources listed in this response, see responseUrls(). */
+		QSet<QUrl> m_ResponseUrls;
+
+		/** The HTTP method of the request, for the metrics. */
+		QByteArray m_Method;
+
+		/** Measures the time since the request has been sent. */
+		QElapsedTimer m_SinceSent;
+
+		/** The time from sending the request until the response headers have been received, in microseconds.
+		-1 until the headers are received. */
+		qint64 m_TimeToFirstByteUsec;
+
+		/** The total time spent parsing the response, in nanoseconds. */
+		qint64 m_ParseNsec;
+
+		/** The size of the request body. */
+		qint64 m_BytesUp;
+
+		/** The size of the response body received so far (m_Body may hold only a part of it). */
+		qint64 m_BytesDown;
+
+		explicit ResponseParser(const QUrl & a_Url):
+			m_Url(a_Url),
+			m_HasMultiStatus(false),
+			m_HasFailed(false),
+			m_TimeToFirstByteUsec(-1),
+			m_ParseNsec(0),
+			m_BytesUp(0),
+			m_BytesDown(0)
+		{
+		}
+	};
+
+	/** Type for storing the ResponseParser instances for each reply being received. */
+	using ResponseParserMap = QHash<const QNetworkReply *, std::shared_ptr<ResponseParser>>;
+
 
 	/** The base URL for which the tree is built. */
 	QUrl m_BaseUrl;
@@ -222,6 +355,10 @@ protected:
 	/** All the known nodes. */
 	NodeMap m_NodeMap;
 
+	/** The parent -> children index of m_NodeMap.
+	Maps the parent URL, without the trailing slash, to the URLs of all its children present in m_NodeMap. */
+	QHash<QString, QSet<QUrl>> m_Children;
+
 	/** The network access manager used to send the requests to the server. */
 	QNetworkAccessManager m_NAM;
 
@@ -234,28 +371,79 @@ protected:
 
 	std::atomic<unsigned> m_NextBufferIndex;
 
+	/** The parsers for the replies that are being received. */
+	ResponseParserMap m_ResponseParsers;
 
-	/** Implementation of the response processing.
-	May throw EDavResponseException, caller handles that by emitting a responseError() signal. */
-	void internalProcessResponse(const QNetworkReply & a_Reply, const QByteArray & a_Response);
+	/** The resource statuses reported in the response that has been processed last.
+	See responseStatuses() for details. */
+	QHash<QUrl, int> m_ResponseStatuses;
 
-	/** Handles the <DAV:response> element in the multistatus response.
-	May throw EDavResponseException, caller handles that by emitting a responseError() signal. */
-	void processElementResponse(const QDomNode & a_ResponseElement);
+	/** The URLs of the resources listed in the response that has been processed last.
+	See responseUrls() for details. */
+	QSet<QUrl> m_ResponseUrls;
 
-	/** Handles the <DAV:propstat> element inside a <DAV:response> element in the multistatus response.
+	/** Set if the response that has been processed last was parsed completely, see isResponseComplete(). */
+	bool m_IsResponseComplete;
+
+	/** The metrics of the finished requests, see metrics(). */
+	DavRequestMetrics m_Metrics;
+
+
+	/** Sends the prepared request with the specified body, tracking its buffer and response parser.
+	Common code for sendRequest() and sendResourceRequest(). */
+	QNetworkReply * sendNetworkRequest(QNetworkRequest & a_Request, const char * a_HttpMethod, const QByteArray & a_RequestBody);
+
+	/** Feeds the received data into the parser and processes all the completely received <DAV:response>
+	elements. If a_IsFinal is true, the data is the last part of the response and everything is processed.
+	Parsing errors are stored in a_Parser, to be reported by reportParserResult() once the reply finishes. */
+	void feedParser(ResponseParser & a_Parser, const QByteArray & a_Data, bool a_IsFinal);
+
+	/** Processes all the elements available in the parser's reader.
+	May throw EDavResponseException, caller stores it in a_Parser. */
+	void parseAvailable(ResponseParser & a_Parser, bool a_IsFinal);
+
+	/** Records the time to first byte of the reply, if not recorded yet. */
+	void markFirstByte(QNetworkReply * a_Reply);
+
+	/** Adds the metrics of the finished reply, measured by its parser, to m_Metrics. */
+	void recordMetrics(const QNetworkReply & a_Reply, const ResponseParser & a_Parser);
+
+	/** Stores the resource statuses and URLs from the parser into m_ResponseStatuses and m_ResponseUrls, and emits the responseError()
+	signal if the parsing has failed. */
+	void reportParserResult(const QNetworkReply & a_Reply, ResponseParser & a_Parser);
+
+	/** Parses the HTTP status line ("HTTP/1.1 200 OK") into the status code.
+	Returns -1 if the line cannot be parsed. */
+	static int parseStatusLine(const QString & a_StatusLine);
+
+	/** Handles the <DAV:response> element in the multistatus response, a_Parser's reader is positioned at its
+	start element. Reads up to and including the end element.
 	May throw EDavResponseException, caller handles that by emitting a responseError() signal. */
-	void processElementPropstat(const QString & a_Href, const QDomNode & a_PropstatElement);
+	void processElementResponse(ResponseParser & a_Parser);
+
+	/** Handles the top-level <DAV:sync-token> element in the multistatus response of a sync-collection REPORT.
+	Stores the token as the DAV:sync-token property of the node for a_Url (the collection being synced). */
+	void processElementSyncToken(const QUrl & a_Url, const QString & a_SyncToken);
 
-	/** Handles the <DAV:prop> element, its status should already have been checked by the caller.
-	Stores the property in to the storage. */
-	void processElementProp(const QString & a_Href, const QDomNode & a_PropElement);
+	/** Handles the <DAV:propstat> element inside a <DAV:response> element in the multistatus response.
+	a_Reader is positioned at its start element; reads up to and including the end element.
+	The properties are stored only if the propstat's status is successful. */
+	void processElementPropstat(const QString & a_Href, QXmlStreamReader & a_Reader);
+
+	/** Handles the <DAV:prop> element, a_Reader is positioned at its start element.
+	Creates the property instances using the registered handlers and appends them to a_Props,
+	as (namespace, localname, instance) tuples. */
+	void processElementProp(
+		QXmlStreamReader & a_Reader,
+		std::vector<std::tuple<QString, QString, std::shared_ptr<Property>>> & a_Props
+	);
 
 signals:
 
 	/** Emitted when a reply is received for a request that was sent using sendRequest.
 	The reply is already processed internally, if appropriate.
-	a_Reply has already had all its body read, the data is provided in the a_ResponseBody parameter.
+	a_Reply has already had all its body read. The body is provided in the a_ResponseBody parameter, except for
+	a 207 (multistatus) response, which has been parsed into the tree and discarded while being received.
 	a_UserData is the data that was supplied for the request in the sendRequest() call. */
 	void requestFinished(
 		const QNetworkReply * a_Reply,
@@ -264,8 +452,8 @@ signals:
 	);
 
 	/** Emitted when processResponse runs into an error.
-	a_Reply is the reply that has caused the error. Its body has already been read all, and is provided in
-	a_ResponseBody.
+	a_Reply is the reply that has caused the error. Its body has already been read all; a_ResponseBody holds
+	the part of it from the failing data on (the successfully parsed part has been discarded).
 	a_UserData is the data that was supplied for the request in the sendRequest() call.
 	a_Error is the error message. */
 	void responseError(
@@ -280,6 +468,10 @@ protected slots:
 	/** Emitted by m_NAM when the reply is received. */
 	void internalRequestFinished(QNetworkReply * a_Reply);
 
+	/** Emitted by a reply when a part of its data has been received.
+	Feeds the data into the reply's parser. */
+	void replyReadyRead(QNetworkReply * a_Reply);
+
 	/** Triggered when a network request to the server requests authentication.
 	Provides the auth supplied in m_UserName and m_Password. */
 	void authenticationRequired(QNetworkReply * a_Reply, QAuthenticator * a_Auth);
@@ -291,6 +483,7 @@ protected slots:
 
 static const char NS_DAV[] = "DAV:";
 static const char NS_CARDDAV[] = "urn:ietf:params:xml:ns:carddav";
+static const char NS_CALENDARSERVER[] = "http://calendarserver.org/ns/";
 
 
 
@@ -0,0 +1,184 @@
+#include "DavRequestMetrics.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DavRequestMetrics::Sample:
+
+DavRequestMetrics::Sample::Sample():
+	m_RequestType(0),
+	m_HttpStatus(0),
+	m_TimeToFirstByteUsec(-1),
+	m_TotalUsec(0),
+	m_ParseUsec(0),
+	m_BytesUp(0),
+	m_BytesDown(0)
+{
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DavRequestMetrics::Histogram:
+
+DavRequestMetrics::Histogram::Histogram():
+	m_Count(0),
+	m_Sum(0),
+	m_Min(0),
+	m_Max(0)
+{
+	m_Buckets.fill(0);
+}
+
+
+
+
+
+void DavRequestMetrics::Histogram::add(qint64 a_Value)
+{
+	if (a_Value < 0)
+	{
+		return;
+	}
+
+	// The bucket index is the number of significant bits of the value:
+	int bucket = 0;
+	for (auto v = a_Value; (v > 0) && (bucket < NUM_BUCKETS - 1); v >>= 1)
+	{
+		bucket += 1;
+	}
+	m_Buckets[bucket] += 1;
+	m_Min = (m_Count == 0) ? a_Value : std::min(m_Min, a_Value);
+	m_Max = std::max(m_Max, a_Value);
+	m_Count += 1;
+	m_Sum += a_Value;
+}
+
+
+
+
+
+double DavRequestMetrics::Histogram::mean() const
+{
+	if (m_Count == 0)
+	{
+		return 0;
+	}
+	return static_cast<double>(m_Sum) / m_Count;
+}
+
+
+
+
+
+qint64 DavRequestMetrics::Histogram::percentile(double a_Percentile) const
+{
+	if (m_Count == 0)
+	{
+		return 0;
+	}
+	auto rank = static_cast<quint64>(std::ceil(a_Percentile / 100 * m_Count));
+	rank = std::max<quint64>(rank, 1);
+	quint64 seen = 0;
+	for (int i = 0; i < NUM_BUCKETS; ++i)
+	{
+		seen += m_Buckets[i];
+		if (seen >= rank)
+		{
+			if (i == 0)
+			{
+				return 0;
+			}
+			auto upperBound = (i < 63) ? ((static_cast<qint64>(1) << i) - 1) : std::numeric_limits<qint64>::max();
+			return std::min(upperBound, m_Max);
+		}
+	}
+	return m_Max;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DavRequestMetrics::Aggregate:
+
+DavRequestMetrics::Aggregate::Aggregate(const QByteArray & a_Method, int a_RequestType):
+	m_Method(a_Method),
+	m_RequestType(a_RequestType)
+{
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DavRequestMetrics:
+
+DavRequestMetrics::DavRequestMetrics():
+	m_Total(QByteArray(), 0)
+{
+}
+
+
+
+
+
+void DavRequestMetrics::addSample(const Sample & a_Sample)
+{
+	auto key = std::make_pair(a_Sample.m_Method, a_Sample.m_RequestType);
+	auto itr = m_Aggregates.find(key);
+	if (itr == m_Aggregates.end())
+	{
+		itr = m_Aggregates.emplace(key, Aggregate(a_Sample.m_Method, a_Sample.m_RequestType)).first;
+	}
+	addToAggregate(itr->second, a_Sample);
+	addToAggregate(m_Total, a_Sample);
+}
+
+
+
+
+
+std::vector<DavRequestMetrics::Aggregate> DavRequestMetrics::aggregates() const
+{
+	std::vector<Aggregate> res;
+	res.reserve(m_Aggregates.size());
+	for (const auto & agg: m_Aggregates)
+	{
+		res.push_back(agg.second);
+	}
+	return res;
+}
+
+
+
+
+
+void DavRequestMetrics::clear()
+{
+	m_Aggregates.clear();
+	m_Total = Aggregate(QByteArray(), 0);
+}
+
+
+
+
+
+void DavRequestMetrics::addToAggregate(Aggregate & a_Aggregate, const Sample & a_Sample)
+{
+	a_Aggregate.m_StatusCounts[a_Sample.m_HttpStatus] += 1;
+	a_Aggregate.m_TimeToFirstByteUsec.add(a_Sample.m_TimeToFirstByteUsec);
+	a_Aggregate.m_TotalUsec.add(a_Sample.m_TotalUsec);
+	a_Aggregate.m_ParseUsec.add(a_Sample.m_ParseUsec);
+	a_Aggregate.m_BytesUp.add(a_Sample.m_BytesUp);
+	a_Aggregate.m_BytesDown.add(a_Sample.m_BytesDown);
+}
@@ -0,0 +1,154 @@
+#ifndef DAVREQUESTMETRICS_H
+#define DAVREQUESTMETRICS_H
+
+
+
+
+
+#include <array>
+#include <map>
+#include <vector>
+#include <QByteArray>
+
+
+
+
+
+/** Aggregates the metrics of the requests sent to a DAV server, per request kind (HTTP method + request type).
+The timings and sizes are collected into histograms with power-of-two buckets, so that the memory used is
+constant regardless of the number of requests, while the percentiles can still be estimated.
+Filled by DavPropertyTree for each finished request; not thread-safe, used only from the thread owning
+the DavPropertyTree. */
+class DavRequestMetrics
+{
+public:
+
+	/** The metrics of a single finished request. */
+	struct Sample
+	{
+		/** The HTTP method of the request. */
+		QByteArray m_Method;
+
+		/** The type of the request, as assigned by the client (the user data of the request, such as
+		reqListAddressbooks in DeviceCardDav). */
+		int m_RequestType;
+
+		/** The HTTP status of the response, 0 if no response has been received (network error). */
+		int m_HttpStatus;
+
+		/** The time from sending the request until the response headers have been received, in microseconds.
+		-1 if no response has been received. */
+		qint64 m_TimeToFirstByteUsec;
+
+		/** The time from sending the request until the whole response has been received and processed,
+		in microseconds. */
+		qint64 m_TotalUsec;
+
+		/** The time spent parsing the response body, in microseconds. */
+		qint64 m_ParseUsec;
+
+		/** The size of the request body, in bytes. */
+		qint64 m_BytesUp;
+
+		/** The size of the response body, in bytes. */
+		qint64 m_BytesDown;
+
+		Sample();
+	};
+
+
+	/** A histogram of non-negative values, with power-of-two buckets:
+	bucket 0 holds the zero values, bucket N holds the values in the range [2^(N-1), 2^N). */
+	class Histogram
+	{
+	public:
+
+		static const int NUM_BUCKETS = 48;
+
+		Histogram();
+
+		/** Adds the value to the histogram. Negative values are ignored. */
+		void add(qint64 a_Value);
+
+		/** Returns the number of values added. */
+		quint64 count() const { return m_Count; }
+
+		/** Returns the sum of all the values added. */
+		qint64 sum() const { return m_Sum; }
+
+		qint64 min() const { return m_Min; }
+		qint64 max() const { return m_Max; }
+
+		/** Returns the average of the values, 0 if no values have been added. */
+		double mean() const;
+
+		/** Returns the estimate of the specified percentile (0 .. 100): the upper bound of the bucket containing
+		the value, limited to max(). Returns 0 if no values have been added. */
+		qint64 percentile(double a_Percentile) const;
+
+		/** Returns the counts of the values in the individual buckets. */
+		const std::array<quint64, NUM_BUCKETS> & buckets() const { return m_Buckets; }
+
+
+	protected:
+
+		std::array<quint64, NUM_BUCKETS> m_Buckets;
+		quint64 m_Count;
+		qint64 m_Sum;
+		qint64 m_Min;
+		qint64 m_Max;
+	};
+
+
+	/** The aggregated metrics of all the requests of a single kind. */
+	struct Aggregate
+	{
+		QByteArray m_Method;
+		int m_RequestType;
+
+		/** The number of the responses received, per HTTP status (0 for network errors). */
+		std::map<int, quint64> m_StatusCounts;
+
+		Histogram m_TimeToFirstByteUsec;
+		Histogram m_TotalUsec;
+		Histogram m_ParseUsec;
+		Histogram m_BytesUp;
+		Histogram m_BytesDown;
+
+		Aggregate(const QByteArray & a_Method, int a_RequestType);
+	};
+
+
+	DavRequestMetrics();
+
+	/** Adds the metrics of a single finished request. */
+	void addSample(const Sample & a_Sample);
+
+	/** Returns the aggregated metrics of all the request kinds seen so far, ordered by the method and type. */
+	std::vector<Aggregate> aggregates() const;
+
+	/** Returns the aggregated metrics of all the requests together, regardless of their kind. */
+	const Aggregate & total() const { return m_Total; }
+
+	/** Removes all the collected metrics. */
+	void clear();
+
+
+protected:
+
+	/** The aggregated metrics, mapped by (method, request type). */
+	std::map<std::pair<QByteArray, int>, Aggregate> m_Aggregates;
+
+	/** The aggregated metrics of all the requests. */
+	Aggregate m_Total;
+
+
+	/** Adds the sample to the specified aggregate. */
+	static void addToAggregate(Aggregate & a_Aggregate, const Sample & a_Sample);
+};
+
+
+
+
+
+#endif // DAVREQUESTMETRICS_H
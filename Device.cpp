@@ -3,6 +3,7 @@
 #include "ExampleDevice.h"
 #include "DeviceVcfFile.h"
 #include "DeviceCardDav.h"
+#include "DeviceBackup.h"
 
 
 
@@ -69,6 +70,10 @@ std::unique_ptr<Device> Device::createFromType(const QString & a_Type)
 	{
 		return std::unique_ptr<Device>(new DeviceCardDav);
 	}
+	if (a_Type == "Backup")
+	{
+		return std::unique_ptr<Device>(new DeviceBackup);
+	}
 
 	// TODO: Other device types
 
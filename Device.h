@@ -54,6 +54,19 @@ public:
 	/** Returns true if the device is currently online. */
 	virtual bool isOnline() const = 0;
 
+	/** Re-reads the device's data from scratch, as requested by the user.
+	Devices that cache any information about their data source should drop it here.
+	The default implementation does nothing. */
+	virtual void refresh() {}
+
+	/** Writes the changes made to the device's contact books back to the data source (async).
+	The default implementation does nothing, for read-only devices. */
+	virtual void pushChanges() {}
+
+	/** Returns true while some of the changes are still being written to the data source (see pushChanges()).
+	The default implementation returns false, for read-only devices. */
+	virtual bool isPushing() const { return false; }
+
 	/** Returns true if the device represents a backup.
 	The default implementation is sufficient for all descendants except for the actual backup. */
 	virtual bool isBackup() const { return false; }
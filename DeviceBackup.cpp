@@ -0,0 +1,519 @@
+#include "DeviceBackup.h"
+#include <unordered_set>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QSaveFile>
+#include <QtConcurrentMap>
+#include "ContactBook.h"
+#include "Exceptions.h"
+#include "VCardParser.h"
+#include "VCardSerializer.h"
+
+
+
+
+
+/** The first line of each manifest file, identifying the format. */
+static const QByteArray MANIFEST_SIGNATURE("ContactBookSanitizer backup manifest 1");
+
+
+
+
+
+/** Returns the value of the contact's first UID sentence, or an empty value if it has none. */
+static QByteArray contactUid(const Contact & a_Contact)
+{
+	for (const auto & s: a_Contact.sentences())
+	{
+		if (s.m_Key == "uid")
+		{
+			return s.m_Value;
+		}
+	}
+	return QByteArray();
+}
+
+
+
+
+
+DeviceBackup::RestoreStats::RestoreStats():
+	m_NumUnchanged(0),
+	m_NumReplaced(0),
+	m_NumAdded(0),
+	m_NumRemoved(0)
+{
+}
+
+
+
+
+
+DeviceBackup::DeviceBackup():
+	m_HasListedObjects(false)
+{
+}
+
+
+
+
+
+QString DeviceBackup::displayName() const
+{
+	return m_DisplayName;
+}
+
+
+
+
+
+void DeviceBackup::start()
+{
+	if (m_Folder.isEmpty())
+	{
+		// Invalid settings
+		return;
+	}
+
+	QDir snapshotsDir(m_Folder + "/snapshots");
+	auto manifests = snapshotsDir.entryList({"*.manifest"}, QDir::Files, QDir::Name);
+	for (const auto & m: manifests)
+	{
+		auto cb = loadManifest(snapshotsDir.filePath(m));
+		if (cb == nullptr)
+		{
+			continue;
+		}
+		m_ContactBooks.push_back(cb);
+		emit addContactBook(this, cb);
+	}
+	qDebug() << __FUNCTION__ << ": Loaded " << m_ContactBooks.size() << " backups, "
+		<< m_LoadedObjects.size() << " distinct contacts";
+	emit online(this, true);
+}
+
+
+
+
+
+void DeviceBackup::stop()
+{
+	// Nothing needed
+}
+
+
+
+
+
+bool DeviceBackup::isOnline() const
+{
+	return !m_Folder.isEmpty();
+}
+
+
+
+
+
+void DeviceBackup::setFolder(const QString & a_Folder)
+{
+	m_Folder = a_Folder;
+	m_DisplayName = tr("Backup: %1").arg(QDir::toNativeSeparators(a_Folder));
+	m_StoredObjects.clear();
+	m_HasListedObjects = false;
+	m_ObjectHashes.clear();
+}
+
+
+
+
+
+ContactBookPtr DeviceBackup::backupContactBook(const ContactBook & a_ContactBook)
+{
+	listObjects();
+	auto snapshot = a_ContactBook.snapshot();
+	auto now = QDateTime::currentDateTimeUtc();
+
+	// Write the contacts not yet stored, build the manifest.
+	// The contacts are serialized and hashed in parallel, one snapshot chunk at a time:
+	QByteArray manifest;
+	manifest.append(MANIFEST_SIGNATURE).append('\n');
+	manifest.append(a_ContactBook.displayName().toUtf8()).append('\n');
+	manifest.append(now.toString(Qt::ISODate).toUtf8()).append('\n');
+	int numWritten = 0;
+	struct Object
+	{
+		ContactPtr m_Contact;
+		QByteArray m_Data;
+		QByteArray m_Hash;
+	};
+	for (const auto & chunk: snapshot->chunks())
+	{
+		// Only the contacts not backed up before need serializing and hashing; the others have their hash cached:
+		std::vector<Object> objects;
+		objects.reserve(chunk->size());
+		size_t numToHash = 0;
+		for (const auto & contact: *chunk)
+		{
+			auto itr = m_ObjectHashes.find(contact);
+			if (itr == m_ObjectHashes.end())
+			{
+				objects.push_back({contact, QByteArray(), QByteArray()});
+				numToHash += 1;
+			}
+			else
+			{
+				objects.push_back({contact, QByteArray(), itr->second});
+			}
+		}
+		if (numToHash > 0)
+		{
+			QtConcurrent::blockingMap(objects, [](Object & a_Object)
+				{
+					if (a_Object.m_Hash.isEmpty())
+					{
+						a_Object.m_Data = serializeObject(*a_Object.m_Contact);
+						a_Object.m_Hash = objectHash(a_Object.m_Data);
+					}
+				}
+			);
+		}
+		for (const auto & obj: objects)
+		{
+			if (!obj.m_Data.isEmpty())
+			{
+				if (!m_StoredObjects.contains(obj.m_Hash))
+				{
+					writeObject(obj.m_Hash, obj.m_Data);
+					m_StoredObjects.insert(obj.m_Hash);
+					numWritten += 1;
+				}
+				m_ObjectHashes[obj.m_Contact] = obj.m_Hash;
+			}
+			if (!m_LoadedObjects.contains(obj.m_Hash))
+			{
+				m_LoadedObjects[obj.m_Hash] = obj.m_Contact;
+			}
+			manifest.append(obj.m_Hash).append('\n');
+		}
+	}
+
+	// Write the manifest:
+	QDir().mkpath(m_Folder + "/snapshots");
+	auto manifestFileName = QString::fromUtf8("%1/snapshots/%2.manifest")
+		.arg(m_Folder)
+		.arg(now.toString("yyyyMMdd-HHmmss-zzz"));
+	QSaveFile f(manifestFileName);
+	if (!f.open(QIODevice::WriteOnly) || (f.write(manifest) != manifest.size()) || !f.commit())
+	{
+		throw EFileError(__FILE__, __LINE__, manifestFileName, f.errorString());
+	}
+	qDebug() << __FUNCTION__ << ": Backed up " << snapshot->size() << " contacts of " << a_ContactBook.displayName()
+		<< ", " << numWritten << " of them new";
+
+	// Add the backup as a new contact book; the snapshot's contacts are already prepared, so the book won't modify
+	// them and they can be shared:
+	auto cb = std::make_shared<ContactBook>(backupName(a_ContactBook.displayName(), now));
+	{
+		ContactBook::Batch batch(*cb);
+		snapshot->forEach([&cb](const ContactPtr & a_Contact)
+			{
+				cb->addContact(a_Contact);
+			}
+		);
+	}
+	m_ContactBooks.push_back(cb);
+	emit addContactBook(this, cb);
+	return cb;
+}
+
+
+
+
+
+DeviceBackup::RestoreStats DeviceBackup::restore(const ContactBook & a_Backup, ContactBook & a_Dest)
+{
+	RestoreStats res;
+	auto snapshot = a_Backup.snapshot();
+
+	// The backup's contacts, by their fingerprint (there may be several identical contacts):
+	QHash<QByteArray, std::vector<ContactPtr>> toRestore;
+	snapshot->forEach([&toRestore](const ContactPtr & a_Contact)
+		{
+			toRestore[a_Contact->fingerprint()].push_back(a_Contact);
+		}
+	);
+
+	// Keep the current contacts that are identical to a backed up one:
+	std::vector<ContactPtr> unmatched;
+	std::unordered_set<const Contact *> unpaired;
+	for (const auto & c: a_Dest.contacts())
+	{
+		auto itr = toRestore.find(c->fingerprint());
+		if (itr == toRestore.end())
+		{
+			unmatched.push_back(c);
+			unpaired.insert(c.get());
+			continue;
+		}
+		itr.value().pop_back();
+		if (itr.value().empty())
+		{
+			toRestore.erase(itr);
+		}
+		res.m_NumUnchanged += 1;
+	}
+
+	// Pair the remaining contacts by their UID, looked up in the destination's index; the paired ones are replaced,
+	// so that any device-specific data of the current contact (such as the CardDAV href) is kept:
+	a_Dest.setIndexed(true);
+	ContactBook::Batch batch(a_Dest);
+	for (const auto & group: toRestore)
+	{
+		for (const auto & backedUp: group)
+		{
+			ContactPtr paired;
+			auto uid = contactUid(*backedUp);
+			if (!uid.isEmpty())
+			{
+				for (const auto & candidate: a_Dest.index().findByUid(uid))
+				{
+					if (unpaired.erase(candidate.get()) > 0)
+					{
+						paired = candidate;
+						break;
+					}
+				}
+			}
+			auto sentences = backedUp->sentences();
+			if (paired == nullptr)
+			{
+				a_Dest.createNewContact()->setSentences(std::move(sentences));
+				res.m_NumAdded += 1;
+				continue;
+			}
+			auto newContact = paired->clone();
+			newContact->setSentences(std::move(sentences));
+			a_Dest.replaceContact(paired.get(), newContact);
+			res.m_NumReplaced += 1;
+		}
+	}
+
+	// Remove the contacts not present in the backup:
+	for (const auto & c: unmatched)
+	{
+		if (unpaired.count(c.get()) > 0)
+		{
+			a_Dest.delContact(c.get());
+			res.m_NumRemoved += 1;
+		}
+	}
+	return res;
+}
+
+
+
+
+
+void DeviceBackup::listObjects()
+{
+	if (m_HasListedObjects)
+	{
+		return;
+	}
+	QDirIterator itr(m_Folder + "/objects", {"*.vcf"}, QDir::Files, QDirIterator::Subdirectories);
+	while (itr.hasNext())
+	{
+		itr.next();
+		m_StoredObjects.insert(itr.fileInfo().completeBaseName().toLatin1());
+	}
+	m_HasListedObjects = true;
+}
+
+
+
+
+
+QString DeviceBackup::objectFileName(const QByteArray & a_Hash) const
+{
+	return QString::fromUtf8("%1/objects/%2/%3.vcf")
+		.arg(m_Folder)
+		.arg(QString::fromLatin1(a_Hash.left(2)))
+		.arg(QString::fromLatin1(a_Hash));
+}
+
+
+
+
+
+void DeviceBackup::writeObject(const QByteArray & a_Hash, const QByteArray & a_Data)
+{
+	auto fileName = objectFileName(a_Hash);
+	QDir().mkpath(QFileInfo(fileName).path());
+	QSaveFile f(fileName);
+	if (!f.open(QIODevice::WriteOnly) || (f.write(a_Data) != a_Data.size()) || !f.commit())
+	{
+		throw EFileError(__FILE__, __LINE__, fileName, f.errorString());
+	}
+}
+
+
+
+
+
+QByteArray DeviceBackup::serializeObject(const Contact & a_Contact)
+{
+	QByteArray res;
+	QBuffer buf(&res);
+	buf.open(QIODevice::WriteOnly);
+	VCardSerializer::serialize(a_Contact, buf);
+	return res;
+}
+
+
+
+
+
+QByteArray DeviceBackup::objectHash(const QByteArray & a_Data)
+{
+	return QCryptographicHash::hash(a_Data, QCryptographicHash::Sha256).toHex();
+}
+
+
+
+
+
+QString DeviceBackup::backupName(const QString & a_SourceName, const QDateTime & a_Timestamp)
+{
+	return tr("%1 (%2)")
+		.arg(a_SourceName)
+		.arg(QLocale::system().toString(a_Timestamp.toLocalTime(), QLocale::ShortFormat));
+}
+
+
+
+
+
+ContactBookPtr DeviceBackup::loadManifest(const QString & a_FileName)
+{
+	QFile f(a_FileName);
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		qWarning() << "Cannot open backup manifest " << a_FileName;
+		return nullptr;
+	}
+	auto lines = f.readAll().split('\n');
+	if ((lines.size() < 3) || (lines[0] != MANIFEST_SIGNATURE))
+	{
+		qWarning() << "Invalid backup manifest " << a_FileName;
+		return nullptr;
+	}
+	auto sourceName = QString::fromUtf8(lines[1]);
+	auto timestamp = QDateTime::fromString(QString::fromLatin1(lines[2]), Qt::ISODate);
+	lines = lines.mid(3);
+
+	// Parse the objects not yet loaded, in parallel:
+	struct ObjectToLoad
+	{
+		QByteArray m_Hash;
+		QString m_FileName;
+		ContactPtr m_Contact;
+	};
+	std::vector<ObjectToLoad> toLoad;
+	QSet<QByteArray> scheduled;
+	for (const auto & hash: lines)
+	{
+		if (hash.isEmpty() || m_LoadedObjects.contains(hash) || scheduled.contains(hash))
+		{
+			continue;
+		}
+		scheduled.insert(hash);
+		toLoad.push_back({hash, objectFileName(hash), nullptr});
+	}
+	QtConcurrent::blockingMap(toLoad, [](ObjectToLoad & a_Object)
+		{
+			QFile obj(a_Object.m_FileName);
+			if (!obj.open(QIODevice::ReadOnly))
+			{
+				return;
+			}
+			auto contact = std::make_shared<Contact>();
+			try
+			{
+				VCardParser::parse(obj, contact);
+			}
+			catch (const EException &)
+			{
+				return;
+			}
+
+			// Prepare the contact now, so that no book modifies it once it's shared between books:
+			contact->prepare();
+			a_Object.m_Contact = contact;
+		}
+	);
+	for (const auto & obj: toLoad)
+	{
+		if (obj.m_Contact == nullptr)
+		{
+			qWarning() << "Cannot load backup object " << obj.m_FileName;
+			continue;
+		}
+		m_LoadedObjects[obj.m_Hash] = obj.m_Contact;
+		m_ObjectHashes[obj.m_Contact] = obj.m_Hash;
+	}
+
+	// Build the contact book; a book holds each instance only once, so a repeated object gets a clone:
+	auto cb = std::make_shared<ContactBook>(backupName(sourceName, timestamp));
+	ContactBook::Batch batch(*cb);
+	for (const auto & hash: lines)
+	{
+		auto itr = m_LoadedObjects.constFind(hash);
+		if (itr == m_LoadedObjects.constEnd())
+		{
+			continue;
+		}
+		if (cb->contains(itr.value().get()))
+		{
+			cb->addContact(itr.value()->clone());
+		}
+		else
+		{
+			cb->addContact(itr.value());
+		}
+	}
+	return cb;
+}
+
+
+
+
+
+bool DeviceBackup::load(const QJsonObject & a_Config)
+{
+	auto folder = a_Config["folder"].toString();
+	if (folder.isEmpty())
+	{
+		return false;
+	}
+	setFolder(folder);
+	return true;
+}
+
+
+
+
+
+QJsonObject DeviceBackup::save() const
+{
+	QJsonObject res;
+	res["type"]   = QString::fromUtf8("Backup");
+	res["folder"] = m_Folder;
+	return res;
+}
@@ -0,0 +1,152 @@
+#ifndef DEVICEBACKUP_H
+#define DEVICEBACKUP_H
+
+
+
+
+
+#include <unordered_map>
+
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+
+#include "Contact.h"
+#include "Device.h"
+
+
+
+
+
+/** A device that stores backups (snapshots) of contact books in a local content-addressed store.
+Each distinct contact is stored only once, as a vCard file named by the (SHA-256) hash of its serialized data,
+in "<folder>/objects/<xx>/<hash>.vcf". The hash covers the exact data (unlike Contact::fingerprint(), which
+ignores the formatting and the volatile sentences), so a restored contact is exactly the one backed up.
+Each backup is just a manifest listing the hashes of its contacts, in "<folder>/snapshots/<timestamp>.manifest".
+Backing up a book thus only writes the contacts that have changed since any previous backup, plus the manifest.
+Each backup is presented as a separate (read-only) contact book. The loaded contacts are shared between all
+the backups that contain them, so that browsing many backups of the same book costs little more memory than
+browsing a single one. */
+class DeviceBackup:
+	public Device
+{
+	Q_OBJECT
+	using Super = Device;
+
+
+public:
+
+	DeviceBackup();
+
+	/** Returns the display name that should be used for this device. */
+	virtual QString displayName() const override;
+
+	/** Starts the device.
+	Loads all the backups present in the store. */
+	virtual void start() override;
+
+	/** Stops the device. */
+	virtual void stop() override;
+
+	/** Returns true if the device is currently online. */
+	virtual bool isOnline() const override;
+
+	/** Returns true, this device is a backup. */
+	virtual bool isBackup() const override { return true; }
+
+	/** Returns all the backups currently available in the device, each as a separate contact book. */
+	virtual const std::vector<ContactBookPtr> contactBooks() override { return m_ContactBooks; }
+
+	/** Sets the folder in which the store is located. */
+	void setFolder(const QString & a_Folder);
+
+	/** Backs up the current snapshot of the specified contact book.
+	Only the contacts not backed up before are serialized and hashed, only those not yet present in the store
+	are written, then a new manifest is written.
+	The new backup is added to contactBooks() and reported through the addContactBook() signal.
+	Throws an EFileError if the store cannot be written. */
+	ContactBookPtr backupContactBook(const ContactBook & a_ContactBook);
+
+	/** The number of contacts affected by restore(). */
+	struct RestoreStats
+	{
+		size_t m_NumUnchanged;
+		size_t m_NumReplaced;
+		size_t m_NumAdded;
+		size_t m_NumRemoved;
+
+		RestoreStats();
+	};
+
+
+	/** Makes the contacts in a_Dest the same as the contacts in the specified backup, in a single batch of changes.
+	Only the differences are applied: the contacts identical to a backed up one (by their fingerprint) are kept,
+	the contacts with the same UID as a backed up one are replaced by a clone with the backed up data, the other
+	backed up contacts are created using a_Dest.createNewContact() and the remaining ones are removed.
+	This keeps the device-specific data of the contacts and only marks the actually changed ones as changed.
+	Enables the secondary indexes of a_Dest (ContactBook::setIndexed()), used for pairing the contacts by UID. */
+	static RestoreStats restore(const ContactBook & a_Backup, ContactBook & a_Dest);
+
+
+protected:
+
+	/** The folder in which the store is located. */
+	QString m_Folder;
+
+	/** The device name, as displayed to the user. */
+	QString m_DisplayName;
+
+	/** The backups loaded from the store, each as a separate contact book. */
+	std::vector<ContactBookPtr> m_ContactBooks;
+
+	/** The (hex) hashes of all the contacts present in the store.
+	Filled by listing the store the first time it is needed. */
+	QSet<QByteArray> m_StoredObjects;
+
+	/** Set once m_StoredObjects has been filled. */
+	bool m_HasListedObjects;
+
+	/** The contacts already loaded from the store, shared between all the backups that contain them.
+	Maps the (hex) hash to the contact. */
+	QHash<QByteArray, ContactPtr> m_LoadedObjects;
+
+	/** The (hex) hashes of the contact instances already backed up or loaded, so that backing up a book again
+	only serializes and hashes the contacts changed since. The contacts are immutable once published, so the hash
+	of an instance never changes. */
+	std::unordered_map<ContactPtr, QByteArray> m_ObjectHashes;
+
+
+	/** Fills m_StoredObjects from the objects in the store, unless already done. */
+	void listObjects();
+
+	/** Returns the full filename of the object with the specified (hex) hash. */
+	QString objectFileName(const QByteArray & a_Hash) const;
+
+	/** Writes the specified serialized contact into the store as the object with the specified (hex) hash.
+	Throws an EFileError on failure. */
+	void writeObject(const QByteArray & a_Hash, const QByteArray & a_Data);
+
+	/** Returns the contact serialized into a vCard, as stored in the objects. */
+	static QByteArray serializeObject(const Contact & a_Contact);
+
+	/** Returns the (hex) hash of the serialized contact, used as its name in the store. */
+	static QByteArray objectHash(const QByteArray & a_Data);
+
+	/** Returns the display name of the contact book representing the backup of the specified source,
+	made at the specified (UTC) time. */
+	static QString backupName(const QString & a_SourceName, const QDateTime & a_Timestamp);
+
+	/** Loads the backup from the specified manifest file, parsing the objects not yet in m_LoadedObjects in parallel.
+	Returns the contact book representing the backup, or nullptr on failure. */
+	ContactBookPtr loadManifest(const QString & a_FileName);
+
+	// Device overrides:
+	virtual bool load(const QJsonObject & a_Config) override;
+	virtual QJsonObject save() const override;
+};
+
+
+
+
+
+#endif // DEVICEBACKUP_H
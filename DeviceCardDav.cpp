@@ -1,18 +1,67 @@
 #include "DeviceCardDav.h"
 #include <assert.h>
+#include <algorithm>
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QXmlStreamWriter>
 #include <QBuffer>
 #include <QFile>
+#include <QJsonArray>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QUuid>
+#include <QtConcurrentMap>
 #include "VCardParser.h"
+#include "VCardSerializer.h"
 #include "Exceptions.h"
 
 
 
 
 
-static const int PERIODIC_CHECK_SECONDS = 5 * 60;
+/** The interval between the periodic checks right after the server has reported changes. */
+static const int MIN_POLL_SECONDS = 60;
+
+/** The maximum interval between the periodic checks, reached by doubling the interval after each check
+that hasn't seen any changes or has failed. */
+static const int MAX_POLL_SECONDS = 60 * 60;
+
+/** The interval in which the service discovery is re-run even when the server reports no errors. */
+static const int REDISCOVERY_SECONDS = 24 * 60 * 60;
+
+/** The default number of contacts fetched in a single addressbook-multiget request. */
+static const int DEFAULT_MULTIGET_BATCH_SIZE = 200;
+
+/** The default number of addressbook-multiget requests sent to the server at the same time. */
+static const int DEFAULT_MAX_MULTIGETS_IN_FLIGHT = 4;
+
+/** The default number of PUT / DELETE requests sent to the server at the same time when pushing the changes. */
+static const int DEFAULT_MAX_PUSHES_IN_FLIGHT = 8;
+
+/** The number of times a failed addressbook-multiget batch is re-sent before giving up. */
+static const int MAX_MULTIGET_RETRIES = 3;
+
+/** The delay between a change in the contacts and the saving of the local cache. */
+static const int CACHE_SAVE_DELAY_SECONDS = 5;
+
+/** The signature and version of the local cache file format. */
+static const quint32 CACHE_MAGIC = 0x43444376;  // "CDCv"
+static const quint32 CACHE_VERSION = 3;
+
+/** The signature and version of the journal file format. */
+static const quint32 JOURNAL_MAGIC = 0x43444a76;  // "CDJv"
+static const quint32 JOURNAL_VERSION = 1;
+
+/** The number of superseded records allowed in the journal file over the number of live records, before the file
+gets compacted. */
+static const int JOURNAL_COMPACTION_SLACK = 1000;
+
+/** The number of jrDone records collected before they are appended to the journal, while writes are in progress. */
+static const size_t JOURNAL_DONE_BATCH_SIZE = 100;
 
 
 
@@ -26,6 +75,9 @@ enum
 	reqListAddressbooks,
 	reqCheckAddressbookEtags,
 	reqAddressbookData,
+	reqSyncCollection,
+	reqCheckAddressbookTag,
+	reqPushContact,
 };
 
 
@@ -35,6 +87,23 @@ enum
 ////////////////////////////////////////////////////////////////////////////////
 // DeviceCardDav:DavContactBook:
 
+DeviceCardDav::DavContactBook::DavContactBook(const QUrl a_BaseUrl, const QString & a_DisplayName):
+	Super(a_DisplayName),
+	m_BaseUrl(a_BaseUrl),
+	m_IsSyncCollectionSupported(true),
+	m_BaseUrlPrefix(a_BaseUrl.toString()),
+	m_IsApplyingServerChange(false)
+{
+	if (!m_BaseUrlPrefix.endsWith('/'))
+	{
+		m_BaseUrlPrefix.append('/');
+	}
+}
+
+
+
+
+
 ContactPtr DeviceCardDav::DavContactBook::createNewContact()
 {
 	DavContactPtr res(new DavContact);
@@ -46,23 +115,161 @@ ContactPtr DeviceCardDav::DavContactBook::createNewContact()
 
 
 
-DeviceCardDav::DavContactPtr DeviceCardDav::DavContactBook::contactFromUrl(const QUrl & a_Url)
+void DeviceCardDav::DavContactBook::addContact(ContactPtr a_Contact)
 {
-	for (const auto & c: m_Contacts)
+	auto dc = std::dynamic_pointer_cast<DavContact>(a_Contact);
+	if (dc == nullptr)
 	{
-		const auto dc = std::dynamic_pointer_cast<DavContact>(c);
-		if (dc == nullptr)
+		qWarning() << __FUNCTION__ << "Adding a non-DAV contact to a DAV ContactBook!";
+		assert(!"Adding a non-DAV contact to a DAV ContactBook!");
+	}
+	else
+	{
+		if (!m_IsApplyingServerChange)
 		{
-			qWarning() << __FUNCTION__ << "DAV ContactBook contains a non-DAV contact!";
-			assert(!"DAV ContactBook contains a non-DAV contact!");
-			continue;
+			// A new local contact, to be written to the server under a new name:
+			dc->setModified(true);
+			if (dc->href().isEmpty())
+			{
+				dc->setHref(QUuid::createUuid().toString().mid(1, 36) + ".vcf");
+			}
+			m_UnjournaledHrefs.insert(dc->href());
 		}
-		if (dc->url() == a_Url)
+		if (!dc->href().isEmpty())
 		{
-			return dc;
+			m_ContactsByHref[dc->href()] = dc;
 		}
 	}
-	return nullptr;
+	Super::addContact(std::move(a_Contact));
+}
+
+
+
+
+
+void DeviceCardDav::DavContactBook::replaceContact(const Contact * a_OldContact, ContactPtr a_NewContact)
+{
+	auto oldDc = dynamic_cast<const DavContact *>(a_OldContact);
+	if (oldDc != nullptr)
+	{
+		auto itr = m_ContactsByHref.find(oldDc->href());
+		if ((itr != m_ContactsByHref.end()) && (itr.value().get() == oldDc))
+		{
+			m_ContactsByHref.erase(itr);
+		}
+	}
+	auto newDc = std::dynamic_pointer_cast<DavContact>(a_NewContact);
+	if (newDc != nullptr)
+	{
+		if (!m_IsApplyingServerChange)
+		{
+			newDc->setModified(true);
+			m_UnjournaledHrefs.insert(newDc->href());
+		}
+		if (!newDc->href().isEmpty())
+		{
+			m_ContactsByHref[newDc->href()] = newDc;
+		}
+	}
+	Super::replaceContact(a_OldContact, std::move(a_NewContact));
+}
+
+
+
+
+
+void DeviceCardDav::DavContactBook::delContact(const Contact * a_Contact)
+{
+	auto dc = dynamic_cast<const DavContact *>(a_Contact);
+	if (dc != nullptr)
+	{
+		auto itr = m_ContactsByHref.find(dc->href());
+		if ((itr != m_ContactsByHref.end()) && (itr.value().get() == dc))
+		{
+			m_ContactsByHref.erase(itr);
+		}
+
+		// Contacts already stored on the server need to be deleted there, too:
+		if (!m_IsApplyingServerChange)
+		{
+			if (!dc->serverData().isEmpty())
+			{
+				m_PendingDeletes[dc->href()] = dc->etag();
+			}
+			m_UnjournaledHrefs.insert(dc->href());
+		}
+	}
+	Super::delContact(a_Contact);
+}
+
+
+
+
+
+void DeviceCardDav::DavContactBook::addServerContact(DavContactPtr a_Contact)
+{
+	m_IsApplyingServerChange = true;
+	addContact(std::move(a_Contact));
+	m_IsApplyingServerChange = false;
+}
+
+
+
+
+
+void DeviceCardDav::DavContactBook::replaceWithServerContact(const Contact * a_OldContact, DavContactPtr a_NewContact)
+{
+	m_IsApplyingServerChange = true;
+	replaceContact(a_OldContact, std::move(a_NewContact));
+	m_IsApplyingServerChange = false;
+}
+
+
+
+
+
+void DeviceCardDav::DavContactBook::delServerContact(const Contact * a_Contact)
+{
+	m_IsApplyingServerChange = true;
+	delContact(a_Contact);
+	m_IsApplyingServerChange = false;
+}
+
+
+
+
+
+DeviceCardDav::DavContactPtr DeviceCardDav::DavContactBook::contactFromUrl(const QUrl & a_Url) const
+{
+	auto href = relativeHref(a_Url);
+	if (href.isEmpty())
+	{
+		return nullptr;
+	}
+	return m_ContactsByHref.value(href);
+}
+
+
+
+
+
+QString DeviceCardDav::DavContactBook::relativeHref(const QUrl & a_Url) const
+{
+	auto url = a_Url.toString();
+	if (!url.startsWith(m_BaseUrlPrefix))
+	{
+		return QString();
+	}
+	return url.mid(m_BaseUrlPrefix.length());
+}
+
+
+
+
+
+QUrl DeviceCardDav::DavContactBook::urlFromRelativeHref(const QString & a_Href) const
+{
+	return QUrl(m_BaseUrlPrefix + a_Href);
 }
 
 
@@ -73,9 +280,20 @@ DeviceCardDav::DavContactPtr DeviceCardDav::DavContactBook::contactFromUrl(const
 // DeviceCardDav:
 
 DeviceCardDav::DeviceCardDav():
-	m_IsOnline(false)
+	m_IsOnline(false),
+	m_IsDiscoveryNeeded(true),
+	m_PollScheduler(MIN_POLL_SECONDS, MAX_POLL_SECONDS),
+	m_CheckHasChanges(false),
+	m_CheckHasFailed(false),
+	m_MultigetBatchSize(DEFAULT_MULTIGET_BATCH_SIZE),
+	m_MaxMultigetsInFlight(DEFAULT_MAX_MULTIGETS_IN_FLIGHT),
+	m_MaxPushesInFlight(DEFAULT_MAX_PUSHES_IN_FLIGHT),
+	m_JournalNumRecords(0),
+	m_JournalNextSeq(1)
 {
-	connect(&m_PeriodicCheck, &QTimer::timeout, this, &DeviceCardDav::periodicCheck);
+	connect(&m_PollScheduler, &PollScheduler::poll, this, &DeviceCardDav::periodicCheck);
+	m_CacheSaveTimer.setSingleShot(true);
+	connect(&m_CacheSaveTimer, &QTimer::timeout, this, &DeviceCardDav::saveCache);
 }
 
 
@@ -97,11 +315,26 @@ QString DeviceCardDav::displayName() const
 
 void DeviceCardDav::start()
 {
-	// Perform the initial check now:
-	periodicCheck();
+	// Show the contacts from the previous run right away:
+	if (m_ContactBooks.empty())
+	{
+		loadCache();
+
+		// Add the addressbooks known from the previous discovery that weren't in the cache:
+		for (const auto & ab: m_SavedAddressbooks)
+		{
+			if (contactBookFromUrl(ab.first) == nullptr)
+			{
+				addDavContactBook(std::make_shared<DavContactBook>(ab.first, ab.second));
+			}
+		}
+
+		// Re-apply the local changes not yet written to the server:
+		loadJournal();
+	}
 
-	// Start checking periodically:
-	m_PeriodicCheck.start(1000 * PERIODIC_CHECK_SECONDS);
+	// Perform the initial check now and then periodically:
+	m_PollScheduler.start();
 }
 
 
@@ -110,7 +343,12 @@ void DeviceCardDav::start()
 
 void DeviceCardDav::stop()
 {
-	m_PeriodicCheck.stop();
+	m_PollScheduler.stop();
+	if (m_CacheSaveTimer.isActive())
+	{
+		saveCache();
+	}
+	flushJournalDone();
 }
 
 
@@ -126,6 +364,119 @@ bool DeviceCardDav::isOnline() const
 
 
 
+void DeviceCardDav::refresh()
+{
+	m_IsDiscoveryNeeded = true;
+	m_PollScheduler.requestPoll();
+}
+
+
+
+
+
+void DeviceCardDav::pushChanges()
+{
+	for (const auto & cb: m_ContactBooks)
+	{
+		// The modified and new contacts:
+		for (const auto & c: cb->contacts())
+		{
+			auto dc = std::dynamic_pointer_cast<DavContact>(c);
+			if ((dc == nullptr) || !dc->isModified() || isPushPending(cb->m_BaseUrl, dc->href()))
+			{
+				continue;
+			}
+			PushOp op;
+			op.m_ContactBookUrl = cb->m_BaseUrl;
+			op.m_Href = dc->href();
+			op.m_IsDelete = false;
+			op.m_JournalSeq = 0;
+			m_PendingPushes.insert(journalKey(op.m_ContactBookUrl, op.m_Href));
+			m_PushQueue.push_back(std::move(op));
+		}
+
+		// The deleted contacts:
+		for (auto itr = cb->m_PendingDeletes.constBegin(), end = cb->m_PendingDeletes.constEnd(); itr != end; ++itr)
+		{
+			if (isPushPending(cb->m_BaseUrl, itr.key()))
+			{
+				continue;
+			}
+			PushOp op;
+			op.m_ContactBookUrl = cb->m_BaseUrl;
+			op.m_Href = itr.key();
+			op.m_Etag = itr.value();
+			op.m_IsDelete = true;
+			op.m_JournalSeq = 0;
+			m_PendingPushes.insert(journalKey(op.m_ContactBookUrl, op.m_Href));
+			m_PushQueue.push_back(std::move(op));
+		}
+	}
+	qDebug() << __FUNCTION__ << ": # changes to push: " << m_PushQueue.size();
+	sendQueuedPushes();
+}
+
+
+
+
+
+
+bool DeviceCardDav::isPushing() const
+{
+	return (!m_PushQueue.empty() || !m_PushesInFlight.empty());
+}
+
+
+
+
+
+
+const DavRequestMetrics * DeviceCardDav::requestMetrics() const
+{
+	if (m_DavPropertyTree == nullptr)
+	{
+		return nullptr;
+	}
+	return &m_DavPropertyTree->metrics();
+}
+
+
+
+
+
+void DeviceCardDav::resetRequestMetrics()
+{
+	if (m_DavPropertyTree != nullptr)
+	{
+		m_DavPropertyTree->resetMetrics();
+	}
+}
+
+
+
+
+
+QString DeviceCardDav::requestTypeName(int a_RequestType) const
+{
+	switch (a_RequestType)
+	{
+		case reqDetectAddressBookSupport: return tr("Detect addressbook support");
+		case reqCurrentUserPrincipal:     return tr("Current user principal");
+		case reqAddressbookRoot:          return tr("Addressbook home");
+		case reqListAddressbooks:         return tr("List addressbooks");
+		case reqCheckAddressbookEtags:    return tr("Addressbook ETags");
+		case reqAddressbookData:          return tr("Contact data (multiget)");
+		case reqSyncCollection:           return tr("Sync collection");
+		case reqCheckAddressbookTag:      return tr("Addressbook tag");
+		case reqPushContact:              return tr("Push contact");
+	}
+	return QString::number(a_RequestType);
+}
+
+
+
+
+
 bool DeviceCardDav::load(const QJsonObject & a_Config)
 {
 	m_ServerUrl   = a_Config["serverUrl"].toString();
@@ -136,6 +487,28 @@ bool DeviceCardDav::load(const QJsonObject & a_Config)
 	{
 		m_DisplayName = tr("CardDAV server");
 	}
+	m_MultigetBatchSize    = std::max(a_Config["multigetBatchSize"].toInt(DEFAULT_MULTIGET_BATCH_SIZE), 1);
+	m_MaxMultigetsInFlight = std::max(a_Config["maxMultigetsInFlight"].toInt(DEFAULT_MAX_MULTIGETS_IN_FLIGHT), 1);
+	m_MaxPushesInFlight    = std::max(a_Config["maxPushesInFlight"].toInt(DEFAULT_MAX_PUSHES_IN_FLIGHT), 1);
+
+	// Load the results of the previous service discovery:
+	m_PrincipalUrl       = a_Config["principalUrl"].toString();
+	m_AddressbookHomeUrl = a_Config["addressbookHomeUrl"].toString();
+	m_SavedAddressbooks.clear();
+	for (const auto & ab: a_Config["addressbooks"].toArray())
+	{
+		auto obj = ab.toObject();
+		QUrl url = obj["url"].toString();
+		if (!url.isEmpty())
+		{
+			m_SavedAddressbooks.emplace_back(url, obj["displayName"].toString());
+		}
+	}
+	m_IsDiscoveryNeeded = (m_PrincipalUrl.isEmpty() || m_AddressbookHomeUrl.isEmpty());
+	if (!m_IsDiscoveryNeeded)
+	{
+		m_SinceDiscovery.start();
+	}
 
 	if (
 		m_ServerUrl.isEmpty() ||
@@ -165,6 +538,25 @@ QJsonObject DeviceCardDav::save() const
 	res["serverUrl"]   = m_ServerUrl.toString();
 	res["userName"]    = m_UserName;
 	res["password"]    = m_Password;
+	res["multigetBatchSize"]    = m_MultigetBatchSize;
+	res["maxMultigetsInFlight"] = m_MaxMultigetsInFlight;
+	res["maxPushesInFlight"]    = m_MaxPushesInFlight;
+
+	// Save the results of the service discovery:
+	if (!m_IsDiscoveryNeeded)
+	{
+		res["principalUrl"]       = m_PrincipalUrl.toString();
+		res["addressbookHomeUrl"] = m_AddressbookHomeUrl.toString();
+		QJsonArray addressbooks;
+		for (const auto & cb: m_ContactBooks)
+		{
+			QJsonObject ab;
+			ab["url"]         = cb->m_BaseUrl.toString();
+			ab["displayName"] = cb->displayName();
+			addressbooks.append(ab);
+		}
+		res["addressbooks"] = addressbooks;
+	}
 	return res;
 }
 
@@ -172,6 +564,24 @@ QJsonObject DeviceCardDav::save() const
 
 
 
+bool DeviceCardDav::checkDiscoveryStale(const QNetworkReply & a_Reply)
+{
+	auto httpStatus = a_Reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if ((httpStatus == 401) || (httpStatus == 404) || (httpStatus / 100 == 3))
+	{
+		qDebug() << __FUNCTION__ << ": Server replied " << httpStatus << " for "
+			<< a_Reply.url().toString() << ", the discovery will be re-run.";
+		m_IsDiscoveryNeeded = true;
+		m_CheckHasFailed = true;
+		return true;
+	}
+	return false;
+}
+
+
+
+
+
 void DeviceCardDav::respDetectAddressBookSupport(const QNetworkReply & a_Reply)
 {
 	if (a_Reply.error() != QNetworkReply::NoError)
@@ -343,6 +753,7 @@ void DeviceCardDav::respListAddressbooks(const QNetworkReply & a_Reply)
 			qDebug() << __FUNCTION__ << ": Removing contactbook " << (*itr)->displayName();
 			emit delContactBook(this, itr->get());
 			itr = m_ContactBooks.erase(itr);
+			scheduleCacheSave();
 		}
 		else
 		{
@@ -350,30 +761,23 @@ void DeviceCardDav::respListAddressbooks(const QNetworkReply & a_Reply)
 		}
 	}
 
-	// Add the new addressbooks not yet present in m_ContactBooks:
+	// Add the new addressbooks not yet present in m_ContactBooks, sync the changes of the present ones:
 	for (const auto & abu: addressBookUrls)
 	{
-		bool isPresent = false;
-		for (const auto & cb: m_ContactBooks)
-		{
-			if (cb->m_BaseUrl == abu)
-			{
-				isPresent = true;
-				break;
-			}
-		}
-		if (!isPresent)
+		auto cb = contactBookFromUrl(abu);
+		if (cb == nullptr)
 		{
 			auto displayName = displayNameForAdressbook(abu);
 			qDebug() << __FUNCTION__ << ": Adding contactbook " << displayName;
-			auto cb = std::make_shared<DavContactBook>(abu, displayName);
-			m_ContactBooks.push_back(cb);
-			emit addContactBook(this, cb);
-			loadContactBook(cb.get());
+			cb = std::make_shared<DavContactBook>(abu, displayName);
+			addDavContactBook(cb);
 		}
+		loadContactBook(cb.get());
 	}
 
 	// The server has replied successfully to all our queries, mark it as online:
+	m_IsDiscoveryNeeded = false;
+	m_SinceDiscovery.start();
 	setOnline();
 }
 
@@ -392,69 +796,32 @@ void DeviceCardDav::respCheckAddressbookEtags(const QNetworkReply & a_Reply)
 		assert(!"Unknown ContactBook URL");
 		return;
 	}
-
-	// The server should have reported fresh Etags for each contact in the addressbook
-	// Sync the list of contacts and request any that have changed:
-	QByteArray baReq;
-	QXmlStreamWriter w(&baReq);
-	int toSync = 0;
-	w.writeStartDocument();
-	w.writeNamespace(NS_DAV, "d");
-	w.writeNamespace(NS_CARDDAV, "c");
-	w.writeStartElement("c:addressbook-query");
-		w.writeStartElement("d:prop");
-			w.writeEmptyElement("d:getetag");
-			w.writeEmptyElement("c:address-data");
-		w.writeEndElement();
-
-		const auto & children = m_DavPropertyTree->nodeChildren(a_Reply.url());
-		auto size = children.size();
-		for (int i = 0; i < size; ++i)
+	if (a_Reply.error() != QNetworkReply::NoError)
+	{
+		if (!checkDiscoveryStale(a_Reply))
 		{
-			const auto & chUrl = children.at(i);
-			auto contact = cb->contactFromUrl(chUrl);
-			if (contact == nullptr)
-			{
-				w.writeStartElement("d:href");
-					w.writeCharacters(m_DavPropertyTree->hrefFromUrl(chUrl));
-				w.writeEndElement();
-				toSync += 1;
-				continue;
-			}
-			const auto & childNode = m_DavPropertyTree->node(chUrl);
-			auto serverEtag = childNode.findProp<DavPropertyTree::TextProperty>(NS_DAV, "getetag");
-			if (serverEtag == nullptr)
-			{
-				qDebug() << __FUNCTION__
-					<< ": Server didn't report an etag for contact at " << chUrl.toString()
-					<< ", skipping contact.";
-				continue;
-			}
-			if (contact->etag() != serverEtag->value())
-			{
-				w.writeStartElement("d:href");
-					w.writeCharacters(m_DavPropertyTree->hrefFromUrl(chUrl));
-				w.writeEndElement();
-				toSync += 1;
-				continue;
-			}
+			qDebug() << __FUNCTION__ << ": Received an error reply: " << a_Reply.errorString();
+			setOffline();
 		}
-	w.writeEndElement();
-	w.writeEndDocument();
-	qDebug() << __FUNCTION__ << ": # contacts to sync: " << toSync;
-	if (toSync > 0)
+		return;
+	}
+	if (!m_IsOnline)
 	{
-		m_DavPropertyTree->sendRequest(a_Reply.url(), "REPORT", 1, baReq, reqAddressbookData);
+		setOnline();
 	}
+
+	// The server should have reported fresh Etags for each contact in the addressbook
+	// Sync the list of contacts and request any that have changed:
+	removeVanishedContacts(*cb);
+	requestChangedContacts(*cb);
 }
 
 
 
 
 
-void DeviceCardDav::respAddressData(const QNetworkReply & a_Reply)
+void DeviceCardDav::respSyncCollection(const QNetworkReply & a_Reply)
 {
-	// Get the ContactBook on which to perform the sync:
 	auto cb = contactBookFromUrl(a_Reply.url());
 	if (cb == nullptr)
 	{
@@ -465,39 +832,931 @@ void DeviceCardDav::respAddressData(const QNetworkReply & a_Reply)
 		return;
 	}
 
-	// Sync the contacts:
-	const auto & children = m_DavPropertyTree->nodeChildren(a_Reply.url());
-	auto size = children.size();
-	for (int i = 0; i < size; ++i)
+	auto httpStatus = a_Reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if (httpStatus != 207)
 	{
-		const auto & chUrl = children.at(i);
-		auto contact = cb->contactFromUrl(chUrl);
-		if (contact == nullptr)
+		if (httpStatus == 0)
 		{
-			qDebug() << __FUNCTION__ <<": Creating a new contact for URL " << chUrl.toString();
-			contact = std::static_pointer_cast<DavContact>(cb->createNewContact());
-			contact->setUrl(chUrl);
+			// Not an HTTP error, but a network one; the next periodic check will retry:
+			qDebug() << __FUNCTION__ << ": Network error while syncing: " << a_Reply.errorString();
+			setOffline();
+			return;
 		}
-		const auto & childNode = m_DavPropertyTree->node(chUrl);
-		auto serverEtag = childNode.findProp<DavPropertyTree::TextProperty>(NS_DAV, "getetag");
-		if (serverEtag == nullptr)
+		if (checkDiscoveryStale(a_Reply))
 		{
-			qDebug() << __FUNCTION__
-				<< ": Server didn't report an etag for contact at " << chUrl.toString()
-				<< ", skipping contact sync.";
-			continue;
+			return;
 		}
-		contact->setEtag(serverEtag->value());
-		auto serverData = childNode.findProp<DavPropertyTree::TextProperty>(NS_CARDDAV, "address-data");
-		if (serverData == nullptr)
+		if (!cb->m_SyncToken.isEmpty())
+		{
+			// The server has most likely invalidated the token (403 / 409 with DAV:valid-sync-token), start over:
+			qDebug() << __FUNCTION__ << ": Server rejected the sync token (" << httpStatus << "), doing a full sync.";
+			cb->m_SyncToken.clear();
+		}
+		else
+		{
+			qDebug() << __FUNCTION__ << ": Server doesn't support sync-collection (" << httpStatus << "), using ETag scan.";
+			cb->m_IsSyncCollectionSupported = false;
+		}
+		loadContactBook(cb.get());
+		return;
+	}
+
+	if (!m_IsOnline)
+	{
+		setOnline();
+	}
+
+	// A sync without a token lists the whole addressbook:
+	bool isFullListing = cb->m_SyncToken.isEmpty();
+
+	// Remove the contacts reported as removed, detect a truncated result (RFC 6578, section 3.6):
+	bool isTruncated = false;
+	{
+		ContactBook::Batch batch(*cb);
+		const auto & statuses = m_DavPropertyTree->responseStatuses();
+		for (auto itr = statuses.constBegin(), end = statuses.constEnd(); itr != end; ++itr)
+		{
+			if (itr.value() == 507)
+			{
+				isTruncated = true;
+			}
+			else if (itr.value() == 404)
+			{
+				auto contact = cb->contactFromUrl(itr.key());
+				if (contact != nullptr)
+				{
+					m_CheckHasChanges = true;
+					qDebug() << __FUNCTION__ << ": Removing contact for URL " << itr.key().toString();
+					cb->delServerContact(contact.get());
+				}
+			}
+		}
+	}
+
+	// A complete full listing also reveals the contacts removed while the token was not valid:
+	if (isFullListing && !isTruncated)
+	{
+		removeVanishedContacts(*cb);
+	}
+
+	// Store the new sync token:
+	const auto & node = m_DavPropertyTree->node(cb->m_BaseUrl);
+	auto token = node.findProp<DavPropertyTree::TextProperty>(NS_DAV, "sync-token");
+	if ((token == nullptr) || token->value().isEmpty())
+	{
+		qDebug() << __FUNCTION__ << ": Server didn't report a sync token, using ETag scan from now on.";
+		cb->m_IsSyncCollectionSupported = false;
+	}
+	else
+	{
+		cb->m_SyncToken = token->value();
+	}
+	scheduleCacheSave();
+
+	// The ETags of the changed contacts have been updated by the response, request their data:
+	requestChangedContacts(*cb);
+
+	// If the server has truncated the results, continue from the new token:
+	if (isTruncated && cb->m_IsSyncCollectionSupported)
+	{
+		qDebug() << __FUNCTION__ << ": Results truncated by the server, requesting the next part.";
+		loadContactBook(cb.get());
+	}
+}
+
+
+
+
+
+void DeviceCardDav::respCheckAddressbookTag(const QNetworkReply & a_Reply)
+{
+	auto cb = contactBookFromUrl(a_Reply.url());
+	if (cb == nullptr)
+	{
+		qWarning() << __FUNCTION__
+			<< ": Received a response for unknown ContactBook URL: " << a_Reply.url().toString()
+			<< ", ignoring.";
+		assert(!"Unknown ContactBook URL");
+		return;
+	}
+	if (a_Reply.error() != QNetworkReply::NoError)
+	{
+		if (!checkDiscoveryStale(a_Reply))
+		{
+			qDebug() << __FUNCTION__ << ": Received an error reply: " << a_Reply.errorString();
+			setOffline();
+		}
+		return;
+	}
+	if (!m_IsOnline)
+	{
+		setOnline();
+	}
+
+	// Skip the sync if the server reports the same tag as in the last sync.
+	// Prefer the getctag, fall back to the sync-token if the server doesn't support getctag:
+	const auto & node = m_DavPropertyTree->node(cb->m_BaseUrl);
+	auto ctag = node.findProp<DavPropertyTree::TextProperty>(NS_CALENDARSERVER, "getctag");
+	auto syncToken = node.findProp<DavPropertyTree::TextProperty>(NS_DAV, "sync-token");
+	if ((ctag != nullptr) && !ctag->value().isEmpty())
+	{
+		if (ctag->value() == cb->m_CTag)
+		{
+			qDebug() << __FUNCTION__ << ": No changes (ctag) in " << cb->m_BaseUrl.toString();
+			return;
+		}
+		cb->m_PendingCTag = ctag->value();
+	}
+	else if ((syncToken != nullptr) && !syncToken->value().isEmpty() && (syncToken->value() == cb->m_SyncToken))
+	{
+		qDebug() << __FUNCTION__ << ": No changes (sync-token) in " << cb->m_BaseUrl.toString();
+		return;
+	}
+	m_CheckHasChanges = true;
+	loadContactBook(cb.get());
+}
+
+
+
+
+
+void DeviceCardDav::removeVanishedContacts(DavContactBook & a_ContactBook)
+{
+	if (!m_DavPropertyTree->isResponseComplete())
+	{
+		qDebug() << __FUNCTION__ << ": The listing is incomplete, not removing any contacts.";
+		return;
+	}
+	const auto & listed = m_DavPropertyTree->responseUrls();
+
+	// Forget the tree nodes of the removed resources, so that they're not synced again:
+	for (const auto & chUrl: m_DavPropertyTree->nodeChildren(a_ContactBook.m_BaseUrl))
+	{
+		if (!listed.contains(chUrl))
+		{
+			m_DavPropertyTree->removeNode(chUrl);
+		}
+	}
+
+	// Remove the contacts:
+	std::vector<const DavContact *> toRemove;
+	for (const auto & c: a_ContactBook.contacts())
+	{
+		auto dc = dynamic_cast<const DavContact *>(c.get());
+		if ((dc == nullptr) || dc->href().isEmpty() || dc->serverData().isEmpty())
+		{
+			// Not a contact stored on the server (a new local contact not yet written)
+			continue;
+		}
+		if (!listed.contains(a_ContactBook.urlFromRelativeHref(dc->href())))
+		{
+			toRemove.push_back(dc);
+		}
+	}
+	if (toRemove.empty())
+	{
+		return;
+	}
+	m_CheckHasChanges = true;
+	ContactBook::Batch batch(a_ContactBook);
+	for (const auto & dc: toRemove)
+	{
+		qDebug() << __FUNCTION__ << ": Removing contact no longer present on the server: " << dc->href();
+		a_ContactBook.delServerContact(dc);
+	}
+}
+
+
+
+
+
+void DeviceCardDav::requestChangedContacts(DavContactBook & a_ContactBook)
+{
+	// Collect the contacts that are new or have changed:
+	QList<QUrl> toSync;
+	const auto & children = m_DavPropertyTree->nodeChildren(a_ContactBook.m_BaseUrl);
+	auto size = children.size();
+	for (int i = 0; i < size; ++i)
+	{
+		const auto & chUrl = children.at(i);
+		auto contact = a_ContactBook.contactFromUrl(chUrl);
+		if (contact == nullptr)
+		{
+			toSync.append(chUrl);
+			continue;
+		}
+		const auto & childNode = m_DavPropertyTree->node(chUrl);
+		auto serverEtag = childNode.findProp<DavPropertyTree::TextProperty>(NS_DAV, "getetag");
+		if (serverEtag == nullptr)
 		{
 			qDebug() << __FUNCTION__
-				<< ": Server didn't report any address data for contact at " << chUrl.toString()
-				<< ", skipping contact sync.";
+				<< ": Server didn't report an etag for contact at " << chUrl.toString()
+				<< ", skipping contact.";
+			continue;
+		}
+		if (contact->etag() != serverEtag->value())
+		{
+			toSync.append(chUrl);
+		}
+	}
+	qDebug() << __FUNCTION__ << ": # contacts to sync: " << toSync.size();
+
+	queueMultiget(a_ContactBook.m_BaseUrl, toSync);
+	sendQueuedMultigets();
+}
+
+
+
+
+
+void DeviceCardDav::queueMultiget(const QUrl & a_ContactBookUrl, const QList<QUrl> & a_ContactUrls)
+{
+	// Fill up the last queued batch, if it is for the same ContactBook:
+	int start = 0;
+	if (!m_MultigetQueue.empty() && (m_MultigetQueue.back().m_ContactBookUrl == a_ContactBookUrl))
+	{
+		auto & last = m_MultigetQueue.back();
+		start = std::min(std::max(m_MultigetBatchSize - last.m_ContactUrls.size(), 0), a_ContactUrls.size());
+		last.m_ContactUrls.append(a_ContactUrls.mid(0, start));
+	}
+
+	// Queue the rest of the contacts in new batches:
+	for (; start < a_ContactUrls.size(); start += m_MultigetBatchSize)
+	{
+		MultigetBatch batch;
+		batch.m_ContactBookUrl = a_ContactBookUrl;
+		batch.m_ContactUrls = a_ContactUrls.mid(start, m_MultigetBatchSize);
+		batch.m_NumRetries = 0;
+		m_MultigetQueue.push_back(std::move(batch));
+	}
+}
+
+
+
+
+
+void DeviceCardDav::sendQueuedMultigets()
+{
+	while (
+		!m_MultigetQueue.empty() &&
+		(static_cast<int>(m_MultigetsInFlight.size()) < m_MaxMultigetsInFlight)
+	)
+	{
+		auto batch = std::move(m_MultigetQueue.front());
+		m_MultigetQueue.pop_front();
+		QByteArray baReq;
+		QXmlStreamWriter w(&baReq);
+		w.writeStartDocument();
+		w.writeNamespace(NS_DAV, "d");
+		w.writeNamespace(NS_CARDDAV, "c");
+		w.writeStartElement("c:addressbook-multiget");
+			w.writeStartElement("d:prop");
+				w.writeEmptyElement("d:getetag");
+				w.writeEmptyElement("c:address-data");
+			w.writeEndElement();
+			for (const auto & url: batch.m_ContactUrls)
+			{
+				w.writeTextElement("d:href", m_DavPropertyTree->hrefFromUrl(url));
+			}
+		w.writeEndElement();
+		w.writeEndDocument();
+		qDebug() << __FUNCTION__ << ": Requesting " << batch.m_ContactUrls.size() << " contacts";
+		auto reply = m_DavPropertyTree->sendRequest(batch.m_ContactBookUrl, "REPORT", 1, baReq, reqAddressbookData);
+		m_MultigetsInFlight[reply] = std::move(batch);
+	}
+}
+
+
+
+
+
+bool DeviceCardDav::isPushPending(const QUrl & a_ContactBookUrl, const QString & a_Href) const
+{
+	return m_PendingPushes.contains(journalKey(a_ContactBookUrl, a_Href));
+}
+
+
+
+
+
+void DeviceCardDav::sendQueuedPushes()
+{
+	while (
+		!m_PushQueue.empty() &&
+		(static_cast<int>(m_PushesInFlight.size()) < m_MaxPushesInFlight)
+	)
+	{
+		auto op = std::move(m_PushQueue.front());
+		m_PushQueue.pop_front();
+		auto cb = contactBookFromUrl(op.m_ContactBookUrl);
+		if (cb == nullptr)
+		{
+			qDebug() << __FUNCTION__ << ": ContactBook no longer present: " << op.m_ContactBookUrl.toString();
+			m_PendingPushes.remove(journalKey(op.m_ContactBookUrl, op.m_Href));
 			continue;
 		}
-		parseServerDataToContact(serverData->value(), contact);
-		qDebug() << __FUNCTION__ << ": Contact parsed, URL " << chUrl.toString();
+		auto url = cb->urlFromRelativeHref(op.m_Href);
+		QList<QPair<QByteArray, QByteArray>> headers;
+		QNetworkReply * reply;
+		if (op.m_IsDelete)
+		{
+			if (!op.m_Etag.isEmpty())
+			{
+				headers.append(qMakePair(QByteArray("If-Match"), op.m_Etag.toUtf8()));
+			}
+			op.m_JournalSeq = m_Journal.value(journalKey(op.m_ContactBookUrl, op.m_Href)).m_Seq;
+			reply = m_DavPropertyTree->sendResourceRequest(url, "DELETE", QByteArray(), QByteArray(), headers, reqPushContact);
+		}
+		else
+		{
+			// Write the current version of the contact, it may have changed since it was queued:
+			op.m_Contact = cb->contactFromUrl(url);
+			if ((op.m_Contact == nullptr) || !op.m_Contact->isModified())
+			{
+				// Deleted or already written in the meantime
+				m_PendingPushes.remove(journalKey(op.m_ContactBookUrl, op.m_Href));
+				continue;
+			}
+			op.m_Etag = op.m_Contact->etag();
+			auto journalItr = m_Journal.constFind(journalKey(op.m_ContactBookUrl, op.m_Href));
+			if ((journalItr != m_Journal.constEnd()) && (journalItr->m_Type == JournalRecord::jrPut))
+			{
+				// The journal has the data of the current version already serialized:
+				op.m_Data = journalItr->m_Data;
+				op.m_JournalSeq = journalItr->m_Seq;
+			}
+			else
+			{
+				QBuffer buf(&op.m_Data);
+				buf.open(QIODevice::WriteOnly);
+				VCardSerializer::serialize(*op.m_Contact, buf);
+				buf.close();
+			}
+			if (op.m_Etag.isEmpty())
+			{
+				// A new contact, must not overwrite anything on the server:
+				headers.append(qMakePair(QByteArray("If-None-Match"), QByteArray("*")));
+			}
+			else
+			{
+				headers.append(qMakePair(QByteArray("If-Match"), op.m_Etag.toUtf8()));
+			}
+			reply = m_DavPropertyTree->sendResourceRequest(
+				url, "PUT", op.m_Data, "text/vcard; charset=utf-8", headers, reqPushContact
+			);
+		}
+		m_PushesInFlight[reply] = std::move(op);
+	}
+}
+
+
+
+
+
+void DeviceCardDav::requestAddressbookTag(DavContactBook & a_ContactBook)
+{
+	// Drop the tags from previous responses, so that they aren't mistaken for the server's answer:
+	auto & node = m_DavPropertyTree->node(a_ContactBook.m_BaseUrl);
+	node.removeProperty(NS_CALENDARSERVER, "getctag");
+	node.removeProperty(NS_DAV, "sync-token");
+
+	QByteArray baReq;
+	QXmlStreamWriter w(&baReq);
+	w.writeStartDocument();
+	w.writeNamespace(NS_DAV, "d");
+	w.writeNamespace(NS_CALENDARSERVER, "cs");
+	w.writeStartElement("d:propfind");
+		w.writeStartElement("d:prop");
+			w.writeEmptyElement("cs:getctag");
+			w.writeEmptyElement("d:sync-token");
+		w.writeEndElement();
+	w.writeEndElement();
+	w.writeEndDocument();
+	m_DavPropertyTree->sendRequest(a_ContactBook.m_BaseUrl, "PROPFIND", 0, baReq, reqCheckAddressbookTag);
+}
+
+
+
+
+
+void DeviceCardDav::finishCheckIfIdle()
+{
+	if (
+		!m_PollScheduler.isPolling() ||
+		(m_DavPropertyTree->numRequestsInFlight() > 0) ||
+		!m_MultigetQueue.empty()
+	)
+	{
+		return;
+	}
+
+	// All the changes have been synced, remember the tags of the synced addressbooks:
+	if (!m_CheckHasFailed)
+	{
+		for (const auto & cb: m_ContactBooks)
+		{
+			if (!cb->m_PendingCTag.isEmpty())
+			{
+				cb->m_CTag = cb->m_PendingCTag;
+				cb->m_PendingCTag.clear();
+				scheduleCacheSave();
+			}
+		}
+	}
+	m_PollScheduler.pollFinished(m_CheckHasChanges, m_CheckHasFailed);
+}
+
+
+
+
+
+void DeviceCardDav::respAddressData(const QNetworkReply & a_Reply)
+{
+	// Get the batch to which the reply belongs:
+	auto itr = m_MultigetsInFlight.find(&a_Reply);
+	if (itr == m_MultigetsInFlight.end())
+	{
+		qWarning() << __FUNCTION__ << ": Received a response for an unknown multiget batch, ignoring.";
+		assert(!"Unknown multiget batch");
+		return;
+	}
+	auto batch = std::move(itr->second);
+	m_MultigetsInFlight.erase(itr);
+
+	// Re-queue a failed batch, unless it has failed too many times already:
+	auto httpStatus = a_Reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if ((a_Reply.error() != QNetworkReply::NoError) || (httpStatus != 207))
+	{
+		if (batch.m_NumRetries < MAX_MULTIGET_RETRIES)
+		{
+			qDebug() << __FUNCTION__ << ": Multiget failed (" << httpStatus << "), re-queueing the batch.";
+			batch.m_NumRetries += 1;
+			m_MultigetQueue.push_back(std::move(batch));
+		}
+		else
+		{
+			// The contacts will be requested again on the next full sync, since their ETags still differ:
+			qDebug() << __FUNCTION__ << ": Multiget failed (" << httpStatus << ") too many times, giving up.";
+			m_CheckHasFailed = true;
+			auto cb = contactBookFromUrl(batch.m_ContactBookUrl);
+			if (cb != nullptr)
+			{
+				cb->m_SyncToken.clear();
+			}
+		}
+		sendQueuedMultigets();
+		return;
+	}
+
+	// Get the ContactBook on which to perform the sync:
+	auto cb = contactBookFromUrl(batch.m_ContactBookUrl);
+	if (cb == nullptr)
+	{
+		// The ContactBook has been removed while the batch was in flight
+		qDebug() << __FUNCTION__ << ": ContactBook no longer present: " << batch.m_ContactBookUrl.toString();
+		sendQueuedMultigets();
+		return;
+	}
+
+	// Sync the contacts in the batch, report all the changes as a single ContactBook batch.
+	// The contacts may already be published in a snapshot, so changed contacts are parsed into a new instance
+	// and then replaced in the contact book, rather than modified in-place:
+	m_CheckHasChanges = true;
+	std::vector<std::pair<DavContactPtr, DavContactPtr>> conflicts;  // Local and server versions
+	{
+		ContactBook::Batch cbBatch(*cb);
+		for (const auto & chUrl: batch.m_ContactUrls)
+		{
+			const auto & childNode = m_DavPropertyTree->node(chUrl);
+			auto serverEtag = childNode.findProp<DavPropertyTree::TextProperty>(NS_DAV, "getetag");
+			if (serverEtag == nullptr)
+			{
+				qDebug() << __FUNCTION__
+					<< ": Server didn't report an etag for contact at " << chUrl.toString()
+					<< ", skipping contact sync.";
+				continue;
+			}
+			auto serverData = childNode.findProp<DavPropertyTree::TextProperty>(NS_CARDDAV, "address-data");
+			if (serverData == nullptr)
+			{
+				qDebug() << __FUNCTION__
+					<< ": Server didn't report any address data for contact at " << chUrl.toString()
+					<< ", skipping contact sync.";
+				continue;
+			}
+			auto href = cb->relativeHref(chUrl);
+			if (href.isEmpty())
+			{
+				qDebug() << __FUNCTION__
+					<< ": Contact at " << chUrl.toString() << " is outside its ContactBook, skipping contact sync.";
+				continue;
+			}
+			DavContactPtr contact(new DavContact);
+			contact->setHref(href);
+			contact->setEtag(serverEtag->value());
+			contact->setServerData(serverData->value().toUtf8());
+			parseServerDataToContact(serverData->value(), contact);
+			auto oldContact = cb->contactFromUrl(chUrl);
+			auto pendingDelete = cb->m_PendingDeletes.find(href);
+			if (pendingDelete != cb->m_PendingDeletes.end())
+			{
+				// Deleted locally, the delete is yet to be written; rebase it if the contact has changed on the server:
+				if (pendingDelete.value() != contact->etag())
+				{
+					qDebug() << __FUNCTION__ << ": Contact changed on the server before pushing the local delete: "
+						<< chUrl.toString();
+					pendingDelete.value() = contact->etag();
+					rebaseJournalRecord(*cb, href, contact->etag());
+					conflicts.emplace_back(nullptr, contact);
+				}
+				continue;
+			}
+			if (oldContact == nullptr)
+			{
+				qDebug() << __FUNCTION__ <<": Creating a new contact for URL " << chUrl.toString();
+				cb->addServerContact(contact);
+			}
+			else if (oldContact->isModified())
+			{
+				if (oldContact->etag() == contact->etag())
+				{
+					// The server still has the version that the local changes are based on, keep them as they are:
+					continue;
+				}
+
+				// Keep the local changes, rebased onto the server version, so that the next push overwrites it:
+				qDebug() << __FUNCTION__ << ": Contact changed on the server before pushing the local changes: "
+					<< chUrl.toString();
+				auto rebased = std::static_pointer_cast<DavContact>(oldContact->clone());
+				rebased->setEtag(contact->etag());
+				rebased->setServerData(contact->serverData());
+				cb->replaceWithServerContact(oldContact.get(), rebased);
+				rebaseJournalRecord(*cb, href, contact->etag());
+				conflicts.emplace_back(rebased, contact);
+			}
+			else
+			{
+				cb->replaceWithServerContact(oldContact.get(), contact);
+			}
+			qDebug() << __FUNCTION__ << ": Contact parsed, URL " << chUrl.toString();
+		}
+	}
+	for (const auto & conflict: conflicts)
+	{
+		emit pushConflict(cb.get(), conflict.first, conflict.second);
+	}
+
+	scheduleCacheSave();
+	sendQueuedMultigets();
+}
+
+
+
+
+
+void DeviceCardDav::respPushContact(const QNetworkReply & a_Reply)
+{
+	// Get the write to which the reply belongs:
+	auto itr = m_PushesInFlight.find(&a_Reply);
+	if (itr == m_PushesInFlight.end())
+	{
+		qWarning() << __FUNCTION__ << ": Received a response for an unknown write, ignoring.";
+		assert(!"Unknown write");
+		return;
+	}
+	auto op = std::move(itr->second);
+	m_PushesInFlight.erase(itr);
+	m_PendingPushes.remove(journalKey(op.m_ContactBookUrl, op.m_Href));
+	auto cb = contactBookFromUrl(op.m_ContactBookUrl);
+	if (cb == nullptr)
+	{
+		// The ContactBook has been removed while the write was in flight
+		qDebug() << __FUNCTION__ << ": ContactBook no longer present: " << op.m_ContactBookUrl.toString();
+		sendQueuedPushes();
+		return;
+	}
+	auto url = cb->urlFromRelativeHref(op.m_Href);
+
+	auto httpStatus = a_Reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if ((httpStatus >= 200) && (httpStatus < 300))
+	{
+		if (op.m_IsDelete)
+		{
+			qDebug() << __FUNCTION__ << ": Contact deleted: " << url.toString();
+			cb->m_PendingDeletes.remove(op.m_Href);
+			m_DavPropertyTree->removeNode(url);
+		}
+		else
+		{
+			// Store the new ETag and server data; the server may not report the ETag if it has modified the data,
+			// in which case the contact is re-fetched on the next sync:
+			qDebug() << __FUNCTION__ << ": Contact written: " << url.toString();
+			auto current = cb->contactFromUrl(url);
+			if (current != nullptr)
+			{
+				auto updated = std::static_pointer_cast<DavContact>(current->clone());
+				updated->setEtag(QString::fromUtf8(a_Reply.rawHeader("ETag")));
+				updated->setServerData(op.m_Data);
+
+				// If the contact has changed again while being written, keep it for the next push:
+				updated->setModified(current != op.m_Contact);
+				cb->replaceWithServerContact(current.get(), updated);
+			}
+		}
+		journalWriteDone(op);
+		scheduleCacheSave();
+	}
+	else if ((httpStatus == 404) && op.m_IsDelete)
+	{
+		qDebug() << __FUNCTION__ << ": Contact already deleted on the server: " << url.toString();
+		cb->m_PendingDeletes.remove(op.m_Href);
+		m_DavPropertyTree->removeNode(url);
+		journalWriteDone(op);
+		scheduleCacheSave();
+	}
+	else if (httpStatus == 412)
+	{
+		// The contact has changed on the server since it was last synced; re-fetch it. The local change stays
+		// pending (and journaled), it gets rebased onto the server version and pushConflict() is emitted:
+		qDebug() << __FUNCTION__ << ": Conflict while writing contact " << url.toString() << ", re-fetching it.";
+		queueMultiget(cb->m_BaseUrl, {url});
+		sendQueuedMultigets();
+	}
+	else if (httpStatus == 0)
+	{
+		// Not an HTTP error, but a network one; the change stays pending for the next push:
+		qDebug() << __FUNCTION__ << ": Network error while writing contact: " << a_Reply.errorString();
+		setOffline();
+	}
+	else
+	{
+		qWarning() << __FUNCTION__ << ": Failed to write contact " << url.toString() << ": " << httpStatus
+			<< a_Reply.errorString();
+	}
+	sendQueuedPushes();
+	if (m_PushesInFlight.empty() || (m_JournalPendingDone.size() >= JOURNAL_DONE_BATCH_SIZE))
+	{
+		flushJournalDone();
+	}
+}
+
+
+
+
+
+QString DeviceCardDav::displayNameForAdressbook(const QUrl & a_AddressbookUrl)
+{
+	auto displayNameProp = m_DavPropertyTree->node(a_AddressbookUrl).findProp<DavPropertyTree::TextProperty>(NS_DAV, "displayname");
+	if (displayNameProp != nullptr)
+	{
+		return displayNameProp->value();
+	}
+	auto path = a_AddressbookUrl.path();
+	if (path.endsWith('/'))
+	{
+		path.remove(path.length() - 1, 1);
+	}
+	auto idxLastSlash = path.lastIndexOf('/');
+	if (idxLastSlash > 0)
+	{
+		path.remove(0, idxLastSlash);
+	}
+	return path;
+}
+
+
+
+
+
+void DeviceCardDav::setOnline()
+{
+	qDebug() << __FUNCTION__;
+	auto wasOnline = m_IsOnline;
+	m_IsOnline = true;
+	emit online(this, true);
+
+	// Replay the local changes made while offline:
+	if (!wasOnline && !m_Journal.isEmpty())
+	{
+		pushChanges();
+	}
+}
+
+
+
+
+
+void DeviceCardDav::setOffline()
+{
+	qDebug() << __FUNCTION__;
+	m_CheckHasFailed = true;
+	m_IsOnline = false;
+	emit online(this, false);
+}
+
+
+
+
+
+void DeviceCardDav::loadContactBook(DeviceCardDav::DavContactBook * a_ContactBook)
+{
+	qDebug() << __FUNCTION__ << ": Loading ContactBook " << a_ContactBook->m_BaseUrl.toString();
+	if (a_ContactBook->m_IsSyncCollectionSupported)
+	{
+		// Ask only for the changes since the last sync (RFC 6578):
+		QByteArray baReq;
+		QXmlStreamWriter w(&baReq);
+		w.writeStartDocument();
+		w.writeNamespace(NS_DAV, "d");
+		w.writeStartElement("d:sync-collection");
+			w.writeTextElement("d:sync-token", a_ContactBook->m_SyncToken);
+			w.writeTextElement("d:sync-level", "1");
+			w.writeStartElement("d:prop");
+				w.writeEmptyElement("d:getetag");
+			w.writeEndElement();
+		w.writeEndElement();
+		w.writeEndDocument();
+		m_DavPropertyTree->sendRequest(a_ContactBook->m_BaseUrl, "REPORT", 0, baReq, reqSyncCollection);
+		return;
+	}
+
+	// Sync-collection not supported, list the ETags of all the contacts:
+	QByteArray baReq;
+	QXmlStreamWriter w(&baReq);
+	w.writeStartDocument();
+	w.writeNamespace(NS_DAV, "d");
+	w.writeNamespace(NS_CARDDAV, "c");
+	w.writeStartElement("c:addressbook-query");
+		w.writeStartElement("d:prop");
+			w.writeEmptyElement("d:getetag");
+		w.writeEndElement();
+	w.writeEndElement();
+	w.writeEndDocument();
+	m_DavPropertyTree->sendRequest(a_ContactBook->m_BaseUrl, "REPORT", 1, baReq, reqCheckAddressbookEtags);
+}
+
+
+
+
+
+DeviceCardDav::DavContactBookPtr DeviceCardDav::contactBookFromUrl(const QUrl & a_Url)
+{
+	for (auto & cb: m_ContactBooks)
+	{
+		if (cb->m_BaseUrl == a_Url)
+		{
+			return cb;
+		}
+	}
+	return nullptr;
+}
+
+
+
+
+
+void DeviceCardDav::parseServerDataToContact(const QString & a_ServerData, DavContactPtr a_Contact)
+{
+	// Parse the VCard data into a new contact:
+	try
+	{
+		auto baServerData = a_ServerData.toUtf8();
+
+		// DEBUG: Save data to file:
+		static int counter = 0;
+		auto fnam = QString("dbg/contact_%1.vcf").arg(counter);
+		QFile f(fnam);
+		if (f.open(QIODevice::WriteOnly))
+		{
+			f.write(baServerData);
+			f.close();
+		}
+		counter += 1;
+
+		QBuffer bufServerData(&baServerData);
+		bufServerData.open(QIODevice::ReadOnly);
+		VCardParser::parse(bufServerData, std::dynamic_pointer_cast<Contact>(a_Contact));
+	}
+	catch (const EException & exc)
+	{
+		qDebug() << __FUNCTION__
+			<< ": Exception while parsing contact " << a_Contact->href()
+			<< ": " << exc.what()
+			<< "\nServer data: " << a_ServerData;
+		return;
+	}
+}
+
+
+
+
+
+QString DeviceCardDav::cacheFileName() const
+{
+	return QString("%1/CardDav/%2.cache").arg(
+		QStandardPaths::writableLocation(QStandardPaths::CacheLocation),
+		storageName()
+	);
+}
+
+
+
+
+
+void DeviceCardDav::loadCache()
+{
+	QFile f(cacheFileName());
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		qDebug() << __FUNCTION__ << ": No local cache: " << f.fileName();
+		return;
+	}
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_6);
+	quint32 magic = 0, version = 0;
+	ds >> magic >> version;
+	if ((magic != CACHE_MAGIC) || (version != CACHE_VERSION))
+	{
+		qDebug() << __FUNCTION__ << ": Unsupported local cache format, ignoring: " << f.fileName();
+		return;
+	}
+
+	// Read all the data:
+	std::vector<std::pair<DavContactBookPtr, std::vector<DavContactPtr>>> books;
+	quint32 numBooks = 0;
+	ds >> numBooks;
+	for (quint32 i = 0; (i < numBooks) && (ds.status() == QDataStream::Ok); ++i)
+	{
+		QUrl baseUrl;
+		QString displayName, syncToken, ctag;
+		quint32 numContacts = 0;
+		ds >> baseUrl >> displayName >> syncToken >> ctag >> numContacts;
+		auto cb = std::make_shared<DavContactBook>(baseUrl, displayName);
+		cb->m_SyncToken = syncToken;
+		cb->m_CTag = ctag;
+		std::vector<DavContactPtr> contacts;
+		for (quint32 c = 0; (c < numContacts) && (ds.status() == QDataStream::Ok); ++c)
+		{
+			QString href, etag;
+			QByteArray serverData;
+			ds >> href >> etag >> serverData;
+			DavContactPtr contact(new DavContact);
+			contact->setHref(href);
+			contact->setEtag(etag);
+			contact->setServerData(serverData);
+			contacts.push_back(std::move(contact));
+		}
+		books.emplace_back(std::move(cb), std::move(contacts));
+	}
+	if (ds.status() != QDataStream::Ok)
+	{
+		qWarning() << __FUNCTION__ << ": The local cache is corrupt, ignoring: " << f.fileName();
+		return;
+	}
+
+	// Parse the contacts in parallel:
+	std::vector<DavContactPtr> allContacts;
+	for (const auto & book: books)
+	{
+		allContacts.insert(allContacts.end(), book.second.begin(), book.second.end());
+	}
+	QtConcurrent::blockingMap(allContacts, [](DavContactPtr & a_Contact)
+		{
+			auto data = a_Contact->serverData();
+			QBuffer buf(&data);
+			buf.open(QIODevice::ReadOnly);
+			try
+			{
+				VCardParser::parse(buf, a_Contact);
+			}
+			catch (const EException & exc)
+			{
+				qDebug() << "Cannot parse cached contact " << a_Contact->href() << ": " << exc.what();
+				a_Contact->setSentences({});
+			}
+		}
+	);
+
+	// Publish the contact books:
+	for (auto & book: books)
+	{
+		auto & cb = book.first;
+		{
+			ContactBook::Batch batch(*cb);
+			for (auto & contact: book.second)
+			{
+				if (contact->sentences().empty())
+				{
+					// Failed to parse; sync the whole addressbook, so that the contact gets re-fetched from the server:
+					cb->m_SyncToken.clear();
+					continue;
+				}
+				cb->addServerContact(contact);
+			}
+		}
+		qDebug() << __FUNCTION__ << ": Loaded contactbook " << cb->displayName()
+			<< " from the local cache, " << cb->contacts().size() << " contacts";
+		addDavContactBook(cb);
 	}
 }
 
@@ -505,119 +1764,406 @@ void DeviceCardDav::respAddressData(const QNetworkReply & a_Reply)
 
 
 
-QString DeviceCardDav::displayNameForAdressbook(const QUrl & a_AddressbookUrl)
+void DeviceCardDav::scheduleCacheSave()
 {
-	auto displayNameProp = m_DavPropertyTree->node(a_AddressbookUrl).findProp<DavPropertyTree::TextProperty>(NS_DAV, "displayname");
-	if (displayNameProp != nullptr)
-	{
-		return displayNameProp->value();
-	}
-	auto path = a_AddressbookUrl.path();
-	if (path.endsWith('/'))
-	{
-		path.remove(path.length() - 1, 1);
-	}
-	auto idxLastSlash = path.lastIndexOf('/');
-	if (idxLastSlash > 0)
+	if (!m_CacheSaveTimer.isActive())
 	{
-		path.remove(0, idxLastSlash);
+		m_CacheSaveTimer.start(1000 * CACHE_SAVE_DELAY_SECONDS);
 	}
-	return path;
 }
 
 
 
 
 
-void DeviceCardDav::setOnline()
+void DeviceCardDav::addDavContactBook(DavContactBookPtr a_ContactBook)
 {
-	qDebug() << __FUNCTION__;
-	m_IsOnline = true;
-	emit online(this, true);
+	connect(a_ContactBook.get(), &ContactBook::contactsInserted, this, &DeviceCardDav::journalLocalChanges);
+	connect(a_ContactBook.get(), &ContactBook::contactsRemoved,  this, &DeviceCardDav::journalLocalChanges);
+	connect(a_ContactBook.get(), &ContactBook::contactsChanged,  this, &DeviceCardDav::journalLocalChanges);
+	m_ContactBooks.push_back(a_ContactBook);
+	emit addContactBook(this, a_ContactBook);
 }
 
 
 
 
 
-void DeviceCardDav::setOffline()
+QString DeviceCardDav::storageName() const
 {
-	qDebug() << __FUNCTION__;
-	m_IsOnline = false;
-	emit online(this, false);
+	return QString::fromUtf8(QCryptographicHash::hash(
+		(m_ServerUrl.toString() + "\n" + m_UserName).toUtf8(),
+		QCryptographicHash::Md5
+	).toHex());
 }
 
 
 
 
 
-void DeviceCardDav::loadContactBook(DeviceCardDav::DavContactBook * a_ContactBook)
+QString DeviceCardDav::journalFileName() const
 {
-	qDebug() << __FUNCTION__ << ": Loading ContactBook " << a_ContactBook->m_BaseUrl.toString();
-	QByteArray baReq;
-	QXmlStreamWriter w(&baReq);
-	w.writeStartDocument();
-	w.writeNamespace(NS_DAV, "d");
-	w.writeNamespace(NS_CARDDAV, "c");
-	w.writeStartElement("c:addressbook-query");
-		w.writeStartElement("d:prop");
-			w.writeEmptyElement("d:getetag");
-		w.writeEndElement();
-	w.writeEndElement();
-	w.writeEndDocument();
-	m_DavPropertyTree->sendRequest(a_ContactBook->m_BaseUrl, "REPORT", 1, baReq, reqCheckAddressbookEtags);
+	return QString("%1/CardDav/%2.journal").arg(
+		QStandardPaths::writableLocation(QStandardPaths::AppDataLocation),
+		storageName()
+	);
 }
 
 
 
 
 
-DeviceCardDav::DavContactBookPtr DeviceCardDav::contactBookFromUrl(const QUrl & a_Url)
+QString DeviceCardDav::journalKey(const QUrl & a_ContactBookUrl, const QString & a_Href)
 {
-	for (auto & cb: m_ContactBooks)
+	return a_ContactBookUrl.toString() + "\n" + a_Href;
+}
+
+
+
+
+
+void DeviceCardDav::writeJournalRecord(QDataStream & a_Stream, const JournalRecord & a_Record)
+{
+	a_Stream << static_cast<quint8>(a_Record.m_Type) << a_Record.m_ContactBookUrl << a_Record.m_Href << a_Record.m_Seq;
+	switch (a_Record.m_Type)
 	{
-		if (cb->m_BaseUrl == a_Url)
+		case JournalRecord::jrPut:    a_Stream << a_Record.m_Etag << a_Record.m_Data; break;
+		case JournalRecord::jrDelete: a_Stream << a_Record.m_Etag; break;
+		case JournalRecord::jrDone:   break;
+	}
+}
+
+
+
+
+
+bool DeviceCardDav::readJournalRecord(QDataStream & a_Stream, JournalRecord & a_Record)
+{
+	quint8 type = 0;
+	a_Stream >> type >> a_Record.m_ContactBookUrl >> a_Record.m_Href >> a_Record.m_Seq;
+	switch (type)
+	{
+		case JournalRecord::jrPut:    a_Stream >> a_Record.m_Etag >> a_Record.m_Data; break;
+		case JournalRecord::jrDelete: a_Stream >> a_Record.m_Etag; break;
+		case JournalRecord::jrDone:   break;
+		default: return false;
+	}
+	a_Record.m_Type = static_cast<JournalRecord::Type>(type);
+	return (a_Stream.status() == QDataStream::Ok);
+}
+
+
+
+
+
+void DeviceCardDav::loadJournal()
+{
+	m_Journal.clear();
+	m_JournalNumRecords = 0;
+	QFile f(journalFileName());
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		qDebug() << __FUNCTION__ << ": No journal: " << f.fileName();
+		return;
+	}
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_6);
+	quint32 magic = 0, version = 0;
+	ds >> magic >> version;
+	if ((magic != JOURNAL_MAGIC) || (version != JOURNAL_VERSION))
+	{
+		qWarning() << __FUNCTION__ << ": Unsupported journal format, ignoring: " << f.fileName();
+		return;
+	}
+
+	// Replay the records, keeping only the last change of each contact that hasn't been written yet:
+	while (!ds.atEnd())
+	{
+		JournalRecord rec;
+		if (!readJournalRecord(ds, rec))
 		{
-			return cb;
+			qWarning() << __FUNCTION__ << ": The journal is truncated, using the records read so far: " << f.fileName();
+			break;
+		}
+		m_JournalNumRecords += 1;
+		m_JournalNextSeq = std::max(m_JournalNextSeq, rec.m_Seq + 1);
+		auto key = journalKey(rec.m_ContactBookUrl, rec.m_Href);
+		if (rec.m_Type == JournalRecord::jrDone)
+		{
+			auto itr = m_Journal.find(key);
+			if ((itr != m_Journal.end()) && (itr->m_Seq <= rec.m_Seq))
+			{
+				m_Journal.erase(itr);
+			}
+		}
+		else
+		{
+			m_Journal[key] = std::move(rec);
+		}
+	}
+	f.close();
+	compactJournal();
+	qDebug() << __FUNCTION__ << ": # local changes to write: " << m_Journal.size();
+
+	// Apply the changes to the contact books; the changes for contact books not known yet are kept in the journal:
+	for (const auto & cb: m_ContactBooks)
+	{
+		ContactBook::Batch batch(*cb);
+		for (const auto & rec: m_Journal)
+		{
+			if (rec.m_ContactBookUrl == cb->m_BaseUrl)
+			{
+				applyJournalRecord(*cb, rec);
+			}
 		}
 	}
-	return nullptr;
 }
 
 
 
 
 
-void DeviceCardDav::parseServerDataToContact(const QString & a_ServerData, DavContactPtr a_Contact)
+void DeviceCardDav::applyJournalRecord(DavContactBook & a_ContactBook, const JournalRecord & a_Record)
 {
-	// Parse the VCard data into a new contact:
-	try
+	auto current = a_ContactBook.contactFromUrl(a_ContactBook.urlFromRelativeHref(a_Record.m_Href));
+	if (a_Record.m_Type == JournalRecord::jrDelete)
 	{
-		auto baServerData = a_ServerData.toUtf8();
-
-		// DEBUG: Save data to file:
-		static int counter = 0;
-		auto fnam = QString("dbg/contact_%1.vcf").arg(counter);
-		QFile f(fnam);
-		if (f.open(QIODevice::WriteOnly))
+		if (current != nullptr)
 		{
-			f.write(baServerData);
-			f.close();
+			a_ContactBook.delServerContact(current.get());
 		}
-		counter += 1;
+		a_ContactBook.m_PendingDeletes[a_Record.m_Href] = a_Record.m_Etag;
+		return;
+	}
 
-		QBuffer bufServerData(&baServerData);
-		bufServerData.open(QIODevice::ReadOnly);
-		VCardParser::parse(bufServerData, std::dynamic_pointer_cast<Contact>(a_Contact));
+	// Replace the cached server version with the changed one; keep the server data and the ETag that
+	// the change is based on, so that a concurrent change on the server is detected when writing:
+	DavContactPtr contact(new DavContact);
+	auto data = a_Record.m_Data;
+	QBuffer buf(&data);
+	buf.open(QIODevice::ReadOnly);
+	try
+	{
+		VCardParser::parse(buf, contact);
 	}
 	catch (const EException & exc)
 	{
-		qDebug() << __FUNCTION__
-			<< ": Exception while parsing contact at " << a_Contact->url().toString()
-			<< ": " << exc.what()
-			<< "\nServer data: " << a_ServerData;
+		qWarning() << __FUNCTION__ << ": Cannot parse journaled contact " << a_Record.m_Href << ": " << exc.what();
+		return;
+	}
+	contact->setHref(a_Record.m_Href);
+	contact->setEtag(a_Record.m_Etag);
+	contact->setModified(true);
+	if (current == nullptr)
+	{
+		a_ContactBook.addServerContact(contact);
+	}
+	else
+	{
+		contact->setServerData(current->serverData());
+		a_ContactBook.replaceWithServerContact(current.get(), contact);
+	}
+}
+
+
+
+
+
+void DeviceCardDav::appendJournal(const std::vector<JournalRecord> & a_Records)
+{
+	if (a_Records.empty())
+	{
 		return;
 	}
+	QFile f(journalFileName());
+	QDir().mkpath(QFileInfo(f.fileName()).path());
+	auto isNew = (f.size() == 0);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Append))
+	{
+		qWarning() << __FUNCTION__ << ": Cannot write the journal: " << f.fileName();
+		return;
+	}
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_6);
+	if (isNew)
+	{
+		ds << JOURNAL_MAGIC << JOURNAL_VERSION;
+	}
+	for (const auto & rec: a_Records)
+	{
+		writeJournalRecord(ds, rec);
+	}
+	f.flush();
+	if (ds.status() != QDataStream::Ok)
+	{
+		qWarning() << __FUNCTION__ << ": Failed to write the journal: " << f.fileName();
+	}
+	f.close();
+	m_JournalNumRecords += static_cast<int>(a_Records.size());
+
+	if (m_JournalNumRecords > 2 * m_Journal.size() + JOURNAL_COMPACTION_SLACK)
+	{
+		compactJournal();
+	}
+}
+
+
+
+
+
+void DeviceCardDav::compactJournal()
+{
+	auto fileName = journalFileName();
+	if (m_Journal.isEmpty())
+	{
+		QFile::remove(fileName);
+		m_JournalNumRecords = 0;
+		return;
+	}
+	QDir().mkpath(QFileInfo(fileName).path());
+	QSaveFile f(fileName);
+	if (!f.open(QIODevice::WriteOnly))
+	{
+		qWarning() << __FUNCTION__ << ": Cannot write the journal: " << fileName;
+		return;
+	}
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_6);
+	ds << JOURNAL_MAGIC << JOURNAL_VERSION;
+	for (const auto & rec: m_Journal)
+	{
+		writeJournalRecord(ds, rec);
+	}
+	if ((ds.status() != QDataStream::Ok) || !f.commit())
+	{
+		qWarning() << __FUNCTION__ << ": Failed to write the journal: " << fileName;
+		return;
+	}
+	m_JournalNumRecords = m_Journal.size();
+}
+
+
+
+
+
+void DeviceCardDav::rebaseJournalRecord(const DavContactBook & a_ContactBook, const QString & a_Href, const QString & a_Etag)
+{
+	auto itr = m_Journal.find(journalKey(a_ContactBook.m_BaseUrl, a_Href));
+	if (itr == m_Journal.end())
+	{
+		// Not journaled
+		return;
+	}
+	itr->m_Etag = a_Etag;
+	itr->m_Seq = m_JournalNextSeq++;
+	appendJournal({*itr});
+}
+
+
+
+
+
+void DeviceCardDav::journalWriteDone(const PushOp & a_Op)
+{
+	auto itr = m_Journal.find(journalKey(a_Op.m_ContactBookUrl, a_Op.m_Href));
+	if ((itr == m_Journal.end()) || (itr->m_Seq > a_Op.m_JournalSeq))
+	{
+		// Not journaled, or changed again while being written
+		return;
+	}
+	JournalRecord rec;
+	rec.m_Type = JournalRecord::jrDone;
+	rec.m_ContactBookUrl = a_Op.m_ContactBookUrl;
+	rec.m_Href = a_Op.m_Href;
+	rec.m_Seq = a_Op.m_JournalSeq;
+	m_Journal.erase(itr);
+	m_JournalPendingDone.push_back(std::move(rec));
+}
+
+
+
+
+
+void DeviceCardDav::flushJournalDone()
+{
+	if (m_JournalPendingDone.empty())
+	{
+		return;
+	}
+	if (m_Journal.isEmpty())
+	{
+		// All the changes have been written, drop the whole journal:
+		m_JournalPendingDone.clear();
+		compactJournal();
+		return;
+	}
+	std::vector<JournalRecord> records;
+	std::swap(records, m_JournalPendingDone);
+	appendJournal(records);
+}
+
+
+
+
+
+void DeviceCardDav::saveCache()
+{
+	m_CacheSaveTimer.stop();
+	auto fileName = cacheFileName();
+	QDir().mkpath(QFileInfo(fileName).path());
+	QSaveFile f(fileName);
+	if (!f.open(QIODevice::WriteOnly))
+	{
+		qWarning() << __FUNCTION__ << ": Cannot write the local cache: " << fileName;
+		return;
+	}
+	QDataStream ds(&f);
+	ds.setVersion(QDataStream::Qt_5_6);
+	ds << CACHE_MAGIC << CACHE_VERSION << static_cast<quint32>(m_ContactBooks.size());
+	for (const auto & cb: m_ContactBooks)
+	{
+		// Only the contacts received from the server are cached:
+		std::vector<const DavContact *> contacts;
+		for (const auto & c: cb->contacts())
+		{
+			auto dc = dynamic_cast<const DavContact *>(c.get());
+			if ((dc != nullptr) && !dc->href().isEmpty() && !dc->serverData().isEmpty())
+			{
+				contacts.push_back(dc);
+			}
+		}
+		// If the contacts of the last sync haven't all been received yet, don't save the tags, so that
+		// the next run doesn't consider them up-to-date:
+		auto isSyncing = std::any_of(m_MultigetQueue.begin(), m_MultigetQueue.end(),
+			[&cb](const MultigetBatch & a_Batch)
+			{
+				return (a_Batch.m_ContactBookUrl == cb->m_BaseUrl);
+			}
+		) || std::any_of(m_MultigetsInFlight.begin(), m_MultigetsInFlight.end(),
+			[&cb](const std::pair<const QNetworkReply * const, MultigetBatch> & a_Batch)
+			{
+				return (a_Batch.second.m_ContactBookUrl == cb->m_BaseUrl);
+			}
+		);
+		ds << cb->m_BaseUrl << cb->displayName();
+		if (isSyncing)
+		{
+			ds << QString() << QString();
+		}
+		else
+		{
+			ds << cb->m_SyncToken << cb->m_CTag;
+		}
+		ds << static_cast<quint32>(contacts.size());
+		for (const auto & dc: contacts)
+		{
+			ds << dc->href() << dc->etag() << dc->serverData();
+		}
+	}
+	if ((ds.status() != QDataStream::Ok) || !f.commit())
+	{
+		qWarning() << __FUNCTION__ << ": Failed to write the local cache: " << fileName;
+	}
 }
 
 
@@ -634,14 +2180,22 @@ void DeviceCardDav::replyFinished(
 
 	switch (a_UserData.toInt())
 	{
-		case reqDetectAddressBookSupport: return respDetectAddressBookSupport(*a_Reply);
-		case reqCurrentUserPrincipal:     return respCurrentUserPrincipal(*a_Reply);
-		case reqAddressbookRoot:          return respAddressbookRoot(*a_Reply);
-		case reqListAddressbooks:         return respListAddressbooks(*a_Reply);
-		case reqCheckAddressbookEtags:    return respCheckAddressbookEtags(*a_Reply);
-		case reqAddressbookData:          return respAddressData(*a_Reply);
+		case reqDetectAddressBookSupport: respDetectAddressBookSupport(*a_Reply); break;
+		case reqCurrentUserPrincipal:     respCurrentUserPrincipal(*a_Reply);     break;
+		case reqAddressbookRoot:          respAddressbookRoot(*a_Reply);          break;
+		case reqListAddressbooks:         respListAddressbooks(*a_Reply);         break;
+		case reqCheckAddressbookEtags:    respCheckAddressbookEtags(*a_Reply);    break;
+		case reqAddressbookData:          respAddressData(*a_Reply);              break;
+		case reqSyncCollection:           respSyncCollection(*a_Reply);           break;
+		case reqCheckAddressbookTag:      respCheckAddressbookTag(*a_Reply);      break;
+		case reqPushContact:              respPushContact(*a_Reply);              break;
+		default:
+		{
+			qWarning() << __FUNCTION__ << ": Unhandled request type: " << a_UserData;
+			break;
+		}
 	}
-	qWarning() << __FUNCTION__ << ": Unhandled request type: " << a_UserData;
+	finishCheckIfIdle();
 }
 
 
@@ -661,8 +2215,25 @@ void DeviceCardDav::davResponseError(const QString & a_Error)
 
 void DeviceCardDav::periodicCheck()
 {
-	// Start by detecting address-book support on the URL:
 	qDebug() << __FUNCTION__ << ": Initiating a periodic check";
+	m_CheckHasChanges = false;
+	m_CheckHasFailed = false;
+	if (
+		!m_IsDiscoveryNeeded &&
+		m_SinceDiscovery.isValid() &&
+		!m_SinceDiscovery.hasExpired(1000LL * REDISCOVERY_SECONDS)
+	)
+	{
+		// The discovered URLs are still valid, go straight to checking the addressbooks for changes:
+		for (const auto & cb: m_ContactBooks)
+		{
+			requestAddressbookTag(*cb);
+		}
+		finishCheckIfIdle();
+		return;
+	}
+
+	// Start the discovery by detecting address-book support on the URL:
 	m_DavPropertyTree->sendRequest(m_ServerUrl, "OPTIONS", 0, QByteArray(), reqDetectAddressBookSupport);
 }
 
@@ -670,3 +2241,60 @@ void DeviceCardDav::periodicCheck()
 
 
 
+void DeviceCardDav::journalLocalChanges()
+{
+	std::vector<JournalRecord> records;
+	for (const auto & cb: m_ContactBooks)
+	{
+		for (const auto & href: cb->m_UnjournaledHrefs)
+		{
+			JournalRecord rec;
+			rec.m_ContactBookUrl = cb->m_BaseUrl;
+			rec.m_Href = href;
+			auto key = journalKey(cb->m_BaseUrl, href);
+			auto contact = cb->contactFromUrl(cb->urlFromRelativeHref(href));
+			if ((contact != nullptr) && contact->isModified())
+			{
+				rec.m_Type = JournalRecord::jrPut;
+				rec.m_Etag = contact->etag();
+				QBuffer buf(&rec.m_Data);
+				buf.open(QIODevice::WriteOnly);
+				VCardSerializer::serialize(*contact, buf);
+			}
+			else if (cb->m_PendingDeletes.contains(href))
+			{
+				rec.m_Type = JournalRecord::jrDelete;
+				rec.m_Etag = cb->m_PendingDeletes.value(href);
+			}
+			else if (m_Journal.contains(key))
+			{
+				// A new contact deleted before being written, cancel its write:
+				rec.m_Type = JournalRecord::jrDone;
+			}
+			else
+			{
+				continue;
+			}
+			rec.m_Seq = m_JournalNextSeq++;
+			if (rec.m_Type == JournalRecord::jrDone)
+			{
+				m_Journal.remove(key);
+			}
+			else
+			{
+				m_Journal[key] = rec;
+			}
+			records.push_back(std::move(rec));
+		}
+		cb->m_UnjournaledHrefs.clear();
+	}
+	if (records.empty())
+	{
+		return;
+	}
+	appendJournal(records);
+	if (m_IsOnline)
+	{
+		pushChanges();
+	}
+}
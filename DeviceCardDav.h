@@ -4,11 +4,24 @@
 
 
 
+#include <deque>
+#include <map>
+#include <QHash>
+#include <QSet>
 #include <QUrl>
 #include <QTimer>
+#include <QElapsedTimer>
 #include "Device.h"
 #include "DavPropertyTree.h"
 #include "ContactBook.h"
+#include "PollScheduler.h"
+
+
+
+
+
+// fwd:
+class QDataStream;
 
 
 
@@ -39,6 +52,27 @@ public:
 	/** Returns true if the device is currently online. */
 	virtual bool isOnline() const override;
 
+	/** Re-runs the whole service discovery (addressbook support, user principal, addressbook home and
+	the addressbook list) and re-syncs all the addressbooks. */
+	virtual void refresh() override;
+
+	/** Writes the local changes in all the addressbooks back to the server (async).
+	The modified and new contacts are PUT and the deleted ones DELETEd, conditionally on their ETag, with up to
+	m_MaxPushesInFlight requests at a time. */
+	virtual void pushChanges() override;
+
+	/** Returns true while any push is queued or in flight. */
+	virtual bool isPushing() const override;
+
+	/** Returns the metrics of the requests sent to the server, or nullptr if the device hasn't been loaded. */
+	const DavRequestMetrics * requestMetrics() const;
+
+	/** Removes all the metrics collected in requestMetrics(). */
+	void resetRequestMetrics();
+
+	/** Returns the human-readable name of the specified request type (reqXYZ). */
+	QString requestTypeName(int a_RequestType) const;
+
 	/** Returns all the contact books currently available in the device. */
 	virtual const std::vector<ContactBookPtr> contactBooks() override
 	{
@@ -59,20 +93,43 @@ protected:
 	{
 	protected:
 		QString m_Etag;
-		QUrl m_Url;
+
+		/** Set if the contact has local changes that haven't been written to the server yet. */
+		bool m_IsModified;
+
+		/** The contact's href, relative to the base URL of its DavContactBook. */
+		QString m_Href;
+
+		/** The vCard data as received from the server, stored in the local cache. */
+		QByteArray m_ServerData;
 
 	public:
+		DavContact():
+			m_IsModified(false)
+		{
+		}
+
+		// Contact overrides:
+		virtual std::shared_ptr<Contact> clone() const override { return std::make_shared<DavContact>(*this); }
+
 		const QString & etag() const { return m_Etag; }
 		void setEtag(const QString & a_Etag) { m_Etag = a_Etag; }
-		const QUrl & url() const { return m_Url; }
-		void setUrl(const QUrl & a_Url) { m_Url = a_Url; }
+		const QString & href() const { return m_Href; }
+		void setHref(const QString & a_Href) { m_Href = a_Href; }
+		const QByteArray & serverData() const { return m_ServerData; }
+		void setServerData(const QByteArray & a_ServerData) { m_ServerData = a_ServerData; }
+		bool isModified() const { return m_IsModified; }
+		void setModified(bool a_IsModified) { m_IsModified = a_IsModified; }
 	};
 
 	using DavContactPtr = std::shared_ptr<DavContact>;
 
 
 	/** ContactBook specialization for DAV contact books.
-	Remembers the addressbook's base URL. */
+	Remembers the addressbook's base URL and the state of the incremental sync.
+	The local changes made through the ContactBook API are tracked for writing back to the server: added and
+	replaced contacts are marked as modified, the deleted ones are remembered in m_PendingDeletes. The changes
+	coming from the server are applied through the *ServerContact() functions, which don't track them. */
 	class DavContactBook:
 		public ContactBook
 	{
@@ -82,22 +139,152 @@ protected:
 
 		QUrl m_BaseUrl;
 
-		explicit DavContactBook(const QUrl a_BaseUrl, const QString & a_DisplayName):
-			Super(a_DisplayName),
-			m_BaseUrl(a_BaseUrl)
-		{
-		}
+		/** The sync token received in the last sync-collection REPORT (RFC 6578).
+		Empty if the addressbook hasn't been synced yet, the next sync then lists the whole addressbook. */
+		QString m_SyncToken;
+
+		/** The getctag value of the addressbook at the time of the last successful sync.
+		Empty if unknown, the next check then syncs the addressbook. */
+		QString m_CTag;
+
+		/** The getctag value reported by the server in the current check, to be stored in m_CTag once
+		the check finishes successfully. */
+		QString m_PendingCTag;
+
+		/** Set to false once the server rejects the sync-collection REPORT for this addressbook.
+		The full ETag scan is then used instead. */
+		bool m_IsSyncCollectionSupported;
+
+		/** The hrefs of the contacts deleted locally, mapped to their last known ETag, waiting to be deleted
+		on the server. */
+		QHash<QString, QString> m_PendingDeletes;
+
+		/** The hrefs of the contacts changed locally (added, replaced or deleted) since the changes have last
+		been written into the journal. */
+		QSet<QString> m_UnjournaledHrefs;
+
+		explicit DavContactBook(const QUrl a_BaseUrl, const QString & a_DisplayName);
 
 		// ContactBook overrides:
 		virtual ContactPtr createNewContact() override;
+		virtual void addContact(ContactPtr a_Contact) override;
+		virtual void replaceContact(const Contact * a_OldContact, ContactPtr a_NewContact) override;
+		virtual void delContact(const Contact * a_Contact) override;
+
+		/** Adds a contact received from the server, without marking it as a local change. */
+		void addServerContact(DavContactPtr a_Contact);
+
+		/** Replaces a contact with the version received from the server, without marking it as a local change. */
+		void replaceWithServerContact(const Contact * a_OldContact, DavContactPtr a_NewContact);
+
+		/** Deletes a contact that has been removed on the server, without scheduling its deletion on the server. */
+		void delServerContact(const Contact * a_Contact);
 
 		/** Returns the contact represented by the specified URL, or nullptr if no such contact. */
-		DavContactPtr contactFromUrl(const QUrl & a_Url);
+		DavContactPtr contactFromUrl(const QUrl & a_Url) const;
+
+		/** Returns the href of the specified URL relative to m_BaseUrl.
+		Returns an empty string if the URL doesn't lie under m_BaseUrl. */
+		QString relativeHref(const QUrl & a_Url) const;
+
+		/** Returns the full URL for the specified href relative to m_BaseUrl. */
+		QUrl urlFromRelativeHref(const QString & a_Href) const;
+
+
+	protected:
+
+		/** The string form of m_BaseUrl, always with a trailing slash, used for converting between the full URLs
+		and the relative hrefs. */
+		QString m_BaseUrlPrefix;
+
+		/** Index of the contacts by their relative href, maintained by the ContactBook overrides.
+		New local contacts are assigned a fresh href when added, so all the contacts are indexed. */
+		QHash<QString, DavContactPtr> m_ContactsByHref;
+
+		/** Set while a server change is being applied, so that it isn't tracked as a local change. */
+		bool m_IsApplyingServerChange;
 	};
 
 	using DavContactBookPtr = std::shared_ptr<DavContactBook>;
 
 
+	/** A batch of contacts whose data is to be fetched from the server using a single addressbook-multiget. */
+	struct MultigetBatch
+	{
+		/** The URL of the ContactBook to which the contacts belong. */
+		QUrl m_ContactBookUrl;
+
+		/** The URLs of the contacts to fetch. */
+		QList<QUrl> m_ContactUrls;
+
+		/** The number of times the batch has failed and been re-queued. */
+		int m_NumRetries;
+	};
+
+
+	/** A single write of a local change to the server, a PUT of a contact or a DELETE. */
+	struct PushOp
+	{
+		/** The URL of the ContactBook to which the contact belongs. */
+		QUrl m_ContactBookUrl;
+
+		/** The href of the contact, relative to the ContactBook's base URL. */
+		QString m_Href;
+
+		/** The ETag the server is expected to have for the contact (If-Match).
+		Empty for contacts not yet stored on the server (If-None-Match: *). */
+		QString m_Etag;
+
+		/** Set for a DELETE, clear for a PUT. */
+		bool m_IsDelete;
+
+		/** The local version of the contact being written, filled in when the PUT is sent. */
+		DavContactPtr m_Contact;
+
+		/** The serialized vCard data of m_Contact, filled in when the PUT is sent. */
+		QByteArray m_Data;
+
+		/** The sequence number of the journal record being written, 0 if not journaled. */
+		quint64 m_JournalSeq;
+	};
+
+
+	/** A single record of the journal of the local changes not yet written to the server. */
+	struct JournalRecord
+	{
+		/** The kind of the record. */
+		enum Type
+		{
+			jrPut = 1,     ///< The contact has been added or changed locally
+			jrDelete = 2,  ///< The contact has been deleted locally
+			jrDone = 3,    ///< The changes up to m_Seq have been written to the server (or cancelled)
+		};
+
+		Type m_Type;
+
+		/** The URL of the ContactBook to which the contact belongs. */
+		QUrl m_ContactBookUrl;
+
+		/** The href of the contact, relative to the ContactBook's base URL. */
+		QString m_Href;
+
+		/** The sequence number of the record, increasing through the whole journal. */
+		quint64 m_Seq;
+
+		/** The ETag the local change is based on (jrPut, jrDelete). */
+		QString m_Etag;
+
+		/** The serialized vCard data of the changed contact (jrPut). */
+		QByteArray m_Data;
+
+		JournalRecord():
+			m_Type(jrDone),
+			m_Seq(0)
+		{
+		}
+	};
+
+
 	/** The server's base URL. */
 	QUrl m_ServerUrl;
 
@@ -126,14 +313,78 @@ protected:
 	/** The home URL of the address books for this user. */
 	QUrl m_AddressbookHomeUrl;
 
-	/** The timer used for checking the online status of this device periodically.
+	/** The addressbooks (URL and display name) discovered in the previous run, as read from the config.
+	Used for creating the ContactBooks on start() without re-running the discovery. */
+	std::vector<std::pair<QUrl, QString>> m_SavedAddressbooks;
+
+	/** True if the service discovery needs to be run before the addressbooks can be synced.
+	Set initially when the config has no discovery results, when the server reports that the discovered URLs
+	are no longer valid (401, 404, redirect) or when the user forces a refresh.
+	While false, the periodic check goes straight to syncing the known addressbooks. */
+	bool m_IsDiscoveryNeeded;
+
+	/** Measures the time since the last successful service discovery.
+	The discovery is re-run once in a while even without errors, to pick up the addressbooks newly created
+	on the server. */
+	QElapsedTimer m_SinceDiscovery;
+
+	/** Schedules the periodic checks of the server, adapting the interval to the changes seen.
 	Triggers the periodicCheck() slot. */
-	QTimer m_PeriodicCheck;
+	PollScheduler m_PollScheduler;
+
+	/** Set if the current periodic check has seen any changes on the server. */
+	bool m_CheckHasChanges;
+
+	/** Set if any request of the current periodic check has failed. */
+	bool m_CheckHasFailed;
 
 	/** The WebDAV protocol parser and storage for the WebDAV properties.
 	Is nullptr while this object is not loaded. */
 	std::unique_ptr<DavPropertyTree> m_DavPropertyTree;
 
+	/** The maximum number of contacts to fetch in a single addressbook-multiget request. */
+	int m_MultigetBatchSize;
+
+	/** The maximum number of addressbook-multiget requests sent to the server at the same time. */
+	int m_MaxMultigetsInFlight;
+
+	/** The multiget batches waiting to be sent, once the number of the batches in flight drops. */
+	std::deque<MultigetBatch> m_MultigetQueue;
+
+	/** The multiget batches that have been sent and are waiting for the reply, mapped by their reply. */
+	std::map<const QNetworkReply *, MultigetBatch> m_MultigetsInFlight;
+
+	/** The maximum number of PUT / DELETE requests sent to the server at the same time. */
+	int m_MaxPushesInFlight;
+
+	/** The writes of the local changes waiting to be sent, once the number of the writes in flight drops. */
+	std::deque<PushOp> m_PushQueue;
+
+	/** The writes that have been sent and are waiting for the reply, mapped by their reply. */
+	std::map<const QNetworkReply *, PushOp> m_PushesInFlight;
+
+	/** The journalKey()s of all the writes in m_PushQueue and m_PushesInFlight, for isPushPending(). */
+	QSet<QString> m_PendingPushes;
+
+	/** The journal records of the local changes not yet written to the server, mapped by journalKey().
+	Only the last change of each contact is kept, so multiple edits of a contact are written as a single PUT. */
+	QHash<QString, JournalRecord> m_Journal;
+
+	/** The jrDone records not yet appended to the journal file; they are appended in bulk, rather than one by one
+	as the writes finish. */
+	std::vector<JournalRecord> m_JournalPendingDone;
+
+	/** The number of records in the journal file, including the superseded ones. Used for deciding when to
+	compact the file. */
+	int m_JournalNumRecords;
+
+	/** The sequence number to assign to the next journal record. */
+	quint64 m_JournalNextSeq;
+
+	/** The timer used for postponing the saving of the local cache, so that a sync consisting of many
+	replies saves the cache only once. Triggers the saveCache() slot. */
+	QTimer m_CacheSaveTimer;
+
 
 	/** Loads the Device-specific data from the configuration.
 	a_Config is a config returned by save() in a previous app run, through which a Device descendant is
@@ -145,6 +396,11 @@ protected:
 	login etc. */
 	virtual QJsonObject save() const override;
 
+	/** Checks the HTTP status of the reply to a request on a discovered URL.
+	If the status indicates that the discovery results are stale (401, 404 or a redirect), schedules
+	the discovery to be re-run on the next periodic check and returns true. */
+	bool checkDiscoveryStale(const QNetworkReply & a_Reply);
+
 	/** Handles the response for addressbook support detection. */
 	void respDetectAddressBookSupport(const QNetworkReply & a_Reply);
 
@@ -160,9 +416,26 @@ protected:
 	/** Handles the response for addressbook Etag report. */
 	void respCheckAddressbookEtags(const QNetworkReply & a_Reply);
 
-	/** Handles the response for addressbook data report. */
+	/** Handles the response for the addressbook getctag / sync-token query.
+	Syncs the addressbook only if the tag has changed since the last sync. */
+	void respCheckAddressbookTag(const QNetworkReply & a_Reply);
+
+	/** Handles the response for the sync-collection report.
+	Removes the contacts reported as removed, stores the new sync token and requests the changed contacts' data.
+	Falls back to the full ETag scan if the server doesn't support the report. */
+	void respSyncCollection(const QNetworkReply & a_Reply);
+
+	/** Handles the response for a single addressbook-multiget batch.
+	Parses the contacts in the batch into the ContactBook, re-queues the batch if it failed.
+	A contact with local changes not yet written (or deleted locally) that has changed on the server is not
+	replaced; the local change is rebased onto the server version and pushConflict() is emitted. */
 	void respAddressData(const QNetworkReply & a_Reply);
 
+	/** Handles the response for a single PUT or DELETE of a local change.
+	Stores the new ETag on success. On a 412 conflict, keeps the change pending (including its journal record)
+	and re-fetches the contact from the server, so that the change gets rebased onto the server version. */
+	void respPushContact(const QNetworkReply & a_Reply);
+
 	/** Returns the display name for the specified addressbook.
 	If the server doesn't provide an addressbook displayname, it is synthesized from the URL. */
 	QString displayNameForAdressbook(const QUrl & a_AddressbookUrl);
@@ -174,9 +447,39 @@ protected:
 	TODO: Triggers the online-state-change signals. */
 	void setOffline();
 
-	/** Loads the server-side changes for the specified ContactBook (async). */
+	/** Loads the server-side changes for the specified ContactBook (async).
+	Uses the sync-collection REPORT, if supported by the server, otherwise lists the ETags of all the contacts. */
 	void loadContactBook(DavContactBook * a_ContactBook);
 
+	/** Removes the contacts, and their DavPropertyTree nodes, that are not listed in the last response, which
+	must have been a full listing of the specified ContactBook. Does nothing if the response wasn't parsed
+	completely. */
+	void removeVanishedContacts(DavContactBook & a_ContactBook);
+
+	/** Requests the data for the contacts in the specified ContactBook that are new or whose ETag reported
+	by the server differs from the one stored in the contact (async).
+	The contacts are split into multiget batches of m_MultigetBatchSize and queued. */
+	void requestChangedContacts(DavContactBook & a_ContactBook);
+
+	/** Sends the queued multiget batches, up to m_MaxMultigetsInFlight requests at a time. */
+	void sendQueuedMultigets();
+
+	/** Queues the specified contacts to be fetched from the server, appending them to the last queued batch
+	for the same ContactBook if it has room. Doesn't send the batches. */
+	void queueMultiget(const QUrl & a_ContactBookUrl, const QList<QUrl> & a_ContactUrls);
+
+	/** Returns true if a write of the specified contact is already queued or in flight. */
+	bool isPushPending(const QUrl & a_ContactBookUrl, const QString & a_Href) const;
+
+	/** Sends the queued writes, up to m_MaxPushesInFlight requests at a time. */
+	void sendQueuedPushes();
+
+	/** Asks the server for the getctag and sync-token of the specified addressbook (async). */
+	void requestAddressbookTag(DavContactBook & a_ContactBook);
+
+	/** If the current periodic check has no more requests in flight, reports its result to m_PollScheduler. */
+	void finishCheckIfIdle();
+
 	/** Returns the ContactBook that is represented by the specified URL.
 	Returns nullptr if URL not found. */
 	DavContactBookPtr contactBookFromUrl(const QUrl & a_Url);
@@ -184,6 +487,75 @@ protected:
 	/** Parses the VCard data received from the server into the specified contact. */
 	void parseServerDataToContact(const QString & a_ServerData, DavContactPtr a_Contact);
 
+	/** Returns the full path to the file used as the local cache of the contacts for this device.
+	The file is in the user's cache folder, named by the hash of the server URL and the user name. */
+	QString cacheFileName() const;
+
+	/** Loads the contact books and their contacts from the local cache, if it exists.
+	Called from start(), before any network traffic, so that the contacts are available immediately and
+	only the server-side changes since the last run need to be synced. */
+	void loadCache();
+
+	/** Schedules the local cache to be saved after a short delay. */
+	void scheduleCacheSave();
+
+	/** Adds the ContactBook to m_ContactBooks, connects its change signals to journalLocalChanges() and reports
+	it through the addContactBook() signal. */
+	void addDavContactBook(DavContactBookPtr a_ContactBook);
+
+	/** Returns the name used for the local files of this device, the hash of the server URL and the user name. */
+	QString storageName() const;
+
+	/** Returns the full path to the file used as the journal of the local changes not yet written to the server.
+	Unlike the cache, the file is in the user's app data folder, since it cannot be re-created from the server. */
+	QString journalFileName() const;
+
+	/** Returns the key for m_Journal representing the specified contact. */
+	static QString journalKey(const QUrl & a_ContactBookUrl, const QString & a_Href);
+
+	/** Writes a single journal record into the stream. */
+	static void writeJournalRecord(QDataStream & a_Stream, const JournalRecord & a_Record);
+
+	/** Reads a single journal record from the stream.
+	Returns false if the record cannot be read (such as a record truncated by a crash while writing it). */
+	static bool readJournalRecord(QDataStream & a_Stream, JournalRecord & a_Record);
+
+	/** Loads the journal of the local changes from the previous runs, compacts it and applies the changes
+	to the contact books, so that they are written to the server once it is online.
+	Called from start(), after the local cache has been loaded. */
+	void loadJournal();
+
+	/** Applies the journal record (jrPut or jrDelete) to the specified ContactBook. */
+	void applyJournalRecord(DavContactBook & a_ContactBook, const JournalRecord & a_Record);
+
+	/** Appends the records to the journal file. Compacts the file if it has grown too much over m_Journal. */
+	void appendJournal(const std::vector<JournalRecord> & a_Records);
+
+	/** Rewrites the journal file with only the records in m_Journal, or removes it if there are none. */
+	void compactJournal();
+
+	/** Rebases the journaled change of the specified contact onto the specified server ETag, so that the next write
+	(also after a restart) overwrites the server version that conflicted with it. Does nothing if not journaled. */
+	void rebaseJournalRecord(const DavContactBook & a_ContactBook, const QString & a_Href, const QString & a_Etag);
+
+	/** Marks the journal record written by the specified push as done, unless the contact has been changed
+	again since. The jrDone record is queued in m_JournalPendingDone. */
+	void journalWriteDone(const PushOp & a_Op);
+
+	/** Appends the records queued in m_JournalPendingDone to the journal file. */
+	void flushJournalDone();
+
+
+signals:
+
+	/** Emitted when a contact with local changes not yet written to the server has changed on the server, too,
+	either detected by the write being rejected with 412 Precondition Failed, or by a sync before the write.
+	The local version is kept, rebased onto the server version's ETag, so that it overwrites the server version
+	on the next push.
+	a_LocalContact is the kept local version (nullptr if the contact has been deleted locally), a_ServerContact
+	is the server version, so that its changes can be merged into the local one. */
+	void pushConflict(const ContactBook * a_ContactBook, ContactPtr a_LocalContact, ContactPtr a_ServerContact);
+
 
 protected slots:
 
@@ -200,6 +572,15 @@ protected slots:
 	/** Pings the addressbook API of the server to update the m_IsOnline member.
 	Also initiates the refresh of ContactBooks available on the server. */
 	void periodicCheck();
+
+	/** Saves the contact books (URLs, ETags, sync tokens and the server vCard data of the contacts)
+	into the local cache. */
+	void saveCache();
+
+	/** Appends the local changes made in the contact books (m_UnjournaledHrefs) to the journal and starts
+	writing them to the server, if online.
+	Triggered at the end of each ContactBook batch. */
+	void journalLocalChanges();
 };
 
 
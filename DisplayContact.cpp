@@ -1,5 +1,6 @@
 #include "DisplayContact.h"
 #include "VCardParser.h"
+#include "PhoneNumber.h"
 
 
 
@@ -46,19 +47,7 @@ std::shared_ptr<DisplayContact> DisplayContact::fromContact(const Contact & a_Co
 
 void DisplayContact::addNameItem(const Contact::Sentence & a_NameSentence)
 {
-	auto components = VCardParser::breakValueIntoParts(a_NameSentence.m_Value);
-	while (components.size() < 5)
-	{
-		components.push_back({});
-	}
-	const auto & lastNames = components[0];
-	const auto & firstNames = components[1];
-	const auto & middleNames = components[2];
-	const auto & prefixes = components[3];
-	const auto & suffixes = components[4];
-
-	auto name = composeName(firstNames, middleNames, lastNames, prefixes, suffixes);
-	addItem(nullptr, tr("Name"), {name});
+	addItem(nullptr, tr("Name"), {composeName(a_NameSentence)});
 }
 
 
@@ -91,7 +80,15 @@ void DisplayContact::addTelItem(const Contact::Sentence & a_TelSentence)
 		type = tr("%1 fax").arg(type);
 	}
 
-	addItem(icoTel(), type, {a_TelSentence.m_Value});
+	// Display the normalized (international) form of the number, if available:
+	if (a_TelSentence.m_NormalizedValue.isEmpty())
+	{
+		addItem(icoTel(), type, {a_TelSentence.m_Value});
+	}
+	else
+	{
+		addItem(icoTel(), type, {PhoneNumber::formatForDisplay(a_TelSentence.m_NormalizedValue)});
+	}
 }
 
 
@@ -195,6 +192,26 @@ QString DisplayContact::composeName(
 
 
 
+QString DisplayContact::composeName(const Contact::Sentence & a_NameSentence)
+{
+	auto components = VCardParser::breakValueIntoParts(a_NameSentence.m_Value);
+	while (components.size() < 5)
+	{
+		components.push_back({});
+	}
+	const auto & lastNames = components[0];
+	const auto & firstNames = components[1];
+	const auto & middleNames = components[2];
+	const auto & prefixes = components[3];
+	const auto & suffixes = components[4];
+
+	return composeName(firstNames, middleNames, lastNames, prefixes, suffixes);
+}
+
+
+
+
+
 bool DisplayContact::isType(const Contact::SentenceParams & a_SentenceParams, const QByteArray & a_LcType)
 {
 	for (const auto & p: a_SentenceParams)
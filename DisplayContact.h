@@ -67,6 +67,21 @@ public:
 
 	const std::vector<ItemPtr> & items() const { return m_Items; }
 
+	/** Returns the contact from which this instance was created. */
+	const Contact & contact() const { return m_Contact; }
+
+	/** Composes a name out of its (VCard) components. */
+	static QString composeName(
+		const std::vector<QByteArray> & a_FirstNames,
+		const std::vector<QByteArray> & a_MiddleNames,
+		const std::vector<QByteArray> & a_LastNames,
+		const std::vector<QByteArray> & a_Prefixes,
+		const std::vector<QByteArray> & a_Suffixes
+	);
+
+	/** Composes a name out of the components in the specified "N" VCard sentence. */
+	static QString composeName(const Contact::Sentence & a_NameSentence);
+
 
 protected:
 
@@ -99,15 +114,6 @@ protected:
 	/** Adds a new item with the specified contents. */
 	void addItem(const QIcon * a_Icon, const QString & a_Label, const std::vector<QString> & a_Values);
 
-	/** Composes a name out of its (VCard) components. */
-	QString composeName(
-		const std::vector<QByteArray> & a_FirstNames,
-		const std::vector<QByteArray> & a_MiddleNames,
-		const std::vector<QByteArray> & a_LastNames,
-		const std::vector<QByteArray> & a_Prefixes,
-		const std::vector<QByteArray> & a_Suffixes
-	);
-
 	/** Returns true if the sentence params either contain "type=<type>" (v4) or "<type>" (v2.1).
 	Used to determine home vs work vs mobile vs ... type of sentence.
 	a_LcType is the lowercase of the type to check. */
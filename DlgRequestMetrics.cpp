@@ -0,0 +1,175 @@
+#include "DlgRequestMetrics.h"
+#include <algorithm>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QVBoxLayout>
+#include "DeviceCardDav.h"
+#include "DavRequestMetrics.h"
+
+
+
+
+
+/** The interval between the updates of the displayed metrics. */
+static const int UPDATE_INTERVAL_MSEC = 1000;
+
+
+
+
+
+/** Formats the time in microseconds as milliseconds. */
+static QString formatUsec(qint64 a_Usec)
+{
+	return QString::fromUtf8("%1 ms").arg(static_cast<double>(a_Usec) / 1000, 0, 'f', 1);
+}
+
+
+
+
+
+/** Formats the size in bytes using the binary units. */
+static QString formatBytes(qint64 a_Bytes)
+{
+	if (a_Bytes < 1024)
+	{
+		return QString::fromUtf8("%1 B").arg(a_Bytes);
+	}
+	if (a_Bytes < 1024 * 1024)
+	{
+		return QString::fromUtf8("%1 KiB").arg(static_cast<double>(a_Bytes) / 1024, 0, 'f', 1);
+	}
+	return QString::fromUtf8("%1 MiB").arg(static_cast<double>(a_Bytes) / (1024 * 1024), 0, 'f', 1);
+}
+
+
+
+
+
+/** Formats the counts of the individual HTTP statuses, such as "207: 12, 404: 1". */
+static QString formatStatuses(const std::map<int, quint64> & a_StatusCounts)
+{
+	QStringList res;
+	for (const auto & sc: a_StatusCounts)
+	{
+		auto status = (sc.first == 0) ? DlgRequestMetrics::tr("network error") : QString::number(sc.first);
+		res.append(QString::fromUtf8("%1: %2").arg(status).arg(sc.second));
+	}
+	return res.join(", ");
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DlgRequestMetrics:
+
+DlgRequestMetrics::DlgRequestMetrics(DeviceCardDav & a_Device, QWidget * a_Parent):
+	Super(a_Parent),
+	m_Device(a_Device),
+	m_lblTotal(new QLabel(this)),
+	m_tblKinds(new QTableWidget(this))
+{
+	setWindowTitle(tr("Network metrics: %1").arg(m_Device.displayName()));
+	resize(1000, 400);
+
+	// Create the UI:
+	auto layV = new QVBoxLayout(this);
+	layV->addWidget(m_lblTotal);
+	m_tblKinds->setColumnCount(12);
+	m_tblKinds->setHorizontalHeaderLabels({
+		tr("Request"), tr("Method"), tr("Count"), tr("Statuses"),
+		tr("TTFB p50"), tr("TTFB p95"), tr("Total p50"), tr("Total p95"), tr("Total max"), tr("Total sum"),
+		tr("Parse avg"), tr("Sent / received"),
+	});
+	m_tblKinds->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	m_tblKinds->setSelectionBehavior(QAbstractItemView::SelectRows);
+	m_tblKinds->verticalHeader()->hide();
+	layV->addWidget(m_tblKinds);
+	auto layButtons = new QHBoxLayout();
+	layButtons->addStretch();
+	auto btnReset = new QPushButton(tr("&Reset"), this);
+	layButtons->addWidget(btnReset);
+	auto btnClose = new QPushButton(tr("&Close"), this);
+	layButtons->addWidget(btnClose);
+	layV->addLayout(layButtons);
+	setLayout(layV);
+
+	// Connect the signals:
+	connect(btnReset,       &QPushButton::clicked, this, &DlgRequestMetrics::resetMetrics);
+	connect(btnClose,       &QPushButton::clicked, this, &QDialog::accept);
+	connect(&m_UpdateTimer, &QTimer::timeout,      this, &DlgRequestMetrics::updateMetrics);
+
+	updateMetrics();
+	m_UpdateTimer.start(UPDATE_INTERVAL_MSEC);
+}
+
+
+
+
+
+void DlgRequestMetrics::updateMetrics()
+{
+	auto metrics = m_Device.requestMetrics();
+	if (metrics == nullptr)
+	{
+		m_lblTotal->setText(tr("The device doesn't collect any network metrics."));
+		m_tblKinds->setRowCount(0);
+		return;
+	}
+
+	const auto & total = metrics->total();
+	m_lblTotal->setText(tr("%1 requests, %2 in total, %3 sent, %4 received")
+		.arg(total.m_TotalUsec.count())
+		.arg(formatUsec(total.m_TotalUsec.sum()))
+		.arg(formatBytes(total.m_BytesUp.sum()))
+		.arg(formatBytes(total.m_BytesDown.sum()))
+	);
+
+	// List the request kinds that have taken the most time first:
+	auto aggregates = metrics->aggregates();
+	std::sort(aggregates.begin(), aggregates.end(),
+		[](const DavRequestMetrics::Aggregate & a_First, const DavRequestMetrics::Aggregate & a_Second)
+		{
+			return (a_First.m_TotalUsec.sum() > a_Second.m_TotalUsec.sum());
+		}
+	);
+	m_tblKinds->setRowCount(static_cast<int>(aggregates.size()));
+	int row = 0;
+	for (const auto & agg: aggregates)
+	{
+		QStringList values;
+		values
+			<< m_Device.requestTypeName(agg.m_RequestType)
+			<< QString::fromUtf8(agg.m_Method)
+			<< QString::number(agg.m_TotalUsec.count())
+			<< formatStatuses(agg.m_StatusCounts)
+			<< formatUsec(agg.m_TimeToFirstByteUsec.percentile(50))
+			<< formatUsec(agg.m_TimeToFirstByteUsec.percentile(95))
+			<< formatUsec(agg.m_TotalUsec.percentile(50))
+			<< formatUsec(agg.m_TotalUsec.percentile(95))
+			<< formatUsec(agg.m_TotalUsec.max())
+			<< formatUsec(agg.m_TotalUsec.sum())
+			<< formatUsec(static_cast<qint64>(agg.m_ParseUsec.mean()))
+			<< QString::fromUtf8("%1 / %2").arg(formatBytes(agg.m_BytesUp.sum()), formatBytes(agg.m_BytesDown.sum()));
+		for (int col = 0; col < values.size(); ++col)
+		{
+			m_tblKinds->setItem(row, col, new QTableWidgetItem(values[col]));
+		}
+		row += 1;
+	}
+	m_tblKinds->resizeColumnsToContents();
+}
+
+
+
+
+
+void DlgRequestMetrics::resetMetrics()
+{
+	m_Device.resetRequestMetrics();
+	updateMetrics();
+}
@@ -0,0 +1,69 @@
+#ifndef DLGREQUESTMETRICS_H
+#define DLGREQUESTMETRICS_H
+
+
+
+
+
+#include <QDialog>
+#include <QTimer>
+
+
+
+
+
+// fwd:
+class DeviceCardDav;
+class QLabel;
+class QTableWidget;
+
+
+
+
+
+/** Shows the metrics of the network requests sent by a single device, aggregated per request kind.
+The kinds that have spent the most time in total are listed first, so that the requests making the syncs slow
+stand out. The displayed values are updated periodically while the dialog is open. */
+class DlgRequestMetrics:
+	public QDialog
+{
+	Q_OBJECT
+	using Super = QDialog;
+
+
+public:
+
+	/** Creates the dialog for the specified device.
+	The device must outlive the dialog. */
+	DlgRequestMetrics(DeviceCardDav & a_Device, QWidget * a_Parent = nullptr);
+
+
+protected:
+
+	/** The device whose metrics are shown. */
+	DeviceCardDav & m_Device;
+
+	/** The summary of all the requests together. */
+	QLabel * m_lblTotal;
+
+	/** The metrics per request kind, one row each. */
+	QTableWidget * m_tblKinds;
+
+	/** Triggers the periodic updates of the displayed values. */
+	QTimer m_UpdateTimer;
+
+
+protected slots:
+
+	/** Fills the UI with the current metrics of the device. */
+	void updateMetrics();
+
+	/** Clears the metrics of the device and updates the UI. */
+	void resetMetrics();
+};
+
+
+
+
+
+#endif // DLGREQUESTMETRICS_H
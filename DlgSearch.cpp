@@ -0,0 +1,101 @@
+#include "DlgSearch.h"
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QVBoxLayout>
+#include "DisplayContact.h"
+#include "Session.h"
+#include "VCardParser.h"
+
+
+
+
+
+/** The maximum number of results displayed. */
+static const size_t MAX_RESULTS = 200;
+
+
+
+
+
+/** Returns the name of the contact to display in the results (FN, or the composed N if there's no FN). */
+static QString contactName(const Contact & a_Contact)
+{
+	QString res;
+	for (const auto & s: a_Contact.sentences())
+	{
+		if (s.m_Key == "fn")
+		{
+			return QString::fromUtf8(VCardParser::unescapeBackslashes(s.m_Value));
+		}
+		if ((s.m_Key == "n") && res.isEmpty())
+		{
+			res = DisplayContact::composeName(s);
+		}
+	}
+	return res;
+}
+
+
+
+
+
+DlgSearch::DlgSearch(Session & a_Session, QWidget * a_Parent):
+	Super(a_Parent),
+	m_Index(&a_Session),
+	m_leQuery(new QLineEdit(this)),
+	m_tblResults(new QTableWidget(this)),
+	m_lblStatus(new QLabel(this))
+{
+	setWindowTitle(tr("Search"));
+	resize(600, 400);
+
+	// Create the UI:
+	auto layV = new QVBoxLayout(this);
+	auto layQuery = new QHBoxLayout();
+	layQuery->addWidget(new QLabel(tr("&Search for:"), this));
+	layQuery->addWidget(m_leQuery);
+	layV->addLayout(layQuery);
+	m_tblResults->setColumnCount(2);
+	m_tblResults->setHorizontalHeaderLabels({tr("Name"), tr("Contact book")});
+	m_tblResults->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	m_tblResults->setSelectionBehavior(QAbstractItemView::SelectRows);
+	m_tblResults->verticalHeader()->hide();
+	m_tblResults->horizontalHeader()->setStretchLastSection(true);
+	layV->addWidget(m_tblResults);
+	auto layButtons = new QHBoxLayout();
+	layButtons->addWidget(m_lblStatus);
+	layButtons->addStretch();
+	auto btnClose = new QPushButton(tr("&Close"), this);
+	layButtons->addWidget(btnClose);
+	layV->addLayout(layButtons);
+	setLayout(layV);
+
+	// Connect the signals:
+	connect(m_leQuery, &QLineEdit::textChanged, this, &DlgSearch::updateResults);
+	connect(btnClose,  &QPushButton::clicked,   this, &QDialog::accept);
+
+	updateResults();
+}
+
+
+
+
+
+void DlgSearch::updateResults()
+{
+	auto hits = m_Index.search(m_leQuery->text(), MAX_RESULTS);
+	m_tblResults->setRowCount(static_cast<int>(hits.size()));
+	int row = 0;
+	for (const auto & h: hits)
+	{
+		m_tblResults->setItem(row, 0, new QTableWidgetItem(contactName(*h.m_Contact)));
+		m_tblResults->setItem(row, 1, new QTableWidgetItem(h.m_ContactBook->displayName()));
+		row += 1;
+	}
+	m_tblResults->resizeColumnsToContents();
+	m_lblStatus->setText(tr("Found %1 of %2 contacts").arg(hits.size()).arg(m_Index.numContacts()));
+}
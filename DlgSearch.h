@@ -0,0 +1,67 @@
+#ifndef DLGSEARCH_H
+#define DLGSEARCH_H
+
+
+
+
+
+#include <QDialog>
+#include "SessionSearchIndex.h"
+
+
+
+
+
+// fwd:
+class Session;
+class QLabel;
+class QLineEdit;
+class QTableWidget;
+
+
+
+
+
+/** Lets the user search all the contacts in the session by the words in their names, organizations, notes,
+e-mails or by their phone numbers, as-you-type.
+The search index is built when the dialog is created and then kept up to date with the changes in the session. */
+class DlgSearch:
+	public QDialog
+{
+	Q_OBJECT
+	using Super = QDialog;
+
+
+public:
+
+	/** Creates the dialog for the specified session.
+	The session must outlive the dialog. */
+	DlgSearch(Session & a_Session, QWidget * a_Parent = nullptr);
+
+
+protected:
+
+	/** The index of all the contacts in the session. */
+	SessionSearchIndex m_Index;
+
+	/** The query to search for. */
+	QLineEdit * m_leQuery;
+
+	/** The matching contacts. */
+	QTableWidget * m_tblResults;
+
+	/** The number of the contacts indexed and found. */
+	QLabel * m_lblStatus;
+
+
+protected slots:
+
+	/** Searches for the query currently entered and displays the matching contacts. */
+	void updateResults();
+};
+
+
+
+
+
+#endif // DLGSEARCH_H
@@ -0,0 +1,77 @@
+#include "DlgSimilarNames.h"
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QVBoxLayout>
+#include "Session.h"
+
+
+
+
+
+/** The maximum number of matches displayed. */
+static const size_t MAX_MATCHES = 100;
+
+/** The maximum edit distance between the match keys of the entered name and a displayed match. */
+static const int MAX_DISTANCE = 3;
+
+
+
+
+
+DlgSimilarNames::DlgSimilarNames(Session & a_Session, QWidget * a_Parent):
+	Super(a_Parent),
+	m_Session(a_Session),
+	m_leName(new QLineEdit(this)),
+	m_tblMatches(new QTableWidget(this))
+{
+	setWindowTitle(tr("Find similar names"));
+	resize(600, 400);
+
+	// Create the UI:
+	auto layV = new QVBoxLayout(this);
+	auto layName = new QHBoxLayout();
+	layName->addWidget(new QLabel(tr("&Name:"), this));
+	layName->addWidget(m_leName);
+	layV->addLayout(layName);
+	m_tblMatches->setColumnCount(3);
+	m_tblMatches->setHorizontalHeaderLabels({tr("Name"), tr("Contact book"), tr("Distance")});
+	m_tblMatches->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	m_tblMatches->setSelectionBehavior(QAbstractItemView::SelectRows);
+	m_tblMatches->verticalHeader()->hide();
+	m_tblMatches->horizontalHeader()->setStretchLastSection(true);
+	layV->addWidget(m_tblMatches);
+	auto layButtons = new QHBoxLayout();
+	layButtons->addStretch();
+	auto btnClose = new QPushButton(tr("&Close"), this);
+	layButtons->addWidget(btnClose);
+	layV->addLayout(layButtons);
+	setLayout(layV);
+
+	// Connect the signals:
+	connect(m_leName, &QLineEdit::textChanged, this, &DlgSimilarNames::updateMatches);
+	connect(btnClose, &QPushButton::clicked,   this, &QDialog::accept);
+}
+
+
+
+
+
+void DlgSimilarNames::updateMatches()
+{
+	m_Matcher.update(m_Session);
+	auto matches = m_Matcher.findSimilar(m_leName->text(), MAX_MATCHES, MAX_DISTANCE);
+	m_tblMatches->setRowCount(static_cast<int>(matches.size()));
+	int row = 0;
+	for (const auto & m: matches)
+	{
+		m_tblMatches->setItem(row, 0, new QTableWidgetItem(m.m_Name));
+		m_tblMatches->setItem(row, 1, new QTableWidgetItem(m.m_ContactBook->displayName()));
+		m_tblMatches->setItem(row, 2, new QTableWidgetItem(QString::number(m.m_Distance)));
+		row += 1;
+	}
+	m_tblMatches->resizeColumnsToContents();
+}
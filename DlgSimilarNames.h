@@ -0,0 +1,67 @@
+#ifndef DLGSIMILARNAMES_H
+#define DLGSIMILARNAMES_H
+
+
+
+
+
+#include <QDialog>
+#include "FuzzyNameMatcher.h"
+
+
+
+
+
+// fwd:
+class Session;
+class QLineEdit;
+class QTableWidget;
+
+
+
+
+
+/** Lets the user look up the contacts whose names are similar to the entered name, across all the devices
+in the session (typos, missing diacritics, swapped first and last names, abbreviated first names).
+The matcher is updated from the contact books' snapshots before each lookup, which only re-indexes the books
+that have changed since the previous lookup. */
+class DlgSimilarNames:
+	public QDialog
+{
+	Q_OBJECT
+	using Super = QDialog;
+
+
+public:
+
+	/** Creates the dialog for the specified session.
+	The session must outlive the dialog. */
+	DlgSimilarNames(Session & a_Session, QWidget * a_Parent = nullptr);
+
+
+protected:
+
+	/** The session whose contacts are searched. */
+	Session & m_Session;
+
+	/** The index of the names of all the contacts in m_Session. */
+	FuzzyNameMatcher m_Matcher;
+
+	/** The name to look up. */
+	QLineEdit * m_leName;
+
+	/** The matching contacts, best first. */
+	QTableWidget * m_tblMatches;
+
+
+protected slots:
+
+	/** Looks up the name currently entered and displays the matching contacts. */
+	void updateMatches();
+};
+
+
+
+
+
+#endif // DLGSIMILARNAMES_H
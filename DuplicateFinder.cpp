@@ -0,0 +1,469 @@
+#include "DuplicateFinder.h"
+#include <assert.h>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <QtConcurrentMap>
+#include <QDebug>
+#include <QElapsedTimer>
+#include "Session.h"
+#include "Normalizer.h"
+#include "PhoneNumber.h"
+
+
+
+
+
+/** Number of MinHash functions in each contact's signature. */
+static const size_t NUM_MINHASHES = 32;
+
+/** Number of rows (MinHash values) in a single LSH band; NUM_MINHASHES / LSH_ROWS bands are used.
+With 8 bands of 4 rows, pairs with token Jaccard similarity of 0.6 become candidates with ~66 % probability,
+pairs with 0.8 with ~97 %. */
+static const size_t LSH_ROWS = 4;
+
+/** Phone numbers with fewer digits than this are not used as blocking keys (extensions, short codes). */
+static const int MIN_PHONE_DIGITS = 6;
+
+
+
+
+
+namespace
+{
+
+/** The features of a single contact used for blocking and scoring. */
+struct Features
+{
+	/** Hashes of the blocking keys (UID, e-mails, phones, whole name). */
+	std::vector<quint64> m_BlockingKeys;
+
+	/** The normalized identifiers (UIDs, e-mails, phones), each prefixed with its kind, sorted. */
+	std::vector<QString> m_Ids;
+
+	/** Hashes of the name and organization tokens, sorted and unique. */
+	std::vector<uint> m_Tokens;
+
+	/** The MinHash signature over m_Tokens; only valid if m_Tokens is not empty. */
+	uint m_MinHash[NUM_MINHASHES];
+};
+
+
+
+
+
+/** A candidate pair of contacts (indices into the items), together with its score. */
+struct CandidatePair
+{
+	quint32 m_A;
+	quint32 m_B;
+	float m_Score;
+};
+
+
+
+
+
+/** Disjoint-set forest over the contact indices, with path halving and union by size. */
+class UnionFind
+{
+public:
+	explicit UnionFind(size_t a_Size):
+		m_Parent(a_Size),
+		m_Size(a_Size, 1)
+	{
+		for (size_t i = 0; i < a_Size; ++i)
+		{
+			m_Parent[i] = static_cast<quint32>(i);
+		}
+	}
+
+	quint32 find(quint32 a_Item)
+	{
+		while (m_Parent[a_Item] != a_Item)
+		{
+			m_Parent[a_Item] = m_Parent[m_Parent[a_Item]];
+			a_Item = m_Parent[a_Item];
+		}
+		return a_Item;
+	}
+
+	void unite(quint32 a_Item1, quint32 a_Item2)
+	{
+		auto root1 = find(a_Item1);
+		auto root2 = find(a_Item2);
+		if (root1 == root2)
+		{
+			return;
+		}
+		if (m_Size[root1] < m_Size[root2])
+		{
+			std::swap(root1, root2);
+		}
+		m_Parent[root2] = root1;
+		m_Size[root1] += m_Size[root2];
+	}
+
+	/** Returns the number of items in the set, a_Root must be the result of find(). */
+	quint32 size(quint32 a_Root) const
+	{
+		return m_Size[a_Root];
+	}
+
+protected:
+	std::vector<quint32> m_Parent;
+	std::vector<quint32> m_Size;
+};
+
+}  // anonymous namespace
+
+
+
+
+
+/** Returns a 64-bit hash of the specified key. */
+static quint64 hashKey(const QString & a_Key)
+{
+	return (static_cast<quint64>(qHash(a_Key, 0)) << 32) | qHash(a_Key, 0x9e3779b9u);
+}
+
+
+
+
+
+/** Splits the folded text into word tokens and appends their hashes to a_Tokens. */
+static void addTokens(const QString & a_FoldedText, std::vector<uint> & a_Tokens)
+{
+	int start = -1;
+	auto len = a_FoldedText.length();
+	for (int i = 0; i <= len; ++i)
+	{
+		bool isWordChar = (i < len) && a_FoldedText.at(i).isLetterOrNumber();
+		if (isWordChar)
+		{
+			if (start < 0)
+			{
+				start = i;
+			}
+		}
+		else if (start >= 0)
+		{
+			a_Tokens.push_back(qHash(a_FoldedText.midRef(start, i - start).toString()));
+			start = -1;
+		}
+	}
+}
+
+
+
+
+
+/** Extracts the blocking and scoring features from the specified contact. */
+static void extractFeatures(const Contact & a_Contact, Features & a_Features)
+{
+	std::vector<uint> nameTokens;
+	for (const auto & s: a_Contact.sentences())
+	{
+		if (s.m_Key == "uid")
+		{
+			auto uid = s.m_Value.trimmed();
+			if (!uid.isEmpty())
+			{
+				a_Features.m_Ids.push_back(QString::fromLatin1("u:") + QString::fromUtf8(uid));
+			}
+		}
+		else if (s.m_Key == "email")
+		{
+			auto email = Normalizer::email(s.m_Value);
+			if (!email.isEmpty())
+			{
+				a_Features.m_Ids.push_back(QString::fromLatin1("e:") + email);
+			}
+		}
+		else if (s.m_Key == "tel")
+		{
+			auto phone = PhoneNumber::key(s);
+			if (phone.length() >= MIN_PHONE_DIGITS)
+			{
+				a_Features.m_Ids.push_back(QString::fromLatin1("p:") + phone);
+			}
+		}
+		else if (s.m_Key == "fn")
+		{
+			addTokens(Normalizer::foldValue(s.m_Value), nameTokens);
+		}
+		else if ((s.m_Key == "n") || (s.m_Key == "org"))
+		{
+			addTokens(Normalizer::foldValue(s.m_Value), a_Features.m_Tokens);
+		}
+	}
+
+	// The whole name, regardless of the token order, is a blocking key:
+	std::sort(nameTokens.begin(), nameTokens.end());
+	nameTokens.erase(std::unique(nameTokens.begin(), nameTokens.end()), nameTokens.end());
+	if (!nameTokens.empty())
+	{
+		quint64 nameKey = 0xcbf29ce484222325ull;
+		for (auto t: nameTokens)
+		{
+			nameKey = (nameKey ^ t) * 0x100000001b3ull;
+		}
+		a_Features.m_BlockingKeys.push_back(nameKey);
+	}
+
+	// Identifiers:
+	std::sort(a_Features.m_Ids.begin(), a_Features.m_Ids.end());
+	a_Features.m_Ids.erase(std::unique(a_Features.m_Ids.begin(), a_Features.m_Ids.end()), a_Features.m_Ids.end());
+	for (const auto & id: a_Features.m_Ids)
+	{
+		a_Features.m_BlockingKeys.push_back(hashKey(id));
+	}
+
+	// Tokens and their MinHash signature:
+	auto & tokens = a_Features.m_Tokens;
+	tokens.insert(tokens.end(), nameTokens.begin(), nameTokens.end());
+	std::sort(tokens.begin(), tokens.end());
+	tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+	for (size_t h = 0; h < NUM_MINHASHES; ++h)
+	{
+		// Each hash function is a different odd multiplier followed by an xorshift mix:
+		auto mul = static_cast<uint>(0x9e3779b1u + 2 * h * 0x85ebca6bu) | 1u;
+		auto minValue = std::numeric_limits<uint>::max();
+		for (auto t: tokens)
+		{
+			auto v = t * mul;
+			v ^= v >> 15;
+			v *= 0x2c1b3c6du;
+			v ^= v >> 12;
+			minValue = std::min(minValue, v);
+		}
+		a_Features.m_MinHash[h] = minValue;
+	}
+}
+
+
+
+
+
+/** Returns the number of elements present in both sorted ranges. */
+template <typename T>
+static size_t countCommon(const std::vector<T> & a_Sorted1, const std::vector<T> & a_Sorted2)
+{
+	size_t res = 0;
+	auto itr1 = a_Sorted1.cbegin(), end1 = a_Sorted1.cend();
+	auto itr2 = a_Sorted2.cbegin(), end2 = a_Sorted2.cend();
+	while ((itr1 != end1) && (itr2 != end2))
+	{
+		if (*itr1 < *itr2)
+		{
+			++itr1;
+		}
+		else if (*itr2 < *itr1)
+		{
+			++itr2;
+		}
+		else
+		{
+			++res;
+			++itr1;
+			++itr2;
+		}
+	}
+	return res;
+}
+
+
+
+
+
+/** Returns the similarity score (0 .. 1) of the two contacts, based on their features.
+The score is the Jaccard similarity of their name and organization tokens, raised if they share an identifier
+(UID, e-mail, phone), unless the names are entirely different (family members sharing a landline). */
+static float scorePair(const Features & a_Features1, const Features & a_Features2)
+{
+	const auto & tokens1 = a_Features1.m_Tokens;
+	const auto & tokens2 = a_Features2.m_Tokens;
+	float score = 0;
+	auto numCommonTokens = countCommon(tokens1, tokens2);
+	if (!tokens1.empty() && !tokens2.empty())
+	{
+		score = static_cast<float>(numCommonTokens) / static_cast<float>(tokens1.size() + tokens2.size() - numCommonTokens);
+	}
+	auto numCommonIds = countCommon(a_Features1.m_Ids, a_Features2.m_Ids);
+	if (numCommonIds > 0)
+	{
+		bool areNamesDifferent = (!tokens1.empty() && !tokens2.empty() && (numCommonTokens == 0));
+		score = std::max(score, areNamesDifferent ? 0.5f : 0.95f);
+	}
+	return score;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DuplicateFinder:
+
+DuplicateFinder::DuplicateFinder():
+	m_Threshold(0.8),
+	m_MaxBlockSize(1000)
+{
+}
+
+
+
+
+
+std::vector<DuplicateFinder::Cluster> DuplicateFinder::findDuplicates(const Session & a_Session) const
+{
+	std::vector<ContactBookPtr> contactBooks;
+	for (const auto & dev: a_Session.getDevices())
+	{
+		for (const auto & cb: dev->contactBooks())
+		{
+			contactBooks.push_back(cb);
+		}
+	}
+	return findDuplicates(contactBooks);
+}
+
+
+
+
+
+std::vector<DuplicateFinder::Cluster> DuplicateFinder::findDuplicates(const std::vector<ContactBookPtr> & a_ContactBooks) const
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	// Collect all the contacts from the current snapshots:
+	std::vector<Item> items;
+	for (const auto & cb: a_ContactBooks)
+	{
+		auto snapshot = cb->snapshot();
+		snapshot->forEach([&items, &cb](const ContactPtr & a_Contact)
+			{
+				items.push_back({cb, a_Contact});
+			}
+		);
+	}
+	assert(items.size() < std::numeric_limits<quint32>::max());
+
+	// Extract the features, in parallel:
+	std::vector<Features> features(items.size());
+	std::vector<quint32> indices(items.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		indices[i] = static_cast<quint32>(i);
+	}
+	QtConcurrent::blockingMap(indices, [&items, &features](quint32 a_Index)
+		{
+			extractFeatures(*items[a_Index].m_Contact, features[a_Index]);
+		}
+	);
+
+	// Assign the contacts into blocks, by the blocking keys and by the LSH bands of the MinHash signatures:
+	std::unordered_map<quint64, std::vector<quint32>> blocks;
+	for (quint32 i = 0, size = static_cast<quint32>(features.size()); i < size; ++i)
+	{
+		const auto & f = features[i];
+		for (auto key: f.m_BlockingKeys)
+		{
+			blocks[key].push_back(i);
+		}
+		if (f.m_Tokens.empty())
+		{
+			continue;
+		}
+		for (size_t band = 0; band < NUM_MINHASHES / LSH_ROWS; ++band)
+		{
+			quint64 key = 0x84222325cbf29ce4ull ^ (band + 1);
+			for (size_t row = 0; row < LSH_ROWS; ++row)
+			{
+				key = (key ^ f.m_MinHash[band * LSH_ROWS + row]) * 0x100000001b3ull;
+			}
+			blocks[key].push_back(i);
+		}
+	}
+
+	// Generate the unique candidate pairs from the blocks:
+	std::vector<quint64> pairKeys;
+	size_t numSkippedBlocks = 0;
+	for (const auto & block: blocks)
+	{
+		const auto & members = block.second;
+		if (members.size() < 2)
+		{
+			continue;
+		}
+		if (members.size() > m_MaxBlockSize)
+		{
+			numSkippedBlocks += 1;
+			continue;
+		}
+		for (size_t i = 0; i < members.size(); ++i)
+		{
+			for (size_t j = i + 1; j < members.size(); ++j)
+			{
+				auto a = std::min(members[i], members[j]);
+				auto b = std::max(members[i], members[j]);
+				if (a != b)
+				{
+					pairKeys.push_back((static_cast<quint64>(a) << 32) | b);
+				}
+			}
+		}
+	}
+	blocks.clear();
+	std::sort(pairKeys.begin(), pairKeys.end());
+	pairKeys.erase(std::unique(pairKeys.begin(), pairKeys.end()), pairKeys.end());
+	std::vector<CandidatePair> pairs;
+	pairs.reserve(pairKeys.size());
+	for (auto key: pairKeys)
+	{
+		pairs.push_back({static_cast<quint32>(key >> 32), static_cast<quint32>(key & 0xffffffffu), 0});
+	}
+	pairKeys.clear();
+	pairKeys.shrink_to_fit();
+
+	// Score the candidate pairs, in parallel:
+	QtConcurrent::blockingMap(pairs, [&features](CandidatePair & a_Pair)
+		{
+			a_Pair.m_Score = scorePair(features[a_Pair.m_A], features[a_Pair.m_B]);
+		}
+	);
+
+	// Cluster the matching pairs:
+	UnionFind uf(items.size());
+	auto threshold = static_cast<float>(m_Threshold);
+	for (const auto & p: pairs)
+	{
+		if (p.m_Score >= threshold)
+		{
+			uf.unite(p.m_A, p.m_B);
+		}
+	}
+	std::unordered_map<quint32, size_t> clusterIndex;  // Maps the UnionFind root to index into res
+	std::vector<Cluster> res;
+	for (quint32 i = 0, size = static_cast<quint32>(items.size()); i < size; ++i)
+	{
+		auto root = uf.find(i);
+		if (uf.size(root) < 2)
+		{
+			continue;
+		}
+		auto itr = clusterIndex.find(root);
+		if (itr == clusterIndex.end())
+		{
+			itr = clusterIndex.emplace(root, res.size()).first;
+			res.emplace_back();
+		}
+		res[itr->second].push_back(items[i]);
+	}
+
+	qDebug() << __FUNCTION__ << ": Processed " << items.size() << " contacts, "
+		<< pairs.size() << " candidate pairs (" << numSkippedBlocks << " oversized blocks skipped), found "
+		<< res.size() << " clusters of duplicates in " << timer.elapsed() << " msec";
+	return res;
+}
@@ -0,0 +1,79 @@
+#ifndef DUPLICATEFINDER_H
+#define DUPLICATEFINDER_H
+
+
+
+
+
+#include <vector>
+#include <QString>
+
+#include "Contact.h"
+#include "ContactBook.h"
+
+
+
+
+
+// fwd:
+class Session;
+
+
+
+
+
+/** Detects duplicate contacts across all the ContactBooks in a Session.
+Avoids the quadratic pairwise comparison by generating candidate pairs only from blocks of contacts sharing
+a blocking key (normalized e-mail, normalized phone, UID, folded name) and from LSH buckets of MinHash
+signatures over the name and organization tokens. The candidate pairs are then scored in parallel and the
+pairs scoring above the threshold are clustered using union-find.
+Works on the contact book snapshots, so it can be run on a worker thread while the devices keep syncing. */
+class DuplicateFinder
+{
+public:
+
+	/** A single contact in the input, together with the contact book it came from. */
+	struct Item
+	{
+		ContactBookPtr m_ContactBook;
+		ContactPtr m_Contact;
+	};
+
+	/** A group of contacts that are considered duplicates of each other. */
+	using Cluster = std::vector<Item>;
+
+
+	/** Creates a new instance with the default settings. */
+	DuplicateFinder();
+
+	/** Sets the minimum score (0 .. 1) of a candidate pair for the contacts to be considered duplicates. */
+	void setThreshold(double a_Threshold) { m_Threshold = a_Threshold; }
+
+	/** Sets the maximum size of a single block or LSH bucket.
+	Larger blocks (such as everyone sharing a company switchboard number) are skipped, since they would generate
+	a quadratic number of candidate pairs while carrying very little information. */
+	void setMaxBlockSize(size_t a_MaxBlockSize) { m_MaxBlockSize = a_MaxBlockSize; }
+
+	/** Finds the duplicates among the contacts in all the contact books of all the devices in the session.
+	Returns the clusters of duplicates; each cluster has at least two contacts. */
+	std::vector<Cluster> findDuplicates(const Session & a_Session) const;
+
+	/** Finds the duplicates among the contacts in the specified contact books.
+	Returns the clusters of duplicates; each cluster has at least two contacts. */
+	std::vector<Cluster> findDuplicates(const std::vector<ContactBookPtr> & a_ContactBooks) const;
+
+
+protected:
+
+	/** The minimum score of a candidate pair for the contacts to be considered duplicates. */
+	double m_Threshold;
+
+	/** The maximum size of a block or LSH bucket that still generates candidate pairs. */
+	size_t m_MaxBlockSize;
+};
+
+
+
+
+
+#endif // DUPLICATEFINDER_H
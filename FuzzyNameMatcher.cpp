@@ -0,0 +1,537 @@
+#include "FuzzyNameMatcher.h"
+#include <algorithm>
+#include <unordered_set>
+#include <QStringList>
+#include "Session.h"
+#include "Normalizer.h"
+#include "DisplayContact.h"
+#include "VCardParser.h"
+
+
+
+
+
+/** Maximum length of the pattern for the bit-parallel edit distance (number of bits in the machine word). */
+static const int MAX_BITPARALLEL_LENGTH = 64;
+
+
+
+
+
+/** Packs the three characters of a trigram into a single number. */
+static inline quint64 packTrigram(QChar a_Ch1, QChar a_Ch2, QChar a_Ch3)
+{
+	return
+		(static_cast<quint64>(a_Ch1.unicode()) << 32) |
+		(static_cast<quint64>(a_Ch2.unicode()) << 16) |
+		static_cast<quint64>(a_Ch3.unicode());
+}
+
+
+
+
+
+/** Returns the distinct trigrams of the specified match key, padded with two spaces on each side. */
+static std::vector<quint64> keyTrigrams(const QString & a_Key)
+{
+	auto padded = QString::fromLatin1("  ") + a_Key + QString::fromLatin1("  ");
+	std::vector<quint64> res;
+	res.reserve(static_cast<size_t>(padded.length()));
+	for (int i = 0, len = padded.length() - 2; i < len; ++i)
+	{
+		res.push_back(packTrigram(padded.at(i), padded.at(i + 1), padded.at(i + 2)));
+	}
+	std::sort(res.begin(), res.end());
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
+}
+
+
+
+
+
+/** Returns the bounded edit distance computed using Myers' bit-parallel algorithm (Hyyrö's formulation).
+a_Pattern must be 1 .. 64 characters long. Returns a_MaxDistance + 1 as soon as the distance is known to be larger. */
+static int myersDistance(const QString & a_Pattern, const QString & a_Text, int a_MaxDistance)
+{
+	auto m = a_Pattern.length();
+	auto n = a_Text.length();
+	Q_ASSERT((m > 0) && (m <= MAX_BITPARALLEL_LENGTH));
+
+	// Build the match masks for the pattern characters; ASCII in a table, the rest in a short list:
+	quint64 peqAscii[128] = {};
+	std::vector<std::pair<ushort, quint64>> peqOther;
+	for (int i = 0; i < m; ++i)
+	{
+		auto ch = a_Pattern.at(i).unicode();
+		if (ch < 128)
+		{
+			peqAscii[ch] |= (1ull << i);
+			continue;
+		}
+		auto itr = std::find_if(peqOther.begin(), peqOther.end(),
+			[ch](const std::pair<ushort, quint64> & a_Item)
+			{
+				return (a_Item.first == ch);
+			}
+		);
+		if (itr == peqOther.end())
+		{
+			peqOther.emplace_back(ch, 1ull << i);
+		}
+		else
+		{
+			itr->second |= (1ull << i);
+		}
+	}
+
+	quint64 pv = ~0ull;
+	quint64 mv = 0;
+	quint64 highBit = 1ull << (m - 1);
+	int score = m;
+	for (int j = 0; j < n; ++j)
+	{
+		auto ch = a_Text.at(j).unicode();
+		quint64 eq = 0;
+		if (ch < 128)
+		{
+			eq = peqAscii[ch];
+		}
+		else
+		{
+			for (const auto & p: peqOther)
+			{
+				if (p.first == ch)
+				{
+					eq = p.second;
+					break;
+				}
+			}
+		}
+		auto xv = eq | mv;
+		auto xh = (((eq & pv) + pv) ^ pv) | eq;
+		auto ph = mv | ~(xh | pv);
+		auto mh = pv & xh;
+		if (ph & highBit)
+		{
+			score += 1;
+		}
+		else if (mh & highBit)
+		{
+			score -= 1;
+		}
+		ph = (ph << 1) | 1;  // Global distance, the top row increases by one in each column
+		mh = mh << 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+
+		// Each remaining text character can decrease the score by at most one:
+		if (score - (n - j - 1) > a_MaxDistance)
+		{
+			return a_MaxDistance + 1;
+		}
+	}
+	return (score > a_MaxDistance) ? (a_MaxDistance + 1) : score;
+}
+
+
+
+
+
+/** Returns the bounded edit distance computed using the banded dynamic programming (Ukkonen).
+Used for the strings too long for myersDistance(). */
+static int bandedDistance(const QString & a_String1, const QString & a_String2, int a_MaxDistance)
+{
+	auto m = a_String1.length();
+	auto n = a_String2.length();
+	const int infinity = a_MaxDistance + 1;
+	std::vector<int> prev(static_cast<size_t>(n + 1)), cur(static_cast<size_t>(n + 1));
+	for (int j = 0; j <= n; ++j)
+	{
+		prev[static_cast<size_t>(j)] = std::min(j, infinity);
+	}
+	for (int i = 1; i <= m; ++i)
+	{
+		auto from = std::max(1, i - a_MaxDistance);
+		auto to = std::min(n, i + a_MaxDistance);
+		std::fill(cur.begin(), cur.end(), infinity);
+		cur[0] = std::min(i, infinity);
+		int rowMin = cur[0];
+		for (int j = from; j <= to; ++j)
+		{
+			auto cost = (a_String1.at(i - 1) == a_String2.at(j - 1)) ? 0 : 1;
+			auto v = std::min({
+				prev[static_cast<size_t>(j - 1)] + cost,
+				prev[static_cast<size_t>(j)] + 1,
+				cur[static_cast<size_t>(j - 1)] + 1
+			});
+			cur[static_cast<size_t>(j)] = std::min(v, infinity);
+			rowMin = std::min(rowMin, cur[static_cast<size_t>(j)]);
+		}
+		if (rowMin > a_MaxDistance)
+		{
+			return infinity;
+		}
+		std::swap(prev, cur);
+	}
+	return prev[static_cast<size_t>(n)];
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FuzzyNameMatcher:
+
+FuzzyNameMatcher::FuzzyNameMatcher():
+	m_NumDeadEntries(0)
+{
+}
+
+
+
+
+
+void FuzzyNameMatcher::update(const Session & a_Session)
+{
+	std::unordered_set<const ContactBook *> present;
+	for (const auto & dev: a_Session.getDevices())
+	{
+		for (const auto & cb: dev->contactBooks())
+		{
+			updateContactBook(cb);
+			present.insert(cb.get());
+		}
+	}
+
+	// Remove the books that are no longer in the session:
+	std::vector<const ContactBook *> toRemove;
+	for (const auto & b: m_Books)
+	{
+		if (present.count(b.first) == 0)
+		{
+			toRemove.push_back(b.first);
+		}
+	}
+	for (const auto cb: toRemove)
+	{
+		removeContactBook(cb);
+	}
+}
+
+
+
+
+
+void FuzzyNameMatcher::updateContactBook(const ContactBookPtr & a_ContactBook)
+{
+	auto snapshot = a_ContactBook->snapshot();
+	auto itr = m_Books.find(a_ContactBook.get());
+	if ((itr != m_Books.end()) && (itr->second.m_Version == snapshot->version()))
+	{
+		return;
+	}
+	killBookEntries(a_ContactBook.get());
+	if (m_NumDeadEntries > m_Entries.size() / 2)
+	{
+		compact();
+	}
+	m_Books[a_ContactBook.get()].m_Version = snapshot->version();
+	snapshot->forEach([this, &a_ContactBook](const ContactPtr & a_Contact)
+		{
+			for (const auto & name: contactNames(*a_Contact))
+			{
+				addEntry(a_ContactBook, a_Contact, name);
+			}
+		}
+	);
+}
+
+
+
+
+
+void FuzzyNameMatcher::removeContactBook(const ContactBook * a_ContactBook)
+{
+	killBookEntries(a_ContactBook);
+	if (m_NumDeadEntries > m_Entries.size() / 2)
+	{
+		compact();
+	}
+}
+
+
+
+
+
+std::vector<FuzzyNameMatcher::Match> FuzzyNameMatcher::findSimilar(const QString & a_Name, size_t a_Count, int a_MaxDistance) const
+{
+	return findSimilarKey(matchKey(a_Name), a_Count, a_MaxDistance, nullptr);
+}
+
+
+
+
+
+std::vector<FuzzyNameMatcher::Match> FuzzyNameMatcher::findSimilar(const Contact & a_Contact, size_t a_Count, int a_MaxDistance) const
+{
+	// Query each name of the contact, then merge the results, keeping the best match for each contact:
+	std::vector<Match> all;
+	for (const auto & name: contactNames(a_Contact))
+	{
+		auto matches = findSimilarKey(matchKey(name), a_Count, a_MaxDistance, &a_Contact);
+		all.insert(all.end(), matches.begin(), matches.end());
+	}
+	std::stable_sort(all.begin(), all.end(),
+		[](const Match & a_Match1, const Match & a_Match2)
+		{
+			return (a_Match1.m_Distance < a_Match2.m_Distance);
+		}
+	);
+	std::vector<Match> res;
+	std::unordered_set<const Contact *> seen;
+	for (const auto & m: all)
+	{
+		if (res.size() >= a_Count)
+		{
+			break;
+		}
+		if (seen.insert(m.m_Contact.get()).second)
+		{
+			res.push_back(m);
+		}
+	}
+	return res;
+}
+
+
+
+
+
+QString FuzzyNameMatcher::matchKey(const QString & a_Name)
+{
+	// Split the folded name into tokens at any non-alphanumeric character, sort the tokens:
+	auto folded = Normalizer::foldText(a_Name);
+	QStringList tokens;
+	int start = -1;
+	for (int i = 0, len = folded.length(); i <= len; ++i)
+	{
+		if ((i < len) && folded.at(i).isLetterOrNumber())
+		{
+			if (start < 0)
+			{
+				start = i;
+			}
+		}
+		else if (start >= 0)
+		{
+			tokens.append(folded.mid(start, i - start));
+			start = -1;
+		}
+	}
+	tokens.sort();
+	return tokens.join(' ');
+}
+
+
+
+
+
+std::vector<QString> FuzzyNameMatcher::contactNames(const Contact & a_Contact)
+{
+	std::vector<QString> res;
+	for (const auto & s: a_Contact.sentences())
+	{
+		QString name;
+		if (s.m_Key == "fn")
+		{
+			name = QString::fromUtf8(VCardParser::unescapeBackslashes(s.m_Value));
+		}
+		else if (s.m_Key == "n")
+		{
+			name = DisplayContact::composeName(s);
+		}
+		if (!name.trimmed().isEmpty() && (std::find(res.begin(), res.end(), name) == res.end()))
+		{
+			res.push_back(name);
+		}
+	}
+	return res;
+}
+
+
+
+
+
+int FuzzyNameMatcher::boundedEditDistance(const QString & a_String1, const QString & a_String2, int a_MaxDistance)
+{
+	auto len1 = a_String1.length();
+	auto len2 = a_String2.length();
+	if (std::abs(len1 - len2) > a_MaxDistance)
+	{
+		return a_MaxDistance + 1;
+	}
+	if (len1 == 0)
+	{
+		return len2;
+	}
+	if (len2 == 0)
+	{
+		return len1;
+	}
+
+	// Use the shorter string as the bit-parallel pattern, if it fits into the machine word:
+	const auto & shorter = (len1 <= len2) ? a_String1 : a_String2;
+	const auto & longer  = (len1 <= len2) ? a_String2 : a_String1;
+	if (shorter.length() <= MAX_BITPARALLEL_LENGTH)
+	{
+		return myersDistance(shorter, longer, a_MaxDistance);
+	}
+	return bandedDistance(shorter, longer, a_MaxDistance);
+}
+
+
+
+
+
+void FuzzyNameMatcher::killBookEntries(const ContactBook * a_ContactBook)
+{
+	auto itr = m_Books.find(a_ContactBook);
+	if (itr == m_Books.end())
+	{
+		return;
+	}
+	for (auto idx: itr->second.m_Entries)
+	{
+		auto & entry = m_Entries[idx];
+		entry.m_IsDead = true;
+		entry.m_Contact.reset();
+		entry.m_ContactBook.reset();
+	}
+	m_NumDeadEntries += itr->second.m_Entries.size();
+	m_Books.erase(itr);
+}
+
+
+
+
+
+void FuzzyNameMatcher::addEntry(const ContactBookPtr & a_ContactBook, const ContactPtr & a_Contact, const QString & a_Name)
+{
+	auto key = matchKey(a_Name);
+	if (key.isEmpty())
+	{
+		return;
+	}
+	auto idx = static_cast<quint32>(m_Entries.size());
+	auto trigrams = keyTrigrams(key);
+	m_Entries.push_back({a_ContactBook, a_Contact, a_Name, key, static_cast<int>(trigrams.size()), false});
+	m_Books[a_ContactBook.get()].m_Entries.push_back(idx);
+	for (auto t: trigrams)
+	{
+		m_Trigrams[t].push_back(idx);
+	}
+}
+
+
+
+
+
+void FuzzyNameMatcher::compact()
+{
+	std::vector<Entry> entries;
+	entries.swap(m_Entries);
+	m_Trigrams.clear();
+	m_NumDeadEntries = 0;
+	for (auto & b: m_Books)
+	{
+		b.second.m_Entries.clear();
+	}
+	for (const auto & e: entries)
+	{
+		if (!e.m_IsDead)
+		{
+			addEntry(e.m_ContactBook, e.m_Contact, e.m_Name);
+		}
+	}
+}
+
+
+
+
+
+std::vector<FuzzyNameMatcher::Match> FuzzyNameMatcher::findSimilarKey(
+	const QString & a_Key,
+	size_t a_Count,
+	int a_MaxDistance,
+	const Contact * a_Exclude
+) const
+{
+	if (a_Key.isEmpty() || (a_Count == 0))
+	{
+		return {};
+	}
+
+	// Count the shared trigrams for each entry that shares any, so that the cost depends only on the size of
+	// the posting lists of the query's trigrams, not on the total number of entries:
+	auto queryTrigrams = keyTrigrams(a_Key);
+	std::unordered_map<quint32, int> counts;  // Entry index -> number of trigrams shared with the query
+	for (auto t: queryTrigrams)
+	{
+		auto itr = m_Trigrams.find(t);
+		if (itr == m_Trigrams.end())
+		{
+			continue;
+		}
+		for (auto idx: itr->second)
+		{
+			counts[idx] += 1;
+		}
+	}
+
+	// Verify the candidates that may be within the distance (each edit destroys at most 3 trigrams):
+	std::vector<std::pair<int, quint32>> verified;  // (distance, entry index)
+	auto queryLength = a_Key.length();
+	for (const auto & c: counts)
+	{
+		auto idx = c.first;
+		const auto & entry = m_Entries[idx];
+		if (entry.m_IsDead || (entry.m_Contact.get() == a_Exclude))
+		{
+			continue;
+		}
+		if (std::abs(entry.m_Key.length() - queryLength) > a_MaxDistance)
+		{
+			continue;
+		}
+		auto maxTrigrams = std::max(static_cast<int>(queryTrigrams.size()), entry.m_NumTrigrams);
+		if (c.second < maxTrigrams - 3 * a_MaxDistance)
+		{
+			continue;
+		}
+		auto dist = boundedEditDistance(a_Key, entry.m_Key, a_MaxDistance);
+		if (dist <= a_MaxDistance)
+		{
+			verified.emplace_back(dist, idx);
+		}
+	}
+
+	// Return the best matches, one per contact:
+	std::sort(verified.begin(), verified.end());
+	std::vector<Match> res;
+	std::unordered_set<const Contact *> seen;
+	for (const auto & v: verified)
+	{
+		if (res.size() >= a_Count)
+		{
+			break;
+		}
+		const auto & entry = m_Entries[v.second];
+		if (seen.insert(entry.m_Contact.get()).second)
+		{
+			res.push_back({entry.m_ContactBook, entry.m_Contact, entry.m_Name, v.first});
+		}
+	}
+	return res;
+}
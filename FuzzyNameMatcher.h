@@ -0,0 +1,141 @@
+#ifndef FUZZYNAMEMATCHER_H
+#define FUZZYNAMEMATCHER_H
+
+
+
+
+
+#include <unordered_map>
+#include <vector>
+#include <QString>
+
+#include "Contact.h"
+#include "ContactBook.h"
+
+
+
+
+
+// fwd:
+class Session;
+
+
+
+
+
+/** Finds contacts with names similar to a query, across all the ContactBooks in a Session.
+The names (FN and the name composed from N by DisplayContact::composeName()) are normalized into match keys:
+case-folded, with the diacritics and punctuation removed and the tokens sorted, so that "Jan Novák",
+"Novak Jan" and "NOVÁK, Jan" all produce the same key, and "J. Novák" only differs by a small edit distance.
+A trigram inverted index over the keys provides the candidates, which are then verified using a bit-parallel
+(Myers) bounded edit distance. */
+class FuzzyNameMatcher
+{
+public:
+
+	/** A single match returned by the queries. */
+	struct Match
+	{
+		ContactBookPtr m_ContactBook;
+		ContactPtr m_Contact;
+
+		/** The name of the contact that matched (the original form, not the match key). */
+		QString m_Name;
+
+		/** The edit distance between the match keys of the query and the name. */
+		int m_Distance;
+	};
+
+
+	/** Creates an empty matcher. */
+	FuzzyNameMatcher();
+
+	/** Re-indexes the contacts from all the contact books of all the devices in the session.
+	The contact books whose snapshot hasn't changed since the last indexing are skipped. */
+	void update(const Session & a_Session);
+
+	/** Re-indexes the contacts from the specified contact book, using its current snapshot.
+	Does nothing if the snapshot hasn't changed since the last indexing of the book. */
+	void updateContactBook(const ContactBookPtr & a_ContactBook);
+
+	/** Removes all the contacts of the specified contact book from the index. */
+	void removeContactBook(const ContactBook * a_ContactBook);
+
+	/** Returns up to a_Count contacts whose names are the most similar to a_Name, best first.
+	Only names within a_MaxDistance edits of the query are returned. */
+	std::vector<Match> findSimilar(const QString & a_Name, size_t a_Count, int a_MaxDistance = 3) const;
+
+	/** Returns up to a_Count contacts whose names are the most similar to any name of a_Contact, best first.
+	The contact itself is never returned. */
+	std::vector<Match> findSimilar(const Contact & a_Contact, size_t a_Count, int a_MaxDistance = 3) const;
+
+	/** Returns the match key for the specified name. */
+	static QString matchKey(const QString & a_Name);
+
+	/** Returns all the distinct names of the specified contact (FN and the composed N). */
+	static std::vector<QString> contactNames(const Contact & a_Contact);
+
+	/** Returns the edit distance between the two strings, or a_MaxDistance + 1 if it is larger than a_MaxDistance. */
+	static int boundedEditDistance(const QString & a_String1, const QString & a_String2, int a_MaxDistance);
+
+
+protected:
+
+	/** A single indexed name. */
+	struct Entry
+	{
+		ContactBookPtr m_ContactBook;
+		ContactPtr m_Contact;
+		QString m_Name;
+		QString m_Key;
+
+		/** The number of distinct trigrams in m_Key. */
+		int m_NumTrigrams;
+
+		/** Set when the entry's contact book has been re-indexed or removed; the entry is to be ignored. */
+		bool m_IsDead;
+	};
+
+	/** Per-contact-book bookkeeping. */
+	struct BookInfo
+	{
+		/** The version of the snapshot that was last indexed. */
+		quint64 m_Version;
+
+		/** Indices into m_Entries of all the entries belonging to the book. */
+		std::vector<quint32> m_Entries;
+	};
+
+
+	/** All the indexed names, including the dead ones (until compacted). */
+	std::vector<Entry> m_Entries;
+
+	/** The number of dead entries in m_Entries. */
+	size_t m_NumDeadEntries;
+
+	/** The trigram inverted index: packed trigram -> indices into m_Entries. */
+	std::unordered_map<quint64, std::vector<quint32>> m_Trigrams;
+
+	/** The bookkeeping for all the indexed contact books. */
+	std::unordered_map<const ContactBook *, BookInfo> m_Books;
+
+
+	/** Marks all the entries of the specified book as dead and forgets the book. */
+	void killBookEntries(const ContactBook * a_ContactBook);
+
+	/** Adds a new entry for the specified name and indexes its trigrams. */
+	void addEntry(const ContactBookPtr & a_ContactBook, const ContactPtr & a_Contact, const QString & a_Name);
+
+	/** Rebuilds m_Entries and m_Trigrams without the dead entries. */
+	void compact();
+
+	/** Returns the candidates for a_Key, verified to be within a_MaxDistance, best first.
+	Entries for a_Exclude are skipped. */
+	std::vector<Match> findSimilarKey(const QString & a_Key, size_t a_Count, int a_MaxDistance, const Contact * a_Exclude) const;
+};
+
+
+
+
+
+#endif // FUZZYNAMEMATCHER_H
@@ -1,4 +1,8 @@
 #include "HorizontalContactView.h"
+#include <assert.h>
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
 #include <QScrollBar>
 #include <QPainter>
 #include <QPaintEvent>
@@ -22,6 +26,16 @@ inline static int lineSpacingToRowHeight(int a_LineSpacing)
 
 
 
+/** Returns true if a_Contact1 should be displayed before a_Contact2. */
+static bool isDisplayedBefore(const DisplayContactPtr & a_Contact1, const DisplayContactPtr & a_Contact2)
+{
+	return (a_Contact1->displayName() < a_Contact2->displayName());
+}
+
+
+
+
+
 HorizontalContactView::HorizontalContactView(QWidget * a_Parent):
 	Super(a_Parent),
 	m_Header(Qt::Horizontal, this),
@@ -73,7 +87,17 @@ void HorizontalContactView::setContactBook(ContactBookPtr a_ContactBook)
 	m_HeaderModel.setHorizontalHeaderItem(1, new QStandardItem);
 	m_Header.resizeSection(0, m_LabelWidth);
 	m_Header.resizeSection(1, m_ValueWidth);
+	if (m_ContactBook != nullptr)
+	{
+		disconnect(m_ContactBook.get(), nullptr, this, nullptr);
+	}
 	m_ContactBook = a_ContactBook;
+	if (m_ContactBook != nullptr)
+	{
+		connect(m_ContactBook.get(), &ContactBook::contactsInserted, this, &HorizontalContactView::contactsInserted);
+		connect(m_ContactBook.get(), &ContactBook::contactsRemoved,  this, &HorizontalContactView::contactsRemoved);
+		connect(m_ContactBook.get(), &ContactBook::contactsChanged,  this, &HorizontalContactView::contactsChanged);
+	}
 	parseContacts();
 	viewport()->update();
 }
@@ -172,6 +196,7 @@ void HorizontalContactView::parseContacts()
 {
 	// Parse the contacts into displayable items:
 	m_DisplayContacts.clear();
+	m_BookOrder.clear();
 	if (m_ContactBook == nullptr)
 	{
 		return;
@@ -180,17 +205,13 @@ void HorizontalContactView::parseContacts()
 	timer.start();
 	for (const auto & contact: m_ContactBook->contacts())
 	{
-		m_DisplayContacts.push_back(DisplayContact::fromContact(*contact));
+		m_BookOrder.push_back(DisplayContact::fromContact(*contact));
 	}
 	qDebug() << __FUNCTION__ << ": Parsing into DisplayContact took " << timer.restart() << " msec.";
 
 	// Sort:
-	std::sort(m_DisplayContacts.begin(), m_DisplayContacts.end(),
-		[](DisplayContactPtr a_Contact1, DisplayContactPtr a_Contact2)
-		{
-			return (a_Contact1->displayName() < a_Contact2->displayName());
-		}
-	);
+	m_DisplayContacts = m_BookOrder;
+	std::sort(m_DisplayContacts.begin(), m_DisplayContacts.end(), isDisplayedBefore);
 
 	// Update contact card layout:
 	recalculateLayout();
@@ -200,6 +221,27 @@ void HorizontalContactView::parseContacts()
 
 
 
+void HorizontalContactView::mergeIntoDisplayContacts(std::vector<DisplayContactPtr> && a_NewContacts)
+{
+	std::sort(a_NewContacts.begin(), a_NewContacts.end(), isDisplayedBefore);
+	auto numOld = m_DisplayContacts.size();
+	m_DisplayContacts.insert(
+		m_DisplayContacts.end(),
+		std::make_move_iterator(a_NewContacts.begin()),
+		std::make_move_iterator(a_NewContacts.end())
+	);
+	std::inplace_merge(
+		m_DisplayContacts.begin(),
+		m_DisplayContacts.begin() + static_cast<std::ptrdiff_t>(numOld),
+		m_DisplayContacts.end(),
+		isDisplayedBefore
+	);
+}
+
+
+
+
+
 void HorizontalContactView::recalculateLayout()
 {
 	m_CurrentLayout.clear();
@@ -481,3 +523,98 @@ void HorizontalContactView::horizontalScrollBarValueChanged(int a_NewValue)
 
 
 
+
+void HorizontalContactView::contactsInserted(int a_First, int a_Count)
+{
+	assert(m_ContactBook != nullptr);
+	assert(a_First >= 0);
+	assert(static_cast<size_t>(a_First) <= m_BookOrder.size());
+
+	// Parse the new contacts:
+	const auto & contacts = m_ContactBook->contacts();
+	std::vector<DisplayContactPtr> added;
+	added.reserve(static_cast<size_t>(a_Count));
+	for (int i = a_First; i < a_First + a_Count; ++i)
+	{
+		added.push_back(DisplayContact::fromContact(*contacts[static_cast<size_t>(i)]));
+	}
+	m_BookOrder.insert(m_BookOrder.begin() + a_First, added.begin(), added.end());
+
+	// Display them:
+	mergeIntoDisplayContacts(std::move(added));
+	recalculateLayout();
+}
+
+
+
+
+
+void HorizontalContactView::contactsRemoved(int a_First, int a_Count)
+{
+	assert(a_First >= 0);
+	assert(static_cast<size_t>(a_First + a_Count) <= m_BookOrder.size());
+
+	// Remove from the book-ordered mirror, remember what was removed:
+	std::unordered_set<const DisplayContact *> removed;
+	auto first = m_BookOrder.begin() + a_First;
+	auto last = first + a_Count;
+	for (auto itr = first; itr != last; ++itr)
+	{
+		removed.insert(itr->get());
+	}
+	m_BookOrder.erase(first, last);
+
+	// Remove from display:
+	m_DisplayContacts.erase(
+		std::remove_if(m_DisplayContacts.begin(), m_DisplayContacts.end(),
+			[&removed](const DisplayContactPtr & a_Contact)
+			{
+				return (removed.count(a_Contact.get()) > 0);
+			}
+		),
+		m_DisplayContacts.end()
+	);
+	recalculateLayout();
+}
+
+
+
+
+
+void HorizontalContactView::contactsChanged(int a_First, int a_Count)
+{
+	assert(m_ContactBook != nullptr);
+	assert(a_First >= 0);
+	assert(static_cast<size_t>(a_First + a_Count) <= m_BookOrder.size());
+
+	// Re-parse the changed contacts in the book-ordered mirror:
+	const auto & contacts = m_ContactBook->contacts();
+	std::unordered_set<const DisplayContact *> replaced;
+	std::vector<DisplayContactPtr> changed;
+	changed.reserve(static_cast<size_t>(a_Count));
+	for (int i = a_First; i < a_First + a_Count; ++i)
+	{
+		auto & dc = m_BookOrder[static_cast<size_t>(i)];
+		replaced.insert(dc.get());
+		dc = DisplayContact::fromContact(*contacts[static_cast<size_t>(i)]);
+		changed.push_back(dc);
+	}
+
+	// Replace in the display (the display name may have changed, so re-sort them in):
+	m_DisplayContacts.erase(
+		std::remove_if(m_DisplayContacts.begin(), m_DisplayContacts.end(),
+			[&replaced](const DisplayContactPtr & a_Contact)
+			{
+				return (replaced.count(a_Contact.get()) > 0);
+			}
+		),
+		m_DisplayContacts.end()
+	);
+	mergeIntoDisplayContacts(std::move(changed));
+	recalculateLayout();
+}
+
+
+
+
+
@@ -67,6 +67,10 @@ protected:
 	/** Contacts from m_ContactBook, parsed into their display forms and sorted. */
 	std::vector<DisplayContactPtr> m_DisplayContacts;
 
+	/** Contacts from m_ContactBook, parsed into their display forms, in the same order as in the contact book.
+	Used for applying the incremental change notifications from m_ContactBook. */
+	std::vector<DisplayContactPtr> m_BookOrder;
+
 	/** Stores all contacts in their layout positions.
 	Updated by recalculateLayout(). */
 	std::vector<ContactLayout> m_CurrentLayout;
@@ -108,6 +112,9 @@ protected:
 	Then calls recalculateLayout() to update the layout, too. */
 	void parseContacts();
 
+	/** Sorts the specified display contacts and merges them into m_DisplayContacts, keeping it sorted. */
+	void mergeIntoDisplayContacts(std::vector<DisplayContactPtr> && a_NewContacts);
+
 	/** Recalculates m_CurrentLayout for the current contents of m_DisplayContacts.
 	Also updates the scrollbars as needed. */
 	void recalculateLayout();
@@ -134,6 +141,15 @@ private slots:
 
 	/** The horizontal scrollbar has been changed. */
 	void horizontalScrollBarValueChanged(int a_NewValue);
+
+	/** New contacts have been added to m_ContactBook, parse and display them. */
+	void contactsInserted(int a_First, int a_Count);
+
+	/** Contacts have been removed from m_ContactBook, remove them from display. */
+	void contactsRemoved(int a_First, int a_Count);
+
+	/** Contacts in m_ContactBook have changed, re-parse and re-display them. */
+	void contactsChanged(int a_First, int a_Count);
 };
 
 
@@ -1,10 +1,21 @@
 #include "MainWindow.h"
+#include <QFileDialog>
 #include <QMessageBox>
+#include <QInputDialog>
 #include "ui_MainWindow.h"
 #include "Session.h"
 #include "SessionModel.h"
 #include "Device.h"
+#include "DeviceBackup.h"
+#include "DeviceCardDav.h"
+#include "DisplayContact.h"
 #include "DlgAddDevice.h"
+#include "DlgRequestMetrics.h"
+#include "DlgSearch.h"
+#include "DlgSimilarNames.h"
+#include "Exceptions.h"
+#include "PhoneNumber.h"
+#include "PhotoProcessor.h"
 
 
 
@@ -30,6 +41,11 @@ MainWindow::MainWindow(std::unique_ptr<Session> && a_Session):
 	}
 
 	connectSignals();
+	for (const auto & dev: m_Session->getDevices())
+	{
+		connectDeviceSignals(dev.get());
+	}
+	connect(m_Session.get(), &Session::addedDevice, this, &MainWindow::connectDeviceSignals);
 
 	// Start the devices:
 	m_Session->startDevices();
@@ -75,8 +91,30 @@ void MainWindow::connectSignals()
 {
 	connect(m_UI->tvSession,       &QTreeView::activated, this, &MainWindow::sessionItemActivated);
 	connect(m_UI->tvSession,       &QTreeView::clicked,   this, &MainWindow::sessionItemActivated);
+	connect(m_UI->actFilePhoneCountry, &QAction::triggered, this, &MainWindow::setPhoneCountry);
+	connect(m_UI->actSearchContacts,     &QAction::triggered, this, &MainWindow::searchContacts);
+	connect(m_UI->actSearchSimilarNames, &QAction::triggered, this, &MainWindow::findSimilarNames);
 	connect(m_UI->actDeviceAddNew, &QAction::triggered,   this, &MainWindow::addNewDevice);
 	connect(m_UI->actDeviceDel,    &QAction::triggered,   this, &MainWindow::delDevice);
+	connect(m_UI->actDeviceRefresh, &QAction::triggered,  this, &MainWindow::refreshDevice);
+	connect(m_UI->actDevicePushChanges, &QAction::triggered, this, &MainWindow::pushDeviceChanges);
+	connect(m_UI->actDeviceMetrics,     &QAction::triggered, this, &MainWindow::showDeviceMetrics);
+	connect(m_UI->actDeviceBackup,      &QAction::triggered, this, &MainWindow::backupContactBook);
+	connect(m_UI->actDeviceRestoreBackup, &QAction::triggered, this, &MainWindow::restoreBackup);
+	connect(m_UI->actToolsProcessPhotos, &QAction::triggered, this, &MainWindow::processPhotos);
+}
+
+
+
+
+
+void MainWindow::connectDeviceSignals(Device * a_Device)
+{
+	auto davDevice = dynamic_cast<DeviceCardDav *>(a_Device);
+	if (davDevice != nullptr)
+	{
+		connect(davDevice, &DeviceCardDav::pushConflict, this, &MainWindow::reportPushConflict);
+	}
 }
 
 
@@ -92,6 +130,54 @@ void MainWindow::sessionItemActivated(const QModelIndex & a_Index)
 
 
 
+void MainWindow::setPhoneCountry()
+{
+	QStringList countries;
+	for (const auto & c: PhoneNumber::knownCountries())
+	{
+		countries.append(c);
+	}
+	countries.sort();
+	bool isOK = false;
+	auto country = QInputDialog::getItem(this, tr("ContactBookSanitizer"),
+		tr("Country for the phone numbers without the international prefix:"),
+		countries, countries.indexOf(PhoneNumber::defaultCountry()), false, &isOK
+	);
+	if (!isOK || (country == PhoneNumber::defaultCountry()))
+	{
+		return;
+	}
+	m_Session->setPhoneCountry(country);
+	m_Session->saveToFile();
+	QMessageBox::information(this, tr("ContactBookSanitizer"),
+		tr("The new country applies to the contacts loaded or changed from now on. Refresh the devices to apply it to all their contacts.")
+	);
+}
+
+
+
+
+
+void MainWindow::searchContacts()
+{
+	DlgSearch dlg(*m_Session, this);
+	dlg.exec();
+}
+
+
+
+
+
+void MainWindow::findSimilarNames()
+{
+	DlgSimilarNames dlg(*m_Session, this);
+	dlg.exec();
+}
+
+
+
+
+
 void MainWindow::addNewDevice()
 {
 	DlgAddDevice dlg;
@@ -127,6 +213,251 @@ void MainWindow::delDevice()
 
 
 
+void MainWindow::refreshDevice()
+{
+	auto dev = selectedDevice();
+	if (dev == nullptr)
+	{
+		return;
+	}
+	dev->refresh();
+}
+
+
+
+
+
+void MainWindow::pushDeviceChanges()
+{
+	auto dev = selectedDevice();
+	if (dev == nullptr)
+	{
+		return;
+	}
+	dev->pushChanges();
+}
+
+
+
+
+
+void MainWindow::showDeviceMetrics()
+{
+	auto dev = selectedDevice();
+	if (dev == nullptr)
+	{
+		return;
+	}
+	auto davDev = dynamic_cast<DeviceCardDav *>(dev);
+	if ((davDev == nullptr) || (davDev->requestMetrics() == nullptr))
+	{
+		QMessageBox::information(this, tr("ContactBookSanitizer"),
+			tr("The device %1 doesn't collect any network metrics.").arg(dev->displayName())
+		);
+		return;
+	}
+	DlgRequestMetrics dlg(*davDev, this);
+	dlg.exec();
+}
+
+
+
+
+
+void MainWindow::reportPushConflict(
+	const ContactBook * a_ContactBook,
+	std::shared_ptr<Contact> a_LocalContact,
+	std::shared_ptr<Contact> a_ServerContact
+)
+{
+	auto name = DisplayContact::fromContact(*a_ServerContact)->displayName();
+	if (a_LocalContact == nullptr)
+	{
+		statusBar()->showMessage(
+			tr("%1: The contact %2 has changed on the server, but it has been deleted here; it will be deleted on the server.")
+				.arg(a_ContactBook->displayName(), name)
+		);
+	}
+	else
+	{
+		statusBar()->showMessage(
+			tr("%1: The contact %2 has changed on the server, too; the local version will overwrite it.")
+				.arg(a_ContactBook->displayName(), name)
+		);
+	}
+}
+
+
+
+
+
+void MainWindow::backupContactBook()
+{
+	auto contactBook = selectedContactBook();
+	auto dev = selectedDevice();
+	if ((contactBook == nullptr) || (dev == nullptr) || dev->isBackup())
+	{
+		QMessageBox::information(this, tr("ContactBookSanitizer"),
+			tr("Select a contact book to back up.")
+		);
+		return;
+	}
+
+	// Use the session's backup device, create one if there's none:
+	DeviceBackup * backup = nullptr;
+	for (const auto & d: m_Session->getDevices())
+	{
+		backup = dynamic_cast<DeviceBackup *>(d.get());
+		if (backup != nullptr)
+		{
+			break;
+		}
+	}
+	if (backup == nullptr)
+	{
+		auto folder = QFileDialog::getExistingDirectory(this, tr("Select the folder for the backups"));
+		if (folder.isEmpty())
+		{
+			return;
+		}
+		std::unique_ptr<DeviceBackup> newBackup(new DeviceBackup);
+		newBackup->setFolder(folder);
+		backup = newBackup.get();
+		m_Session->addDevice(std::move(newBackup));
+		backup->start();
+		m_Session->saveToFile();
+	}
+
+	try
+	{
+		backup->backupContactBook(*contactBook);
+	}
+	catch (const EFileError & exc)
+	{
+		QMessageBox::warning(this, tr("ContactBookSanitizer"),
+			tr("Cannot write the backup file %1: %2").arg(exc.m_OperationFileName, exc.m_Message)
+		);
+	}
+}
+
+
+
+
+
+void MainWindow::restoreBackup()
+{
+	auto backup = selectedContactBook();
+	auto dev = selectedDevice();
+	if ((backup == nullptr) || (dev == nullptr) || !dev->isBackup())
+	{
+		QMessageBox::information(this, tr("ContactBookSanitizer"),
+			tr("Select the backup to restore.")
+		);
+		return;
+	}
+
+	// Let the user choose the contact book to restore into:
+	QStringList names;
+	std::vector<ContactBookPtr> books;
+	for (const auto & d: m_Session->getDevices())
+	{
+		if (d->isBackup())
+		{
+			continue;
+		}
+		for (const auto & cb: d->contactBooks())
+		{
+			names.append(QString::fromUtf8("%1 / %2").arg(d->displayName(), cb->displayName()));
+			books.push_back(cb);
+		}
+	}
+	if (books.empty())
+	{
+		QMessageBox::information(this, tr("ContactBookSanitizer"),
+			tr("There is no contact book to restore the backup into.")
+		);
+		return;
+	}
+	bool isOk = false;
+	auto name = QInputDialog::getItem(this, tr("ContactBookSanitizer"),
+		tr("Restore the backup %1 into:").arg(backup->displayName()),
+		names, 0, false, &isOk
+	);
+	if (!isOk)
+	{
+		return;
+	}
+	auto dest = books[static_cast<size_t>(names.indexOf(name))];
+	auto res = QMessageBox::question(this, tr("ContactBookSanitizer"),
+		tr("All the changes made to %1 since the backup will be lost. Are you sure you want to restore it?")
+			.arg(dest->displayName()),
+		QMessageBox::Yes, QMessageBox::No | QMessageBox::Default | QMessageBox::Escape
+	);
+	if (res != QMessageBox::Yes)
+	{
+		return;
+	}
+
+	auto stats = DeviceBackup::restore(*backup, *dest);
+	QMessageBox::information(this, tr("ContactBookSanitizer"),
+		tr("Restored %1: %2 contacts unchanged, %3 replaced, %4 added, %5 removed.")
+			.arg(dest->displayName())
+			.arg(stats.m_NumUnchanged)
+			.arg(stats.m_NumReplaced)
+			.arg(stats.m_NumAdded)
+			.arg(stats.m_NumRemoved)
+	);
+}
+
+
+
+
+
+void MainWindow::processPhotos()
+{
+	auto contactBook = selectedContactBook();
+	if (contactBook == nullptr)
+	{
+		QMessageBox::information(this, tr("ContactBookSanitizer"),
+			tr("Select a contact book whose photos should be processed.")
+		);
+		return;
+	}
+
+	// Report the photos first (dry run), then let the user decide whether to re-encode them:
+	PhotoProcessor processor;
+	auto report = processor.process(*contactBook, true);
+	auto text = tr("The contact book %1 has %2 photos (%3 KiB), %4 of them cannot be decoded.\n"
+		"Groups of identical photos: %5\nGroups of similar photos: %6"
+	)
+		.arg(contactBook->displayName())
+		.arg(report.m_NumPhotos)
+		.arg(report.m_BytesBefore / 1024)
+		.arg(report.m_NumUndecodable)
+		.arg(report.m_IdenticalGroups.size())
+		.arg(report.m_SimilarGroups.size());
+	if (report.m_NumReencoded == 0)
+	{
+		QMessageBox::information(this, tr("ContactBookSanitizer"), text);
+		return;
+	}
+	auto res = QMessageBox::question(this, tr("ContactBookSanitizer"),
+		text + "\n\n" + tr("Downscale the %1 oversized photos, saving %2 KiB?")
+			.arg(report.m_NumReencoded)
+			.arg(report.bytesSaved() / 1024),
+		QMessageBox::Yes, QMessageBox::No | QMessageBox::Default | QMessageBox::Escape
+	);
+	if (res != QMessageBox::Yes)
+	{
+		return;
+	}
+	processor.process(*contactBook, false);
+}
+
+
+
+
+
 Device * MainWindow::selectedDevice(void)
 {
 	auto sel = m_UI->tvSession->selectionModel()->selectedIndexes();
@@ -141,6 +472,20 @@ Device * MainWindow::selectedDevice(void)
 
 
 
+ContactBookPtr MainWindow::selectedContactBook(void)
+{
+	auto sel = m_UI->tvSession->selectionModel()->selectedIndexes();
+	if (sel.isEmpty())
+	{
+		return nullptr;
+	}
+	return m_SessionModel->getContactBook(sel.at(0));
+}
+
+
+
+
+
 void MainWindow::expandDeviceItem(Device * a_Device, const QModelIndex & a_Index)
 {
 	Q_UNUSED(a_Device);
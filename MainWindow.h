@@ -13,9 +13,12 @@
 
 
 // fwd:
+class Contact;
+class ContactBook;
 class Session;
 class SessionModel;
 class Device;
+using ContactBookPtr = std::shared_ptr<ContactBook>;
 namespace Ui
 {
 	class MainWindow;
@@ -43,6 +46,10 @@ public:
 	Returns nullptr if no device selected. */
 	Device * selectedDevice();
 
+	/** Returns the contact book that is currently selected in the tree view.
+	Returns nullptr if no contact book selected. */
+	ContactBookPtr selectedContactBook();
+
 
 private:
 
@@ -58,18 +65,58 @@ private:
 	/** Connects the UI signals and slots. */
 	void connectSignals();
 
+	/** Connects the signals of the specified device that are reported in the UI. */
+	void connectDeviceSignals(Device * a_Device);
+
 
 private slots:
 
 	/** Triggered when the selection in tvSession changes. */
 	void sessionItemActivated(const QModelIndex & a_Index);
 
+	/** Lets the user choose the country in which the phone numbers without the international prefix
+	are interpreted. */
+	void setPhoneCountry(void);
+
+	/** Shows the dialog for the full-text search over all the contacts. */
+	void searchContacts(void);
+
+	/** Shows the dialog for looking up contacts with names similar to the one entered. */
+	void findSimilarNames(void);
+
 	/** Shows the "Add new device" dialog. */
 	void addNewDevice(void);
 
 	/** Deletes the currently selected device, after confirmation. */
 	void delDevice(void);
 
+	/** Re-reads the currently selected device's data from scratch. */
+	void refreshDevice(void);
+
+	/** Writes the changes in the currently selected device's contact books back to the device. */
+	void pushDeviceChanges(void);
+
+	/** Shows the metrics of the network requests sent by the currently selected device. */
+	void showDeviceMetrics(void);
+
+	/** Reports in the status bar that a contact with unwritten local changes has changed on the server, too.
+	Connected to DeviceCardDav::pushConflict(). */
+	void reportPushConflict(
+		const ContactBook * a_ContactBook,
+		std::shared_ptr<Contact> a_LocalContact,
+		std::shared_ptr<Contact> a_ServerContact
+	);
+
+	/** Backs up the currently selected contact book into the session's backup device.
+	If the session has no backup device yet, asks the user for the backup folder and creates one. */
+	void backupContactBook(void);
+
+	/** Restores the currently selected backup into a contact book chosen by the user, after confirmation. */
+	void restoreBackup(void);
+
+	/** Finds the duplicate photos in the contact book selected in tvSession and offers to downscale the oversized ones. */
+	void processPhotos(void);
+
 	/** Expands the device item represented by the model.
 	Triggered by m_SessionModel after a new device is added. */
 	void expandDeviceItem(Device * a_Device, const QModelIndex & a_Index);
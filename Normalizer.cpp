@@ -0,0 +1,98 @@
+#include "Normalizer.h"
+#include "VCardParser.h"
+
+
+
+
+
+QString Normalizer::email(const QByteArray & a_Email)
+{
+	auto res = QString::fromUtf8(a_Email).trimmed().toLower();
+	if (res.startsWith("mailto:"))
+	{
+		res.remove(0, 7);
+	}
+	return res;
+}
+
+
+
+
+
+QString Normalizer::phone(const QByteArray & a_Phone)
+{
+	QString res;
+	auto len = a_Phone.length();
+	res.reserve(len);
+	int start = 0;
+	if (a_Phone.toLower().startsWith("tel:"))
+	{
+		start = 4;
+	}
+	bool hasDigits = false;
+	for (int i = start; i < len; ++i)
+	{
+		auto ch = a_Phone.at(i);
+		if ((ch >= '0') && (ch <= '9'))
+		{
+			res.append(QChar(ch));
+			hasDigits = true;
+		}
+		else if ((ch == '+') && !hasDigits && res.isEmpty())
+		{
+			res.append(QChar(ch));
+		}
+	}
+	if (!hasDigits)
+	{
+		return QString();
+	}
+	if (res.startsWith("00"))
+	{
+		res.replace(0, 2, "+");
+	}
+	return res;
+}
+
+
+
+
+
+QString Normalizer::foldText(const QString & a_Text)
+{
+	auto decomposed = a_Text.normalized(QString::NormalizationForm_KD);
+	QString res;
+	res.reserve(decomposed.size());
+	for (const auto & ch: decomposed)
+	{
+		switch (ch.category())
+		{
+			case QChar::Mark_NonSpacing:
+			case QChar::Mark_SpacingCombining:
+			case QChar::Mark_Enclosing:
+			{
+				// Drop the diacritics
+				break;
+			}
+			default:
+			{
+				res.append(ch);
+				break;
+			}
+		}
+	}
+	return res.toCaseFolded().simplified();
+}
+
+
+
+
+
+QString Normalizer::foldValue(const QByteArray & a_Value)
+{
+	return foldText(QString::fromUtf8(VCardParser::unescapeBackslashes(a_Value)));
+}
+
+
+
+
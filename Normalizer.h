@@ -0,0 +1,45 @@
+#ifndef NORMALIZER_H
+#define NORMALIZER_H
+
+
+
+
+
+#include <QString>
+#include <QByteArray>
+
+
+
+
+
+/** Provides the normalization of the various contact values into keys that can be compared for equality.
+The normalized forms are used for indexing, looking up and matching the contacts; they are never displayed. */
+class Normalizer
+{
+public:
+
+	/** Returns the normalized form of the specified e-mail address (vCard EMAIL value).
+	Strips any "mailto:" prefix and surrounding whitespace and lowercases the address. */
+	static QString email(const QByteArray & a_Email);
+
+	/** Returns the normalized form of the specified phone number (vCard TEL value).
+	Strips any "tel:" prefix and all the formatting, keeping only the digits and an international "+" prefix
+	(an international "00" prefix is converted to "+").
+	Returns an empty string if the value contains no digits. */
+	static QString phone(const QByteArray & a_Phone);
+
+	/** Returns the folded form of the specified text (typically a name), suitable for accent- and
+	case-insensitive comparison.
+	Decomposes the text, drops all the combining marks (diacritics), case-folds it and collapses whitespace. */
+	static QString foldText(const QString & a_Text);
+
+	/** Returns the folded form of the specified vCard text value (FN, ORG etc.).
+	Unescapes the backslash-escapes in the value first, then folds it using foldText(). */
+	static QString foldValue(const QByteArray & a_Value);
+};
+
+
+
+
+
+#endif // NORMALIZER_H
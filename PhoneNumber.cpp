@@ -0,0 +1,300 @@
+#include "PhoneNumber.h"
+#include <string.h>
+#include <atomic>
+#include <QLocale>
+#include "Normalizer.h"
+
+
+
+
+
+/** The numbering rules for a single country. */
+struct CountryRules
+{
+	/** ISO 3166-1 alpha-2 code of the country. */
+	const char * m_IsoCode;
+
+	/** The international calling code, without the "+". */
+	const char * m_CallingCode;
+
+	/** The national trunk prefix, dialed before the area code within the country; empty if none. */
+	const char * m_TrunkPrefix;
+
+	/** The international call prefix, if different from "00" (which is always recognized). */
+	const char * m_ExitPrefix;
+
+	/** If true, the trunk prefix is kept as a part of the number in the international form (Italy). */
+	bool m_KeepsTrunkPrefix;
+};
+
+
+
+
+
+/** The numbering rules for the common countries. */
+static const CountryRules g_Countries[] =
+{
+	{"AT", "43",  "0",  "",     false},
+	{"AU", "61",  "0",  "0011", false},
+	{"BE", "32",  "0",  "",     false},
+	{"BR", "55",  "0",  "",     false},
+	{"CA", "1",   "1",  "011",  false},
+	{"CH", "41",  "0",  "",     false},
+	{"CN", "86",  "0",  "",     false},
+	{"CZ", "420", "",   "",     false},
+	{"DE", "49",  "0",  "",     false},
+	{"DK", "45",  "",   "",     false},
+	{"ES", "34",  "",   "",     false},
+	{"FI", "358", "0",  "",     false},
+	{"FR", "33",  "0",  "",     false},
+	{"GB", "44",  "0",  "",     false},
+	{"HU", "36",  "06", "",     false},
+	{"IE", "353", "0",  "",     false},
+	{"IN", "91",  "0",  "",     false},
+	{"IT", "39",  "0",  "",     true},
+	{"JP", "81",  "0",  "010",  false},
+	{"MX", "52",  "",   "",     false},
+	{"NL", "31",  "0",  "",     false},
+	{"NO", "47",  "",   "",     false},
+	{"NZ", "64",  "0",  "",     false},
+	{"PL", "48",  "",   "",     false},
+	{"PT", "351", "",   "",     false},
+	{"RU", "7",   "8",  "810",  false},
+	{"SE", "46",  "0",  "",     false},
+	{"SK", "421", "0",  "",     false},
+	{"UA", "380", "0",  "",     false},
+	{"US", "1",   "1",  "011",  false},
+};
+
+static const int NUM_COUNTRIES = static_cast<int>(sizeof(g_Countries) / sizeof(g_Countries[0]));
+
+/** The minimum and maximum number of digits in an E.164 number that we accept.
+Shorter numbers are most likely service numbers or extensions, which cannot be normalized. */
+static const int MIN_E164_DIGITS = 8;
+static const int MAX_E164_DIGITS = 15;
+
+
+
+
+
+/** Returns the index into g_Countries of the specified country, or -1 if not known. */
+static int findCountry(const QString & a_IsoCode)
+{
+	auto isoCode = a_IsoCode.toUpper();
+	for (int i = 0; i < NUM_COUNTRIES; ++i)
+	{
+		if (isoCode == g_Countries[i].m_IsoCode)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+
+
+
+/** Returns the index into g_Countries of the country of the system locale, or of the US if the locale's
+country is not known. */
+static int systemCountryIdx()
+{
+	auto localeName = QLocale::system().name();  // "cs_CZ"
+	auto idx = findCountry(localeName.mid(localeName.indexOf('_') + 1));
+	return (idx >= 0) ? idx : findCountry("US");
+}
+
+
+
+
+
+/** Returns the index into g_Countries of the default country.
+Initialized from the system locale on first use. */
+static std::atomic<int> & defaultCountryIdx()
+{
+	static std::atomic<int> idx(systemCountryIdx());
+	return idx;
+}
+
+
+
+
+
+/** Returns the E.164 form of the specified value, using the specified country's rules. */
+static QString convertToE164(const QByteArray & a_Value, const CountryRules & a_Country)
+{
+	auto digits = Normalizer::phone(a_Value);  // Digits only, international "00" already converted to "+"
+	if (digits.isEmpty())
+	{
+		return QString();
+	}
+	QString res;
+	if (digits.at(0) == '+')
+	{
+		res = digits.mid(1);
+	}
+	else if ((a_Country.m_ExitPrefix[0] != 0) && digits.startsWith(a_Country.m_ExitPrefix))
+	{
+		res = digits.mid(static_cast<int>(strlen(a_Country.m_ExitPrefix)));
+	}
+	else if (a_Country.m_KeepsTrunkPrefix || (a_Country.m_TrunkPrefix[0] == 0))
+	{
+		res = a_Country.m_CallingCode + digits;
+	}
+	else if (digits.startsWith(a_Country.m_TrunkPrefix))
+	{
+		res = a_Country.m_CallingCode + digits.mid(static_cast<int>(strlen(a_Country.m_TrunkPrefix)));
+	}
+	else if ((strcmp(a_Country.m_CallingCode, "1") == 0) && (digits.length() == 10))
+	{
+		// NANP numbers are commonly written without the trunk prefix:
+		res = "1" + digits;
+	}
+	else
+	{
+		// A national number without the trunk prefix is a local number without the area code, cannot normalize:
+		return QString();
+	}
+	if ((res.length() < MIN_E164_DIGITS) || (res.length() > MAX_E164_DIGITS))
+	{
+		return QString();
+	}
+	return "+" + res;
+}
+
+
+
+
+
+bool PhoneNumber::setDefaultCountry(const QString & a_IsoCode)
+{
+	auto idx = findCountry(a_IsoCode);
+	if (idx < 0)
+	{
+		return false;
+	}
+	defaultCountryIdx().store(idx);
+	return true;
+}
+
+
+
+
+
+QString PhoneNumber::defaultCountry()
+{
+	return QString::fromLatin1(g_Countries[defaultCountryIdx().load()].m_IsoCode);
+}
+
+
+
+
+
+QString PhoneNumber::systemCountry()
+{
+	return QString::fromLatin1(g_Countries[systemCountryIdx()].m_IsoCode);
+}
+
+
+
+
+
+std::vector<QString> PhoneNumber::knownCountries()
+{
+	std::vector<QString> res;
+	for (const auto & c: g_Countries)
+	{
+		res.push_back(QString::fromLatin1(c.m_IsoCode));
+	}
+	return res;
+}
+
+
+
+
+
+QString PhoneNumber::toE164(const QByteArray & a_Value)
+{
+	return convertToE164(a_Value, g_Countries[defaultCountryIdx().load()]);
+}
+
+
+
+
+
+QString PhoneNumber::toE164(const QByteArray & a_Value, const QString & a_CountryIsoCode)
+{
+	auto idx = findCountry(a_CountryIsoCode);
+	if (idx < 0)
+	{
+		return QString();
+	}
+	return convertToE164(a_Value, g_Countries[idx]);
+}
+
+
+
+
+
+QString PhoneNumber::key(const QByteArray & a_Value)
+{
+	auto res = toE164(a_Value);
+	if (res.isEmpty())
+	{
+		return Normalizer::phone(a_Value);
+	}
+	return res;
+}
+
+
+
+
+
+QString PhoneNumber::key(const Contact::Sentence & a_Sentence)
+{
+	if (!a_Sentence.m_NormalizedValue.isEmpty())
+	{
+		return a_Sentence.m_NormalizedValue;
+	}
+	return key(a_Sentence.m_Value);
+}
+
+
+
+
+
+QString PhoneNumber::formatForDisplay(const QString & a_E164)
+{
+	if (!a_E164.startsWith('+'))
+	{
+		return a_E164;
+	}
+
+	// The calling codes form a prefix code, so at most one of them matches:
+	for (const auto & c: g_Countries)
+	{
+		if (a_E164.midRef(1).startsWith(QLatin1String(c.m_CallingCode)))
+		{
+			auto ccLen = static_cast<int>(strlen(c.m_CallingCode));
+			return a_E164.left(ccLen + 1) + ' ' + a_E164.mid(ccLen + 1);
+		}
+	}
+	return a_E164;
+}
+
+
+
+
+
+void PhoneNumber::normalizeContact(Contact & a_Contact)
+{
+	const auto & country = g_Countries[defaultCountryIdx().load()];
+	const auto & sentences = a_Contact.sentences();
+	for (size_t i = 0, size = sentences.size(); i < size; ++i)
+	{
+		if (sentences[i].m_Key == "tel")
+		{
+			a_Contact.setNormalizedValue(i, convertToE164(sentences[i].m_Value, country));
+		}
+	}
+}
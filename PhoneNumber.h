@@ -0,0 +1,75 @@
+#ifndef PHONENUMBER_H
+#define PHONENUMBER_H
+
+
+
+
+
+#include <vector>
+#include <QString>
+#include <QByteArray>
+
+#include "Contact.h"
+
+
+
+
+
+/** Conversion of the vCard TEL values into the canonical E.164 form ("+<country code><number>").
+Numbers written without the international prefix are interpreted in the context of the default country,
+using its calling code and national trunk prefix rules (the trunk prefix is dropped for most countries, but
+kept for Italy, where it is a part of the number).
+The normalized form is cached in each TEL sentence (Contact::Sentence::m_NormalizedValue) by
+normalizeContact(), which Contact::prepare() calls; ContactBook prepares all new and changed contacts before publishing them,
+so that indexing, duplicate detection and display don't need to re-compute it. */
+class PhoneNumber
+{
+public:
+
+	/** Sets the default country, used for numbers that have no international prefix.
+	a_IsoCode is the ISO 3166-1 alpha-2 code of the country, such as "CZ" or "US".
+	Returns false (and keeps the current default) if the country is not known.
+	The change only applies to the contacts normalized afterwards. */
+	static bool setDefaultCountry(const QString & a_IsoCode);
+
+	/** Returns the ISO 3166-1 alpha-2 code of the current default country. */
+	static QString defaultCountry();
+
+	/** Returns the ISO 3166-1 alpha-2 code of the country of the system locale, if its rules are known,
+	or "US" otherwise. This is the default country until setDefaultCountry() is called. */
+	static QString systemCountry();
+
+	/** Returns the ISO codes of all the countries for which the numbering rules are known. */
+	static std::vector<QString> knownCountries();
+
+	/** Returns the E.164 form of the specified TEL value, interpreted in the default country.
+	Returns an empty string if the value cannot be converted (too short or too long, no digits). */
+	static QString toE164(const QByteArray & a_Value);
+
+	/** Returns the E.164 form of the specified TEL value, interpreted in the specified country.
+	Returns an empty string if the value cannot be converted, or the country is unknown. */
+	static QString toE164(const QByteArray & a_Value, const QString & a_CountryIsoCode);
+
+	/** Returns the key to be used for comparing the specified TEL value with other phone numbers.
+	This is the E.164 form if possible, or the digits-only form (Normalizer::phone()) otherwise. */
+	static QString key(const QByteArray & a_Value);
+
+	/** Returns the key to be used for comparing the specified TEL sentence with other phone numbers.
+	Uses the value cached in the sentence by normalizeContact(), if available, so that the result is the same
+	as key(a_Sentence.m_Value), only faster. */
+	static QString key(const Contact::Sentence & a_Sentence);
+
+	/** Formats the E.164 number for display, separating the country calling code from the rest of the number:
+	"+420603123456" -> "+420 603123456". Returns the input unchanged if the calling code is not known. */
+	static QString formatForDisplay(const QString & a_E164);
+
+	/** Normalizes all the TEL sentences in the specified contact and caches the results in the sentences.
+	The contact must not be published (accessible to readers on other threads) yet. */
+	static void normalizeContact(Contact & a_Contact);
+};
+
+
+
+
+
+#endif // PHONENUMBER_H
@@ -0,0 +1,387 @@
+#include "PhotoProcessor.h"
+#include <algorithm>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QHash>
+#include <QImage>
+#include <QtAlgorithms>
+#include <QtConcurrentMap>
+
+
+
+
+
+namespace
+{
+
+/** The information about a single photo, gathered by the worker threads. */
+struct PhotoInfo
+{
+	ContactPtr m_Contact;
+	size_t m_SentenceIndex;
+
+	/** MD5 hash of the original data, for finding the identical photos. */
+	QByteArray m_DataHash;
+
+	/** The perceptual hash; only valid if m_IsDecoded is true. */
+	quint64 m_PerceptualHash;
+
+	bool m_IsDecoded;
+
+	/** The size of the original data. */
+	qint64 m_OrigSize;
+
+	/** The re-encoded data, if the photo was re-encoded (empty otherwise). */
+	QByteArray m_NewData;
+};
+
+}  // anonymous namespace
+
+
+
+
+
+/** Returns true if the sentence is an embedded (binary) photo. */
+static bool isEmbeddedPhoto(const Contact::Sentence & a_Sentence)
+{
+	if (a_Sentence.m_Key != "photo")
+	{
+		return false;
+	}
+	for (const auto & p: a_Sentence.m_Params)
+	{
+		if (p.m_Name == "encoding")
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+/** Returns the 64-bit difference hash of the image: each bit says whether a pixel in the 9x8 grayscale
+thumbnail is brighter than its right neighbor. Robust against scaling and re-compression. */
+static quint64 dHash(const QImage & a_Image)
+{
+	auto thumb = a_Image.scaled(9, 8, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).convertToFormat(QImage::Format_Grayscale8);
+	quint64 res = 0;
+	for (int y = 0; y < 8; ++y)
+	{
+		auto line = thumb.constScanLine(y);
+		for (int x = 0; x < 8; ++x)
+		{
+			res = (res << 1) | ((line[x] > line[x + 1]) ? 1 : 0);
+		}
+	}
+	return res;
+}
+
+
+
+
+
+/** Disjoint-set forest over the photo indices, for clustering the similar photos. */
+static size_t findRoot(std::vector<size_t> & a_Parent, size_t a_Item)
+{
+	while (a_Parent[a_Item] != a_Item)
+	{
+		a_Parent[a_Item] = a_Parent[a_Parent[a_Item]];
+		a_Item = a_Parent[a_Item];
+	}
+	return a_Item;
+}
+
+
+
+
+
+/** Marks the (re-encoded) photo sentence as a JPEG image, in all the ways the photo type can be specified:
+the TYPE and MEDIATYPE parameters, and the v2.1 value-less type parameter ("PHOTO;PNG;ENCODING=BASE64:..."). */
+static void setJpegType(Contact::Sentence & a_Sentence)
+{
+	for (auto & p: a_Sentence.m_Params)
+	{
+		if (p.m_Name == "type")
+		{
+			p.m_Values = {"JPEG"};
+		}
+		else if (p.m_Name == "mediatype")
+		{
+			p.m_Values = {"image/jpeg"};
+		}
+		else if (p.m_Values.empty() && (p.m_Name != "base64") && (p.m_Name != "b"))
+		{
+			p.m_Name = "jpeg";
+		}
+	}
+}
+
+
+
+
+
+/** Stores the re-encoded photos from a_Photos into the contact book, replacing their contacts (in a single batch).
+Contacts that are no longer in the book are skipped; the contacts in a_Photos are updated to the replacement
+instances. The photos of a single contact must be consecutive in a_Photos. */
+static void storeReencodedPhotos(ContactBook & a_ContactBook, std::vector<PhotoInfo> & a_Photos)
+{
+	ContactBook::Batch batch(a_ContactBook);
+	for (size_t i = 0; i < a_Photos.size();)
+	{
+		auto contact = a_Photos[i].m_Contact;
+		auto first = i;
+		auto sentences = contact->sentences();
+		bool hasChanged = false;
+		for (; (i < a_Photos.size()) && (a_Photos[i].m_Contact == contact); ++i)
+		{
+			if (a_Photos[i].m_NewData.isEmpty())
+			{
+				continue;
+			}
+			auto & s = sentences[a_Photos[i].m_SentenceIndex];
+			s.m_Value = a_Photos[i].m_NewData;
+			setJpegType(s);
+			hasChanged = true;
+		}
+		if (!hasChanged || !a_ContactBook.contains(contact.get()))
+		{
+			continue;
+		}
+		auto newContact = contact->clone();
+		newContact->setSentences(std::move(sentences));
+		a_ContactBook.replaceContact(contact.get(), newContact);
+		for (auto j = first; j < i; ++j)
+		{
+			a_Photos[j].m_Contact = newContact;
+		}
+	}
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PhotoProcessor::Report:
+
+PhotoProcessor::Report::Report():
+	m_NumPhotos(0),
+	m_NumUndecodable(0),
+	m_NumReencoded(0),
+	m_BytesBefore(0),
+	m_BytesAfter(0)
+{
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PhotoProcessor:
+
+PhotoProcessor::PhotoProcessor():
+	m_MaxDimension(512),
+	m_JpegQuality(85),
+	m_MaxHashDistance(4),
+	m_ShouldReencode(true)
+{
+}
+
+
+
+
+
+PhotoProcessor::Report PhotoProcessor::process(ContactBook & a_ContactBook, bool a_IsDryRun) const
+{
+	Report res;
+	auto snapshot = a_ContactBook.snapshot();
+
+	// Decode, process and store the photos one snapshot chunk at a time, to keep the memory usage bounded;
+	// only the hashes of the processed photos are kept for the grouping:
+	std::vector<PhotoInfo> photos;
+	auto maxDimension = m_MaxDimension;
+	auto jpegQuality = m_JpegQuality;
+	auto shouldReencode = m_ShouldReencode;
+	for (const auto & chunk: snapshot->chunks())
+	{
+		std::vector<PhotoInfo> chunkPhotos;
+		for (const auto & contact: *chunk)
+		{
+			const auto & sentences = contact->sentences();
+			for (size_t i = 0, size = sentences.size(); i < size; ++i)
+			{
+				if (isEmbeddedPhoto(sentences[i]))
+				{
+					chunkPhotos.push_back({contact, i, QByteArray(), 0, false, sentences[i].m_Value.size(), QByteArray()});
+				}
+			}
+		}
+		QtConcurrent::blockingMap(chunkPhotos, [maxDimension, jpegQuality, shouldReencode](PhotoInfo & a_Photo)
+			{
+				const auto & data = a_Photo.m_Contact->sentences()[a_Photo.m_SentenceIndex].m_Value;
+				a_Photo.m_DataHash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+				QImage img;
+				if (!img.loadFromData(data))
+				{
+					return;
+				}
+				a_Photo.m_IsDecoded = true;
+				a_Photo.m_PerceptualHash = dHash(img);
+				if (!shouldReencode || ((img.width() <= maxDimension) && (img.height() <= maxDimension)))
+				{
+					return;
+				}
+				auto scaled = img.scaled(maxDimension, maxDimension, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+				img = QImage();  // Free the full-size image as soon as possible
+				QByteArray newData;
+				QBuffer buf(&newData);
+				buf.open(QIODevice::WriteOnly);
+				if (scaled.save(&buf, "JPG", jpegQuality) && (newData.size() < data.size()))
+				{
+					a_Photo.m_NewData = newData;
+				}
+			}
+		);
+
+		// Sizes:
+		for (const auto & p: chunkPhotos)
+		{
+			res.m_NumPhotos += 1;
+			res.m_BytesBefore += p.m_OrigSize;
+			if (!p.m_IsDecoded)
+			{
+				res.m_NumUndecodable += 1;
+			}
+			if (p.m_NewData.isEmpty())
+			{
+				res.m_BytesAfter += p.m_OrigSize;
+			}
+			else
+			{
+				res.m_BytesAfter += p.m_NewData.size();
+				res.m_NumReencoded += 1;
+			}
+		}
+
+		if (!a_IsDryRun)
+		{
+			storeReencodedPhotos(a_ContactBook, chunkPhotos);
+		}
+		for (auto & p: chunkPhotos)
+		{
+			p.m_NewData = QByteArray();
+			photos.push_back(std::move(p));
+		}
+	}
+
+	// Identical photos, by the data hash:
+	QHash<QByteArray, std::vector<size_t>> byDataHash;
+	for (size_t i = 0; i < photos.size(); ++i)
+	{
+		byDataHash[photos[i].m_DataHash].push_back(i);
+	}
+	for (auto itr = byDataHash.cbegin(), end = byDataHash.cend(); itr != end; ++itr)
+	{
+		if (itr.value().size() < 2)
+		{
+			continue;
+		}
+		std::vector<PhotoRef> group;
+		for (auto idx: itr.value())
+		{
+			group.push_back({photos[idx].m_Contact, photos[idx].m_SentenceIndex});
+		}
+		res.m_IdenticalGroups.push_back(std::move(group));
+	}
+
+	// Similar photos: two hashes within distance D must have at least one of D + 1 bit bands equal (pigeonhole),
+	// so only the photos sharing a band value are compared:
+	auto maxDistance = std::max(0, std::min(m_MaxHashDistance, 15));
+	auto numBands = maxDistance + 1;
+	std::vector<size_t> parent(photos.size());
+	for (size_t i = 0; i < parent.size(); ++i)
+	{
+		parent[i] = i;
+	}
+	for (int band = 0; band < numBands; ++band)
+	{
+		auto firstBit = band * 64 / numBands;
+		auto lastBit = (band + 1) * 64 / numBands;
+		auto mask = ((lastBit - firstBit == 64) ? ~0ull : ((1ull << (lastBit - firstBit)) - 1)) << firstBit;
+		QHash<quint64, std::vector<size_t>> buckets;
+		for (size_t i = 0; i < photos.size(); ++i)
+		{
+			if (photos[i].m_IsDecoded)
+			{
+				buckets[photos[i].m_PerceptualHash & mask].push_back(i);
+			}
+		}
+		for (auto itr = buckets.cbegin(), end = buckets.cend(); itr != end; ++itr)
+		{
+			const auto & members = itr.value();
+			for (size_t i = 0; i < members.size(); ++i)
+			{
+				for (size_t j = i + 1; j < members.size(); ++j)
+				{
+					auto dist = qPopulationCount(photos[members[i]].m_PerceptualHash ^ photos[members[j]].m_PerceptualHash);
+					if (static_cast<int>(dist) <= maxDistance)
+					{
+						parent[findRoot(parent, members[i])] = findRoot(parent, members[j]);
+					}
+				}
+			}
+		}
+	}
+	QHash<size_t, std::vector<size_t>> clusters;
+	for (size_t i = 0; i < photos.size(); ++i)
+	{
+		if (photos[i].m_IsDecoded)
+		{
+			clusters[findRoot(parent, i)].push_back(i);
+		}
+	}
+	for (auto itr = clusters.cbegin(), end = clusters.cend(); itr != end; ++itr)
+	{
+		const auto & members = itr.value();
+		auto isAllIdentical = std::all_of(members.begin(), members.end(),
+			[&photos, &members](size_t a_Idx)
+			{
+				return (photos[a_Idx].m_DataHash == photos[members[0]].m_DataHash);
+			}
+		);
+		if ((members.size() < 2) || isAllIdentical)
+		{
+			continue;
+		}
+		std::vector<PhotoRef> group;
+		for (auto idx: members)
+		{
+			group.push_back({photos[idx].m_Contact, photos[idx].m_SentenceIndex});
+		}
+		res.m_SimilarGroups.push_back(std::move(group));
+	}
+
+	qDebug() << __FUNCTION__ << ": Processed " << res.m_NumPhotos << " photos, re-encoded " << res.m_NumReencoded
+		<< ", saving " << res.bytesSaved() << " bytes; " << res.m_IdenticalGroups.size() << " groups of identical and "
+		<< res.m_SimilarGroups.size() << " groups of similar photos";
+	return res;
+}
+
+
+
+
+
+quint64 PhotoProcessor::perceptualHash(const QByteArray & a_ImageData)
+{
+	QImage img;
+	if (!img.loadFromData(a_ImageData))
+	{
+		return 0;
+	}
+	return dHash(img);
+}
@@ -0,0 +1,108 @@
+#ifndef PHOTOPROCESSOR_H
+#define PHOTOPROCESSOR_H
+
+
+
+
+
+#include <vector>
+#include <QByteArray>
+
+#include "Contact.h"
+#include "ContactBook.h"
+
+
+
+
+
+/** Processes the PHOTO sentences in a ContactBook: finds the identical and near-identical pictures (using a
+perceptual hash) and re-encodes the oversized ones to a configurable maximum resolution and JPEG quality.
+The photos are decoded and processed on the global thread pool, one snapshot chunk at a time, so that only
+a bounded number of decoded images is held in memory at any moment. */
+class PhotoProcessor
+{
+public:
+
+	/** Identifies a single photo: the contact and the index of its PHOTO sentence. */
+	struct PhotoRef
+	{
+		ContactPtr m_Contact;
+		size_t m_SentenceIndex;
+	};
+
+	/** The result of the processing. */
+	struct Report
+	{
+		/** Total number of embedded photos found. */
+		size_t m_NumPhotos;
+
+		/** Number of photos that could not be decoded. */
+		size_t m_NumUndecodable;
+
+		/** Number of photos that were (or would be, in a dry run) re-encoded. */
+		size_t m_NumReencoded;
+
+		/** Total size of all the embedded photos before the processing, in bytes. */
+		qint64 m_BytesBefore;
+
+		/** Total size of all the embedded photos after the processing, in bytes. */
+		qint64 m_BytesAfter;
+
+		/** Groups of byte-for-byte identical photos (each group has at least two photos). */
+		std::vector<std::vector<PhotoRef>> m_IdenticalGroups;
+
+		/** Groups of perceptually similar photos (each group has at least two photos, and is not fully identical). */
+		std::vector<std::vector<PhotoRef>> m_SimilarGroups;
+
+		Report();
+
+		/** Returns the number of bytes saved by the re-encoding. */
+		qint64 bytesSaved() const { return m_BytesBefore - m_BytesAfter; }
+	};
+
+
+	/** Creates a new instance with the default settings (512 px, quality 85, similarity distance 4). */
+	PhotoProcessor();
+
+	/** Sets the maximum width and height of the photos; larger photos are downscaled (keeping the aspect ratio). */
+	void setMaxDimension(int a_MaxDimension) { m_MaxDimension = a_MaxDimension; }
+
+	/** Sets the JPEG quality (0 .. 100) used when re-encoding the photos. */
+	void setJpegQuality(int a_JpegQuality) { m_JpegQuality = a_JpegQuality; }
+
+	/** Sets the maximum Hamming distance of the perceptual hashes of two photos to be considered similar (0 .. 15). */
+	void setMaxHashDistance(int a_MaxHashDistance) { m_MaxHashDistance = a_MaxHashDistance; }
+
+	/** Sets whether the oversized photos should be re-encoded at all. */
+	void setShouldReencode(bool a_ShouldReencode) { m_ShouldReencode = a_ShouldReencode; }
+
+	/** Processes all the photos in the contact book's current snapshot.
+	Unless a_IsDryRun is set, the re-encoded photos are stored back into the contact book as soon as each snapshot
+	chunk is processed (one batch per chunk), skipping the contacts that have been replaced or removed meanwhile.
+	The photo references in the report point to the contacts currently in the book. */
+	Report process(ContactBook & a_ContactBook, bool a_IsDryRun) const;
+
+	/** Returns the 64-bit difference hash (dHash) of the specified image data, or 0 if it cannot be decoded. */
+	static quint64 perceptualHash(const QByteArray & a_ImageData);
+
+
+protected:
+
+	/** The maximum width and height of the photos. */
+	int m_MaxDimension;
+
+	/** The JPEG quality used for re-encoding. */
+	int m_JpegQuality;
+
+	/** The maximum Hamming distance of similar photos' hashes. */
+	int m_MaxHashDistance;
+
+	/** If false, the oversized photos are only reported, not re-encoded. */
+	bool m_ShouldReencode;
+};
+
+
+
+
+
+#endif // PHOTOPROCESSOR_H
@@ -0,0 +1,113 @@
+#include "PollScheduler.h"
+#include <algorithm>
+#include <QDebug>
+
+
+
+
+
+PollScheduler::PollScheduler(int a_MinIntervalSec, int a_MaxIntervalSec, QObject * a_Parent):
+	Super(a_Parent),
+	m_MinInterval(std::max(a_MinIntervalSec, 1)),
+	m_MaxInterval(std::max(a_MaxIntervalSec, a_MinIntervalSec)),
+	m_Interval(m_MinInterval),
+	m_IsPolling(false),
+	m_IsPollRequested(false),
+	m_IsRunning(false),
+	m_Random(std::random_device()())
+{
+	m_Timer.setSingleShot(true);
+	connect(&m_Timer, &QTimer::timeout, this, &PollScheduler::requestPoll);
+}
+
+
+
+
+
+void PollScheduler::start()
+{
+	m_IsRunning = true;
+	m_Interval = m_MinInterval;
+	requestPoll();
+}
+
+
+
+
+
+void PollScheduler::stop()
+{
+	m_IsRunning = false;
+	m_IsPollRequested = false;
+	m_Timer.stop();
+}
+
+
+
+
+
+void PollScheduler::requestPoll()
+{
+	if (!m_IsRunning)
+	{
+		return;
+	}
+	if (m_IsPolling)
+	{
+		// Coalesce with the poll in flight:
+		m_IsPollRequested = true;
+		return;
+	}
+	m_Timer.stop();
+	m_IsPolling = true;
+	emit poll();
+}
+
+
+
+
+
+void PollScheduler::pollFinished(bool a_HasChanges, bool a_HasFailed)
+{
+	if (!m_IsPolling)
+	{
+		return;
+	}
+	m_IsPolling = false;
+	if (!m_IsRunning)
+	{
+		return;
+	}
+
+	// Adapt the interval:
+	if (a_HasChanges && !a_HasFailed)
+	{
+		m_Interval = m_MinInterval;
+	}
+	else
+	{
+		m_Interval = std::min(m_Interval * 2, m_MaxInterval);
+	}
+	qDebug() << __FUNCTION__ << ": Changes: " << a_HasChanges << ", failed: " << a_HasFailed
+		<< ", next interval: " << m_Interval << " seconds";
+
+	// Start the next poll:
+	if (m_IsPollRequested)
+	{
+		m_IsPollRequested = false;
+		requestPoll();
+		return;
+	}
+	scheduleNext();
+}
+
+
+
+
+
+void PollScheduler::scheduleNext()
+{
+	std::uniform_real_distribution<double> jitter(0.8, 1.2);
+	auto msec = static_cast<int>(1000.0 * m_Interval * jitter(m_Random));
+	m_Timer.start(msec);
+}
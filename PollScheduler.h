@@ -0,0 +1,100 @@
+#ifndef POLLSCHEDULER_H
+#define POLLSCHEDULER_H
+
+
+
+
+
+#include <random>
+#include <QObject>
+#include <QTimer>
+
+
+
+
+
+/** Schedules periodic polls of a remote data source, adapting the interval to the observed activity.
+After a poll that has seen changes, the interval drops to the minimum; after each poll that has seen no changes,
+or has failed, the interval doubles, up to the maximum (exponential backoff). A random jitter is added to each
+interval, so that many sources started at the same time don't poll in lockstep.
+The poll is reported through the poll() signal and the client must call pollFinished() once it completes;
+the next poll is only scheduled after that, so polls never overlap. Polls requested while a poll is in flight
+are coalesced into a single poll started right after the current one finishes. */
+class PollScheduler:
+	public QObject
+{
+	Q_OBJECT
+	using Super = QObject;
+
+
+public:
+
+	/** Creates a new scheduler with the specified interval limits, in seconds.
+	The scheduler is stopped until start() is called. */
+	PollScheduler(int a_MinIntervalSec, int a_MaxIntervalSec, QObject * a_Parent = nullptr);
+
+	/** Starts the scheduling, with the first poll right away and the interval reset to the minimum. */
+	void start();
+
+	/** Stops the scheduling. A poll currently in flight may still call pollFinished(), it is then ignored. */
+	void stop();
+
+	/** Requests a poll as soon as possible.
+	If a poll is currently in flight, another one is started right after the current one finishes. */
+	void requestPoll();
+
+	/** Reports that the poll started by the poll() signal has finished.
+	a_HasChanges is true if the poll has found any changes in the data source.
+	a_HasFailed is true if the poll has failed (the data source is unreachable etc.). */
+	void pollFinished(bool a_HasChanges, bool a_HasFailed);
+
+	/** Returns true if a poll has been started and not yet finished. */
+	bool isPolling() const { return m_IsPolling; }
+
+	/** Returns the current interval between the polls, in seconds, without the jitter. */
+	int interval() const { return m_Interval; }
+
+
+protected:
+
+	/** The minimum interval between the polls, used after a poll that has seen changes. */
+	int m_MinInterval;
+
+	/** The maximum interval between the polls, the limit for the backoff. */
+	int m_MaxInterval;
+
+	/** The current interval between the polls, without the jitter. */
+	int m_Interval;
+
+	/** Set while a poll is in flight (between the poll() signal and the pollFinished() call). */
+	bool m_IsPolling;
+
+	/** Set if a poll has been requested while another one was in flight. */
+	bool m_IsPollRequested;
+
+	/** Set between start() and stop(). */
+	bool m_IsRunning;
+
+	/** The timer for the next poll. */
+	QTimer m_Timer;
+
+	/** The generator for the jitter. */
+	std::mt19937 m_Random;
+
+
+	/** Starts the timer for the next poll, using the current interval with a random jitter of +- 20 %. */
+	void scheduleNext();
+
+
+signals:
+
+	/** Emitted when a poll should be performed.
+	The receiver must call pollFinished() once the poll completes. */
+	void poll();
+};
+
+
+
+
+
+#endif // POLLSCHEDULER_H
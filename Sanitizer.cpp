@@ -0,0 +1,185 @@
+#include "Sanitizer.h"
+#include <QHash>
+#include <QtConcurrentMap>
+#include "SanitizerRules.h"
+#include "VCardSerializer.h"
+#include "VCardParser.h"
+
+
+
+
+
+Sanitizer::Sanitizer()
+{
+}
+
+
+
+
+
+void Sanitizer::addRule(SanitizerRulePtr && a_Rule)
+{
+	m_Rules.push_back(std::move(a_Rule));
+}
+
+
+
+
+
+void Sanitizer::addDefaultRules()
+{
+	addRule(SanitizerRulePtr(new SanitizerRuleTrimWhitespace));
+	addRule(SanitizerRulePtr(new SanitizerRuleFixMojibake));
+	addRule(SanitizerRulePtr(new SanitizerRuleNormalizeTypeCase));
+	addRule(SanitizerRulePtr(new SanitizerRuleSplitFnIntoN));
+	addRule(SanitizerRulePtr(new SanitizerRuleRemoveDuplicateTel));
+}
+
+
+
+
+
+std::vector<Sanitizer::ContactEdit> Sanitizer::proposeEdits(const ContactBookSnapshot & a_Snapshot) const
+{
+	// Each snapshot chunk is processed as a separate batch, with its own output:
+	struct Batch
+	{
+		ContactBookSnapshot::ChunkPtr m_Chunk;
+		std::vector<ContactEdit> m_Edits;
+	};
+	std::vector<Batch> batches;
+	for (const auto & chunk: a_Snapshot.chunks())
+	{
+		batches.push_back({chunk, {}});
+	}
+
+	const auto & rules = m_Rules;
+	QtConcurrent::blockingMap(batches, [&rules](Batch & a_Batch)
+		{
+			for (const auto & contact: *a_Batch.m_Chunk)
+			{
+				std::vector<Contact::Sentence> sentences(contact->sentences());
+				std::vector<QString> appliedRules;
+				for (const auto & rule: rules)
+				{
+					if (rule->apply(sentences))
+					{
+						appliedRules.push_back(rule->name());
+					}
+				}
+				if (appliedRules.empty())
+				{
+					continue;
+				}
+				auto sanitized = contact->clone();
+				sanitized->setSentences(std::move(sentences));
+				a_Batch.m_Edits.push_back({contact, sanitized, std::move(appliedRules)});
+			}
+		}
+	);
+
+	std::vector<ContactEdit> res;
+	for (auto & b: batches)
+	{
+		std::move(b.m_Edits.begin(), b.m_Edits.end(), std::back_inserter(res));
+	}
+	return res;
+}
+
+
+
+
+
+std::vector<Sanitizer::ContactEdit> Sanitizer::run(ContactBook & a_ContactBook, bool a_IsDryRun) const
+{
+	auto edits = proposeEdits(*a_ContactBook.snapshot());
+	if (!a_IsDryRun)
+	{
+		applyEdits(a_ContactBook, edits);
+	}
+	return edits;
+}
+
+
+
+
+
+size_t Sanitizer::applyEdits(ContactBook & a_ContactBook, const std::vector<ContactEdit> & a_Edits)
+{
+	ContactBook::Batch batch(a_ContactBook);
+	size_t res = 0;
+	for (const auto & e: a_Edits)
+	{
+		if (!a_ContactBook.contains(e.m_Original.get()))
+		{
+			continue;
+		}
+		a_ContactBook.replaceContact(e.m_Original.get(), e.m_Sanitized);
+		res += 1;
+	}
+	return res;
+}
+
+
+
+
+
+QByteArray Sanitizer::diff(const std::vector<ContactEdit> & a_Edits)
+{
+	QByteArray res;
+	for (const auto & e: a_Edits)
+	{
+		// Header, with the contact's name and the applied rules:
+		QByteArray name("?");
+		for (const auto & s: e.m_Original->sentences())
+		{
+			if (s.m_Key == "fn")
+			{
+				name = VCardParser::unescapeBackslashes(s.m_Value);
+				break;
+			}
+		}
+		res.append("@@ ").append(name).append(" [");
+		bool isFirst = true;
+		for (const auto & r: e.m_AppliedRules)
+		{
+			if (!isFirst)
+			{
+				res.append(", ");
+			}
+			isFirst = false;
+			res.append(r.toUtf8());
+		}
+		res.append("]\n");
+
+		// The lines removed and added, as a multiset difference:
+		QHash<QByteArray, int> added;
+		std::vector<QByteArray> after;
+		for (const auto & s: e.m_Sanitized->sentences())
+		{
+			after.push_back(VCardSerializer::serializeSentence(s));
+			added[after.back()] += 1;
+		}
+		for (const auto & s: e.m_Original->sentences())
+		{
+			auto line = VCardSerializer::serializeSentence(s);
+			auto itr = added.find(line);
+			if ((itr != added.end()) && (itr.value() > 0))
+			{
+				itr.value() -= 1;  // Unchanged line
+				continue;
+			}
+			res.append("- ").append(line).append('\n');
+		}
+		for (const auto & line: after)
+		{
+			auto itr = added.find(line);
+			if (itr.value() > 0)
+			{
+				itr.value() -= 1;
+				res.append("+ ").append(line).append('\n');
+			}
+		}
+	}
+	return res;
+}
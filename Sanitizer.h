@@ -0,0 +1,108 @@
+#ifndef SANITIZER_H
+#define SANITIZER_H
+
+
+
+
+
+#include <memory>
+#include <vector>
+#include <QString>
+#include <QByteArray>
+
+#include "Contact.h"
+#include "ContactBook.h"
+
+
+
+
+
+/** Interface for a single sanitization rule, such as "trim whitespace" or "remove duplicate phone numbers".
+A rule works on the sentences of a single contact at a time. The Sanitizer calls it concurrently for different
+contacts from multiple threads, so the implementations must not modify any shared state. */
+class SanitizerRule
+{
+public:
+
+	// Force a virtual destructor in descendants:
+	virtual ~SanitizerRule() {}
+
+	/** Returns the (short, user-visible) name of the rule. */
+	virtual QString name() const = 0;
+
+	/** Applies the rule to the specified sentences of a single contact (a working copy, modified in place).
+	Returns true if the sentences were changed. */
+	virtual bool apply(std::vector<Contact::Sentence> & a_Sentences) const = 0;
+};
+
+using SanitizerRulePtr = std::unique_ptr<SanitizerRule>;
+
+
+
+
+
+/** A pipeline of SanitizerRule instances, run over all contacts of a ContactBook.
+The rules are first used to propose edits, working on the book's snapshot in parallel batches (one snapshot chunk
+per batch) on the global thread pool. The proposed edits can then be reviewed as a compact diff (dry run) and / or
+applied to the ContactBook, replacing the original contacts with their sanitized versions. */
+class Sanitizer
+{
+public:
+
+	/** The proposed sanitization of a single contact. */
+	struct ContactEdit
+	{
+		/** The contact, as it was in the snapshot. */
+		ContactPtr m_Original;
+
+		/** The sanitized version of the contact (a clone of m_Original with the rules applied). */
+		ContactPtr m_Sanitized;
+
+		/** The names of the rules that changed the contact, in the order in which they were applied. */
+		std::vector<QString> m_AppliedRules;
+	};
+
+
+	/** Creates a new sanitizer with no rules. */
+	Sanitizer();
+
+	/** Appends the specified rule to the pipeline. */
+	void addRule(SanitizerRulePtr && a_Rule);
+
+	/** Appends all the built-in rules to the pipeline. */
+	void addDefaultRules();
+
+	/** Returns all the rules in the pipeline. */
+	const std::vector<SanitizerRulePtr> & rules() const { return m_Rules; }
+
+	/** Runs the rules over all the contacts in the snapshot and returns the proposed edits.
+	The contacts are processed in parallel; the snapshot (and the contact book) is not modified. */
+	std::vector<ContactEdit> proposeEdits(const ContactBookSnapshot & a_Snapshot) const;
+
+	/** Runs the rules over the current snapshot of the contact book.
+	Unless a_IsDryRun is set, the edits are applied to the book (in a single batch).
+	Returns the edits. */
+	std::vector<ContactEdit> run(ContactBook & a_ContactBook, bool a_IsDryRun) const;
+
+	/** Applies the specified edits to the contact book, in a single batch.
+	Edits whose original contact is no longer in the book (it has changed meanwhile) are skipped.
+	Returns the number of edits applied. */
+	static size_t applyEdits(ContactBook & a_ContactBook, const std::vector<ContactEdit> & a_Edits);
+
+	/** Returns a compact textual diff of the specified edits.
+	Each contact is introduced by a "@@ <name> [<rules>]" line, followed by the removed ("-") and added ("+")
+	vCard lines; unchanged lines are not output. */
+	static QByteArray diff(const std::vector<ContactEdit> & a_Edits);
+
+
+protected:
+
+	/** The rules in the pipeline, in the order in which they are applied. */
+	std::vector<SanitizerRulePtr> m_Rules;
+};
+
+
+
+
+
+#endif // SANITIZER_H
@@ -0,0 +1,336 @@
+#include "SanitizerRules.h"
+#include <algorithm>
+#include <QCoreApplication>
+#include <QSet>
+#include <QStringList>
+#include <QTextCodec>
+#include "PhoneNumber.h"
+#include "VCardParser.h"
+#include "VCardSerializer.h"
+
+
+
+
+
+/** Splits the text into words separated by spaces, dropping the empty ones. */
+static QStringList splitWords(const QString & a_Text)
+{
+	QStringList res;
+	for (const auto & word: a_Text.split(' '))
+	{
+		if (!word.isEmpty())
+		{
+			res.append(word);
+		}
+	}
+	return res;
+}
+
+
+
+
+
+/** Returns true if the data contains any non-ASCII bytes. */
+static bool hasHighBytes(const QByteArray & a_Data)
+{
+	for (auto ch: a_Data)
+	{
+		if (static_cast<unsigned char>(ch) >= 0x80)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SanitizerRuleTrimWhitespace:
+
+QString SanitizerRuleTrimWhitespace::name() const
+{
+	return QCoreApplication::translate("SanitizerRules", "Trim whitespace");
+}
+
+
+
+
+
+bool SanitizerRuleTrimWhitespace::apply(std::vector<Contact::Sentence> & a_Sentences) const
+{
+	bool res = false;
+	for (auto & s: a_Sentences)
+	{
+		if (s.isBinary())
+		{
+			continue;
+		}
+		auto trimmed = s.m_Value.trimmed();
+		if (trimmed.size() != s.m_Value.size())
+		{
+			s.m_Value = trimmed;
+			s.m_NormalizedValue.clear();
+			res = true;
+		}
+	}
+	return res;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SanitizerRuleFixMojibake:
+
+SanitizerRuleFixMojibake::SanitizerRuleFixMojibake():
+	m_Utf8(QTextCodec::codecForName("UTF-8")),
+	m_Windows1252(QTextCodec::codecForName("windows-1252"))
+{
+}
+
+
+
+
+
+QString SanitizerRuleFixMojibake::name() const
+{
+	return QCoreApplication::translate("SanitizerRules", "Fix mojibake");
+}
+
+
+
+
+
+bool SanitizerRuleFixMojibake::apply(std::vector<Contact::Sentence> & a_Sentences) const
+{
+	if ((m_Utf8 == nullptr) || (m_Windows1252 == nullptr))
+	{
+		return false;
+	}
+	bool res = false;
+	for (auto & s: a_Sentences)
+	{
+		if (s.isBinary() || !hasHighBytes(s.m_Value))
+		{
+			continue;
+		}
+
+		// Undo the bad decoding as long as the result is a valid UTF-8 (at most twice, for double-encoded values):
+		auto value = s.m_Value;
+		for (int i = 0; i < 2; ++i)
+		{
+			auto text = QString::fromUtf8(value);
+			if (!m_Windows1252->canEncode(text))
+			{
+				break;
+			}
+			auto undecoded = m_Windows1252->fromUnicode(text);
+			if ((undecoded == value) || !hasHighBytes(undecoded))
+			{
+				break;
+			}
+			QTextCodec::ConverterState state;
+			m_Utf8->toUnicode(undecoded.constData(), undecoded.size(), &state);
+			if ((state.invalidChars > 0) || (state.remainingChars > 0))
+			{
+				break;
+			}
+			value = undecoded;
+		}
+		if (value != s.m_Value)
+		{
+			s.m_Value = value;
+			s.m_NormalizedValue.clear();
+			res = true;
+		}
+	}
+	return res;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SanitizerRuleNormalizeTypeCase:
+
+QString SanitizerRuleNormalizeTypeCase::name() const
+{
+	return QCoreApplication::translate("SanitizerRules", "Normalize TYPE casing");
+}
+
+
+
+
+
+bool SanitizerRuleNormalizeTypeCase::apply(std::vector<Contact::Sentence> & a_Sentences) const
+{
+	bool res = false;
+	for (auto & s: a_Sentences)
+	{
+		for (auto & p: s.m_Params)
+		{
+			if (p.m_Values.empty())
+			{
+				// v2.1 value-less parameter, the name is the type:
+				auto lcName = p.m_Name.toLower();
+				if (lcName != p.m_Name)
+				{
+					p.m_Name = lcName;
+					res = true;
+				}
+				continue;
+			}
+			if (p.m_Name != "type")
+			{
+				continue;
+			}
+			for (auto & v: p.m_Values)
+			{
+				auto lcValue = v.toLower();
+				if (lcValue != v)
+				{
+					v = lcValue;
+					res = true;
+				}
+			}
+		}
+	}
+	return res;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SanitizerRuleSplitFnIntoN:
+
+QString SanitizerRuleSplitFnIntoN::name() const
+{
+	return QCoreApplication::translate("SanitizerRules", "Split FN into N");
+}
+
+
+
+
+
+bool SanitizerRuleSplitFnIntoN::apply(std::vector<Contact::Sentence> & a_Sentences) const
+{
+	const Contact::Sentence * fn = nullptr;
+	for (const auto & s: a_Sentences)
+	{
+		if (s.m_Key == "n")
+		{
+			return false;
+		}
+
+		// An organization's FN is the company name, not a person name:
+		if ((s.m_Key == "org") && !s.m_Value.isEmpty())
+		{
+			return false;
+		}
+		if ((s.m_Key == "kind") && (s.m_Value.toLower() == "org"))
+		{
+			return false;
+		}
+		if ((s.m_Key == "fn") && (fn == nullptr))
+		{
+			fn = &s;
+		}
+	}
+	if (fn == nullptr)
+	{
+		return false;
+	}
+	auto name = QString::fromUtf8(VCardParser::unescapeBackslashes(fn->m_Value)).simplified();
+	if (name.isEmpty())
+	{
+		return false;
+	}
+
+	// "Family, Given Middle" or "Given Middle Family":
+	QString family, given;
+	QStringList middle;
+	auto idxComma = name.indexOf(',');
+	if (idxComma > 0)
+	{
+		family = name.left(idxComma).trimmed();
+		auto rest = splitWords(name.mid(idxComma + 1));
+		if (!rest.isEmpty())
+		{
+			given = rest.takeFirst();
+		}
+		middle = rest;
+	}
+	else
+	{
+		auto tokens = splitWords(name);
+		given = tokens.takeFirst();
+		if (!tokens.isEmpty())
+		{
+			family = tokens.takeLast();
+		}
+		middle = tokens;
+	}
+
+	Contact::Sentence n;
+	n.m_Key = "n";
+	n.m_Value =
+		VCardSerializer::escapeBackslashes(family.toUtf8()) + ';' +
+		VCardSerializer::escapeBackslashes(given.toUtf8()) + ';' +
+		VCardSerializer::escapeBackslashes(middle.join(' ').toUtf8()) + ";;";
+	a_Sentences.push_back(n);
+	return true;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SanitizerRuleRemoveDuplicateTel:
+
+QString SanitizerRuleRemoveDuplicateTel::name() const
+{
+	return QCoreApplication::translate("SanitizerRules", "Remove duplicate TEL");
+}
+
+
+
+
+
+bool SanitizerRuleRemoveDuplicateTel::apply(std::vector<Contact::Sentence> & a_Sentences) const
+{
+	QSet<QString> seen;
+	auto newEnd = std::remove_if(a_Sentences.begin(), a_Sentences.end(),
+		[&seen](const Contact::Sentence & a_Sentence)
+		{
+			if (a_Sentence.m_Key != "tel")
+			{
+				return false;
+			}
+			auto key = PhoneNumber::key(a_Sentence);
+			if (key.isEmpty())
+			{
+				return false;
+			}
+			if (seen.contains(key))
+			{
+				return true;
+			}
+			seen.insert(key);
+			return false;
+		}
+	);
+	if (newEnd == a_Sentences.end())
+	{
+		return false;
+	}
+	a_Sentences.erase(newEnd, a_Sentences.end());
+	return true;
+}
@@ -0,0 +1,98 @@
+#ifndef SANITIZERRULES_H
+#define SANITIZERRULES_H
+
+
+
+
+
+#include "Sanitizer.h"
+
+
+
+
+
+// fwd:
+class QTextCodec;
+
+
+
+
+
+/** Removes the leading and trailing whitespace from the sentence values.
+Binary (base64-encoded) values, such as PHOTO, are left intact. */
+class SanitizerRuleTrimWhitespace:
+	public SanitizerRule
+{
+public:
+	virtual QString name() const override;
+	virtual bool apply(std::vector<Contact::Sentence> & a_Sentences) const override;
+};
+
+
+
+
+
+/** Fixes the values that are UTF-8 text mistakenly decoded as Latin-1 / Windows-1252 and re-encoded as UTF-8
+("NovÃ¡k" -> "Novák"). */
+class SanitizerRuleFixMojibake:
+	public SanitizerRule
+{
+public:
+	SanitizerRuleFixMojibake();
+
+	virtual QString name() const override;
+	virtual bool apply(std::vector<Contact::Sentence> & a_Sentences) const override;
+
+protected:
+	QTextCodec * m_Utf8;
+	QTextCodec * m_Windows1252;
+};
+
+
+
+
+
+/** Normalizes the casing of the TYPE parameter values ("TYPE=Cell" -> "TYPE=cell"), including the v2.1
+value-less type parameters ("TEL;WORK" -> "TEL;work"). */
+class SanitizerRuleNormalizeTypeCase:
+	public SanitizerRule
+{
+public:
+	virtual QString name() const override;
+	virtual bool apply(std::vector<Contact::Sentence> & a_Sentences) const override;
+};
+
+
+
+
+
+/** Adds the N sentence to contacts that only have the combined FN.
+"Jan Novák" -> N:Novák;Jan;;; and "Novák, Jan" -> N:Novák;Jan;;;
+Contacts with an ORG (or KIND:org) and no N are skipped, their FN is the organization name. */
+class SanitizerRuleSplitFnIntoN:
+	public SanitizerRule
+{
+public:
+	virtual QString name() const override;
+	virtual bool apply(std::vector<Contact::Sentence> & a_Sentences) const override;
+};
+
+
+
+
+
+/** Removes the TEL sentences whose number (compared using PhoneNumber::key()) is already present
+in an earlier TEL sentence of the same contact. */
+class SanitizerRuleRemoveDuplicateTel:
+	public SanitizerRule
+{
+public:
+	virtual QString name() const override;
+	virtual bool apply(std::vector<Contact::Sentence> & a_Sentences) const override;
+};
+
+
+
+
+
+#endif // SANITIZERRULES_H
@@ -4,6 +4,7 @@
 #include <QJsonArray>
 #include <QDebug>
 #include "Device.h"
+#include "PhoneNumber.h"
 #include "Exceptions.h"
 
 
@@ -81,6 +82,22 @@ void Session::setFileName(const QString & a_FileName)
 
 
 
+bool Session::setPhoneCountry(const QString & a_IsoCode)
+{
+	auto isoCode = a_IsoCode.isEmpty() ? PhoneNumber::systemCountry() : a_IsoCode;
+	if (!PhoneNumber::setDefaultCountry(isoCode))
+	{
+		qWarning() << "Unknown phone number country: " << a_IsoCode;
+		return false;
+	}
+	m_PhoneCountry = a_IsoCode;
+	return true;
+}
+
+
+
+
+
 std::unique_ptr<Session> Session::loadFromFile(const QString & a_FileName)
 {
 	// Read the JSON from the file:
@@ -97,8 +114,11 @@ std::unique_ptr<Session> Session::loadFromFile(const QString & a_FileName)
 		return nullptr;
 	}
 
-	// Create devices based on the JSON:
+	// Apply the phone number country before any contacts are loaded and normalized:
 	std::unique_ptr<Session> session(new Session);
+	session->setPhoneCountry(doc.object()["phoneCountry"].toString());
+
+	// Create devices based on the JSON:
 	const auto & devices = doc.object()["devices"];
 	for (const auto & device: devices.toArray())
 	{
@@ -151,6 +171,10 @@ void Session::saveToFile()
 		devices.append(dev->save());
 	}
 	json["devices"] = devices;
+	if (!m_PhoneCountry.isEmpty())
+	{
+		json["phoneCountry"] = m_PhoneCountry;
+	}
 	auto baFileData = QJsonDocument(json).toJson(QJsonDocument::Compact);
 
 	// Write the data to the file:
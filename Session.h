@@ -48,6 +48,16 @@ public:
 	/** Returns the filename where the session should be saved. */
 	const QString & fileName() const { return m_FileName; }
 
+	/** Sets the country in which the phone numbers without the international prefix are interpreted
+	(see PhoneNumber::setDefaultCountry()). The setting is stored with the session.
+	An empty string reverts to the country of the system locale.
+	Returns false (and keeps the current setting) if the country is not known. */
+	bool setPhoneCountry(const QString & a_IsoCode);
+
+	/** Returns the ISO code of the phone number country set by setPhoneCountry(), or an empty string if
+	the country of the system locale is used. */
+	const QString & phoneCountry() const { return m_PhoneCountry; }
+
 	/** Loads a session from the specified filename.
 	Doesn't start the devices.
 	Returns the loaded session, or nullptr if the loading fails. */
@@ -70,6 +80,10 @@ protected:
 	/** The filename where the session should be saved. */
 	QString m_FileName;
 
+	/** The ISO code of the country used for the phone numbers without the international prefix.
+	Empty if the country of the system locale is used. */
+	QString m_PhoneCountry;
+
 
 signals:
 
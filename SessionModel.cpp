@@ -16,6 +16,7 @@ enum
 	roleRole = Qt::UserRole + 2,  // The role for storing the item "type" (device, contactbook etc.) as a role.
 	roleDevice,
 	roleContactBook,
+	roleNumContacts,  // The number of contacts in the ContactBook, maintained from its range-based signals.
 };
 
 
@@ -183,13 +184,56 @@ void SessionModel::addContactBook(QStandardItem & a_DeviceItem, const ContactBoo
 	}
 
 	// Add the item:
-	auto itemCB = new QStandardItem(a_ContactBook.displayName());
+	auto itemCB = new QStandardItem;
 	itemCB->setData(a_DeviceItem.data(roleDevice),                          roleDevice);
 	itemCB->setData(QVariant(reinterpret_cast<qulonglong>(&a_ContactBook)), roleContactBook);
 	itemCB->setData(QVariant(roleContactBook),                              roleRole);
+	itemCB->setData(QVariant(static_cast<int>(a_ContactBook.contacts().size())), roleNumContacts);
 	a_DeviceItem.appendRow(itemCB);
+	updateContactBookItemText(*itemCB, a_ContactBook);
 
-	// TODO: Emit a signal?
+	// Keep the contact count up-to-date from the ContactBook's range-based notifications:
+	QPersistentModelIndex idx(itemCB->index());
+	auto cb = &a_ContactBook;
+	auto updateCount = [this, idx, cb](int a_Delta)
+	{
+		auto item = itemFromIndex(idx);
+		if (item == nullptr)
+		{
+			return;
+		}
+		item->setData(QVariant(item->data(roleNumContacts).toInt() + a_Delta), roleNumContacts);
+		updateContactBookItemText(*item, *cb);
+	};
+	connect(cb, &ContactBook::contactsInserted, this,
+		[updateCount](int a_First, int a_Count)
+		{
+			Q_UNUSED(a_First);
+			updateCount(a_Count);
+		}
+	);
+	connect(cb, &ContactBook::contactsRemoved, this,
+		[updateCount](int a_First, int a_Count)
+		{
+			Q_UNUSED(a_First);
+			updateCount(-a_Count);
+		}
+	);
+	connect(cb, &ContactBook::displayNameChanged, this,
+		[updateCount]()
+		{
+			updateCount(0);
+		}
+	);
+}
+
+
+
+
+
+void SessionModel::updateContactBookItemText(QStandardItem & a_Item, const ContactBook & a_ContactBook)
+{
+	a_Item.setText(tr("%1 (%2)").arg(a_ContactBook.displayName()).arg(a_Item.data(roleNumContacts).toInt()));
 }
 
 
@@ -303,12 +347,7 @@ void SessionModel::addDeviceContactBook(Device * a_Device, ContactBookPtr a_Cont
 		return;
 	}
 
-	// Add the item:
-	auto itemCB = new QStandardItem(a_ContactBook->displayName());
-	itemCB->setData(QVariant(reinterpret_cast<qulonglong>(a_Device)),            roleDevice);
-	itemCB->setData(QVariant(reinterpret_cast<qulonglong>(a_ContactBook.get())), roleContactBook);
-	itemCB->setData(QVariant(roleContactBook),                                   roleRole);
-	devItem->appendRow(itemCB);
+	addContactBook(*devItem, *a_ContactBook);
 }
 
 
@@ -339,7 +378,8 @@ void SessionModel::delDeviceContactBook(Device * a_Device, const ContactBook * a
 		qDebug() << "Attempting to del a contact book not present to the model, ignoring.";
 		return;
 	}
-	// TODO: Remove
+	disconnect(a_ContactBook, nullptr, this, nullptr);
+	devItem->removeRow(cbItem->row());
 }
 
 
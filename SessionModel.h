@@ -72,9 +72,14 @@ protected:
 	Returns nullptr if no such item exists. */
 	QStandardItem * findDeviceItem(const Device * a_Device);
 
-	/** Adds the item representing the specified ContactBook to a_DeviceItem, unless already present. */
+	/** Adds the item representing the specified ContactBook to a_DeviceItem, unless already present.
+	The item displays the number of contacts in the ContactBook, updated from its contactsInserted() and
+	contactsRemoved() notifications, so the book never needs to be rescanned. */
 	void addContactBook(QStandardItem & a_DeviceItem, const ContactBook & a_ContactBook);
 
+	/** Sets the text of the item representing the ContactBook, from its display name and contact count. */
+	void updateContactBookItemText(QStandardItem & a_Item, const ContactBook & a_ContactBook);
+
 	/** Returns the item representing the specified ContactBook.
 	Returns nullptr if no such item found.
 	a_DeviceItem is the item for the Device which contains the ContactBook. */
@@ -0,0 +1,555 @@
+#include "SessionSearchIndex.h"
+#include <algorithm>
+#include <QDebug>
+#include <QSet>
+#include <QtConcurrentMap>
+#include "Device.h"
+#include "Normalizer.h"
+#include "PhoneNumber.h"
+#include "Session.h"
+
+
+
+
+
+/** Minimum number of dead docs before compacting is considered. */
+static const size_t MIN_DEAD_DOCS_TO_COMPACT = 1024;
+
+
+
+
+
+/** Splits the (already folded) text into words of letters and digits, appending them to a_Dest. */
+static void appendWords(const QString & a_Text, std::vector<QString> & a_Dest)
+{
+	int start = -1;
+	for (int i = 0, len = a_Text.length(); i <= len; ++i)
+	{
+		bool isWordChar = (i < len) && a_Text.at(i).isLetterOrNumber();
+		if (isWordChar && (start < 0))
+		{
+			start = i;
+		}
+		else if (!isWordChar && (start >= 0))
+		{
+			a_Dest.push_back(a_Text.mid(start, i - start));
+			start = -1;
+		}
+	}
+}
+
+
+
+
+
+/** Appends the digits of the phone number (without the international "+") to a_Dest, if non-empty. */
+static void appendPhone(const QString & a_Phone, std::vector<QString> & a_Dest)
+{
+	auto digits = a_Phone.startsWith('+') ? a_Phone.mid(1) : a_Phone;
+	if (!digits.isEmpty())
+	{
+		a_Dest.push_back(digits);
+	}
+}
+
+
+
+
+
+/** Returns true if the specified sorted tokens contain a token starting with a_Prefix. */
+static bool hasTokenWithPrefix(const std::vector<QString> & a_Tokens, const QString & a_Prefix)
+{
+	auto itr = std::lower_bound(a_Tokens.begin(), a_Tokens.end(), a_Prefix);
+	return ((itr != a_Tokens.end()) && itr->startsWith(a_Prefix));
+}
+
+
+
+
+
+SessionSearchIndex::SessionSearchIndex(Session * a_Session, QObject * a_Parent):
+	Super(a_Parent),
+	m_Session(nullptr),
+	m_NumDeadDocs(0)
+{
+	setSession(a_Session);
+}
+
+
+
+
+
+void SessionSearchIndex::setSession(Session * a_Session)
+{
+	// Disconnect everything from the previous session:
+	if (m_Session != nullptr)
+	{
+		disconnect(m_Session, nullptr, this, nullptr);
+		for (const auto & dev: m_Session->getDevices())
+		{
+			disconnect(dev.get(), nullptr, this, nullptr);
+		}
+	}
+	for (const auto & b: m_Books)
+	{
+		disconnect(b.second.m_ContactBook.get(), nullptr, this, nullptr);
+	}
+	m_Books.clear();
+	m_Docs.clear();
+	m_Tokens.clear();
+	m_NumDeadDocs = 0;
+
+	m_Session = a_Session;
+	if (a_Session == nullptr)
+	{
+		return;
+	}
+	connect(m_Session, &Session::addedDevice,    this, &SessionSearchIndex::addDevice);
+	connect(m_Session, &Session::removingDevice, this, &SessionSearchIndex::removeDevice);
+
+	for (const auto & dev: a_Session->getDevices())
+	{
+		connect(dev.get(), &Device::addContactBook, this, &SessionSearchIndex::addContactBook);
+		connect(dev.get(), &Device::delContactBook, this, &SessionSearchIndex::removeContactBook);
+		for (const auto & cb: dev->contactBooks())
+		{
+			if (m_Books.find(cb.get()) != m_Books.end())
+			{
+				continue;
+			}
+			auto & book = m_Books[cb.get()];
+			book = {cb, dev.get(), {}};
+			startTrackingContactBook(book);
+		}
+	}
+}
+
+
+
+
+
+std::vector<SessionSearchIndex::Hit> SessionSearchIndex::search(const QString & a_Query, size_t a_MaxResults) const
+{
+	std::vector<Hit> res;
+	auto tokens = queryTokens(a_Query);
+	if (tokens.empty() || (a_MaxResults == 0))
+	{
+		return res;
+	}
+
+	// The longest token is expected to be the most selective one, it drives the search; the rest only verify:
+	auto driver = std::max_element(tokens.begin(), tokens.end(),
+		[](const QString & a_Token1, const QString & a_Token2)
+		{
+			return (a_Token1.length() < a_Token2.length());
+		}
+	);
+	auto driverToken = *driver;
+	tokens.erase(driver);
+
+	QSet<quint32> seen;
+	for (auto itr = m_Tokens.lower_bound(driverToken), end = m_Tokens.end(); itr != end; ++itr)
+	{
+		if (!itr->first.startsWith(driverToken))
+		{
+			break;
+		}
+		for (auto docIdx: itr->second)
+		{
+			const auto & doc = m_Docs[docIdx];
+			if (doc.m_IsDead || seen.contains(docIdx))
+			{
+				continue;
+			}
+			seen.insert(docIdx);
+			bool isMatch = std::all_of(tokens.begin(), tokens.end(),
+				[&doc](const QString & a_Token)
+				{
+					return hasTokenWithPrefix(doc.m_Tokens, a_Token);
+				}
+			);
+			if (!isMatch)
+			{
+				continue;
+			}
+			res.push_back({m_Books.at(doc.m_ContactBook).m_ContactBook, doc.m_Contact});
+			if (res.size() >= a_MaxResults)
+			{
+				return res;
+			}
+		}
+	}
+	return res;
+}
+
+
+
+
+
+std::vector<QString> SessionSearchIndex::contactTokens(const Contact & a_Contact)
+{
+	std::vector<QString> res;
+	for (const auto & s: a_Contact.sentences())
+	{
+		if ((s.m_Key == "fn") || (s.m_Key == "n") || (s.m_Key == "org") || (s.m_Key == "note"))
+		{
+			appendWords(Normalizer::foldValue(s.m_Value), res);
+		}
+		else if (s.m_Key == "tel")
+		{
+			appendPhone(Normalizer::phone(s.m_Value), res);
+			appendPhone(PhoneNumber::key(s), res);
+		}
+		else if (s.m_Key == "email")
+		{
+			auto email = Normalizer::email(s.m_Value);
+			if (!email.isEmpty())
+			{
+				res.push_back(email);
+				appendWords(Normalizer::foldText(email), res);
+			}
+		}
+	}
+	std::sort(res.begin(), res.end());
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
+}
+
+
+
+
+
+std::vector<QString> SessionSearchIndex::queryTokens(const QString & a_Query)
+{
+	std::vector<QString> res;
+
+	// A phone number query is a single token of its digits:
+	QString digits;
+	bool isPhone = true;
+	for (const auto & ch: a_Query)
+	{
+		if (ch.isDigit())
+		{
+			digits.append(ch);
+		}
+		else if (!ch.isSpace() && (ch != '+') && (ch != '-') && (ch != '(') && (ch != ')') && (ch != '/') && (ch != '.'))
+		{
+			isPhone = false;
+			break;
+		}
+	}
+	if (isPhone && !digits.isEmpty())
+	{
+		res.push_back(digits);
+		return res;
+	}
+
+	appendWords(Normalizer::foldText(a_Query), res);
+	std::sort(res.begin(), res.end());
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
+}
+
+
+
+
+
+void SessionSearchIndex::addDevice(Device * a_Device)
+{
+	connect(a_Device, &Device::addContactBook, this, &SessionSearchIndex::addContactBook);
+	connect(a_Device, &Device::delContactBook, this, &SessionSearchIndex::removeContactBook);
+	for (const auto & cb: a_Device->contactBooks())
+	{
+		addContactBook(a_Device, cb);
+	}
+}
+
+
+
+
+
+void SessionSearchIndex::removeDevice(const Device * a_Device)
+{
+	disconnect(a_Device, nullptr, this, nullptr);
+	std::vector<const ContactBook *> books;
+	for (const auto & b: m_Books)
+	{
+		if (b.second.m_Device == a_Device)
+		{
+			books.push_back(b.first);
+		}
+	}
+	for (const auto cb: books)
+	{
+		removeContactBook(a_Device, cb);
+	}
+}
+
+
+
+
+
+void SessionSearchIndex::addContactBook(Device * a_Device, ContactBookPtr a_ContactBook)
+{
+	const ContactBook * cb = a_ContactBook.get();
+	if (m_Books.find(cb) != m_Books.end())
+	{
+		// Already added (async)
+		return;
+	}
+	auto & book = m_Books[cb];
+	book = {a_ContactBook, a_Device, {}};
+	startTrackingContactBook(book);
+}
+
+
+
+
+
+void SessionSearchIndex::removeContactBook(const Device * a_Device, const ContactBook * a_ContactBook)
+{
+	Q_UNUSED(a_Device);
+
+	auto itr = m_Books.find(a_ContactBook);
+	if (itr == m_Books.end())
+	{
+		return;
+	}
+	disconnect(a_ContactBook, nullptr, this, nullptr);
+	for (auto docIdx: itr->second.m_Docs)
+	{
+		killDoc(docIdx);
+	}
+	m_Books.erase(itr);
+	compactIfNeeded();
+}
+
+
+
+
+
+void SessionSearchIndex::startTrackingContactBook(BookInfo & a_Book)
+{
+	const ContactBook * cb = a_Book.m_ContactBook.get();
+	connect(cb, &ContactBook::contactsInserted, this,
+		[this, cb](int a_First, int a_Count) { contactsInserted(cb, a_First, a_Count); }
+	);
+	connect(cb, &ContactBook::contactsRemoved, this,
+		[this, cb](int a_First, int a_Count) { contactsRemoved(cb, a_First, a_Count); }
+	);
+	connect(cb, &ContactBook::contactsChanged, this,
+		[this, cb](int a_First, int a_Count) { contactsChanged(cb, a_First, a_Count); }
+	);
+	reindexContactBook(a_Book);
+}
+
+
+
+
+
+std::vector<quint32> SessionSearchIndex::indexContacts(
+	const BookInfo & a_Book,
+	const ContactBookSnapshot & a_Snapshot,
+	size_t a_First,
+	size_t a_Count
+)
+{
+	// Tokenize in parallel:
+	std::vector<std::pair<ContactPtr, std::vector<QString>>> contacts;
+	contacts.reserve(a_Count);
+	for (size_t i = a_First; i < a_First + a_Count; ++i)
+	{
+		contacts.emplace_back(a_Snapshot.at(i), std::vector<QString>());
+	}
+	QtConcurrent::blockingMap(contacts, [](std::pair<ContactPtr, std::vector<QString>> & a_Contact)
+		{
+			a_Contact.second = contactTokens(*a_Contact.first);
+		}
+	);
+
+	// Add the docs:
+	std::vector<quint32> res;
+	res.reserve(a_Count);
+	for (auto & c: contacts)
+	{
+		auto docIdx = static_cast<quint32>(m_Docs.size());
+		for (const auto & token: c.second)
+		{
+			m_Tokens[token].push_back(docIdx);
+		}
+		m_Docs.push_back({a_Book.m_ContactBook.get(), std::move(c.first), std::move(c.second), false});
+		res.push_back(docIdx);
+	}
+	return res;
+}
+
+
+
+
+
+void SessionSearchIndex::contactsInserted(const ContactBook * a_ContactBook, int a_First, int a_Count)
+{
+	auto itr = m_Books.find(a_ContactBook);
+	if (itr == m_Books.end())
+	{
+		return;
+	}
+	auto & book = itr->second;
+	auto snapshot = a_ContactBook->snapshot();
+	auto first = static_cast<size_t>(a_First);
+	auto count = static_cast<size_t>(a_Count);
+	if ((a_First < 0) || (a_Count < 0) || (first > book.m_Docs.size()) || (book.m_Docs.size() + count > snapshot->size()))
+	{
+		qWarning() << __FUNCTION__ << ": The inserted range doesn't match the index, re-indexing " << a_ContactBook->displayName();
+		reindexContactBook(book);
+		return;
+	}
+	auto docs = indexContacts(book, *snapshot, first, count);
+	book.m_Docs.insert(book.m_Docs.begin() + a_First, docs.begin(), docs.end());
+}
+
+
+
+
+
+void SessionSearchIndex::contactsRemoved(const ContactBook * a_ContactBook, int a_First, int a_Count)
+{
+	auto itr = m_Books.find(a_ContactBook);
+	if (itr == m_Books.end())
+	{
+		return;
+	}
+	auto & book = itr->second;
+	if ((a_First < 0) || (a_Count < 0) || (static_cast<size_t>(a_First + a_Count) > book.m_Docs.size()))
+	{
+		qWarning() << __FUNCTION__ << ": The removed range doesn't match the index, re-indexing " << a_ContactBook->displayName();
+		reindexContactBook(book);
+		return;
+	}
+	auto first = book.m_Docs.begin() + a_First;
+	auto last = first + a_Count;
+	for (auto docItr = first; docItr != last; ++docItr)
+	{
+		killDoc(*docItr);
+	}
+	book.m_Docs.erase(first, last);
+	compactIfNeeded();
+}
+
+
+
+
+
+void SessionSearchIndex::contactsChanged(const ContactBook * a_ContactBook, int a_First, int a_Count)
+{
+	auto itr = m_Books.find(a_ContactBook);
+	if (itr == m_Books.end())
+	{
+		return;
+	}
+	auto & book = itr->second;
+	auto snapshot = a_ContactBook->snapshot();
+	auto last = static_cast<size_t>(a_First + a_Count);
+	if ((a_First < 0) || (a_Count < 0) || (last > book.m_Docs.size()) || (last > snapshot->size()))
+	{
+		qWarning() << __FUNCTION__ << ": The changed range doesn't match the index, re-indexing " << a_ContactBook->displayName();
+		reindexContactBook(book);
+		return;
+	}
+	for (auto i = static_cast<size_t>(a_First); i < last; ++i)
+	{
+		killDoc(book.m_Docs[i]);
+	}
+	auto docs = indexContacts(book, *snapshot, static_cast<size_t>(a_First), static_cast<size_t>(a_Count));
+	std::copy(docs.begin(), docs.end(), book.m_Docs.begin() + a_First);
+	compactIfNeeded();
+}
+
+
+
+
+
+void SessionSearchIndex::reindexContactBook(BookInfo & a_Book)
+{
+	for (auto docIdx: a_Book.m_Docs)
+	{
+		killDoc(docIdx);
+	}
+	auto snapshot = a_Book.m_ContactBook->snapshot();
+	a_Book.m_Docs = indexContacts(a_Book, *snapshot, 0, snapshot->size());
+	compactIfNeeded();
+}
+
+
+
+
+
+void SessionSearchIndex::killDoc(quint32 a_DocIdx)
+{
+	auto & doc = m_Docs[a_DocIdx];
+	if (doc.m_IsDead)
+	{
+		return;
+	}
+	doc.m_IsDead = true;
+	doc.m_Contact.reset();
+	m_NumDeadDocs += 1;
+}
+
+
+
+
+
+void SessionSearchIndex::compactIfNeeded()
+{
+	if ((m_NumDeadDocs < MIN_DEAD_DOCS_TO_COMPACT) || (m_NumDeadDocs * 2 < m_Docs.size()))
+	{
+		return;
+	}
+	qDebug() << __FUNCTION__ << ": Compacting " << m_NumDeadDocs << " dead out of " << m_Docs.size() << " docs";
+
+	// Renumber the live docs:
+	std::vector<quint32> newIdx(m_Docs.size(), 0);
+	std::vector<Doc> newDocs;
+	newDocs.reserve(m_Docs.size() - m_NumDeadDocs);
+	for (size_t i = 0; i < m_Docs.size(); ++i)
+	{
+		if (!m_Docs[i].m_IsDead)
+		{
+			newIdx[i] = static_cast<quint32>(newDocs.size());
+			newDocs.push_back(std::move(m_Docs[i]));
+		}
+	}
+
+	// Rewrite the postings, dropping the tokens that have no live docs:
+	for (auto itr = m_Tokens.begin(); itr != m_Tokens.end();)
+	{
+		auto & postings = itr->second;
+		auto newEnd = std::remove_if(postings.begin(), postings.end(),
+			[this](quint32 a_DocIdx)
+			{
+				return m_Docs[a_DocIdx].m_IsDead;
+			}
+		);
+		postings.erase(newEnd, postings.end());
+		if (postings.empty())
+		{
+			itr = m_Tokens.erase(itr);
+			continue;
+		}
+		for (auto & p: postings)
+		{
+			p = newIdx[p];
+		}
+		++itr;
+	}
+	for (auto & b: m_Books)
+	{
+		for (auto & docIdx: b.second.m_Docs)
+		{
+			docIdx = newIdx[docIdx];
+		}
+	}
+	m_Docs = std::move(newDocs);
+	m_NumDeadDocs = 0;
+}
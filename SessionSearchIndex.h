@@ -0,0 +1,167 @@
+#ifndef SESSIONSEARCHINDEX_H
+#define SESSIONSEARCHINDEX_H
+
+
+
+
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <QObject>
+
+#include "Contact.h"
+#include "ContactBook.h"
+
+
+
+
+
+// fwd:
+class Device;
+class Session;
+
+
+
+
+
+/** Full-text search over all the contacts in all the ContactBooks of a Session.
+The values of the FN, N, ORG and NOTE sentences are folded (diacritics removed, case-folded) and split into word
+tokens; TEL values are indexed by their digits (both as written and in the E.164 form), EMAIL values both as
+the whole address and as the separate words. The query tokens are matched as prefixes of the indexed tokens and
+all of them must match, so that the index can be used for as-you-type searching.
+The index keeps itself up to date by listening to the Session's, Devices' and ContactBooks' change signals;
+it mirrors the order of each book's contacts, so that the ranges reported by the ContactBook signals map directly
+to the indexed contacts, and only the contacts in those ranges are re-indexed (read from the book's snapshot).
+The contact books must therefore live in the index's thread. The tokenizing runs on the global thread pool. */
+class SessionSearchIndex:
+	public QObject
+{
+	Q_OBJECT
+
+	using Super = QObject;
+
+
+public:
+
+	/** A single search result. */
+	struct Hit
+	{
+		ContactBookPtr m_ContactBook;
+		ContactPtr m_Contact;
+	};
+
+
+	/** Creates a new instance that indexes the specified session (may be nullptr). */
+	explicit SessionSearchIndex(Session * a_Session, QObject * a_Parent = nullptr);
+
+	/** Resets the index to the contacts of the specified session (may be nullptr) and starts tracking
+	its changes. */
+	void setSession(Session * a_Session);
+
+	/** Returns up to a_MaxResults contacts matching all the words of the query.
+	Each word of the query matches any indexed token that starts with it. A query consisting only of a phone
+	number (digits and the usual separators) is treated as a single token of its digits. */
+	std::vector<Hit> search(const QString & a_Query, size_t a_MaxResults) const;
+
+	/** Returns the number of contacts currently indexed. */
+	size_t numContacts() const { return m_Docs.size() - m_NumDeadDocs; }
+
+	/** Returns the number of distinct tokens currently indexed. */
+	size_t numTokens() const { return m_Tokens.size(); }
+
+	/** Returns the sorted distinct tokens of the specified contact. */
+	static std::vector<QString> contactTokens(const Contact & a_Contact);
+
+	/** Returns the tokens of the specified query. */
+	static std::vector<QString> queryTokens(const QString & a_Query);
+
+
+protected:
+
+	/** A single indexed contact. */
+	struct Doc
+	{
+		const ContactBook * m_ContactBook;
+		ContactPtr m_Contact;
+
+		/** The sorted distinct tokens of the contact, used for verifying the candidates. */
+		std::vector<QString> m_Tokens;
+
+		/** Set when the contact has been removed or replaced; the doc is to be ignored until compacted. */
+		bool m_IsDead;
+	};
+
+	/** Per-contact-book bookkeeping. */
+	struct BookInfo
+	{
+		ContactBookPtr m_ContactBook;
+
+		/** The device that provides the contact book. */
+		const Device * m_Device;
+
+		/** The indices into m_Docs of the book's contacts, in the same order as ContactBook::contacts(). */
+		std::vector<quint32> m_Docs;
+	};
+
+
+	/** The session being indexed. */
+	Session * m_Session;
+
+	/** All the indexed contacts, including the dead ones (until compacted). */
+	std::vector<Doc> m_Docs;
+
+	/** The number of dead docs in m_Docs. */
+	size_t m_NumDeadDocs;
+
+	/** The inverted index: token -> indices into m_Docs. Sorted, so that prefixes are contiguous ranges. */
+	std::map<QString, std::vector<quint32>> m_Tokens;
+
+	/** The bookkeeping for all the indexed contact books. */
+	std::unordered_map<const ContactBook *, BookInfo> m_Books;
+
+
+	/** Starts tracking the specified device and indexes all its current contact books. */
+	void addDevice(Device * a_Device);
+
+	/** Stops tracking the specified device and removes all its contact books from the index. */
+	void removeDevice(const Device * a_Device);
+
+	/** Starts tracking the specified contact book and indexes its contacts. */
+	void addContactBook(Device * a_Device, ContactBookPtr a_ContactBook);
+
+	/** Stops tracking the specified contact book and removes its contacts from the index. */
+	void removeContactBook(const Device * a_Device, const ContactBook * a_ContactBook);
+
+	/** Starts tracking the specified contact book's changes and indexes all its current contacts. */
+	void startTrackingContactBook(BookInfo & a_Book);
+
+	/** Tokenizes the a_Count contacts of the snapshot starting at a_First (in parallel) and adds them as new docs.
+	Returns the indices of the new docs, in the order of the contacts. */
+	std::vector<quint32> indexContacts(const BookInfo & a_Book, const ContactBookSnapshot & a_Snapshot, size_t a_First, size_t a_Count);
+
+	/** Indexes the contacts inserted into the book (ContactBook::contactsInserted()). */
+	void contactsInserted(const ContactBook * a_ContactBook, int a_First, int a_Count);
+
+	/** Removes the contacts removed from the book (ContactBook::contactsRemoved()). */
+	void contactsRemoved(const ContactBook * a_ContactBook, int a_First, int a_Count);
+
+	/** Re-indexes the contacts replaced in the book (ContactBook::contactsChanged()). */
+	void contactsChanged(const ContactBook * a_ContactBook, int a_First, int a_Count);
+
+	/** Drops all the docs of the book and indexes all its current contacts again.
+	Used for the initial indexing and when the change notifications don't match the indexed contacts. */
+	void reindexContactBook(BookInfo & a_Book);
+
+	/** Marks the specified doc as dead. */
+	void killDoc(quint32 a_DocIdx);
+
+	/** Rebuilds m_Docs and m_Tokens without the dead docs, if there are enough of them. */
+	void compactIfNeeded();
+};
+
+
+
+
+
+#endif // SESSIONSEARCHINDEX_H
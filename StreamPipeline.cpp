@@ -0,0 +1,297 @@
+#include "StreamPipeline.h"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <QBuffer>
+#include <QDebug>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrentRun>
+#include "Exceptions.h"
+#include "VCardParser.h"
+#include "VCardSerializer.h"
+
+
+
+
+
+namespace
+{
+
+/** The state shared by the reader, the workers and the writer during a single StreamPipeline::run(). */
+struct PipelineState
+{
+	/** Protects all the members below, except m_FreeSlots. */
+	QMutex m_Mutex;
+
+	/** Signalled when a contact is added to m_Input or the reader finishes. */
+	QWaitCondition m_HasInput;
+
+	/** Signalled when a result is added to m_Output or the reader finishes. */
+	QWaitCondition m_HasOutput;
+
+	/** The parsed contacts waiting for a worker, with their sequence numbers. */
+	std::deque<std::pair<quint64, ContactPtr>> m_Input;
+
+	/** The serialized results waiting for the writer, by sequence number. Empty data means a dropped contact. */
+	std::map<quint64, QByteArray> m_Output;
+
+	/** Set by the reader once it has read all the source data. */
+	bool m_IsReaderDone;
+
+	/** The number of contacts read (the sequence number of the next contact). */
+	quint64 m_NumRead;
+
+	/** The number of parse errors. */
+	quint64 m_NumErrors;
+
+	/** Limits the number of contacts in flight: the reader takes a slot per contact, the writer returns it. */
+	QSemaphore m_FreeSlots;
+
+
+	explicit PipelineState(int a_NumSlots):
+		m_IsReaderDone(false),
+		m_NumRead(0),
+		m_NumErrors(0),
+		m_FreeSlots(a_NumSlots)
+	{
+	}
+};
+
+}  // anonymous namespace
+
+
+
+
+
+/** Skips the source data up to the next "BEGIN:VCARD" line, which is left unread.
+Used after a parse error, so that the rest of the erroneous contact is not parsed as further (erroneous) contacts.
+Returns the number of lines skipped. */
+static int skipToNextContact(QIODevice & a_Source)
+{
+	static const QByteArray BEGIN_VCARD("begin:vcard");
+	int res = 0;
+	while (!a_Source.atEnd())
+	{
+		auto start = a_Source.peek(BEGIN_VCARD.size() + 2).toLower();
+		if (start.startsWith(BEGIN_VCARD))
+		{
+			auto rest = start.mid(BEGIN_VCARD.size());
+			if (rest.isEmpty() || rest.startsWith('\r') || rest.startsWith('\n'))
+			{
+				return res;
+			}
+		}
+		a_Source.readLine();
+		res += 1;
+	}
+	return res;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// StreamPipeline::Stats:
+
+StreamPipeline::Stats::Stats():
+	m_NumRead(0),
+	m_NumWritten(0),
+	m_NumDropped(0),
+	m_NumErrors(0)
+{
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// StreamPipeline:
+
+StreamPipeline::StreamPipeline():
+	m_NumWorkers(QThread::idealThreadCount()),
+	m_QueueCapacity(0)
+{
+}
+
+
+
+
+
+void StreamPipeline::addStage(StreamStagePtr a_Stage)
+{
+	m_Stages.push_back(std::move(a_Stage));
+}
+
+
+
+
+
+void StreamPipeline::setNumWorkers(int a_NumWorkers)
+{
+	m_NumWorkers = std::max(a_NumWorkers, 1);
+}
+
+
+
+
+
+StreamPipeline::Stats StreamPipeline::run(QIODevice & a_Source, QIODevice & a_Dest) const
+{
+	auto numWorkers = std::max(m_NumWorkers, 1);
+	PipelineState state((m_QueueCapacity > 0) ? m_QueueCapacity : numWorkers * 4);
+	QThreadPool pool;
+	pool.setMaxThreadCount(numWorkers + 1);
+
+	// The reader:
+	QtConcurrent::run(&pool, [&state, &a_Source]()
+		{
+			quint64 seq = 0;
+			int lineNum = 0;
+			for (;;)
+			{
+				state.m_FreeSlots.acquire();
+				if (a_Source.atEnd())
+				{
+					state.m_FreeSlots.release();
+					break;
+				}
+				auto contact = std::make_shared<Contact>();
+				try
+				{
+					lineNum = VCardParser::parse(a_Source, contact, lineNum);
+				}
+				catch (const EException &)
+				{
+					// Skip the rest of the erroneous contact, so that it counts as a single error:
+					lineNum += skipToNextContact(a_Source);
+					QMutexLocker lock(&state.m_Mutex);
+					state.m_NumErrors += 1;
+					state.m_FreeSlots.release();
+					continue;
+				}
+				if (contact->sentences().empty())
+				{
+					// Trailing whitespace after the last contact
+					state.m_FreeSlots.release();
+					continue;
+				}
+				QMutexLocker lock(&state.m_Mutex);
+				state.m_Input.emplace_back(seq, std::move(contact));
+				seq += 1;
+				state.m_HasInput.wakeOne();
+			}
+			QMutexLocker lock(&state.m_Mutex);
+			state.m_NumRead = seq;
+			state.m_IsReaderDone = true;
+			state.m_HasInput.wakeAll();
+			state.m_HasOutput.wakeAll();
+		}
+	);
+
+	// The workers:
+	const auto & stages = m_Stages;
+	for (int i = 0; i < numWorkers; ++i)
+	{
+		QtConcurrent::run(&pool, [&state, &stages]()
+			{
+				for (;;)
+				{
+					std::pair<quint64, ContactPtr> item;
+					{
+						QMutexLocker lock(&state.m_Mutex);
+						while (state.m_Input.empty() && !state.m_IsReaderDone)
+						{
+							state.m_HasInput.wait(&state.m_Mutex);
+						}
+						if (state.m_Input.empty())
+						{
+							return;
+						}
+						item = std::move(state.m_Input.front());
+						state.m_Input.pop_front();
+					}
+
+					// Any failure drops the contact; the writer still needs a result for each sequence number:
+					QByteArray data;
+					try
+					{
+						bool shouldKeep = true;
+						for (const auto & stage: stages)
+						{
+							if (!stage->process(*item.second))
+							{
+								shouldKeep = false;
+								break;
+							}
+						}
+						if (shouldKeep)
+						{
+							QBuffer buf(&data);
+							buf.open(QIODevice::WriteOnly);
+							VCardSerializer::serialize(*item.second, buf);
+						}
+					}
+					catch (const std::exception & exc)
+					{
+						qWarning() << "StreamPipeline: Dropping contact #" << item.first << ", failed to process: " << exc.what();
+						data.clear();
+					}
+					item.second.reset();
+
+					QMutexLocker lock(&state.m_Mutex);
+					state.m_Output[item.first] = std::move(data);
+					state.m_HasOutput.wakeOne();
+				}
+			}
+		);
+	}
+
+	// The writer, in the original order:
+	Stats res;
+	bool hasWriteFailed = false;
+	for (quint64 next = 0;; ++next)
+	{
+		QByteArray data;
+		{
+			QMutexLocker lock(&state.m_Mutex);
+			auto itr = state.m_Output.find(next);
+			while ((itr == state.m_Output.end()) && !(state.m_IsReaderDone && (next >= state.m_NumRead)))
+			{
+				state.m_HasOutput.wait(&state.m_Mutex);
+				itr = state.m_Output.find(next);
+			}
+			if (itr == state.m_Output.end())
+			{
+				// All contacts have been written
+				res.m_NumRead = state.m_NumRead;
+				res.m_NumErrors = state.m_NumErrors;
+				break;
+			}
+			data = std::move(itr->second);
+			state.m_Output.erase(itr);
+		}
+		if (data.isEmpty())
+		{
+			res.m_NumDropped += 1;
+		}
+		else
+		{
+			if ((a_Dest.write(data) != data.size()) && !hasWriteFailed)
+			{
+				// Keep consuming the data, so that the reader and the workers can finish
+				qWarning() << __FUNCTION__ << ": Failed to write to the destination: " << a_Dest.errorString();
+				hasWriteFailed = true;
+			}
+			res.m_NumWritten += 1;
+		}
+		state.m_FreeSlots.release();
+	}
+	pool.waitForDone();
+	return res;
+}
@@ -0,0 +1,107 @@
+#ifndef STREAMPIPELINE_H
+#define STREAMPIPELINE_H
+
+
+
+
+
+#include <memory>
+#include <vector>
+
+#include "Contact.h"
+
+
+
+
+
+// fwd:
+class QIODevice;
+
+
+
+
+
+/** A single transformation stage of the StreamPipeline.
+The stages are shared by all the worker threads, so process() must be thread-safe (typically stateless). */
+class StreamStage
+{
+public:
+
+	// Force a virtual destructor in descendants:
+	virtual ~StreamStage() {}
+
+	/** Transforms the contact in-place.
+	Returns false if the contact is to be dropped from the output (filtered out), true to keep it. */
+	virtual bool process(Contact & a_Contact) const = 0;
+};
+
+using StreamStagePtr = std::shared_ptr<StreamStage>;
+
+
+
+
+
+/** Transforms vCard data from a source to a destination device contact-by-contact, without ever holding the
+whole data in memory.
+A reader thread parses the contacts from the source one at a time, a pool of worker threads passes each contact
+through all the stages and serializes it, and the calling thread writes the results to the destination in the
+original order. The number of contacts in flight (read but not yet written) is bounded by the queue capacity,
+the reader blocks when it is reached, so the memory use doesn't depend on the size of the data. */
+class StreamPipeline
+{
+public:
+
+	/** The counters reported by run(). */
+	struct Stats
+	{
+		/** Number of contacts parsed from the source. */
+		quint64 m_NumRead;
+
+		/** Number of contacts written to the destination. */
+		quint64 m_NumWritten;
+
+		/** Number of contacts dropped by the stages, including those whose processing threw an exception. */
+		quint64 m_NumDropped;
+
+		/** Number of contacts that failed to parse (the rest of each is skipped, up to the next BEGIN:VCARD). */
+		quint64 m_NumErrors;
+
+		Stats();
+	};
+
+
+	/** Creates a new pipeline with no stages, using QThread::idealThreadCount() workers. */
+	StreamPipeline();
+
+	/** Appends a stage to the end of the pipeline. */
+	void addStage(StreamStagePtr a_Stage);
+
+	/** Sets the number of the worker threads. */
+	void setNumWorkers(int a_NumWorkers);
+
+	/** Sets the maximum number of contacts in flight. The default is four times the number of workers. */
+	void setQueueCapacity(int a_QueueCapacity) { m_QueueCapacity = a_QueueCapacity; }
+
+	/** Reads all the contacts from a_Source, transforms them through the stages and writes them into a_Dest.
+	a_Source is only accessed from the reader thread and a_Dest only from the calling thread.
+	Blocks until all the data is processed. */
+	Stats run(QIODevice & a_Source, QIODevice & a_Dest) const;
+
+
+protected:
+
+	/** The transformation stages, in the order of their application. */
+	std::vector<StreamStagePtr> m_Stages;
+
+	/** The number of the worker threads. */
+	int m_NumWorkers;
+
+	/** The maximum number of contacts in flight; 0 means four times m_NumWorkers. */
+	int m_QueueCapacity;
+};
+
+
+
+
+
+#endif // STREAMPIPELINE_H
@@ -0,0 +1,178 @@
+#include "StreamStages.h"
+#include <algorithm>
+#include <QTextCodec>
+#include "Sanitizer.h"
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// StreamStageSanitize:
+
+StreamStageSanitize::StreamStageSanitize(std::shared_ptr<const Sanitizer> a_Sanitizer):
+	m_Sanitizer(std::move(a_Sanitizer))
+{
+}
+
+
+
+
+
+bool StreamStageSanitize::process(Contact & a_Contact) const
+{
+	auto sentences = a_Contact.sentences();
+	bool hasChanged = false;
+	for (const auto & rule: m_Sanitizer->rules())
+	{
+		hasChanged = rule->apply(sentences) || hasChanged;
+	}
+	if (hasChanged)
+	{
+		a_Contact.setSentences(std::move(sentences));
+	}
+	return true;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// StreamStageFilter:
+
+StreamStageFilter::StreamStageFilter(Predicate a_Predicate):
+	m_Predicate(std::move(a_Predicate))
+{
+}
+
+
+
+
+
+bool StreamStageFilter::process(Contact & a_Contact) const
+{
+	return m_Predicate(a_Contact);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// StreamStageAnonymize:
+
+bool StreamStageAnonymize::process(Contact & a_Contact) const
+{
+	auto sentences = a_Contact.sentences();
+	for (auto & s: sentences)
+	{
+		s.m_Params.erase(
+			std::remove_if(s.m_Params.begin(), s.m_Params.end(),
+				[](const Contact::SentenceParam & a_Param)
+				{
+					return (a_Param.m_Name == "sort-as");
+				}
+			),
+			s.m_Params.end()
+		);
+		s.m_NormalizedValue.clear();
+		if (s.isBinary())
+		{
+			s.m_Value.clear();
+			continue;
+		}
+		auto value = QString::fromUtf8(s.m_Value);
+		for (auto & ch: value)
+		{
+			if (ch.isLetter())
+			{
+				ch = ch.isUpper() ? 'X' : 'x';
+			}
+			else if (ch.isDigit())
+			{
+				ch = '5';
+			}
+		}
+		s.m_Value = value.toUtf8();
+	}
+	a_Contact.setSentences(std::move(sentences));
+	return true;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// StreamStageConvertToV3:
+
+bool StreamStageConvertToV3::process(Contact & a_Contact) const
+{
+	auto sentences = a_Contact.sentences();
+	bool hasChanged = false;
+	for (auto & s: sentences)
+	{
+		std::vector<QByteArray> types;
+		Contact::SentenceParams params;
+		for (auto & p: s.m_Params)
+		{
+			if (p.m_Values.empty())
+			{
+				auto lcName = p.m_Name.toLower();
+				if ((lcName == "base64") || (lcName == "quoted-printable") || (lcName == "8bit") || (lcName == "7bit"))
+				{
+					// Value-less encoding, not a type; leave as-is
+					params.push_back(std::move(p));
+					continue;
+				}
+				types.push_back(lcName);
+				hasChanged = true;
+				continue;
+			}
+			if (p.m_Name == "charset")
+			{
+				auto codec = QTextCodec::codecForName(p.m_Values[0]);
+				if (codec != nullptr)
+				{
+					s.m_Value = codec->toUnicode(s.m_Value).toUtf8();
+					hasChanged = true;
+					continue;
+				}
+			}
+			if (p.m_Name == "encoding")
+			{
+				for (auto & v: p.m_Values)
+				{
+					if (v.toLower() == "base64")
+					{
+						v = "b";
+						hasChanged = true;
+					}
+				}
+			}
+			params.push_back(std::move(p));
+		}
+		if (!types.empty())
+		{
+			auto itr = std::find_if(params.begin(), params.end(),
+				[](const Contact::SentenceParam & a_Param)
+				{
+					return (a_Param.m_Name == "type");
+				}
+			);
+			if (itr == params.end())
+			{
+				params.emplace_back(QByteArray("type"));
+				itr = params.end() - 1;
+			}
+			itr->m_Values.insert(itr->m_Values.end(), types.begin(), types.end());
+		}
+		s.m_Params = std::move(params);
+	}
+	if (hasChanged)
+	{
+		a_Contact.setSentences(std::move(sentences));
+	}
+	return true;
+}
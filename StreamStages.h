@@ -0,0 +1,88 @@
+#ifndef STREAMSTAGES_H
+#define STREAMSTAGES_H
+
+
+
+
+
+#include <functional>
+
+#include "StreamPipeline.h"
+
+
+
+
+
+// fwd:
+class Sanitizer;
+
+
+
+
+
+/** Applies all the rules of a Sanitizer to each contact. */
+class StreamStageSanitize:
+	public StreamStage
+{
+public:
+	explicit StreamStageSanitize(std::shared_ptr<const Sanitizer> a_Sanitizer);
+
+	virtual bool process(Contact & a_Contact) const override;
+
+protected:
+	std::shared_ptr<const Sanitizer> m_Sanitizer;
+};
+
+
+
+
+
+/** Keeps only the contacts for which the predicate returns true.
+The predicate is called from multiple worker threads at once. */
+class StreamStageFilter:
+	public StreamStage
+{
+public:
+	using Predicate = std::function<bool(const Contact &)>;
+
+	explicit StreamStageFilter(Predicate a_Predicate);
+
+	virtual bool process(Contact & a_Contact) const override;
+
+protected:
+	Predicate m_Predicate;
+};
+
+
+
+
+
+/** Removes all the personal data from the contacts, keeping only their structure (the same as VcfAnonymizer.lua,
+but preserving the shape of the values): letters are replaced with "x" / "X", digits with "5", binary values
+(PHOTO etc.) are emptied and the SORT-AS parameters are removed. */
+class StreamStageAnonymize:
+	public StreamStage
+{
+public:
+	virtual bool process(Contact & a_Contact) const override;
+};
+
+
+
+
+
+/** Converts the vCard 2.1 constructs into their vCard 3.0 forms, matching the VERSION:3.0 written by the
+VCardSerializer: value-less parameters ("TEL;WORK;CELL") are merged into a TYPE parameter, the values with
+a CHARSET parameter are transcoded into UTF-8 and the ENCODING=BASE64 is changed to ENCODING=b. */
+class StreamStageConvertToV3:
+	public StreamStage
+{
+public:
+	virtual bool process(Contact & a_Contact) const override;
+};
+
+
+
+
+
+#endif // STREAMSTAGES_H
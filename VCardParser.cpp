@@ -574,6 +574,9 @@ protected:
 
 void VCardParser::parse(QIODevice & a_Source, ContactBookPtr a_Dest)
 {
+	// Report all the parsed contacts in a single notification:
+	ContactBook::Batch batch(*a_Dest);
+
 	int lineNum = 0;
 	while (!a_Source.atEnd())
 	{
@@ -24,7 +24,8 @@ public:
 	/** Parses the vCard data from a_Source into the destination contact book a_Dest.
 	Throws an EException descendant on error. Note that in such a case a_Dest may contain contacts / data
 	that parsed successfully before the error was encountered.
-	Reads the entire a_Source until there's no more data to read. */
+	Reads the entire a_Source until there's no more data to read.
+	All the parsed contacts are reported by a_Dest in a single batch of change notifications. */
 	static void parse(QIODevice & a_Source, ContactBookPtr a_Dest);
 
 	/** Parses the vCard data from a_Source into the destination contact a_Dest.
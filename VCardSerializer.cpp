@@ -0,0 +1,168 @@
+#include "VCardSerializer.h"
+#include <QIODevice>
+#include "ContactBookSnapshot.h"
+
+
+
+
+
+/** The maximum length of a single physical line, in octets, excluding the CRLF. */
+static const int MAX_LINE_LENGTH = 75;
+
+
+
+
+
+/** Writes the specified logical line into a_Dest, folding it at MAX_LINE_LENGTH octets.
+Never breaks the line inside a multibyte UTF-8 sequence. */
+static void writeFolded(const QByteArray & a_Line, QIODevice & a_Dest)
+{
+	auto len = a_Line.length();
+	int start = 0;
+	int maxLen = MAX_LINE_LENGTH;
+	while (len - start > maxLen)
+	{
+		auto end = start + maxLen;
+		while ((end > start + 1) && ((static_cast<unsigned char>(a_Line.at(end)) & 0xc0) == 0x80))
+		{
+			--end;  // Don't split a UTF-8 sequence
+		}
+		a_Dest.write(a_Line.constData() + start, end - start);
+		a_Dest.write("\r\n ", 3);
+		start = end;
+		maxLen = MAX_LINE_LENGTH - 1;  // The continuation lines start with a space
+	}
+	a_Dest.write(a_Line.constData() + start, len - start);
+	a_Dest.write("\r\n", 2);
+}
+
+
+
+
+
+/** Returns true if the parameter value needs to be enclosed in double quotes. */
+static bool needsQuoting(const QByteArray & a_ParamValue)
+{
+	for (auto ch: a_ParamValue)
+	{
+		if ((ch == ':') || (ch == ';') || (ch == ','))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+void VCardSerializer::serialize(const Contact & a_Contact, QIODevice & a_Dest)
+{
+	a_Dest.write("BEGIN:VCARD\r\nVERSION:3.0\r\n");
+	for (const auto & s: a_Contact.sentences())
+	{
+		writeFolded(serializeSentence(s), a_Dest);
+	}
+	a_Dest.write("END:VCARD\r\n");
+}
+
+
+
+
+
+void VCardSerializer::serialize(const ContactBookSnapshot & a_Snapshot, QIODevice & a_Dest)
+{
+	a_Snapshot.forEach([&a_Dest](const ContactPtr & a_Contact)
+		{
+			serialize(*a_Contact, a_Dest);
+		}
+	);
+}
+
+
+
+
+
+QByteArray VCardSerializer::serializeSentence(const Contact::Sentence & a_Sentence)
+{
+	QByteArray res;
+	if (!a_Sentence.m_Group.isEmpty())
+	{
+		res.append(a_Sentence.m_Group).append('.');
+	}
+	res.append(a_Sentence.m_Key.toUpper());
+	bool isBase64 = false;
+	for (const auto & p: a_Sentence.m_Params)
+	{
+		if (p.m_Name == "encoding")
+		{
+			// The parser has decoded the value; re-encode in base64, drop the quoted-printable encoding:
+			for (const auto & v: p.m_Values)
+			{
+				auto lcv = v.toLower();
+				isBase64 = isBase64 || (lcv == "b") || (lcv == "base64");
+			}
+			if (!isBase64)
+			{
+				continue;
+			}
+		}
+		res.append(';').append(p.m_Name.toUpper());
+		if (p.m_Values.empty())
+		{
+			continue;  // v2.1 value-less parameter ("TEL;CELL:...")
+		}
+		res.append('=');
+		bool isFirst = true;
+		for (const auto & v: p.m_Values)
+		{
+			if (!isFirst)
+			{
+				res.append(',');
+			}
+			isFirst = false;
+			if (needsQuoting(v))
+			{
+				res.append('"').append(v).append('"');
+			}
+			else
+			{
+				res.append(v);
+			}
+		}
+	}
+	res.append(':');
+	if (isBase64)
+	{
+		res.append(a_Sentence.m_Value.toBase64());
+	}
+	else
+	{
+		res.append(a_Sentence.m_Value);
+	}
+	return res;
+}
+
+
+
+
+
+QByteArray VCardSerializer::escapeBackslashes(const QByteArray & a_Value)
+{
+	QByteArray res;
+	res.reserve(a_Value.size() + a_Value.size() / 8);
+	for (auto ch: a_Value)
+	{
+		switch (ch)
+		{
+			case '\\': res.append("\\\\"); break;
+			case ';':  res.append("\\;");  break;
+			case ',':  res.append("\\,");  break;
+			case '\n': res.append("\\n");  break;
+			case '\r': break;
+			default:   res.append(ch);     break;
+		}
+	}
+	return res;
+}
@@ -0,0 +1,46 @@
+#ifndef VCARDSERIALIZER_H
+#define VCARDSERIALIZER_H
+
+
+
+
+
+#include "Contact.h"
+
+
+
+
+
+// fwd:
+class QIODevice;
+class ContactBookSnapshot;
+
+
+
+
+
+/** Writes contacts in the vCard format; the counterpart of VCardParser. */
+class VCardSerializer
+{
+public:
+
+	/** Writes the specified contact as a single vCard (BEGIN:VCARD ... END:VCARD) into a_Dest.
+	The lines are folded at 75 octets and terminated with CRLF, as required by the RFC. */
+	static void serialize(const Contact & a_Contact, QIODevice & a_Dest);
+
+	/** Writes all the contacts in the specified snapshot into a_Dest. */
+	static void serialize(const ContactBookSnapshot & a_Snapshot, QIODevice & a_Dest);
+
+	/** Returns the single (unfolded, unterminated) line representing the specified sentence.
+	The value's encoding, as specified in its ENCODING parameter, is re-applied (the parser decodes it). */
+	static QByteArray serializeSentence(const Contact::Sentence & a_Sentence);
+
+	/** Returns the value with the backslash escaping applied; the inverse of VCardParser::unescapeBackslashes(). */
+	static QByteArray escapeBackslashes(const QByteArray & a_Value);
+};
+
+
+
+
+
+#endif // VCARDSERIALIZER_H
@@ -0,0 +1,77 @@
+#-------------------------------------------------
+#
+# Headless command-line batch mode, without the widget modules
+#
+#-------------------------------------------------
+
+QT       += core xml network concurrent
+
+QT       -= gui
+
+TARGET = ContactBookSanitizerCli
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which as been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+SOURCES +=\
+	main.cpp \
+	../Session.cpp \
+	../ContactBook.cpp \
+	../ContactBookIndex.cpp \
+	../Device.cpp \
+	../ExampleDevice.cpp \
+	../DeviceVcfFile.cpp \
+	../DeviceCardDav.cpp \
+	../DeviceBackup.cpp \
+	../DavPropertyTree.cpp \
+	../DavRequestMetrics.cpp \
+	../DavPropertyHandlers.cpp \
+	../PollScheduler.cpp \
+	../VCardParser.cpp \
+	../VCardSerializer.cpp \
+	../Contact.cpp \
+	../Normalizer.cpp \
+	../ContactBookSnapshot.cpp \
+	../DuplicateFinder.cpp \
+	../ContactBookDiff.cpp \
+	../PhoneNumber.cpp \
+	../Sanitizer.cpp \
+	../SanitizerRules.cpp \
+	../StreamPipeline.cpp \
+	../StreamStages.cpp
+
+HEADERS +=\
+	../Session.h \
+	../ContactBook.h \
+	../ContactBookIndex.h \
+	../Device.h \
+	../ExampleDevice.h \
+	../DeviceVcfFile.h \
+	../DeviceCardDav.h \
+	../DeviceBackup.h \
+	../DavPropertyTree.h \
+	../DavRequestMetrics.h \
+	../DavPropertyHandlers.h \
+	../PollScheduler.h \
+	../VCardParser.h \
+	../VCardSerializer.h \
+	../Exceptions.h \
+	../Contact.h \
+	../Normalizer.h \
+	../ContactBookSnapshot.h \
+	../DuplicateFinder.h \
+	../ContactBookDiff.h \
+	../PhoneNumber.h \
+	../Sanitizer.h \
+	../SanitizerRules.h \
+	../StreamPipeline.h \
+	../StreamStages.h
@@ -0,0 +1,619 @@
+// main.cpp
+
+// Implements the headless command-line batch mode: parses, sanitizes, deduplicates and exports contacts
+// from VCF files or device configs, without any GUI.
+
+#include <algorithm>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrentMap>
+#include "../ContactBook.h"
+#include "../ContactBookDiff.h"
+#include "../Device.h"
+#include "../DuplicateFinder.h"
+#include "../Exceptions.h"
+#include "../PhoneNumber.h"
+#include "../Sanitizer.h"
+#include "../StreamPipeline.h"
+#include "../StreamStages.h"
+#include "../VCardParser.h"
+#include "../VCardSerializer.h"
+
+
+
+
+
+/** A single input to be processed: either a VCF file, or a contact book provided by a device. */
+struct Input
+{
+	/** The name under which the input is reported (the file name or the device / book display name). */
+	QString m_Name;
+
+	/** The VCF file to parse; empty for inputs coming from a device. */
+	QString m_FileName;
+
+	/** The path of the exported file, relative to the export folder and without the extension.
+	Made of sanitized components only, and unique among all the inputs (see makeExportNamesUnique()). */
+	QString m_ExportName;
+
+	/** The contact book into which the input is parsed (or the device's book). */
+	ContactBookPtr m_ContactBook;
+
+	/** Size of the input file, in bytes. */
+	qint64 m_NumBytes;
+
+	/** Number of contacts changed by the sanitizer. */
+	size_t m_NumSanitized;
+
+	/** Number of contacts written by the streaming pipeline (the streamed inputs have no contact book). */
+	quint64 m_NumStreamed;
+
+	/** The error that stopped the processing of this input, empty if none. */
+	QString m_Error;
+};
+
+
+
+
+
+/** The settings for processing the inputs, as given on the command line. */
+struct Settings
+{
+	bool m_ShouldSanitize;
+	bool m_IsDryRun;
+	bool m_ShouldDedup;
+	bool m_ShouldDiff;
+
+	/** If set, the files are transformed by the StreamPipeline, without loading them into a ContactBook. */
+	bool m_ShouldStream;
+	bool m_ShouldAnonymize;
+
+	/** The folder into which the processed inputs are exported; empty if not exporting. */
+	QString m_ExportFolder;
+};
+
+
+
+
+
+/** Returns the name with the characters that have a special meaning in paths (separators, wildcards,
+control characters, leading dots) replaced by underscores, so that it is safe as a single path component. */
+static QString safeFileName(const QString & a_Name)
+{
+	static const QString SPECIAL_CHARS("/\\:*?\"<>|");
+	QString res;
+	res.reserve(a_Name.size());
+	for (const auto & ch: a_Name)
+	{
+		if ((ch < QChar(' ')) || SPECIAL_CHARS.contains(ch))
+		{
+			res.append('_');
+		}
+		else
+		{
+			res.append(ch);
+		}
+	}
+	for (int i = 0; (i < res.size()) && (res[i] == '.'); ++i)
+	{
+		res[i] = '_';
+	}
+	if (res.isEmpty())
+	{
+		res = QString::fromUtf8("_");
+	}
+	return res;
+}
+
+
+
+
+
+/** Adds the specified VCF file, or all the VCF files in the specified folder (recursively), to a_Inputs.
+The files in a folder are exported under their path relative to that folder, so that the same file names
+in different subfolders don't overwrite each other. */
+static void addFileInputs(const QString & a_Path, std::vector<Input> & a_Inputs)
+{
+	QFileInfo fi(a_Path);
+	if (!fi.isDir())
+	{
+		a_Inputs.push_back({a_Path, a_Path, safeFileName(fi.completeBaseName()), nullptr, fi.size(), 0, 0, QString()});
+		return;
+	}
+	QDir root(a_Path);
+	QDirIterator itr(a_Path, {"*.vcf", "*.VCF"}, QDir::Files, QDirIterator::Subdirectories);
+	while (itr.hasNext())
+	{
+		auto fileName = itr.next();
+		QStringList exportName;
+		for (const auto & folder: QFileInfo(root.relativeFilePath(fileName)).path().split('/', QString::SkipEmptyParts))
+		{
+			if (folder != ".")
+			{
+				exportName.append(safeFileName(folder));
+			}
+		}
+		exportName.append(safeFileName(itr.fileInfo().completeBaseName()));
+		a_Inputs.push_back({fileName, fileName, exportName.join('/'), nullptr, itr.fileInfo().size(), 0, 0, QString()});
+	}
+}
+
+
+
+
+
+/** Loads the device from the specified JSON config file, starts it and waits up to a_WaitMSec for it to
+provide its contact books (for devices that load asynchronously, such as CardDAV).
+The device's contact books are added to a_Inputs. Returns the device, or nullptr on failure. */
+static std::unique_ptr<Device> loadDevice(const QString & a_ConfigFileName, int a_WaitMSec, std::vector<Input> & a_Inputs)
+{
+	QFile f(a_ConfigFileName);
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		qWarning() << "Cannot open device config " << a_ConfigFileName;
+		return nullptr;
+	}
+	auto dev = Device::createFromConfig(QJsonDocument::fromJson(f.readAll()).object());
+	if (dev == nullptr)
+	{
+		return nullptr;
+	}
+	dev->start();
+	if (a_WaitMSec > 0)
+	{
+		QEventLoop loop;
+		QTimer::singleShot(a_WaitMSec, &loop, &QEventLoop::quit);
+		loop.exec();
+	}
+	for (const auto & cb: dev->contactBooks())
+	{
+		auto name = QString::fromUtf8("%1 / %2").arg(dev->displayName()).arg(cb->displayName());
+		auto exportName = safeFileName(dev->displayName()) + '/' + safeFileName(cb->displayName());
+		a_Inputs.push_back({name, QString(), exportName, cb, 0, 0, 0, QString()});
+	}
+	return dev;
+}
+
+
+
+
+
+/** Appends " (2)", " (3)" etc. to the export names that are already used by a previous input, so that no two
+inputs are exported into the same file. The names are compared case-insensitively, as some filesystems do. */
+static void makeExportNamesUnique(std::vector<Input> & a_Inputs)
+{
+	QSet<QString> used;
+	for (auto & in: a_Inputs)
+	{
+		auto name = in.m_ExportName;
+		for (int n = 2; used.contains(name.toLower()); ++n)
+		{
+			name = QString::fromUtf8("%1 (%2)").arg(in.m_ExportName).arg(n);
+		}
+		used.insert(name.toLower());
+		in.m_ExportName = name;
+	}
+}
+
+
+
+
+
+/** Returns the full name of the file into which the input is exported, creating its folder, if needed. */
+static QString exportFileName(const Input & a_Input, const Settings & a_Settings)
+{
+	auto res = QDir(a_Settings.m_ExportFolder).filePath(a_Input.m_ExportName + ".vcf");
+	QDir().mkpath(QFileInfo(res).path());
+	return res;
+}
+
+
+
+
+
+/** Writes the changes made to the devices' contact books back to their data sources, then processes the events
+until all the online devices have finished writing, or a_WaitMSec elapses.
+Returns the devices that haven't finished writing their changes. */
+static std::vector<const Device *> pushDeviceChanges(const std::vector<std::unique_ptr<Device>> & a_Devices, int a_WaitMSec)
+{
+	for (const auto & dev: a_Devices)
+	{
+		dev->pushChanges();
+	}
+
+	// The deadline timer makes sure that the blocking processEvents() wakes up even with no network activity:
+	QTimer deadline;
+	deadline.setSingleShot(true);
+	deadline.start(a_WaitMSec);
+	auto isPushing = [&a_Devices]()
+	{
+		return std::any_of(a_Devices.cbegin(), a_Devices.cend(), [](const std::unique_ptr<Device> & a_Device)
+			{
+				return (a_Device->isOnline() && a_Device->isPushing());
+			}
+		);
+	};
+	while (isPushing() && deadline.isActive())
+	{
+		QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+	}
+
+	std::vector<const Device *> res;
+	for (const auto & dev: a_Devices)
+	{
+		if (dev->isPushing())
+		{
+			res.push_back(dev.get());
+		}
+	}
+	return res;
+}
+
+
+
+
+
+/** Processes a single input: parses it (if a file), sanitizes it and exports it, as requested. */
+static void processInput(Input & a_Input, const Settings & a_Settings, const Sanitizer & a_Sanitizer)
+{
+	try
+	{
+		if (!a_Input.m_FileName.isEmpty())
+		{
+			QFile f(a_Input.m_FileName);
+			if (!f.open(QIODevice::ReadOnly))
+			{
+				a_Input.m_Error = f.errorString();
+				return;
+			}
+			a_Input.m_ContactBook = std::make_shared<ContactBook>(QFileInfo(a_Input.m_FileName).completeBaseName());
+			VCardParser::parse(f, a_Input.m_ContactBook);
+		}
+
+		if (a_Settings.m_ShouldSanitize)
+		{
+			a_Input.m_NumSanitized = a_Sanitizer.run(*a_Input.m_ContactBook, a_Settings.m_IsDryRun).size();
+		}
+
+		if (!a_Settings.m_ExportFolder.isEmpty())
+		{
+			QSaveFile out(exportFileName(a_Input, a_Settings));
+			if (!out.open(QIODevice::WriteOnly))
+			{
+				a_Input.m_Error = out.errorString();
+				return;
+			}
+			VCardSerializer::serialize(*a_Input.m_ContactBook->snapshot(), out);
+			if (!out.commit())
+			{
+				a_Input.m_Error = out.errorString();
+				return;
+			}
+		}
+	}
+	catch (const EParseError & exc)
+	{
+		a_Input.m_Error = QString::fromStdString(exc.m_Message);
+	}
+	catch (const EFileError & exc)
+	{
+		a_Input.m_Error = exc.m_Message;
+	}
+	catch (const EException & exc)
+	{
+		a_Input.m_Error = QString::fromUtf8("%1 (%2:%3)")
+			.arg(QString::fromUtf8(exc.what()))
+			.arg(QString::fromStdString(exc.m_SrcFileName))
+			.arg(exc.m_SrcLine);
+	}
+}
+
+
+
+
+
+/** Transforms a single input file through the streaming pipeline into the export folder. */
+static void streamInput(Input & a_Input, const Settings & a_Settings, const StreamPipeline & a_Pipeline)
+{
+	QFile f(a_Input.m_FileName);
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		a_Input.m_Error = f.errorString();
+		return;
+	}
+	QSaveFile out(exportFileName(a_Input, a_Settings));
+	if (!out.open(QIODevice::WriteOnly))
+	{
+		a_Input.m_Error = out.errorString();
+		return;
+	}
+	auto stats = a_Pipeline.run(f, out);
+	a_Input.m_NumStreamed = stats.m_NumWritten;
+	if (!out.commit())
+	{
+		a_Input.m_Error = out.errorString();
+		return;
+	}
+	if (stats.m_NumErrors > 0)
+	{
+		a_Input.m_Error = QString::fromUtf8("%1 parse errors, the erroneous contacts were skipped").arg(stats.m_NumErrors);
+	}
+}
+
+
+
+
+
+/** Returns the throughput (a_Count per second) as a string, for the stats output. */
+static QString perSecond(double a_Count, qint64 a_ElapsedMSec)
+{
+	if (a_ElapsedMSec <= 0)
+	{
+		return QString::fromUtf8("-");
+	}
+	return QString::number(a_Count * 1000 / a_ElapsedMSec, 'f', 1);
+}
+
+
+
+
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("ContactBookSanitizerCli");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Headless batch processing of contact books.");
+	parser.addHelpOption();
+	QCommandLineOption optDevice({"d", "device"}, "Process the contact books of the device described by the JSON config file.", "config");
+	QCommandLineOption optDeviceWait("device-wait", "Wait for asynchronous devices to load for the specified time.", "msec", "0");
+	QCommandLineOption optPushWait("push-wait", "Wait at most the specified time for the devices to write the sanitized contacts.", "msec", "60000");
+	QCommandLineOption optSanitize({"s", "sanitize"}, "Run the default sanitizer rules over the contacts.");
+	QCommandLineOption optDryRun({"n", "dry-run"}, "Only report the sanitizer changes, don't apply them.");
+	QCommandLineOption optDedup("dedup", "Find duplicate contacts across all the inputs.");
+	QCommandLineOption optDiff("diff", "Compare the contacts of all the inputs and list the differences.");
+	QCommandLineOption optExport({"o", "export"}, "Export each processed contact book as a VCF file into the folder.", "folder");
+	QCommandLineOption optStream("stream", "Stream the files into the export folder contact-by-contact, in constant memory.");
+	QCommandLineOption optAnonymize("anonymize", "Remove all personal data from the streamed contacts.");
+	QCommandLineOption optWorkers({"j", "workers"}, "Number of worker threads (default: number of cores).", "count");
+	QCommandLineOption optCountry("country", "Country for the phone numbers without the international prefix (default: from the system locale).", "iso-code");
+	parser.addOption(optDevice);
+	parser.addOption(optDeviceWait);
+	parser.addOption(optPushWait);
+	parser.addOption(optSanitize);
+	parser.addOption(optDryRun);
+	parser.addOption(optDedup);
+	parser.addOption(optDiff);
+	parser.addOption(optExport);
+	parser.addOption(optStream);
+	parser.addOption(optAnonymize);
+	parser.addOption(optWorkers);
+	parser.addOption(optCountry);
+	parser.addPositionalArgument("inputs", "VCF files or folders containing VCF files.", "[inputs...]");
+	parser.process(app);
+
+	QTextStream out(stdout);
+	if (parser.isSet(optWorkers))
+	{
+		bool isOk = false;
+		auto numWorkers = parser.value(optWorkers).toInt(&isOk);
+		if (!isOk || (numWorkers < 1))
+		{
+			out << "Invalid worker count: " << parser.value(optWorkers) << "\n";
+			out.flush();
+			return 2;
+		}
+		QThreadPool::globalInstance()->setMaxThreadCount(numWorkers);
+	}
+	if (parser.isSet(optCountry) && !PhoneNumber::setDefaultCountry(parser.value(optCountry)))
+	{
+		out << "Unknown phone number country: " << parser.value(optCountry) << "\n";
+		out.flush();
+		return 2;
+	}
+	Settings settings;
+	settings.m_ShouldSanitize = parser.isSet(optSanitize);
+	settings.m_IsDryRun = parser.isSet(optDryRun);
+	settings.m_ShouldDedup = parser.isSet(optDedup);
+	settings.m_ShouldDiff = parser.isSet(optDiff);
+	settings.m_ShouldStream = parser.isSet(optStream);
+	settings.m_ShouldAnonymize = parser.isSet(optAnonymize);
+	settings.m_ExportFolder = parser.value(optExport);
+	if (settings.m_ShouldStream && (settings.m_ExportFolder.isEmpty() || parser.isSet(optDevice) || settings.m_ShouldDedup || settings.m_ShouldDiff))
+	{
+		out << "Streaming needs an export folder and works only on files, without deduplication or diff\n";
+		out.flush();
+		return 2;
+	}
+	if (!settings.m_ExportFolder.isEmpty() && !QDir().mkpath(settings.m_ExportFolder))
+	{
+		out << "Cannot create the export folder " << settings.m_ExportFolder << "\n";
+		out.flush();
+		return 2;
+	}
+
+	// Collect the inputs:
+	std::vector<Input> inputs;
+	std::vector<std::unique_ptr<Device>> devices;
+	for (const auto & cfg: parser.values(optDevice))
+	{
+		auto dev = loadDevice(cfg, parser.value(optDeviceWait).toInt(), inputs);
+		if (dev == nullptr)
+		{
+			out << "Cannot load device " << cfg << "\n";
+			out.flush();
+			return 2;
+		}
+		devices.push_back(std::move(dev));
+	}
+	for (const auto & path: parser.positionalArguments())
+	{
+		addFileInputs(path, inputs);
+	}
+	if (inputs.empty())
+	{
+		parser.showHelp(2);
+	}
+	makeExportNamesUnique(inputs);
+
+	// Process the inputs in parallel:
+	Sanitizer sanitizer;
+	sanitizer.addDefaultRules();
+	QElapsedTimer timer;
+	timer.start();
+	if (settings.m_ShouldStream)
+	{
+		// Each file is processed by all the workers, one file at a time, to keep the memory use constant:
+		StreamPipeline pipeline;
+		pipeline.setNumWorkers(QThreadPool::globalInstance()->maxThreadCount());
+		pipeline.addStage(std::make_shared<StreamStageConvertToV3>());
+		if (settings.m_ShouldSanitize)
+		{
+			std::shared_ptr<Sanitizer> streamSanitizer(new Sanitizer);
+			streamSanitizer->addDefaultRules();
+			pipeline.addStage(std::make_shared<StreamStageSanitize>(streamSanitizer));
+		}
+		if (settings.m_ShouldAnonymize)
+		{
+			pipeline.addStage(std::make_shared<StreamStageAnonymize>());
+		}
+		for (auto & in: inputs)
+		{
+			streamInput(in, settings, pipeline);
+		}
+	}
+	else
+	{
+		// The files are processed in parallel. The devices' books are processed on the main thread, in which
+		// the devices live, so that the devices get notified of the changes and can write them back:
+		QtConcurrent::blockingMap(inputs, [&settings, &sanitizer](Input & a_Input)
+			{
+				if (!a_Input.m_FileName.isEmpty())
+				{
+					processInput(a_Input, settings, sanitizer);
+				}
+			}
+		);
+		for (auto & in: inputs)
+		{
+			if (in.m_FileName.isEmpty())
+			{
+				processInput(in, settings, sanitizer);
+			}
+		}
+	}
+	auto processMSec = timer.elapsed();
+
+	// Write the sanitized contacts back to the devices:
+	std::vector<const Device *> unpushedDevices;
+	if (settings.m_ShouldSanitize && !settings.m_IsDryRun && !devices.empty())
+	{
+		unpushedDevices = pushDeviceChanges(devices, parser.value(optPushWait).toInt());
+	}
+
+	// Report the results:
+	size_t numContacts = 0, numSanitized = 0, numFailed = 0;
+	qint64 numBytes = 0;
+	std::vector<ContactBookPtr> books;
+	for (const auto & in: inputs)
+	{
+		if (!in.m_Error.isEmpty())
+		{
+			out << in.m_Name << ": " << in.m_Error << "\n";
+			numFailed += 1;
+		}
+		if (in.m_ContactBook != nullptr)
+		{
+			numContacts += in.m_ContactBook->snapshot()->size();
+			books.push_back(in.m_ContactBook);
+		}
+		numContacts += in.m_NumStreamed;
+		numSanitized += in.m_NumSanitized;
+		numBytes += in.m_NumBytes;
+	}
+	for (const auto dev: unpushedDevices)
+	{
+		out << dev->displayName() << ": Not all the changes have been written to the device\n";
+		numFailed += 1;
+	}
+	out << "Processed " << inputs.size() << " inputs (" << numFailed << " failed), "
+		<< numContacts << " contacts, " << numBytes << " bytes in " << processMSec << " msec using "
+		<< QThreadPool::globalInstance()->maxThreadCount() << " workers\n";
+	out << "Throughput: " << perSecond(inputs.size(), processMSec) << " inputs/s, "
+		<< perSecond(numContacts, processMSec) << " contacts/s, "
+		<< perSecond(numBytes / 1048576.0, processMSec) << " MiB/s\n";
+	if (settings.m_ShouldSanitize && !settings.m_ShouldStream)
+	{
+		out << (settings.m_IsDryRun ? "Contacts to sanitize: " : "Contacts sanitized: ") << numSanitized << "\n";
+	}
+	out.flush();
+
+	// Deduplicate across all the inputs:
+	if (settings.m_ShouldDedup)
+	{
+		timer.restart();
+		auto clusters = DuplicateFinder().findDuplicates(books);
+		size_t numDuplicates = 0;
+		for (const auto & c: clusters)
+		{
+			numDuplicates += c.size() - 1;
+		}
+		out << "Found " << clusters.size() << " groups of duplicates (" << numDuplicates
+			<< " redundant contacts) in " << timer.elapsed() << " msec\n";
+		out.flush();
+	}
+
+	// Compare the inputs:
+	if (settings.m_ShouldDiff)
+	{
+		timer.restart();
+		ContactBookDiff diff(books);
+		for (const auto & row: diff.rows())
+		{
+			if (row.m_Status == ContactBookDiff::stIdentical)
+			{
+				continue;
+			}
+			QStringList missingFrom;
+			for (size_t b = 0; b < books.size(); ++b)
+			{
+				if (row.m_Contacts[b] == nullptr)
+				{
+					missingFrom.append(books[b]->displayName());
+				}
+			}
+			if (row.m_Status == ContactBookDiff::stChanged)
+			{
+				out << "Changed: " << row.m_Key << "\n";
+			}
+			else
+			{
+				out << "Missing from " << missingFrom.join(", ") << ": " << row.m_Key << "\n";
+			}
+		}
+		out << "Diff: " << diff.count(ContactBookDiff::stIdentical) << " identical, "
+			<< diff.count(ContactBookDiff::stChanged) << " changed, "
+			<< diff.count(ContactBookDiff::stMissing) << " missing, in " << timer.elapsed() << " msec\n";
+		out.flush();
+	}
+
+	for (auto & dev: devices)
+	{
+		dev->stop();
+	}
+	return (numFailed > 0) ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+#ifndef TESTHELPERS_H
+#define TESTHELPERS_H
+
+
+
+
+
+// Helper functions and classes shared by the unit tests
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QString>
+
+#include "../ContactBook.h"
+#include "../Device.h"
+#include "../VCardParser.h"
+
+
+
+
+
+/** Returns a VCard consisting of the specified (already formatted) sentences. */
+inline QByteArray vcard(const QByteArray & a_Sentences, const QByteArray & a_Version = "3.0")
+{
+	return "BEGIN:VCARD\r\nVERSION:" + a_Version + "\r\n" + a_Sentences + "END:VCARD\r\n";
+}
+
+
+
+
+
+/** Returns the VCF data of the specified VCards, each given as its (already formatted) sentences. */
+inline QByteArray vcards(const std::vector<QByteArray> & a_Contacts, const QByteArray & a_Version = "3.0")
+{
+	QByteArray res;
+	for (const auto & c: a_Contacts)
+	{
+		res.append(vcard(c, a_Version));
+	}
+	return res;
+}
+
+
+
+
+
+/** Parses the specified VCF data into a new ContactBook. */
+inline ContactBookPtr parseBook(const QString & a_DisplayName, QByteArray a_Vcf)
+{
+	ContactBookPtr res(new ContactBook(a_DisplayName));
+	QBuffer buf(&a_Vcf);
+	buf.open(QIODevice::ReadOnly);
+	VCardParser::parse(buf, res);
+	return res;
+}
+
+
+
+
+
+/** A device whose contact books are added and removed by the test. */
+class TestDevice:
+	public Device
+{
+public:
+
+	/** Adds the contact book to the device and announces it. */
+	void addBook(ContactBookPtr a_ContactBook)
+	{
+		m_ContactBooks.push_back(a_ContactBook);
+		emit addContactBook(this, a_ContactBook);
+	}
+
+	/** Removes the contact book from the device and announces it. */
+	void removeBook(const ContactBook * a_ContactBook)
+	{
+		m_ContactBooks.erase(std::remove_if(m_ContactBooks.begin(), m_ContactBooks.end(),
+			[a_ContactBook](const ContactBookPtr & a_Book)
+			{
+				return (a_Book.get() == a_ContactBook);
+			}
+		), m_ContactBooks.end());
+		emit delContactBook(this, a_ContactBook);
+	}
+
+
+protected:
+
+	std::vector<ContactBookPtr> m_ContactBooks;
+
+
+	// Device overrides:
+	virtual QString displayName() const override { return "test"; }
+	virtual void start() override {}
+	virtual void stop() override {}
+	virtual bool isOnline() const override { return true; }
+	virtual const std::vector<ContactBookPtr> contactBooks() override { return m_ContactBooks; }
+	virtual bool load(const QJsonObject & a_Config) override { Q_UNUSED(a_Config); return true; }
+	virtual QJsonObject save() const override { return QJsonObject(); }
+};
+
+
+
+
+
+/** Adds a new contact with the specified sentences (key -> value) to the contact book.
+Must be called within a batch. */
+inline ContactPtr addContact(ContactBook & a_ContactBook, const std::vector<std::pair<QByteArray, QByteArray>> & a_Sentences)
+{
+	auto res = a_ContactBook.createNewContact();
+	for (const auto & kv: a_Sentences)
+	{
+		Contact::Sentence s;
+		s.m_Key = kv.first;
+		s.m_Value = kv.second;
+		res->addSentence(s);
+	}
+	return res;
+}
+
+
+
+
+
+#endif // TESTHELPERS_H
@@ -0,0 +1,276 @@
+#include <QDirIterator>
+#include <QString>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "../../DeviceBackup.h"
+#include "../../ContactBook.h"
+#include "../TestHelpers.h"
+
+
+
+
+
+/** Returns the value of the first sentence with the specified key, or an empty value if not present. */
+static QByteArray valueOf(const Contact & a_Contact, const QByteArray & a_Key)
+{
+	for (const auto & s: a_Contact.sentences())
+	{
+		if (s.m_Key == a_Key)
+		{
+			return s.m_Value;
+		}
+	}
+	return QByteArray();
+}
+
+
+
+
+
+/** Returns the sorted values of the specified key in all the contacts of the book. */
+static QStringList valuesOf(const ContactBook & a_ContactBook, const QByteArray & a_Key)
+{
+	QStringList res;
+	for (const auto & c: a_ContactBook.contacts())
+	{
+		res.append(QString::fromUtf8(valueOf(*c, a_Key)));
+	}
+	res.sort();
+	return res;
+}
+
+
+
+
+
+/** Returns the number of files matching the filter in the specified folder and its subfolders. */
+static int countFiles(const QString & a_Folder, const QString & a_Filter)
+{
+	int res = 0;
+	QDirIterator itr(a_Folder, {a_Filter}, QDir::Files, QDirIterator::Subdirectories);
+	while (itr.hasNext())
+	{
+		itr.next();
+		res += 1;
+	}
+	return res;
+}
+
+
+
+
+
+class TestDeviceBackup:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testDeduplication();
+	void testSameFingerprintDistinctObjects();
+	void testReload();
+	void testRepeatedObject();
+	void testRestore();
+};
+
+
+
+
+
+void TestDeviceBackup::testDeduplication()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	DeviceBackup dev;
+	dev.setFolder(dir.path());
+	ContactBook book("book");
+	{
+		ContactBook::Batch batch(book);
+		addContact(book, {{"fn", "Jan Novak"}});
+		addContact(book, {{"fn", "Petr Svoboda"}});
+		addContact(book, {{"fn", "Jana Novotna"}});
+	}
+
+	// Backing up an unchanged book writes only the manifest:
+	dev.backupContactBook(book);
+	QCOMPARE(countFiles(dir.path() + "/objects", "*.vcf"), 3);
+	QTest::qSleep(2);  // The manifests are named by the timestamp
+	auto cb = dev.backupContactBook(book);
+	QCOMPARE(countFiles(dir.path() + "/objects", "*.vcf"), 3);
+	QCOMPARE(countFiles(dir.path() + "/snapshots", "*.manifest"), 2);
+	QCOMPARE(dev.contactBooks().size(), static_cast<size_t>(2));
+	QVERIFY(cb->contacts() == book.contacts());
+
+	// Only the changed contact is written:
+	auto replacement = book.contacts()[1]->clone();
+	Contact::Sentence fn;
+	fn.m_Key = "fn";
+	fn.m_Value = "Petr Dvorak";
+	replacement->setSentences({fn});
+	book.replaceContact(book.contacts()[1].get(), replacement);
+	QTest::qSleep(2);
+	dev.backupContactBook(book);
+	QCOMPARE(countFiles(dir.path() + "/objects", "*.vcf"), 4);
+	QCOMPARE(countFiles(dir.path() + "/snapshots", "*.manifest"), 3);
+}
+
+
+
+
+
+void TestDeviceBackup::testSameFingerprintDistinctObjects()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	// Two contacts differing only in REV, which the fingerprint ignores:
+	ContactBook book("book");
+	{
+		ContactBook::Batch batch(book);
+		addContact(book, {{"fn", "Jan Novak"}, {"rev", "20200101T000000Z"}});
+		addContact(book, {{"fn", "Jan Novak"}, {"rev", "20210101T000000Z"}});
+	}
+	QCOMPARE(book.contacts()[0]->fingerprint(), book.contacts()[1]->fingerprint());
+	{
+		DeviceBackup dev;
+		dev.setFolder(dir.path());
+		dev.backupContactBook(book);
+	}
+	QCOMPARE(countFiles(dir.path() + "/objects", "*.vcf"), 2);
+
+	// Each is restored with its exact data:
+	DeviceBackup dev;
+	dev.setFolder(dir.path());
+	dev.start();
+	QCOMPARE(dev.contactBooks().size(), static_cast<size_t>(1));
+	QCOMPARE(valuesOf(*dev.contactBooks()[0], "rev"), QStringList({"20200101T000000Z", "20210101T000000Z"}));
+}
+
+
+
+
+
+void TestDeviceBackup::testReload()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	ContactBook book("book");
+	{
+		ContactBook::Batch batch(book);
+		addContact(book, {{"fn", "Jan Novak"}, {"email", "jan@novak.cz"}});
+		addContact(book, {{"fn", "Petr Svoboda"}});
+	}
+	{
+		DeviceBackup dev;
+		dev.setFolder(dir.path());
+		dev.backupContactBook(book);
+		QTest::qSleep(2);
+		dev.backupContactBook(book);
+	}
+
+	DeviceBackup dev;
+	dev.setFolder(dir.path());
+	dev.start();
+	const auto & books = dev.contactBooks();
+	QCOMPARE(books.size(), static_cast<size_t>(2));
+	QVERIFY(books[0]->displayName().startsWith("book"));
+	QCOMPARE(valuesOf(*books[0], "fn"), QStringList({"Jan Novak", "Petr Svoboda"}));
+	QCOMPARE(valuesOf(*books[0], "email"), QStringList({"", "jan@novak.cz"}));
+	QCOMPARE(books[0]->contacts()[0]->fingerprint(), book.contacts()[0]->fingerprint());
+
+	// The contacts are shared between the backups, already prepared, so that no book modifies them:
+	QVERIFY(books[0]->contacts() == books[1]->contacts());
+	QVERIFY(books[0]->contacts()[0]->isPrepared());
+}
+
+
+
+
+
+void TestDeviceBackup::testRepeatedObject()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	// Two contacts with the exact same data are stored as a single object, listed twice in the manifest:
+	ContactBook book("book");
+	{
+		ContactBook::Batch batch(book);
+		addContact(book, {{"fn", "Jan Novak"}});
+		addContact(book, {{"fn", "Jan Novak"}});
+	}
+	{
+		DeviceBackup dev;
+		dev.setFolder(dir.path());
+		dev.backupContactBook(book);
+	}
+	QCOMPARE(countFiles(dir.path() + "/objects", "*.vcf"), 1);
+
+	// Both are loaded, each as a separate instance:
+	DeviceBackup dev;
+	dev.setFolder(dir.path());
+	dev.start();
+	QCOMPARE(dev.contactBooks().size(), static_cast<size_t>(1));
+	const auto & contacts = dev.contactBooks()[0]->contacts();
+	QCOMPARE(contacts.size(), static_cast<size_t>(2));
+	QVERIFY(contacts[0] != contacts[1]);
+	QCOMPARE(contacts[0]->fingerprint(), contacts[1]->fingerprint());
+}
+
+
+
+
+
+void TestDeviceBackup::testRestore()
+{
+	ContactBook backup("backup");
+	{
+		ContactBook::Batch batch(backup);
+		addContact(backup, {{"fn", "Jan Novak"}});
+		addContact(backup, {{"fn", "Petr Svoboda"}, {"uid", "uid-petr"}});
+		addContact(backup, {{"fn", "Jana Novotna"}});
+	}
+	ContactBook dest("dest");
+	{
+		ContactBook::Batch batch(dest);
+		addContact(dest, {{"fn", "Jan Novak"}});
+		addContact(dest, {{"fn", "Petr Dvorak"}, {"uid", "uid-petr"}});
+		addContact(dest, {{"fn", "Karel Novy"}});
+	}
+	auto unchanged = dest.contacts()[0];
+
+	auto stats = DeviceBackup::restore(backup, dest);
+	QCOMPARE(stats.m_NumUnchanged, static_cast<size_t>(1));
+	QCOMPARE(stats.m_NumReplaced, static_cast<size_t>(1));
+	QCOMPARE(stats.m_NumAdded, static_cast<size_t>(1));
+	QCOMPARE(stats.m_NumRemoved, static_cast<size_t>(1));
+	QCOMPARE(valuesOf(dest, "fn"), QStringList({"Jan Novak", "Jana Novotna", "Petr Svoboda"}));
+	QCOMPARE(dest.contacts()[0], unchanged);
+
+	// The UID index used for the pairing is kept up to date with the changes:
+	QVERIFY(dest.isIndexed());
+	auto petr = dest.index().findByUid("uid-petr");
+	QCOMPARE(petr.size(), static_cast<size_t>(1));
+	QCOMPARE(valueOf(*petr[0], "fn"), QByteArray("Petr Svoboda"));
+	QCOMPARE(dest.index().findByName(QString::fromUtf8("JANA NOVOTNÁ")).size(), static_cast<size_t>(1));
+	QVERIFY(dest.index().findByName("Karel Novy").empty());
+
+	// Restoring again changes nothing:
+	auto contacts = dest.contacts();
+	stats = DeviceBackup::restore(backup, dest);
+	QCOMPARE(stats.m_NumUnchanged, static_cast<size_t>(3));
+	QCOMPARE(stats.m_NumReplaced + stats.m_NumAdded + stats.m_NumRemoved, static_cast<size_t>(0));
+	QVERIFY(dest.contacts() == contacts);
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestDeviceBackup)
+
+
+
+
+
+#include "TestDeviceBackup.moc"
@@ -0,0 +1,851 @@
+#include "MockCardDavServer.h"
+#include <algorithm>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QPointer>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+
+
+
+
+static const QString NS_DAV = "DAV:";
+static const QString NS_CARDDAV = "urn:ietf:params:xml:ns:carddav";
+static const QString NS_CALENDARSERVER = "http://calendarserver.org/ns/";
+
+static const QString PRINCIPAL_PATH = "/principals/user/";
+static const QString HOME_PATH = "/addressbooks/user/";
+static const QString ADDRESSBOOK_PATH = "/addressbooks/user/contacts/";
+
+static const QString SYNC_TOKEN_PREFIX = "http://mock.carddav/sync/";
+
+/** The interval in which the throttled response data is sent. */
+static const int THROTTLE_INTERVAL_MSEC = 50;
+
+
+
+
+
+/** Returns the reason phrase for the specified HTTP status. */
+static QByteArray reasonPhrase(int a_HttpStatus)
+{
+	switch (a_HttpStatus)
+	{
+		case 200: return "OK";
+		case 201: return "Created";
+		case 204: return "No Content";
+		case 207: return "Multi-Status";
+		case 400: return "Bad Request";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 412: return "Precondition Failed";
+		case 500: return "Internal Server Error";
+		case 501: return "Not Implemented";
+		case 503: return "Service Unavailable";
+	}
+	return "Unknown";
+}
+
+
+
+
+
+/** Starts the multistatus response document, declaring all the namespaces used. */
+static void startMultistatus(QXmlStreamWriter & a_Writer)
+{
+	a_Writer.writeStartDocument();
+	a_Writer.writeNamespace(NS_DAV, "d");
+	a_Writer.writeNamespace(NS_CARDDAV, "card");
+	a_Writer.writeNamespace(NS_CALENDARSERVER, "cs");
+	a_Writer.writeStartElement(NS_DAV, "multistatus");
+}
+
+
+
+
+
+/** Writes a <DAV:response> element with a single 404 status for the whole resource. */
+static void writeNotFoundResponse(QXmlStreamWriter & a_Writer, const QString & a_Href)
+{
+	a_Writer.writeStartElement(NS_DAV, "response");
+		a_Writer.writeTextElement(NS_DAV, "href", a_Href);
+		a_Writer.writeTextElement(NS_DAV, "status", "HTTP/1.1 404 Not Found");
+	a_Writer.writeEndElement();
+}
+
+
+
+
+
+/** Writes a <DAV:response> element with a single 200 propstat, the properties are written by a_WriteProps. */
+template <typename Fn>
+static void writePropResponse(QXmlStreamWriter & a_Writer, const QString & a_Href, Fn a_WriteProps)
+{
+	a_Writer.writeStartElement(NS_DAV, "response");
+		a_Writer.writeTextElement(NS_DAV, "href", a_Href);
+		a_Writer.writeStartElement(NS_DAV, "propstat");
+			a_Writer.writeStartElement(NS_DAV, "prop");
+				a_WriteProps();
+			a_Writer.writeEndElement();
+			a_Writer.writeTextElement(NS_DAV, "status", "HTTP/1.1 200 OK");
+		a_Writer.writeEndElement();
+	a_Writer.writeEndElement();
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MockCardDavServer:
+
+MockCardDavServer::MockCardDavServer(QObject * a_Parent):
+	Super(a_Parent),
+	m_ModSeq(1),
+	m_NumGenerated(0),
+	m_LatencyMsec(0),
+	m_BandwidthBytesPerSec(0),
+	m_IsSyncCollectionSupported(true),
+	m_ErrorRate(0),
+	m_ErrorRateStatus(503),
+	m_NumBytesSent(0),
+	m_Random(0)
+{
+	connect(&m_Server, &QTcpServer::newConnection, this, &MockCardDavServer::newConnection);
+}
+
+
+
+
+
+bool MockCardDavServer::listen()
+{
+	return m_Server.listen(QHostAddress::LocalHost, 0);
+}
+
+
+
+
+
+QUrl MockCardDavServer::baseUrl() const
+{
+	return QUrl(QString("http://127.0.0.1:%1/").arg(m_Server.serverPort()));
+}
+
+
+
+
+
+QUrl MockCardDavServer::addressbookUrl() const
+{
+	return baseUrl().resolved(QUrl(ADDRESSBOOK_PATH));
+}
+
+
+
+
+
+void MockCardDavServer::setErrorRate(double a_Probability, int a_HttpStatus)
+{
+	m_ErrorRate = a_Probability;
+	m_ErrorRateStatus = a_HttpStatus;
+}
+
+
+
+
+
+void MockCardDavServer::failNextRequests(const QByteArray & a_Kind, int a_Count, int a_HttpStatus)
+{
+	m_FailNext[a_Kind] = qMakePair(a_Count, a_HttpStatus);
+}
+
+
+
+
+
+void MockCardDavServer::generateContacts(int a_Count)
+{
+	for (int i = 0; i < a_Count; ++i)
+	{
+		putContact(
+			QString("contact-%1.vcf").arg(m_NumGenerated, 6, 10, QChar('0')),
+			syntheticContactData(m_NumGenerated)
+		);
+		m_NumGenerated += 1;
+	}
+}
+
+
+
+
+
+QString MockCardDavServer::putContact(const QString & a_Name, const QByteArray & a_Data)
+{
+	m_ModSeq += 1;
+	auto & contact = m_Contacts[a_Name];
+	contact.m_Data = a_Data;
+	contact.m_Etag = QString("\"%1\"").arg(m_ModSeq);
+	contact.m_ModSeq = m_ModSeq;
+	m_Tombstones.remove(a_Name);
+	return contact.m_Etag;
+}
+
+
+
+
+
+void MockCardDavServer::deleteContact(const QString & a_Name)
+{
+	if (m_Contacts.remove(a_Name) == 0)
+	{
+		return;
+	}
+	m_ModSeq += 1;
+	m_Tombstones[a_Name] = m_ModSeq;
+}
+
+
+
+
+
+const MockCardDavServer::StoredContact * MockCardDavServer::contact(const QString & a_Name) const
+{
+	auto itr = m_Contacts.constFind(a_Name);
+	if (itr == m_Contacts.constEnd())
+	{
+		return nullptr;
+	}
+	return &itr.value();
+}
+
+
+
+
+
+QByteArray MockCardDavServer::syntheticContactData(int a_Index)
+{
+	return QString(
+		"BEGIN:VCARD\r\n"
+		"VERSION:3.0\r\n"
+		"UID:mock-%1\r\n"
+		"N:Surname%1;Given%1;;;\r\n"
+		"FN:Given%1 Surname%1\r\n"
+		"TEL;TYPE=CELL:+420 %2\r\n"
+		"EMAIL;TYPE=WORK:given%1@example.com\r\n"
+		"END:VCARD\r\n"
+	).arg(a_Index).arg(600000000 + a_Index).toUtf8();
+}
+
+
+
+
+
+void MockCardDavServer::processNextRequest(QTcpSocket * a_Socket)
+{
+	auto itr = m_Connections.find(a_Socket);
+	if ((itr == m_Connections.end()) || itr->second.m_IsBusy)
+	{
+		return;
+	}
+	Request req;
+	if (!extractRequest(itr->second.m_Buffer, req))
+	{
+		return;
+	}
+	itr->second.m_IsBusy = true;
+	sendResponse(a_Socket, handleRequest(req));
+}
+
+
+
+
+
+bool MockCardDavServer::extractRequest(QByteArray & a_Buffer, Request & a_Request)
+{
+	auto headerEnd = a_Buffer.indexOf("\r\n\r\n");
+	if (headerEnd < 0)
+	{
+		return false;
+	}
+	auto lines = a_Buffer.left(headerEnd).split('\n');
+	for (int i = 1; i < lines.size(); ++i)
+	{
+		auto colon = lines[i].indexOf(':');
+		if (colon > 0)
+		{
+			a_Request.m_Headers[lines[i].left(colon).trimmed().toLower()] = lines[i].mid(colon + 1).trimmed();
+		}
+	}
+	auto contentLength = a_Request.m_Headers.value("content-length").toInt();
+	if (a_Buffer.size() < headerEnd + 4 + contentLength)
+	{
+		// The body hasn't been received completely yet
+		return false;
+	}
+	auto requestLine = lines[0].trimmed().split(' ');
+	a_Request.m_Method = requestLine.value(0);
+	a_Request.m_Path = QUrl(QString::fromUtf8(requestLine.value(1))).path();
+	a_Request.m_Body = a_Buffer.mid(headerEnd + 4, contentLength);
+	a_Buffer.remove(0, headerEnd + 4 + contentLength);
+	return true;
+}
+
+
+
+
+
+QList<QByteArray> MockCardDavServer::requestKinds(const Request & a_Request)
+{
+	QList<QByteArray> res;
+	res.append(a_Request.m_Method);
+	if (a_Request.m_Method == "REPORT")
+	{
+		QXmlStreamReader reader(a_Request.m_Body);
+		if (reader.readNextStartElement())
+		{
+			res.append(reader.name().toString().toUtf8());
+		}
+	}
+	return res;
+}
+
+
+
+
+
+MockCardDavServer::Response MockCardDavServer::handleRequest(const Request & a_Request)
+{
+	auto kinds = requestKinds(a_Request);
+	for (const auto & kind: kinds)
+	{
+		m_NumRequests[kind] += 1;
+	}
+
+	// Inject the errors:
+	for (const auto & kind: kinds)
+	{
+		auto failItr = m_FailNext.find(kind);
+		if ((failItr != m_FailNext.end()) && (failItr->first > 0))
+		{
+			failItr->first -= 1;
+			Response res;
+			res.m_Status = failItr->second;
+			return res;
+		}
+	}
+	if ((m_ErrorRate > 0) && (std::uniform_real_distribution<double>(0, 1)(m_Random) < m_ErrorRate))
+	{
+		Response res;
+		res.m_Status = m_ErrorRateStatus;
+		return res;
+	}
+
+	if (a_Request.m_Method == "OPTIONS")
+	{
+		return handleOptions(a_Request);
+	}
+	if (a_Request.m_Method == "PROPFIND")
+	{
+		return handlePropfind(a_Request);
+	}
+	if (a_Request.m_Method == "REPORT")
+	{
+		return handleReport(a_Request);
+	}
+	if (a_Request.m_Method == "PUT")
+	{
+		return handlePut(a_Request);
+	}
+	if (a_Request.m_Method == "DELETE")
+	{
+		return handleDelete(a_Request);
+	}
+	Response res;
+	res.m_Status = 405;
+	return res;
+}
+
+
+
+
+
+MockCardDavServer::Response MockCardDavServer::handleOptions(const Request & a_Request)
+{
+	Q_UNUSED(a_Request);
+
+	Response res;
+	res.m_Headers.append(qMakePair(QByteArray("DAV"), QByteArray("1, 2, 3, addressbook")));
+	res.m_Headers.append(qMakePair(QByteArray("Allow"), QByteArray("OPTIONS, PROPFIND, REPORT, PUT, DELETE")));
+	return res;
+}
+
+
+
+
+
+MockCardDavServer::Response MockCardDavServer::handlePropfind(const Request & a_Request)
+{
+	// All the known properties are reported, regardless of the ones requested:
+	Response res;
+	res.m_Status = 207;
+	res.m_Headers.append(qMakePair(QByteArray("Content-Type"), QByteArray("application/xml; charset=utf-8")));
+	QXmlStreamWriter w(&res.m_Body);
+	startMultistatus(w);
+	const auto & path = a_Request.m_Path;
+	auto writeAddressbook = [this, &w]()
+	{
+		writePropResponse(w, ADDRESSBOOK_PATH, [this, &w]()
+			{
+				w.writeStartElement(NS_DAV, "resourcetype");
+					w.writeEmptyElement(NS_DAV, "collection");
+					w.writeEmptyElement(NS_CARDDAV, "addressbook");
+				w.writeEndElement();
+				w.writeTextElement(NS_DAV, "displayname", "Contacts");
+				w.writeTextElement(NS_CALENDARSERVER, "getctag", ctag());
+				if (m_IsSyncCollectionSupported)
+				{
+					w.writeTextElement(NS_DAV, "sync-token", syncToken());
+				}
+			}
+		);
+	};
+	if (path == "/")
+	{
+		writePropResponse(w, path, [&w]()
+			{
+				w.writeStartElement(NS_DAV, "current-user-principal");
+					w.writeTextElement(NS_DAV, "href", PRINCIPAL_PATH);
+				w.writeEndElement();
+			}
+		);
+	}
+	else if (path == PRINCIPAL_PATH)
+	{
+		writePropResponse(w, path, [&w]()
+			{
+				w.writeStartElement(NS_CARDDAV, "addressbook-home-set");
+					w.writeTextElement(NS_DAV, "href", HOME_PATH);
+				w.writeEndElement();
+			}
+		);
+	}
+	else if (path == HOME_PATH)
+	{
+		writePropResponse(w, path, [&w]()
+			{
+				w.writeStartElement(NS_DAV, "resourcetype");
+					w.writeEmptyElement(NS_DAV, "collection");
+				w.writeEndElement();
+			}
+		);
+		if (a_Request.m_Headers.value("depth", "0") != "0")
+		{
+			writeAddressbook();
+		}
+	}
+	else if (path == ADDRESSBOOK_PATH)
+	{
+		writeAddressbook();
+	}
+	else
+	{
+		Response notFound;
+		notFound.m_Status = 404;
+		return notFound;
+	}
+	w.writeEndElement();
+	w.writeEndDocument();
+	return res;
+}
+
+
+
+
+
+MockCardDavServer::Response MockCardDavServer::handleReport(const Request & a_Request)
+{
+	if (a_Request.m_Path != ADDRESSBOOK_PATH)
+	{
+		Response res;
+		res.m_Status = 404;
+		return res;
+	}
+
+	// Dispatch on the root element of the request:
+	QXmlStreamReader reader(a_Request.m_Body);
+	if (!reader.readNextStartElement())
+	{
+		Response res;
+		res.m_Status = 400;
+		return res;
+	}
+	if ((reader.namespaceUri() == NS_CARDDAV) && (reader.name() == "addressbook-query"))
+	{
+		return reportAddressbookQuery();
+	}
+	if ((reader.namespaceUri() == NS_CARDDAV) && (reader.name() == "addressbook-multiget"))
+	{
+		return reportMultiget(a_Request);
+	}
+	if ((reader.namespaceUri() == NS_DAV) && (reader.name() == "sync-collection"))
+	{
+		if (!m_IsSyncCollectionSupported)
+		{
+			Response res;
+			res.m_Status = 501;
+			return res;
+		}
+		return reportSyncCollection(a_Request);
+	}
+	Response res;
+	res.m_Status = 501;
+	return res;
+}
+
+
+
+
+
+MockCardDavServer::Response MockCardDavServer::reportAddressbookQuery()
+{
+	Response res;
+	res.m_Status = 207;
+	res.m_Headers.append(qMakePair(QByteArray("Content-Type"), QByteArray("application/xml; charset=utf-8")));
+	QXmlStreamWriter w(&res.m_Body);
+	startMultistatus(w);
+	for (auto itr = m_Contacts.constBegin(), end = m_Contacts.constEnd(); itr != end; ++itr)
+	{
+		const auto & etag = itr->m_Etag;
+		writePropResponse(w, ADDRESSBOOK_PATH + itr.key(), [&w, &etag]()
+			{
+				w.writeTextElement(NS_DAV, "getetag", etag);
+			}
+		);
+	}
+	w.writeEndElement();
+	w.writeEndDocument();
+	return res;
+}
+
+
+
+
+
+MockCardDavServer::Response MockCardDavServer::reportMultiget(const Request & a_Request)
+{
+	// Collect the requested hrefs:
+	QStringList hrefs;
+	QXmlStreamReader reader(a_Request.m_Body);
+	while (!reader.atEnd())
+	{
+		if (reader.readNext() != QXmlStreamReader::StartElement)
+		{
+			continue;
+		}
+		if ((reader.namespaceUri() == NS_DAV) && (reader.name() == "href"))
+		{
+			hrefs.append(reader.readElementText().trimmed());
+		}
+	}
+
+	Response res;
+	res.m_Status = 207;
+	res.m_Headers.append(qMakePair(QByteArray("Content-Type"), QByteArray("application/xml; charset=utf-8")));
+	QXmlStreamWriter w(&res.m_Body);
+	startMultistatus(w);
+	for (const auto & href: hrefs)
+	{
+		auto c = contact(contactNameFromPath(QUrl(href).path()));
+		if (c == nullptr)
+		{
+			writeNotFoundResponse(w, href);
+			continue;
+		}
+		writePropResponse(w, href, [&w, c]()
+			{
+				w.writeTextElement(NS_DAV, "getetag", c->m_Etag);
+				w.writeTextElement(NS_CARDDAV, "address-data", QString::fromUtf8(c->m_Data));
+			}
+		);
+	}
+	w.writeEndElement();
+	w.writeEndDocument();
+	return res;
+}
+
+
+
+
+
+MockCardDavServer::Response MockCardDavServer::reportSyncCollection(const Request & a_Request)
+{
+	// Read the client's token:
+	QString token;
+	QXmlStreamReader reader(a_Request.m_Body);
+	while (!reader.atEnd())
+	{
+		if (reader.readNext() != QXmlStreamReader::StartElement)
+		{
+			continue;
+		}
+		if ((reader.namespaceUri() == NS_DAV) && (reader.name() == "sync-token"))
+		{
+			token = reader.readElementText().trimmed();
+			break;
+		}
+	}
+	quint64 since = 0;
+	if (!token.isEmpty())
+	{
+		bool isOk = false;
+		if (token.startsWith(SYNC_TOKEN_PREFIX))
+		{
+			since = token.mid(SYNC_TOKEN_PREFIX.length()).toULongLong(&isOk);
+		}
+		if (!isOk || (since > m_ModSeq))
+		{
+			Response res;
+			res.m_Status = 403;
+			res.m_Headers.append(qMakePair(QByteArray("Content-Type"), QByteArray("application/xml; charset=utf-8")));
+			res.m_Body =
+				"<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+				"<d:error xmlns:d=\"DAV:\"><d:valid-sync-token/></d:error>";
+			return res;
+		}
+	}
+
+	// List the changes since the token; a sync without a token lists all the contacts and no removals:
+	Response res;
+	res.m_Status = 207;
+	res.m_Headers.append(qMakePair(QByteArray("Content-Type"), QByteArray("application/xml; charset=utf-8")));
+	QXmlStreamWriter w(&res.m_Body);
+	startMultistatus(w);
+	for (auto itr = m_Contacts.constBegin(), end = m_Contacts.constEnd(); itr != end; ++itr)
+	{
+		if (itr->m_ModSeq <= since)
+		{
+			continue;
+		}
+		const auto & etag = itr->m_Etag;
+		writePropResponse(w, ADDRESSBOOK_PATH + itr.key(), [&w, &etag]()
+			{
+				w.writeTextElement(NS_DAV, "getetag", etag);
+			}
+		);
+	}
+	if (since > 0)
+	{
+		for (auto itr = m_Tombstones.constBegin(), end = m_Tombstones.constEnd(); itr != end; ++itr)
+		{
+			if (itr.value() > since)
+			{
+				writeNotFoundResponse(w, ADDRESSBOOK_PATH + itr.key());
+			}
+		}
+	}
+	w.writeTextElement(NS_DAV, "sync-token", syncToken());
+	w.writeEndElement();
+	w.writeEndDocument();
+	return res;
+}
+
+
+
+
+
+MockCardDavServer::Response MockCardDavServer::handlePut(const Request & a_Request)
+{
+	Response res;
+	auto name = contactNameFromPath(a_Request.m_Path);
+	if (name.isEmpty())
+	{
+		res.m_Status = 403;
+		return res;
+	}
+	auto existing = contact(name);
+	auto ifMatch = a_Request.m_Headers.value("if-match");
+	auto ifNoneMatch = a_Request.m_Headers.value("if-none-match");
+	if (
+		(!ifMatch.isEmpty() && ((existing == nullptr) || (existing->m_Etag != QString::fromUtf8(ifMatch)))) ||
+		((ifNoneMatch == "*") && (existing != nullptr))
+	)
+	{
+		res.m_Status = 412;
+		return res;
+	}
+	res.m_Status = (existing == nullptr) ? 201 : 204;
+	auto etag = putContact(name, a_Request.m_Body);
+	res.m_Headers.append(qMakePair(QByteArray("ETag"), etag.toUtf8()));
+	return res;
+}
+
+
+
+
+
+MockCardDavServer::Response MockCardDavServer::handleDelete(const Request & a_Request)
+{
+	Response res;
+	auto existing = contact(contactNameFromPath(a_Request.m_Path));
+	if (existing == nullptr)
+	{
+		res.m_Status = 404;
+		return res;
+	}
+	auto ifMatch = a_Request.m_Headers.value("if-match");
+	if (!ifMatch.isEmpty() && (existing->m_Etag != QString::fromUtf8(ifMatch)))
+	{
+		res.m_Status = 412;
+		return res;
+	}
+	deleteContact(contactNameFromPath(a_Request.m_Path));
+	res.m_Status = 204;
+	return res;
+}
+
+
+
+
+
+QString MockCardDavServer::contactNameFromPath(const QString & a_Path) const
+{
+	if (!a_Path.startsWith(ADDRESSBOOK_PATH))
+	{
+		return QString();
+	}
+	auto name = a_Path.mid(ADDRESSBOOK_PATH.length());
+	if (name.contains('/'))
+	{
+		return QString();
+	}
+	return name;
+}
+
+
+
+
+
+QString MockCardDavServer::syncToken() const
+{
+	return SYNC_TOKEN_PREFIX + QString::number(m_ModSeq);
+}
+
+
+
+
+
+QByteArray MockCardDavServer::serializeResponse(const Response & a_Response)
+{
+	QByteArray res = "HTTP/1.1 " + QByteArray::number(a_Response.m_Status) + " " + reasonPhrase(a_Response.m_Status) + "\r\n";
+	for (const auto & hdr: a_Response.m_Headers)
+	{
+		res.append(hdr.first + ": " + hdr.second + "\r\n");
+	}
+	res.append("Content-Length: " + QByteArray::number(a_Response.m_Body.size()) + "\r\n\r\n");
+	res.append(a_Response.m_Body);
+	return res;
+}
+
+
+
+
+
+void MockCardDavServer::sendResponse(QTcpSocket * a_Socket, const Response & a_Response)
+{
+	QPointer<QTcpSocket> socket(a_Socket);
+	auto isDrop = (a_Response.m_Status == 0);
+	auto data = isDrop ? QByteArray() : serializeResponse(a_Response);
+	QTimer::singleShot(m_LatencyMsec, this, [this, socket, data, isDrop]()
+		{
+			if (socket == nullptr)
+			{
+				return;
+			}
+			if (isDrop)
+			{
+				socket->abort();
+				return;
+			}
+			auto itr = m_Connections.find(socket.data());
+			if (itr == m_Connections.end())
+			{
+				return;
+			}
+			itr->second.m_Pending = data;
+			sendPendingData(socket.data());
+		}
+	);
+}
+
+
+
+
+
+void MockCardDavServer::sendPendingData(QTcpSocket * a_Socket)
+{
+	auto itr = m_Connections.find(a_Socket);
+	if (itr == m_Connections.end())
+	{
+		return;
+	}
+	auto & conn = itr->second;
+	auto chunkSize = conn.m_Pending.size();
+	if (m_BandwidthBytesPerSec > 0)
+	{
+		chunkSize = std::max(m_BandwidthBytesPerSec * THROTTLE_INTERVAL_MSEC / 1000, 1);
+	}
+	auto chunk = conn.m_Pending.left(chunkSize);
+	conn.m_Pending.remove(0, chunk.size());
+	a_Socket->write(chunk);
+	m_NumBytesSent += chunk.size();
+	if (!conn.m_Pending.isEmpty())
+	{
+		QPointer<QTcpSocket> socket(a_Socket);
+		QTimer::singleShot(THROTTLE_INTERVAL_MSEC, this, [this, socket]()
+			{
+				if (socket != nullptr)
+				{
+					sendPendingData(socket.data());
+				}
+			}
+		);
+		return;
+	}
+
+	// The response has been sent, continue with the next pipelined request:
+	conn.m_IsBusy = false;
+	processNextRequest(a_Socket);
+}
+
+
+
+
+
+void MockCardDavServer::newConnection()
+{
+	while (m_Server.hasPendingConnections())
+	{
+		auto socket = m_Server.nextPendingConnection();
+		m_Connections[socket] = Connection();
+		connect(socket, &QTcpSocket::readyRead, this, [this, socket]()
+			{
+				auto itr = m_Connections.find(socket);
+				if (itr == m_Connections.end())
+				{
+					return;
+				}
+				itr->second.m_Buffer.append(socket->readAll());
+				processNextRequest(socket);
+			}
+		);
+		connect(socket, &QTcpSocket::disconnected, this, [this, socket]()
+			{
+				m_Connections.erase(socket);
+				socket->deleteLater();
+			}
+		);
+	}
+}
@@ -0,0 +1,261 @@
+#ifndef MOCKCARDDAVSERVER_H
+#define MOCKCARDDAVSERVER_H
+
+
+
+
+
+#include <map>
+#include <random>
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QUrl>
+#include <QTcpServer>
+
+
+
+
+
+// fwd:
+class QTcpSocket;
+
+
+
+
+
+/** A minimal in-process CardDAV server, for testing and benchmarking DeviceCardDav and DavPropertyTree without
+a real server.
+Serves a single user with a single addressbook over plain HTTP/1.1 on the loopback interface, supporting
+keep-alive and pipelined requests. Implements OPTIONS, the PROPFIND service discovery (current-user-principal,
+addressbook-home-set, addressbook listing, getctag / sync-token), the addressbook-query, addressbook-multiget and
+sync-collection REPORTs, and conditional PUT and DELETE of the contacts.
+The network conditions can be simulated: a fixed latency is added to each response, the response bodies can be
+throttled to a given bandwidth and errors can be injected, either randomly or for the next N requests of
+a method. Authentication is not checked, any credentials are accepted.
+Runs in the thread that created it, using the event loop of that thread. */
+class MockCardDavServer:
+	public QObject
+{
+	Q_OBJECT
+	using Super = QObject;
+
+
+public:
+
+	/** A single contact in the addressbook. */
+	struct StoredContact
+	{
+		/** The vCard data. */
+		QByteArray m_Data;
+
+		/** The ETag, including the quotes. */
+		QString m_Etag;
+
+		/** The value of the modification counter when the contact was last changed (for sync-collection). */
+		quint64 m_ModSeq;
+	};
+
+
+	explicit MockCardDavServer(QObject * a_Parent = nullptr);
+
+	/** Starts listening on a random port of the loopback interface.
+	Returns true on success. */
+	bool listen();
+
+	/** Returns the URL of the server root, to be used as the serverUrl of DeviceCardDav. */
+	QUrl baseUrl() const;
+
+	/** Returns the URL of the addressbook. */
+	QUrl addressbookUrl() const;
+
+	/** Sets the delay added before sending each response. */
+	void setLatency(int a_Msec) { m_LatencyMsec = a_Msec; }
+
+	/** Sets the rate at which the responses are sent, 0 for unlimited. */
+	void setBandwidth(int a_BytesPerSec) { m_BandwidthBytesPerSec = a_BytesPerSec; }
+
+	/** Enables or disables the support for the sync-collection REPORT and the DAV:sync-token property.
+	Without it, the clients have to use the addressbook-query ETag listing. */
+	void setSyncCollectionSupported(bool a_IsSupported) { m_IsSyncCollectionSupported = a_IsSupported; }
+
+	/** Sets the probability (0 .. 1) of any request failing with the specified status.
+	Status 0 means closing the connection without any response. */
+	void setErrorRate(double a_Probability, int a_HttpStatus = 503);
+
+	/** Makes the next a_Count requests of the specified kind fail with the specified status.
+	The kind is either the method (such as "PUT") or, for the REPORTs, also the report type (such as
+	"addressbook-multiget"). Status 0 means closing the connection without any response. */
+	void failNextRequests(const QByteArray & a_Kind, int a_Count, int a_HttpStatus = 500);
+
+	/** Adds a_Count synthetic contacts, named "contact-NNNNNN.vcf", continuing the numbering of the previous
+	generated contacts. */
+	void generateContacts(int a_Count);
+
+	/** Adds or changes the contact with the specified name (relative to the addressbook).
+	Returns the new ETag. */
+	QString putContact(const QString & a_Name, const QByteArray & a_Data);
+
+	/** Removes the contact with the specified name (relative to the addressbook), if present. */
+	void deleteContact(const QString & a_Name);
+
+	/** Returns the contact with the specified name, or nullptr if there's no such contact. */
+	const StoredContact * contact(const QString & a_Name) const;
+
+	/** Returns the number of contacts in the addressbook. */
+	int numContacts() const { return m_Contacts.size(); }
+
+	/** Returns the current getctag value of the addressbook. */
+	QString ctag() const { return QString::number(m_ModSeq); }
+
+	/** Returns the number of requests received of the specified kind (the method or the report type, see
+	failNextRequests()). */
+	int numRequests(const QByteArray & a_Kind) const { return m_NumRequests.value(a_Kind); }
+
+	/** Returns the total number of response bytes sent so far. */
+	qint64 numBytesSent() const { return m_NumBytesSent; }
+
+	/** Generates the vCard data of a synthetic contact with the specified index. */
+	static QByteArray syntheticContactData(int a_Index);
+
+
+protected:
+
+	/** A single request parsed from a connection. */
+	struct Request
+	{
+		QByteArray m_Method;
+		QString m_Path;
+		QHash<QByteArray, QByteArray> m_Headers;  // Lowercase names
+		QByteArray m_Body;
+	};
+
+	/** A single response to be sent over a connection. */
+	struct Response
+	{
+		int m_Status;
+		QList<QPair<QByteArray, QByteArray>> m_Headers;
+		QByteArray m_Body;
+
+		Response():
+			m_Status(200)
+		{
+		}
+	};
+
+	/** The state of a single client connection.
+	The requests are handled one at a time, in the order received, so that the pipelined responses are sent
+	in the correct order. */
+	struct Connection
+	{
+		/** The received data not yet parsed into requests. */
+		QByteArray m_Buffer;
+
+		/** Set while a response is being delayed or sent. */
+		bool m_IsBusy;
+
+		/** The response data still to be sent, when throttling the bandwidth. */
+		QByteArray m_Pending;
+
+		Connection():
+			m_IsBusy(false)
+		{
+		}
+	};
+
+
+	/** The listening socket. */
+	QTcpServer m_Server;
+
+	/** The state of all the client connections. */
+	std::map<QTcpSocket *, Connection> m_Connections;
+
+	/** The contacts, mapped by their name relative to the addressbook. */
+	QMap<QString, StoredContact> m_Contacts;
+
+	/** The removed contacts, mapped by their name to the value of the modification counter when removed
+	(for sync-collection). */
+	QHash<QString, quint64> m_Tombstones;
+
+	/** The modification counter, incremented on each change of the addressbook. Serves as the getctag and
+	the sync token. */
+	quint64 m_ModSeq;
+
+	/** The number of synthetic contacts generated so far. */
+	int m_NumGenerated;
+
+	int m_LatencyMsec;
+	int m_BandwidthBytesPerSec;
+	bool m_IsSyncCollectionSupported;
+	double m_ErrorRate;
+	int m_ErrorRateStatus;
+
+	/** The number of requests to fail and the status to fail them with, per request kind. */
+	QHash<QByteArray, QPair<int, int>> m_FailNext;
+
+	QHash<QByteArray, int> m_NumRequests;
+	qint64 m_NumBytesSent;
+
+	/** The generator for the random errors; seeded with a constant, so that the runs are repeatable. */
+	std::mt19937 m_Random;
+
+
+	/** Parses and handles the next complete request received on the connection, if not busy. */
+	void processNextRequest(QTcpSocket * a_Socket);
+
+	/** Extracts the next complete request from the buffer into a_Request.
+	Returns false if there's no complete request in the buffer yet. */
+	static bool extractRequest(QByteArray & a_Buffer, Request & a_Request);
+
+	/** Returns the kinds of the request, for counting and failing: the method and, for the REPORTs, the local
+	name of the body's root element. */
+	static QList<QByteArray> requestKinds(const Request & a_Request);
+
+	/** Returns the response for the specified request, including the injected errors.
+	Returns a response with status 0 to close the connection. */
+	Response handleRequest(const Request & a_Request);
+
+	Response handleOptions(const Request & a_Request);
+	Response handlePropfind(const Request & a_Request);
+	Response handleReport(const Request & a_Request);
+	Response handlePut(const Request & a_Request);
+	Response handleDelete(const Request & a_Request);
+
+	/** Handles the addressbook-query REPORT, listing the ETags of all the contacts. */
+	Response reportAddressbookQuery();
+
+	/** Handles the addressbook-multiget REPORT, returning the data of the requested contacts. */
+	Response reportMultiget(const Request & a_Request);
+
+	/** Handles the sync-collection REPORT, listing the changes since the token in the request. */
+	Response reportSyncCollection(const Request & a_Request);
+
+	/** Returns the contact name from the request path, or an empty string if the path isn't a contact in
+	the addressbook. */
+	QString contactNameFromPath(const QString & a_Path) const;
+
+	/** Returns the sync token representing the current state of the addressbook. */
+	QString syncToken() const;
+
+	/** Returns the serialized HTTP response. */
+	static QByteArray serializeResponse(const Response & a_Response);
+
+	/** Sends the response after the configured latency, throttled to the configured bandwidth, then continues
+	with the next request on the connection. */
+	void sendResponse(QTcpSocket * a_Socket, const Response & a_Response);
+
+	/** Sends the next part of the connection's pending data, according to the bandwidth. */
+	void sendPendingData(QTcpSocket * a_Socket);
+
+
+protected slots:
+
+	/** Accepts the new client connections. */
+	void newConnection();
+};
+
+
+
+
+
+#endif // MOCKCARDDAVSERVER_H
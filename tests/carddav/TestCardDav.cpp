@@ -0,0 +1,711 @@
+#include <memory>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QtTest>
+#include "../../DavRequestMetrics.h"
+#include "../../DeviceCardDav.h"
+#include "MockCardDavServer.h"
+
+
+
+
+
+/** Exposes the internal state of DeviceCardDav needed for waiting on its async operations. */
+class TestCardDavDevice:
+	public DeviceCardDav
+{
+public:
+
+	/** Returns true if there's no poll, no push and no multiget in progress. */
+	bool isIdle() const
+	{
+		return (
+			!m_PollScheduler.isPolling() &&
+			m_PushQueue.empty() && m_PushesInFlight.empty() &&
+			m_MultigetQueue.empty() && m_MultigetsInFlight.empty()
+		);
+	}
+
+	/** Starts a poll right away, instead of waiting for the poll interval. */
+	void pollNow()
+	{
+		m_PollScheduler.requestPoll();
+	}
+
+	/** Returns the (single) addressbook, or nullptr if not discovered yet. */
+	ContactBookPtr book() const
+	{
+		return m_ContactBooks.empty() ? nullptr : m_ContactBooks[0];
+	}
+
+	/** Returns the contact with the specified name relative to the addressbook, or nullptr if not present. */
+	ContactPtr contactByName(const QString & a_Name) const
+	{
+		if (m_ContactBooks.empty())
+		{
+			return nullptr;
+		}
+		const auto & cb = m_ContactBooks[0];
+		return cb->contactFromUrl(cb->urlFromRelativeHref(a_Name));
+	}
+
+	/** Returns true if the contact with the specified name has local changes not yet written to the server. */
+	bool isModified(const QString & a_Name) const
+	{
+		auto dc = std::dynamic_pointer_cast<DavContact>(contactByName(a_Name));
+		return ((dc != nullptr) && dc->isModified());
+	}
+
+	/** Returns the ETag that the contact with the specified name is based on, or an empty string if not present. */
+	QString etag(const QString & a_Name) const
+	{
+		auto dc = std::dynamic_pointer_cast<DavContact>(contactByName(a_Name));
+		return (dc == nullptr) ? QString() : dc->etag();
+	}
+};
+
+
+
+
+
+/** Returns the value of the FN sentence in the contact, or an empty array if there's none. */
+static QByteArray formattedName(const Contact & a_Contact)
+{
+	for (const auto & s: a_Contact.sentences())
+	{
+		if (s.m_Key == "fn")
+		{
+			return s.m_Value;
+		}
+	}
+	return QByteArray();
+}
+
+
+
+
+
+/** Returns a copy of the contact with the FN sentence set to the specified value. */
+static ContactPtr withFormattedName(const Contact & a_Contact, const QByteArray & a_FormattedName)
+{
+	auto res = a_Contact.clone();
+	auto sentences = res->sentences();
+	for (auto & s: sentences)
+	{
+		if (s.m_Key == "fn")
+		{
+			s.m_Value = a_FormattedName;
+		}
+	}
+	res->setSentences(std::move(sentences));
+	return res;
+}
+
+
+
+
+
+/** Processes the events until the device is idle, or the timeout expires.
+Returns true if the device is idle. Unlike QTRY_VERIFY, returns as soon as the device gets idle, so that
+the measured times are precise. */
+static bool waitForIdle(const TestCardDavDevice & a_Device, int a_TimeoutMsec = 10000)
+{
+	// The deadline timer makes sure that the blocking processEvents() wakes up even with no network activity:
+	QTimer deadline;
+	deadline.setSingleShot(true);
+	deadline.start(a_TimeoutMsec);
+	while (!a_Device.isIdle())
+	{
+		if (!deadline.isActive())
+		{
+			return false;
+		}
+		QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+	}
+	return true;
+}
+
+
+
+
+
+class TestCardDav:
+	public QObject
+{
+	Q_OBJECT
+
+public:
+	TestCardDav();
+
+private Q_SLOTS:
+	void initTestCase();
+	void init();
+	void cleanup();
+
+	void testFirstSync();
+	void testIncrementalSync();
+	void testEtagScan();
+	void testPush();
+	void testPushConflict();
+	void testPushRefusedWithoutChange();
+	void testDeleteConflict();
+	void testMultigetRetry();
+	void testJournalReplay();
+	void testOfflineCache();
+	void testCachedDiscovery();
+
+	void benchmarkSync_data();
+	void benchmarkSync();
+
+private:
+
+	std::unique_ptr<MockCardDavServer> m_Server;
+
+	/** Creates a new (not yet started) device connected to m_Server.
+	The values in a_Config override the defaults. */
+	std::unique_ptr<TestCardDavDevice> createDevice(const QJsonObject & a_Config = QJsonObject());
+};
+
+
+
+
+
+TestCardDav::TestCardDav()
+{
+}
+
+
+
+
+
+void TestCardDav::initTestCase()
+{
+	// Keep the cache and the journal out of the user's data:
+	QStandardPaths::setTestModeEnabled(true);
+
+	// DeviceCardDav logs each request, which would drown the results:
+	QLoggingCategory::setFilterRules("*.debug=false");
+}
+
+
+
+
+
+void TestCardDav::init()
+{
+	QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/CardDav").removeRecursively();
+	QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/CardDav").removeRecursively();
+	m_Server.reset(new MockCardDavServer);
+	QVERIFY(m_Server->listen());
+}
+
+
+
+
+
+void TestCardDav::cleanup()
+{
+	m_Server.reset();
+}
+
+
+
+
+
+std::unique_ptr<TestCardDavDevice> TestCardDav::createDevice(const QJsonObject & a_Config)
+{
+	QJsonObject config;
+	config["serverUrl"] = m_Server->baseUrl().toString();
+	config["userName"]  = QString::fromUtf8("user");
+	config["password"]  = QString::fromUtf8("password");
+	for (auto itr = a_Config.constBegin(), end = a_Config.constEnd(); itr != end; ++itr)
+	{
+		config[itr.key()] = itr.value();
+	}
+	std::unique_ptr<TestCardDavDevice> res(new TestCardDavDevice);
+	if (!static_cast<Device &>(*res).load(config))
+	{
+		return nullptr;
+	}
+	return res;
+}
+
+
+
+
+
+void TestCardDav::testFirstSync()
+{
+	m_Server->generateContacts(25);
+	auto device = createDevice();
+	QVERIFY(device != nullptr);
+	device->start();
+	QVERIFY(waitForIdle(*device));
+	QVERIFY(device->isOnline());
+	QVERIFY(device->book() != nullptr);
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(25));
+	auto contact = device->contactByName("contact-000007.vcf");
+	QVERIFY(contact != nullptr);
+	QCOMPARE(formattedName(*contact), QByteArray("Given7 Surname7"));
+
+	// Each request has been recorded in the metrics:
+	auto metrics = device->requestMetrics();
+	QVERIFY(metrics != nullptr);
+	auto numRequests = m_Server->numRequests("OPTIONS") + m_Server->numRequests("PROPFIND") + m_Server->numRequests("REPORT");
+	QCOMPARE(metrics->total().m_TotalUsec.count(), static_cast<quint64>(numRequests));
+	QVERIFY(metrics->total().m_StatusCounts.count(207) > 0);
+	QVERIFY(metrics->total().m_BytesDown.sum() > 0);
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testIncrementalSync()
+{
+	m_Server->generateContacts(20);
+	auto device = createDevice();
+	device->start();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(20));
+
+	// Change the addressbook on the server:
+	m_Server->generateContacts(1);
+	m_Server->putContact(
+		"contact-000003.vcf",
+		MockCardDavServer::syntheticContactData(3).replace("FN:Given3 Surname3", "FN:Changed on server")
+	);
+	m_Server->deleteContact("contact-000005.vcf");
+
+	// Only the changes should be fetched, in a single multiget:
+	auto numMultigets = m_Server->numRequests("addressbook-multiget");
+	device->pollNow();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(m_Server->numRequests("addressbook-multiget"), numMultigets + 1);
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(20));
+	QVERIFY(device->contactByName("contact-000020.vcf") != nullptr);
+	QVERIFY(device->contactByName("contact-000005.vcf") == nullptr);
+	auto changed = device->contactByName("contact-000003.vcf");
+	QVERIFY(changed != nullptr);
+	QCOMPARE(formattedName(*changed), QByteArray("Changed on server"));
+
+	// Polling an unchanged addressbook shouldn't run any REPORT:
+	auto numReports = m_Server->numRequests("REPORT");
+	device->pollNow();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(m_Server->numRequests("REPORT"), numReports);
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testEtagScan()
+{
+	m_Server->setSyncCollectionSupported(false);
+	m_Server->generateContacts(10);
+	auto device = createDevice();
+	device->start();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(10));
+	QVERIFY(m_Server->numRequests("addressbook-query") > 0);
+
+	m_Server->deleteContact("contact-000002.vcf");
+	m_Server->generateContacts(2);
+	device->pollNow();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(11));
+	QVERIFY(device->contactByName("contact-000002.vcf") == nullptr);
+	QVERIFY(device->contactByName("contact-000011.vcf") != nullptr);
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testPush()
+{
+	m_Server->generateContacts(5);
+	auto device = createDevice();
+	device->start();
+	QVERIFY(waitForIdle(*device));
+	auto book = device->book();
+	QVERIFY(book != nullptr);
+
+	// Change, add and delete a contact locally, the changes are pushed right away:
+	{
+		ContactBook::Batch batch(*book);
+		auto changed = device->contactByName("contact-000001.vcf");
+		QVERIFY(changed != nullptr);
+		book->replaceContact(changed.get(), withFormattedName(*changed, "Changed locally"));
+		auto added = book->createNewContact();
+		Contact::Sentence fn;
+		fn.m_Key = "fn";
+		fn.m_Value = "Added locally";
+		added->addSentence(fn);
+		book->delContact(device->contactByName("contact-000004.vcf").get());
+	}
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(book->contacts().size(), static_cast<size_t>(5));
+
+	QCOMPARE(m_Server->numContacts(), 5);
+	QVERIFY(m_Server->contact("contact-000004.vcf") == nullptr);
+	auto changed = m_Server->contact("contact-000001.vcf");
+	QVERIFY(changed != nullptr);
+	QVERIFY(changed->m_Data.toLower().contains("fn:changed locally"));
+	QCOMPARE(m_Server->numRequests("PUT"), 2);
+	QCOMPARE(m_Server->numRequests("DELETE"), 1);
+
+	// The pushed contacts are no longer modified, another push does nothing:
+	device->pushChanges();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(m_Server->numRequests("PUT"), 2);
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testPushConflict()
+{
+	m_Server->generateContacts(5);
+	auto device = createDevice();
+	std::vector<std::pair<ContactPtr, ContactPtr>> conflicts;
+	connect(device.get(), &DeviceCardDav::pushConflict,
+		[&conflicts](const ContactBook *, ContactPtr a_LocalContact, ContactPtr a_ServerContact)
+		{
+			conflicts.emplace_back(a_LocalContact, a_ServerContact);
+		}
+	);
+	device->start();
+	QVERIFY(waitForIdle(*device));
+
+	// Change the same contact on the server and locally, before the device notices the server change:
+	m_Server->putContact(
+		"contact-000003.vcf",
+		MockCardDavServer::syntheticContactData(3).replace("FN:Given3 Surname3", "FN:Changed on server")
+	);
+	auto book = device->book();
+	auto local = device->contactByName("contact-000003.vcf");
+	{
+		ContactBook::Batch batch(*book);
+		book->replaceContact(local.get(), withFormattedName(*local, "Changed locally"));
+	}
+	QVERIFY(waitForIdle(*device));
+
+	// The PUT has been refused and the conflict reported with both versions:
+	QCOMPARE(m_Server->numRequests("PUT"), 1);
+	QCOMPARE(conflicts.size(), static_cast<size_t>(1));
+	QCOMPARE(formattedName(*conflicts[0].first), QByteArray("Changed locally"));
+	QCOMPARE(formattedName(*conflicts[0].second), QByteArray("Changed on server"));
+	QVERIFY(m_Server->contact("contact-000003.vcf")->m_Data.contains("FN:Changed on server"));
+
+	// The local version is kept, still pending, and rebased onto the server version:
+	auto current = device->contactByName("contact-000003.vcf");
+	QVERIFY(current != nullptr);
+	QCOMPARE(formattedName(*current), QByteArray("Changed locally"));
+	QVERIFY(device->isModified("contact-000003.vcf"));
+	QCOMPARE(device->etag("contact-000003.vcf"), m_Server->contact("contact-000003.vcf")->m_Etag);
+
+	// The next push overwrites the server version:
+	device->pushChanges();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(m_Server->numRequests("PUT"), 2);
+	QVERIFY(m_Server->contact("contact-000003.vcf")->m_Data.toLower().contains("fn:changed locally"));
+	QVERIFY(!device->isModified("contact-000003.vcf"));
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testPushRefusedWithoutChange()
+{
+	m_Server->generateContacts(5);
+	auto device = createDevice();
+	std::vector<std::pair<ContactPtr, ContactPtr>> conflicts;
+	connect(device.get(), &DeviceCardDav::pushConflict,
+		[&conflicts](const ContactBook *, ContactPtr a_LocalContact, ContactPtr a_ServerContact)
+		{
+			conflicts.emplace_back(a_LocalContact, a_ServerContact);
+		}
+	);
+	device->start();
+	QVERIFY(waitForIdle(*device));
+
+	// The server refuses the PUT as a conflict, although the contact hasn't changed there:
+	m_Server->failNextRequests("PUT", 1, 412);
+	auto etag = m_Server->contact("contact-000003.vcf")->m_Etag;
+	auto book = device->book();
+	auto local = device->contactByName("contact-000003.vcf");
+	{
+		ContactBook::Batch batch(*book);
+		book->replaceContact(local.get(), withFormattedName(*local, "Changed locally"));
+	}
+	QVERIFY(waitForIdle(*device));
+
+	// The re-fetched server version is the one the local change is based on, so there's no conflict,
+	// the local contact is kept as it was:
+	QCOMPARE(m_Server->numRequests("PUT"), 1);
+	QVERIFY(conflicts.empty());
+	QCOMPARE(formattedName(*device->contactByName("contact-000003.vcf")), QByteArray("Changed locally"));
+	QVERIFY(device->isModified("contact-000003.vcf"));
+	QCOMPARE(device->etag("contact-000003.vcf"), etag);
+
+	// The next push writes it:
+	device->pushChanges();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(m_Server->numRequests("PUT"), 2);
+	QVERIFY(m_Server->contact("contact-000003.vcf")->m_Data.toLower().contains("fn:changed locally"));
+	QVERIFY(!device->isModified("contact-000003.vcf"));
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testDeleteConflict()
+{
+	m_Server->generateContacts(5);
+	auto device = createDevice();
+	std::vector<std::pair<ContactPtr, ContactPtr>> conflicts;
+	connect(device.get(), &DeviceCardDav::pushConflict,
+		[&conflicts](const ContactBook *, ContactPtr a_LocalContact, ContactPtr a_ServerContact)
+		{
+			conflicts.emplace_back(a_LocalContact, a_ServerContact);
+		}
+	);
+	device->start();
+	QVERIFY(waitForIdle(*device));
+
+	// Change the contact on the server and delete it locally, before the device notices the server change:
+	m_Server->putContact(
+		"contact-000003.vcf",
+		MockCardDavServer::syntheticContactData(3).replace("FN:Given3 Surname3", "FN:Changed on server")
+	);
+	auto book = device->book();
+	book->delContact(device->contactByName("contact-000003.vcf").get());
+	QVERIFY(waitForIdle(*device));
+
+	// The DELETE has been refused and the conflict reported with no local version:
+	QCOMPARE(m_Server->numRequests("DELETE"), 1);
+	QVERIFY(m_Server->contact("contact-000003.vcf") != nullptr);
+	QCOMPARE(conflicts.size(), static_cast<size_t>(1));
+	QVERIFY(conflicts[0].first == nullptr);
+	QCOMPARE(formattedName(*conflicts[0].second), QByteArray("Changed on server"));
+
+	// The contact stays deleted locally, the next push deletes the server version:
+	QVERIFY(device->contactByName("contact-000003.vcf") == nullptr);
+	QCOMPARE(book->contacts().size(), static_cast<size_t>(4));
+	device->pushChanges();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(m_Server->numRequests("DELETE"), 2);
+	QVERIFY(m_Server->contact("contact-000003.vcf") == nullptr);
+	QCOMPARE(m_Server->numContacts(), 4);
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testMultigetRetry()
+{
+	m_Server->generateContacts(30);
+	m_Server->failNextRequests("addressbook-multiget", 2, 503);
+	QJsonObject config;
+	config["multigetBatchSize"] = 10;
+	config["maxMultigetsInFlight"] = 1;
+	auto device = createDevice(config);
+	device->start();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(30));
+	QCOMPARE(m_Server->numRequests("addressbook-multiget"), 5);
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testJournalReplay()
+{
+	m_Server->generateContacts(5);
+	auto device = createDevice();
+	device->start();
+	QVERIFY(waitForIdle(*device));
+
+	// A local change that the server fails to store:
+	m_Server->failNextRequests("PUT", 1, 503);
+	auto book = device->book();
+	auto local = device->contactByName("contact-000002.vcf");
+	{
+		ContactBook::Batch batch(*book);
+		book->replaceContact(local.get(), withFormattedName(*local, "Changed locally"));
+	}
+	QVERIFY(waitForIdle(*device));
+	QVERIFY(!m_Server->contact("contact-000002.vcf")->m_Data.toLower().contains("fn:changed locally"));
+
+	// The change is written from the journal on the next app run:
+	auto config = static_cast<const Device &>(*device).save();
+	device->stop();
+	device.reset();
+	device = createDevice(config);
+	device->start();
+	QVERIFY(waitForIdle(*device));
+	QTRY_VERIFY(m_Server->contact("contact-000002.vcf")->m_Data.toLower().contains("fn:changed locally"));
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testOfflineCache()
+{
+	m_Server->generateContacts(10);
+	auto device = createDevice();
+	device->start();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(10));
+	auto config = static_cast<const Device &>(*device).save();
+	device->stop();
+	device.reset();
+
+	// With the server gone, the contacts are shown from the cache right away:
+	device = createDevice(config);
+	m_Server.reset();
+	device->start();
+	QVERIFY(device->book() != nullptr);
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(10));
+	auto contact = device->contactByName("contact-000007.vcf");
+	QVERIFY(contact != nullptr);
+	QCOMPARE(formattedName(*contact), QByteArray("Given7 Surname7"));
+
+	// The failed poll leaves the device offline, with the cached contacts intact:
+	QVERIFY(waitForIdle(*device));
+	QVERIFY(!device->isOnline());
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(10));
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::testCachedDiscovery()
+{
+	m_Server->generateContacts(5);
+	auto device = createDevice();
+	device->start();
+	QVERIFY(waitForIdle(*device));
+	auto numOptions = m_Server->numRequests("OPTIONS");
+	QVERIFY(numOptions > 0);
+
+	// The next poll reuses the discovered URLs:
+	device->pollNow();
+	QVERIFY(waitForIdle(*device));
+	QCOMPARE(m_Server->numRequests("OPTIONS"), numOptions);
+
+	// So does the next app run, with the discovery results loaded from the config:
+	auto config = static_cast<const Device &>(*device).save();
+	device->stop();
+	device.reset();
+	device = createDevice(config);
+	device->start();
+	QVERIFY(waitForIdle(*device));
+	QVERIFY(device->isOnline());
+	QCOMPARE(m_Server->numRequests("OPTIONS"), numOptions);
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(5));
+	device->stop();
+}
+
+
+
+
+
+void TestCardDav::benchmarkSync_data()
+{
+	QTest::addColumn<int>("numContacts");
+
+	QTest::newRow("1k")   << 1000;
+	QTest::newRow("10k")  << 10000;
+	QTest::newRow("100k") << 100000;
+}
+
+
+
+
+
+void TestCardDav::benchmarkSync()
+{
+	QFETCH(int, numContacts);
+	if ((numContacts > 1000) && qEnvironmentVariableIsEmpty("CARDDAV_BENCHMARK"))
+	{
+		QSKIP("Set CARDDAV_BENCHMARK=1 to run the large benchmarks.");
+	}
+
+	// The simulated network conditions can be set through the environment:
+	m_Server->setLatency(qEnvironmentVariableIntValue("CARDDAV_BENCHMARK_LATENCY"));
+	m_Server->setBandwidth(qEnvironmentVariableIntValue("CARDDAV_BENCHMARK_BANDWIDTH"));
+	m_Server->generateContacts(numContacts);
+	auto timeout = 60000 + numContacts * 5;
+
+	// First sync, from an empty cache:
+	auto device = createDevice();
+	QElapsedTimer timer;
+	timer.start();
+	device->start();
+	QVERIFY(waitForIdle(*device, timeout));
+	auto firstSyncMsec = timer.elapsed();
+	auto firstSyncBytes = m_Server->numBytesSent();
+	QCOMPARE(device->book()->contacts().size(), static_cast<size_t>(numContacts));
+
+	// Steady-state poll, nothing changed:
+	auto bytesBefore = m_Server->numBytesSent();
+	timer.restart();
+	device->pollNow();
+	QVERIFY(waitForIdle(*device, timeout));
+	auto steadyPollMsec = timer.elapsed();
+	auto steadyPollBytes = m_Server->numBytesSent() - bytesBefore;
+
+	// Poll with a single changed contact:
+	m_Server->putContact("contact-000000.vcf", MockCardDavServer::syntheticContactData(numContacts));
+	bytesBefore = m_Server->numBytesSent();
+	timer.restart();
+	device->pollNow();
+	QVERIFY(waitForIdle(*device, timeout));
+	auto changePollMsec = timer.elapsed();
+	auto changePollBytes = m_Server->numBytesSent() - bytesBefore;
+	device->stop();
+
+	qInfo("%d contacts: first sync %lld ms (%lld bytes), steady-state poll %lld ms (%lld bytes), "
+		"single-change poll %lld ms (%lld bytes)",
+		numContacts,
+		static_cast<long long>(firstSyncMsec), static_cast<long long>(firstSyncBytes),
+		static_cast<long long>(steadyPollMsec), static_cast<long long>(steadyPollBytes),
+		static_cast<long long>(changePollMsec), static_cast<long long>(changePollBytes)
+	);
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestCardDav)
+
+
+
+
+
+#include "TestCardDav.moc"
@@ -0,0 +1,174 @@
+#include <QString>
+#include <QtTest>
+#include "../../ContactBookDiff.h"
+#include "../../VCardParser.h"
+#include "../TestHelpers.h"
+
+
+
+
+
+class TestContactBookDiff:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testIdentical();
+	void testUidInOneBookOnly();
+	void testTransitiveKeys();
+	void testMissing();
+	void testMultipleInOneBook();
+	void testMatchKeys();
+};
+
+
+
+
+
+void TestContactBookDiff::testIdentical()
+{
+	// The sentence order doesn't matter:
+	auto book1 = parseBook("book1", vcard("FN:Jan Novak\r\nTEL:+420603123456\r\n"));
+	auto book2 = parseBook("book2", vcard("TEL:+420603123456\r\nFN:Jan Novak\r\n"));
+	ContactBookDiff diff({book1, book2});
+	QCOMPARE(diff.rows().size(), static_cast<size_t>(1));
+	QCOMPARE(diff.count(ContactBookDiff::stIdentical), static_cast<size_t>(1));
+	QCOMPARE(diff.rows()[0].m_Contacts[0], book1->contacts()[0]);
+	QCOMPARE(diff.rows()[0].m_Contacts[1], book2->contacts()[0]);
+}
+
+
+
+
+
+void TestContactBookDiff::testUidInOneBookOnly()
+{
+	// The server assigned a UID, the phone export doesn't have it; they still match on the name and e-mail:
+	auto server = parseBook("server", vcard("UID:abc-123\r\nFN:Jan Novak\r\nEMAIL:jan@novak.cz\r\n"));
+	auto phone = parseBook("phone", vcard("FN:Jan Novak\r\nEMAIL:jan@novak.cz\r\nTEL:+420603123456\r\n"));
+	ContactBookDiff diff({server, phone});
+	QCOMPARE(diff.rows().size(), static_cast<size_t>(1));
+	const auto & row = diff.rows()[0];
+	QCOMPARE(row.m_Status, ContactBookDiff::stChanged);
+	QCOMPARE(row.m_Key, QString("uid:abc-123"));
+	QCOMPARE(row.m_Contacts[0], server->contacts()[0]);
+	QCOMPARE(row.m_Contacts[1], phone->contacts()[0]);
+}
+
+
+
+
+
+void TestContactBookDiff::testTransitiveKeys()
+{
+	// Book 1 and 2 share the e-mail, book 2 and 3 share the phone; all three are the same contact:
+	auto book1 = parseBook("book1", vcard("FN:Jan Novak\r\nEMAIL:jan@novak.cz\r\n"));
+	auto book2 = parseBook("book2", vcard("FN:J. Novak\r\nEMAIL:JAN@novak.cz\r\nTEL:+420 603 123 456\r\n"));
+	auto book3 = parseBook("book3", vcard("FN:Honza\r\nTEL:+420603123456\r\n"));
+	ContactBookDiff diff({book1, book2, book3});
+	QCOMPARE(diff.rows().size(), static_cast<size_t>(1));
+	QCOMPARE(diff.count(ContactBookDiff::stChanged), static_cast<size_t>(1));
+	for (const auto & c: diff.rows()[0].m_Contacts)
+	{
+		QVERIFY(c != nullptr);
+	}
+}
+
+
+
+
+
+void TestContactBookDiff::testMissing()
+{
+	auto book1 = parseBook("book1",
+		vcard("FN:Jan Novak\r\n") +
+		vcard("FN:Petr Svoboda\r\n") +
+		vcard("NOTE:No name\\, no number\r\n")
+	);
+	auto book2 = parseBook("book2", vcard("FN:Jan Novak\r\n"));
+	auto book3 = parseBook("book3", vcard("FN:Petr Svoboda\r\nTEL:+420603123456\r\n"));
+	ContactBookDiff diff({book1, book2, book3});
+	QCOMPARE(diff.rows().size(), static_cast<size_t>(3));
+	QCOMPARE(diff.count(ContactBookDiff::stMissing), static_cast<size_t>(3));
+	for (const auto & row: diff.rows())
+	{
+		if (row.m_Key == "fn:jan novak")
+		{
+			QVERIFY(row.m_Contacts[0] != nullptr);
+			QVERIFY(row.m_Contacts[1] != nullptr);
+			QVERIFY(row.m_Contacts[2] == nullptr);
+		}
+		else if (row.m_Key == "fn:petr svoboda")
+		{
+			QVERIFY(row.m_Contacts[0] != nullptr);
+			QVERIFY(row.m_Contacts[1] == nullptr);
+			QVERIFY(row.m_Contacts[2] != nullptr);
+		}
+		else
+		{
+			// The contact without any key is reported by its fingerprint:
+			QCOMPARE(row.m_Key, QString::fromLatin1(book1->contacts()[2]->fingerprint().toHex()));
+			QVERIFY(row.m_Contacts[0] != nullptr);
+			QVERIFY(row.m_Contacts[1] == nullptr);
+			QVERIFY(row.m_Contacts[2] == nullptr);
+		}
+	}
+}
+
+
+
+
+
+void TestContactBookDiff::testMultipleInOneBook()
+{
+	// Two entries for the same person in one book, one in the other; one of them is reported as missing:
+	auto book1 = parseBook("book1",
+		vcard("FN:Jan Novak\r\nTEL:+420603123456\r\n") +
+		vcard("FN:Jan Novak\r\nEMAIL:jan@novak.cz\r\n")
+	);
+	auto book2 = parseBook("book2", vcard("FN:Jan Novak\r\nNOTE:Neighbour\r\n"));
+	ContactBookDiff diff({book1, book2});
+	QCOMPARE(diff.rows().size(), static_cast<size_t>(2));
+	QCOMPARE(diff.count(ContactBookDiff::stChanged), static_cast<size_t>(1));
+	QCOMPARE(diff.count(ContactBookDiff::stMissing), static_cast<size_t>(1));
+}
+
+
+
+
+
+void TestContactBookDiff::testMatchKeys()
+{
+	auto book = parseBook("book", vcard(
+		"UID: abc \r\n"
+		"FN:Jan  NOVAK\r\n"
+		"EMAIL:Jan@Novak.CZ\r\n"
+		"EMAIL:jan@novak.cz\r\n"
+		"TEL:+420 603 123 456\r\n"
+	));
+	const auto & contact = *book->contacts()[0];
+	auto keys = ContactBookDiff::matchKeys(contact);
+	QCOMPARE(keys.size(), static_cast<size_t>(4));
+	QCOMPARE(keys[0], QString("uid:abc"));
+	QCOMPARE(keys[1], QString("fn:jan novak"));
+	QCOMPARE(keys[2], QString("email:jan@novak.cz"));
+	QCOMPARE(keys[3], QString("tel:+420603123456"));
+	QCOMPARE(ContactBookDiff::matchKey(contact), QString("uid:abc"));
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestContactBookDiff)
+
+
+
+
+
+#include "TestContactBookDiff.moc"
+
+
+
+
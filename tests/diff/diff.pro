@@ -0,0 +1,40 @@
+#-------------------------------------------------
+#
+# Unit tests of ContactBookDiff
+#
+#-------------------------------------------------
+
+QT       += testlib concurrent
+
+QT       -= gui
+
+TARGET = TestContactBookDiff
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+SOURCES +=\
+	TestContactBookDiff.cpp \
+	../../ContactBookDiff.cpp \
+	../../VCardParser.cpp \
+	../../Contact.cpp \
+	../../ContactBook.cpp \
+	../../ContactBookIndex.cpp \
+	../../ContactBookSnapshot.cpp \
+	../../Normalizer.cpp \
+	../../PhoneNumber.cpp
+
+HEADERS +=\
+	../../ContactBookDiff.h \
+	../../Contact.h \
+	../../ContactBook.h \
+	../../ContactBookIndex.h \
+	../../ContactBookSnapshot.h \
+	../../Normalizer.h \
+	../../PhoneNumber.h \
+	../TestHelpers.h
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <QString>
+#include <QtTest>
+#include "../../DuplicateFinder.h"
+#include "../../VCardParser.h"
+#include "../TestHelpers.h"
+
+
+
+
+
+/** Returns the FN values of the contacts in the cluster, sorted. */
+static QStringList clusterNames(const DuplicateFinder::Cluster & a_Cluster)
+{
+	QStringList res;
+	for (const auto & item: a_Cluster)
+	{
+		QString name;
+		for (const auto & s: item.m_Contact->sentences())
+		{
+			if (s.m_Key == "fn")
+			{
+				name = QString::fromUtf8(s.m_Value);
+			}
+		}
+		res.append(name);
+	}
+	res.sort();
+	return res;
+}
+
+
+
+
+
+class TestDuplicateFinder:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testBlockingByEmail();
+	void testBlockingAcrossBooks();
+	void testSharedPhoneDifferentNames();
+	void testMaxBlockSize();
+	void testUnionFindGrouping();
+	void testLshRecall();
+};
+
+
+
+
+
+void TestDuplicateFinder::testBlockingByEmail()
+{
+	// The names are too different for the token similarity, but the e-mail (in a different case) matches:
+	auto book = parseBook("book",
+		vcard("FN:J. Smith\r\nEMAIL:john.smith@example.com\r\n") +
+		vcard("FN:John Smith\r\nEMAIL:JOHN.SMITH@Example.COM\r\n") +
+		vcard("FN:Jane Doe\r\nEMAIL:jane@example.com\r\n")
+	);
+	auto clusters = DuplicateFinder().findDuplicates({book});
+	QCOMPARE(clusters.size(), static_cast<size_t>(1));
+	QCOMPARE(clusterNames(clusters[0]), QStringList({"J. Smith", "John Smith"}));
+}
+
+
+
+
+
+void TestDuplicateFinder::testBlockingAcrossBooks()
+{
+	// The same person in two books, only the phone number format differs:
+	auto phone = parseBook("phone", vcard("FN:Jan Novak\r\nTEL:+420 603 123 456\r\n"));
+	auto server = parseBook("server",
+		vcard("FN:Novak Jan\r\nTEL:+420603123456\r\n") +
+		vcard("FN:Petr Svoboda\r\nTEL:+420 777 000 111\r\n")
+	);
+	auto clusters = DuplicateFinder().findDuplicates({phone, server});
+	QCOMPARE(clusters.size(), static_cast<size_t>(1));
+	QCOMPARE(clusters[0].size(), static_cast<size_t>(2));
+	QVERIFY(clusters[0][0].m_ContactBook != clusters[0][1].m_ContactBook);
+	QCOMPARE(clusterNames(clusters[0]), QStringList({"Jan Novak", "Novak Jan"}));
+}
+
+
+
+
+
+void TestDuplicateFinder::testSharedPhoneDifferentNames()
+{
+	// Family members sharing a landline are not duplicates:
+	auto book = parseBook("book",
+		vcard("FN:Alice Brown\r\nTEL:+420 222 333 444\r\n") +
+		vcard("FN:Bob Green\r\nTEL:+420 222 333 444\r\n")
+	);
+	auto clusters = DuplicateFinder().findDuplicates({book});
+	QVERIFY(clusters.empty());
+}
+
+
+
+
+
+void TestDuplicateFinder::testMaxBlockSize()
+{
+	// Five nameless contacts sharing a switchboard number form a single block:
+	QByteArray vcf;
+	for (int i = 0; i < 5; ++i)
+	{
+		vcf.append(vcard("TEL:+420 800 100 200\r\n"));
+	}
+	auto book = parseBook("book", vcf);
+
+	auto clusters = DuplicateFinder().findDuplicates({book});
+	QCOMPARE(clusters.size(), static_cast<size_t>(1));
+	QCOMPARE(clusters[0].size(), static_cast<size_t>(5));
+
+	// An oversized block is skipped altogether:
+	DuplicateFinder limited;
+	limited.setMaxBlockSize(3);
+	QVERIFY(limited.findDuplicates({book}).empty());
+}
+
+
+
+
+
+void TestDuplicateFinder::testUnionFindGrouping()
+{
+	// A-B share an e-mail, B-C share a phone, A-C share nothing but a surname; all three form one cluster.
+	// D-E form a separate cluster, F is unique:
+	auto book = parseBook("book",
+		vcard("FN:Jan Novak\r\nEMAIL:jan@novak.cz\r\n") +
+		vcard("FN:J Novak\r\nEMAIL:jan@novak.cz\r\nTEL:+420 603 555 666\r\n") +
+		vcard("FN:Honza Novak\r\nTEL:+420603555666\r\n") +
+		vcard("FN:Eva Dvorakova\r\nEMAIL:eva@dvorak.cz\r\n") +
+		vcard("FN:Eva Dvorakova\r\nUID:eva-1\r\n") +
+		vcard("FN:Karel Cerny\r\nEMAIL:karel@cerny.cz\r\n")
+	);
+	auto clusters = DuplicateFinder().findDuplicates({book});
+	QCOMPARE(clusters.size(), static_cast<size_t>(2));
+	std::vector<QStringList> names;
+	for (const auto & c: clusters)
+	{
+		names.push_back(clusterNames(c));
+	}
+	std::sort(names.begin(), names.end(),
+		[](const QStringList & a_Names1, const QStringList & a_Names2)
+		{
+			return (a_Names1.size() > a_Names2.size());
+		}
+	);
+	QCOMPARE(names[0], QStringList({"Honza Novak", "J Novak", "Jan Novak"}));
+	QCOMPARE(names[1], QStringList({"Eva Dvorakova", "Eva Dvorakova"}));
+}
+
+
+
+
+
+void TestDuplicateFinder::testLshRecall()
+{
+	// Pairs of contacts without any shared identifier and with different names, that only the MinHash LSH
+	// can bring together. Each pair shares 5 of its 6 name + organization tokens (Jaccard similarity 0.83),
+	// which the 8 bands of 4 rows catch with ~99 % probability. The tokens are unique to each pair.
+	static const int NUM_PAIRS = 200;
+	QByteArray vcf;
+	for (int i = 0; i < NUM_PAIRS; ++i)
+	{
+		auto id = QByteArray::number(i);
+		auto name = "given" + id + " middle" + id + " family" + id;
+		vcf.append(vcard("FN:" + name + "\r\nORG:company" + id + " division" + id + " unit" + id + "\r\n"));
+		vcf.append(vcard("FN:" + name + " company" + id + " division" + id + "\r\n"));
+	}
+	auto book = parseBook("book", vcf);
+	auto clusters = DuplicateFinder().findDuplicates({book});
+
+	// Each found cluster must be exactly one of the pairs:
+	int numFound = 0;
+	for (const auto & c: clusters)
+	{
+		QCOMPARE(c.size(), static_cast<size_t>(2));
+		auto names = clusterNames(c);
+		auto id = names[0].section(' ', 0, 0).mid(5);  // "givenN ..." -> "N"
+		QCOMPARE(names[0], QString("given%1 middle%1 family%1").arg(id));
+		QCOMPARE(names[1], QString("given%1 middle%1 family%1 company%1 division%1").arg(id));
+		numFound += 1;
+	}
+	QVERIFY2(numFound >= NUM_PAIRS * 9 / 10, qPrintable(QString("LSH recall too low: %1 of %2").arg(numFound).arg(NUM_PAIRS)));
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestDuplicateFinder)
+
+
+
+
+
+#include "TestDuplicateFinder.moc"
+
+
+
+
@@ -0,0 +1,62 @@
+#-------------------------------------------------
+#
+# Unit tests of DuplicateFinder
+#
+#-------------------------------------------------
+
+QT       += testlib network xml concurrent
+
+QT       -= gui
+
+TARGET = TestDuplicateFinder
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+SOURCES +=\
+	TestDuplicateFinder.cpp \
+	../../DuplicateFinder.cpp \
+	../../Session.cpp \
+	../../Device.cpp \
+	../../ExampleDevice.cpp \
+	../../DeviceVcfFile.cpp \
+	../../DeviceBackup.cpp \
+	../../DeviceCardDav.cpp \
+	../../DavPropertyTree.cpp \
+	../../DavPropertyHandlers.cpp \
+	../../DavRequestMetrics.cpp \
+	../../PollScheduler.cpp \
+	../../VCardParser.cpp \
+	../../VCardSerializer.cpp \
+	../../Contact.cpp \
+	../../ContactBook.cpp \
+	../../ContactBookIndex.cpp \
+	../../ContactBookSnapshot.cpp \
+	../../Normalizer.cpp \
+	../../PhoneNumber.cpp
+
+HEADERS +=\
+	../../DuplicateFinder.h \
+	../../Session.h \
+	../../Device.h \
+	../../ExampleDevice.h \
+	../../DeviceVcfFile.h \
+	../../DeviceBackup.h \
+	../../DeviceCardDav.h \
+	../../DavPropertyTree.h \
+	../../DavPropertyHandlers.h \
+	../../DavRequestMetrics.h \
+	../../PollScheduler.h \
+	../../VCardSerializer.h \
+	../../Contact.h \
+	../../ContactBook.h \
+	../../ContactBookIndex.h \
+	../../ContactBookSnapshot.h \
+	../../Normalizer.h \
+	../../PhoneNumber.h \
+	../TestHelpers.h
@@ -0,0 +1,263 @@
+#include <random>
+#include <QString>
+#include <QtTest>
+#include "../../FuzzyNameMatcher.h"
+#include "../../VCardParser.h"
+
+
+
+
+
+/** Returns a contact book containing a contact for each of the specified formatted names. */
+static ContactBookPtr bookWithNames(const QStringList & a_Names)
+{
+	ContactBookPtr res(new ContactBook("book"));
+	ContactBook::Batch batch(*res);
+	for (const auto & name: a_Names)
+	{
+		auto contact = res->createNewContact();
+		Contact::Sentence fn;
+		fn.m_Key = "fn";
+		fn.m_Value = name.toUtf8();
+		contact->addSentence(fn);
+	}
+	return res;
+}
+
+
+
+
+
+/** Returns the names of the matches, in the order returned. */
+static QStringList matchNames(const std::vector<FuzzyNameMatcher::Match> & a_Matches)
+{
+	QStringList res;
+	for (const auto & m: a_Matches)
+	{
+		res.append(m.m_Name);
+	}
+	return res;
+}
+
+
+
+
+
+/** Returns a random name composed of syllables, so that the trigram statistics resemble real names. */
+static QString randomName(std::mt19937 & a_Random)
+{
+	static const char * syllables[] =
+	{
+		"an", "ba", "ce", "da", "el", "fi", "go", "ha", "ja", "ka", "lo", "ma", "no", "pe", "ra", "si",
+		"to", "va", "ze", "ri", "mi", "ko", "le", "na"
+	};
+	std::uniform_int_distribution<int> numSyllables(2, 3);
+	std::uniform_int_distribution<size_t> syllable(0, sizeof(syllables) / sizeof(syllables[0]) - 1);
+	QString res;
+	for (int word = 0; word < 2; ++word)
+	{
+		if (word > 0)
+		{
+			res.append(' ');
+		}
+		for (int i = numSyllables(a_Random); i > 0; --i)
+		{
+			res.append(QString::fromLatin1(syllables[syllable(a_Random)]));
+		}
+	}
+	return res;
+}
+
+
+
+
+
+class TestFuzzyNameMatcher:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testMatchKey();
+	void testEditDistance();
+	void testFindSimilar();
+	void testFindSimilarContact();
+	void testIncrementalUpdate();
+	void benchmarkFindSimilar_data();
+	void benchmarkFindSimilar();
+};
+
+
+
+
+
+void TestFuzzyNameMatcher::testMatchKey()
+{
+	QCOMPARE(FuzzyNameMatcher::matchKey(QString::fromUtf8("Jan Novák")), QString("jan novak"));
+	QCOMPARE(FuzzyNameMatcher::matchKey(QString::fromUtf8("Novak Jan")), QString("jan novak"));
+	QCOMPARE(FuzzyNameMatcher::matchKey(QString::fromUtf8("NOVÁK, Jan")), QString("jan novak"));
+	QCOMPARE(FuzzyNameMatcher::matchKey(QString::fromUtf8("J. Novák")), QString("j novak"));
+	QVERIFY(FuzzyNameMatcher::matchKey(" ,. ").isEmpty());
+}
+
+
+
+
+
+void TestFuzzyNameMatcher::testEditDistance()
+{
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance("kitten", "sitting", 3), 3);
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance("kitten", "sitting", 2), 3);
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance("kitten", "kitten", 0), 0);
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance("", "abc", 3), 3);
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance("abc", "", 3), 3);
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance("a", "abcdef", 2), 3);
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance(QString::fromUtf8("žluťoučký"), QString::fromUtf8("zlutoucky"), 5), 4);
+
+	// Strings longer than the machine word use the banded algorithm:
+	QString longStr(100, 'a');
+	auto longStr2 = longStr;
+	longStr2[50] = 'b';
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance(longStr, longStr2, 3), 1);
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance(longStr, longStr + "bcd", 3), 3);
+	QCOMPARE(FuzzyNameMatcher::boundedEditDistance(longStr, longStr + "bcde", 3), 4);
+}
+
+
+
+
+
+void TestFuzzyNameMatcher::testFindSimilar()
+{
+	auto book = bookWithNames({
+		QString::fromUtf8("Jan Novák"),
+		QString::fromUtf8("J. Novak"),
+		QString::fromUtf8("Petr Svoboda"),
+		QString::fromUtf8("Jana Nováková"),
+	});
+	FuzzyNameMatcher matcher;
+	matcher.updateContactBook(book);
+
+	auto matches = matcher.findSimilar("novak jan", 10, 3);
+	QCOMPARE(matchNames(matches), QStringList({QString::fromUtf8("Jan Novák"), QString::fromUtf8("J. Novak")}));
+	QCOMPARE(matches[0].m_Distance, 0);
+	QCOMPARE(matches[1].m_Distance, 2);
+	QCOMPARE(matches[0].m_ContactBook, book);
+
+	// The count limits the results, the best ones are kept:
+	QCOMPARE(matchNames(matcher.findSimilar("novak jan", 1, 3)), QStringList({QString::fromUtf8("Jan Novák")}));
+
+	// A stricter distance drops the abbreviated name:
+	QCOMPARE(matcher.findSimilar("novak jan", 10, 1).size(), static_cast<size_t>(1));
+	QVERIFY(matcher.findSimilar("Karel Cerny", 10, 3).empty());
+	QVERIFY(matcher.findSimilar("", 10, 3).empty());
+}
+
+
+
+
+
+void TestFuzzyNameMatcher::testFindSimilarContact()
+{
+	auto book = bookWithNames({"Jan Novak", "Jan Nowak", "Petr Svoboda"});
+	FuzzyNameMatcher matcher;
+	matcher.updateContactBook(book);
+
+	// The contact itself is not reported:
+	auto matches = matcher.findSimilar(*book->contacts()[0], 10, 3);
+	QCOMPARE(matchNames(matches), QStringList({"Jan Nowak"}));
+	QCOMPARE(matches[0].m_Contact, book->contacts()[1]);
+}
+
+
+
+
+
+void TestFuzzyNameMatcher::testIncrementalUpdate()
+{
+	auto book = bookWithNames({"Jan Novak"});
+	FuzzyNameMatcher matcher;
+	matcher.updateContactBook(book);
+	QVERIFY(matcher.findSimilar("Petr Svoboda", 10, 3).empty());
+
+	// A new contact is only found once the matcher is updated from the new snapshot:
+	{
+		ContactBook::Batch batch(*book);
+		auto contact = book->createNewContact();
+		Contact::Sentence fn;
+		fn.m_Key = "fn";
+		fn.m_Value = "Petr Svoboda";
+		contact->addSentence(fn);
+	}
+	QVERIFY(matcher.findSimilar("Petr Svoboda", 10, 3).empty());
+	matcher.updateContactBook(book);
+	QCOMPARE(matchNames(matcher.findSimilar("Petr Svoboda", 10, 3)), QStringList({"Petr Svoboda"}));
+	QCOMPARE(matchNames(matcher.findSimilar("Jan Novak", 10, 3)), QStringList({"Jan Novak"}));
+
+	// A removed book is no longer searched:
+	matcher.removeContactBook(book.get());
+	QVERIFY(matcher.findSimilar("Jan Novak", 10, 3).empty());
+}
+
+
+
+
+
+void TestFuzzyNameMatcher::benchmarkFindSimilar_data()
+{
+	QTest::addColumn<int>("numNames");
+	QTest::newRow("10k")  << 10000;
+	QTest::newRow("100k") << 100000;
+}
+
+
+
+
+
+void TestFuzzyNameMatcher::benchmarkFindSimilar()
+{
+	QFETCH(int, numNames);
+	std::mt19937 random(numNames);
+	QStringList names;
+	for (int i = 0; i < numNames; ++i)
+	{
+		names.append(randomName(random));
+	}
+	auto book = bookWithNames(names);
+	FuzzyNameMatcher matcher;
+	matcher.updateContactBook(book);
+
+	// Query slightly misspelled names from the book:
+	QStringList queries;
+	for (int i = 0; i < 100; ++i)
+	{
+		auto query = names[(i * 7919) % numNames];
+		query[1] = 'x';
+		queries.append(query);
+	}
+	size_t numMatches = 0;
+	QBENCHMARK
+	{
+		for (const auto & q: queries)
+		{
+			numMatches += matcher.findSimilar(q, 10, 2).size();
+		}
+	}
+	QVERIFY(numMatches > 0);
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestFuzzyNameMatcher)
+
+
+
+
+
+#include "TestFuzzyNameMatcher.moc"
+
+
+
+
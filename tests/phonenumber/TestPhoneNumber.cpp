@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <QString>
+#include <QtTest>
+#include "../../PhoneNumber.h"
+#include "../../ContactBook.h"
+
+
+
+
+
+class TestPhoneNumber:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testDefaultCountry();
+	void testToE164_data();
+	void testToE164();
+	void testKey();
+	void testFormatForDisplay();
+	void testNormalizeContact();
+	void testContactBookNormalizes();
+};
+
+
+
+
+
+void TestPhoneNumber::testDefaultCountry()
+{
+	QVERIFY(PhoneNumber::setDefaultCountry("cz"));
+	QCOMPARE(PhoneNumber::defaultCountry(), QString("CZ"));
+	QVERIFY(!PhoneNumber::setDefaultCountry("XX"));
+	QCOMPARE(PhoneNumber::defaultCountry(), QString("CZ"));
+	QVERIFY(PhoneNumber::setDefaultCountry(PhoneNumber::systemCountry()));
+
+	auto known = PhoneNumber::knownCountries();
+	QVERIFY(std::find(known.begin(), known.end(), QString("US")) != known.end());
+	QVERIFY(std::find(known.begin(), known.end(), PhoneNumber::systemCountry()) != known.end());
+}
+
+
+
+
+
+void TestPhoneNumber::testToE164_data()
+{
+	QTest::addColumn<QString>("country");
+	QTest::addColumn<QByteArray>("value");
+	QTest::addColumn<QString>("e164");
+
+	QTest::newRow("international +")     << "CZ" << QByteArray("+420 603 123 456")     << "+420603123456";
+	QTest::newRow("international 00")    << "CZ" << QByteArray("00420 603 123 456")    << "+420603123456";
+	QTest::newRow("tel URI")             << "CZ" << QByteArray("tel:+1-212-555-1234")  << "+12125551234";
+	QTest::newRow("no trunk prefix")     << "CZ" << QByteArray("603 123 456")          << "+420603123456";
+	QTest::newRow("trunk prefix")        << "DE" << QByteArray("030 1234567")          << "+49301234567";
+	QTest::newRow("two-digit trunk")     << "HU" << QByteArray("06 1 234 5678")        << "+3612345678";
+	QTest::newRow("kept trunk prefix")   << "IT" << QByteArray("06 1234 5678")         << "+390612345678";
+	QTest::newRow("NANP with trunk")     << "US" << QByteArray("1 (212) 555-1234")     << "+12125551234";
+	QTest::newRow("NANP without trunk")  << "US" << QByteArray("(212) 555-1234")       << "+12125551234";
+	QTest::newRow("exit prefix")         << "US" << QByteArray("011 44 20 7946 0958")  << "+442079460958";
+	QTest::newRow("local without area")  << "GB" << QByteArray("7946 0958")            << "";
+	QTest::newRow("service number")      << "CZ" << QByteArray("112")                  << "";
+	QTest::newRow("too long")            << "CZ" << QByteArray("+420 603 123 456 789 0") << "";
+	QTest::newRow("no digits")           << "CZ" << QByteArray("n/a")                  << "";
+}
+
+
+
+
+
+void TestPhoneNumber::testToE164()
+{
+	QFETCH(QString, country);
+	QFETCH(QByteArray, value);
+	QFETCH(QString, e164);
+
+	QCOMPARE(PhoneNumber::toE164(value, country), e164);
+	QVERIFY(PhoneNumber::setDefaultCountry(country));
+	QCOMPARE(PhoneNumber::toE164(value), e164);
+	QVERIFY(PhoneNumber::toE164(value, "XX").isEmpty());
+}
+
+
+
+
+
+void TestPhoneNumber::testKey()
+{
+	QVERIFY(PhoneNumber::setDefaultCountry("CZ"));
+	QCOMPARE(PhoneNumber::key("603 123 456"), PhoneNumber::key("+420603123456"));
+
+	// Numbers that cannot be normalized fall back to the digits-only form:
+	QCOMPARE(PhoneNumber::key("1-1-2"), QString("112"));
+
+	// The cached value in the sentence takes precedence:
+	Contact::Sentence s;
+	s.m_Key = "tel";
+	s.m_Value = "603 123 456";
+	QCOMPARE(PhoneNumber::key(s), QString("+420603123456"));
+	s.m_NormalizedValue = "+421603123456";
+	QCOMPARE(PhoneNumber::key(s), QString("+421603123456"));
+}
+
+
+
+
+
+void TestPhoneNumber::testFormatForDisplay()
+{
+	QCOMPARE(PhoneNumber::formatForDisplay("+420603123456"), QString("+420 603123456"));
+	QCOMPARE(PhoneNumber::formatForDisplay("+12125551234"),  QString("+1 2125551234"));
+	QCOMPARE(PhoneNumber::formatForDisplay("+999123456789"), QString("+999123456789"));
+	QCOMPARE(PhoneNumber::formatForDisplay("112"),           QString("112"));
+}
+
+
+
+
+
+void TestPhoneNumber::testNormalizeContact()
+{
+	QVERIFY(PhoneNumber::setDefaultCountry("DE"));
+	Contact contact;
+	Contact::Sentence s;
+	s.m_Key = "fn";
+	s.m_Value = "Max Mustermann";
+	contact.addSentence(s);
+	s.m_Key = "tel";
+	s.m_Value = "030 1234567";
+	contact.addSentence(s);
+	s.m_Value = "110";
+	contact.addSentence(s);
+	PhoneNumber::normalizeContact(contact);
+
+	const auto & sentences = contact.sentences();
+	QCOMPARE(sentences.size(), static_cast<size_t>(3));
+	QVERIFY(sentences[0].m_NormalizedValue.isEmpty());
+	QCOMPARE(sentences[1].m_NormalizedValue, QString("+49301234567"));
+	QVERIFY(sentences[2].m_NormalizedValue.isEmpty());
+}
+
+
+
+
+
+void TestPhoneNumber::testContactBookNormalizes()
+{
+	QVERIFY(PhoneNumber::setDefaultCountry("CZ"));
+	ContactBook book("book");
+	Contact::Sentence s;
+	s.m_Key = "tel";
+	s.m_Value = "603 123 456";
+	ContactPtr original;
+	{
+		ContactBook::Batch batch(book);
+		original = book.createNewContact();
+		original->addSentence(s);
+	}
+	QCOMPARE(original->sentences()[0].m_NormalizedValue, QString("+420603123456"));
+
+	// A replacement is normalized when its batch ends, the published original stays untouched:
+	auto snapshot = book.snapshot();
+	auto replacement = original->clone();
+	replacement->addSentence(s);
+	book.replaceContact(original.get(), replacement);
+	QCOMPARE(replacement->sentences()[1].m_NormalizedValue, QString("+420603123456"));
+	QCOMPARE(original->sentences().size(), static_cast<size_t>(1));
+	QCOMPARE(snapshot->size(), static_cast<size_t>(1));
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestPhoneNumber)
+
+
+
+
+
+#include "TestPhoneNumber.moc"
+
+
+
+
@@ -0,0 +1,37 @@
+#-------------------------------------------------
+#
+# Unit tests of PhoneNumber
+#
+#-------------------------------------------------
+
+QT       += testlib concurrent
+
+QT       -= gui
+
+TARGET = TestPhoneNumber
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+SOURCES +=\
+	TestPhoneNumber.cpp \
+	../../VCardParser.cpp \
+	../../Contact.cpp \
+	../../ContactBook.cpp \
+	../../ContactBookIndex.cpp \
+	../../ContactBookSnapshot.cpp \
+	../../Normalizer.cpp \
+	../../PhoneNumber.cpp
+
+HEADERS +=\
+	../../Contact.h \
+	../../ContactBook.h \
+	../../ContactBookIndex.h \
+	../../ContactBookSnapshot.h \
+	../../Normalizer.h \
+	../../PhoneNumber.h
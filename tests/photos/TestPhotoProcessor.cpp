@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <QBuffer>
+#include <QImage>
+#include <QString>
+#include <QtTest>
+#include "../../PhotoProcessor.h"
+#include "../../VCardParser.h"
+#include "../TestHelpers.h"
+
+
+
+
+
+/** Returns the image data of a smooth test pattern of the specified size, encoded in the specified format.
+If a_IsInverted is set, the pattern is inverted (perceptually different). */
+static QByteArray imageData(int a_Width, int a_Height, const char * a_Format, bool a_IsInverted = false)
+{
+	QImage img(a_Width, a_Height, QImage::Format_RGB32);
+	for (int y = 0; y < a_Height; ++y)
+	{
+		for (int x = 0; x < a_Width; ++x)
+		{
+			auto v = static_cast<int>(128 + 100 * std::sin(x * 9.42 / a_Width) * std::cos(y * 3.14 / a_Height));
+			if (a_IsInverted)
+			{
+				v = 255 - v;
+			}
+			img.setPixel(x, y, qRgb(v, v / 2, 255 - v));
+		}
+	}
+	QByteArray res;
+	QBuffer buf(&res);
+	buf.open(QIODevice::WriteOnly);
+	img.save(&buf, a_Format);
+	return res;
+}
+
+
+
+
+
+/** Returns a VCard sentence with the specified photo data, in the v2.1 value-less type format. */
+static QByteArray photoSentence(const QByteArray & a_Data)
+{
+	return "PHOTO;PNG;ENCODING=BASE64:" + a_Data.toBase64() + "\r\n";
+}
+
+
+
+
+
+/** Returns the first PHOTO sentence of the contact. */
+static const Contact::Sentence & photoOf(const Contact & a_Contact)
+{
+	for (const auto & s: a_Contact.sentences())
+	{
+		if (s.m_Key == "photo")
+		{
+			return s;
+		}
+	}
+	throw std::runtime_error("No photo");
+}
+
+
+
+
+
+/** Returns true if the contact book currently contains the specified contact instance. */
+static bool containsContact(const ContactBook & a_ContactBook, const ContactPtr & a_Contact)
+{
+	const auto & contacts = a_ContactBook.contacts();
+	return (std::find(contacts.begin(), contacts.end(), a_Contact) != contacts.end());
+}
+
+
+
+
+
+class TestPhotoProcessor:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testPerceptualHash();
+	void testDryRun();
+	void testReencode();
+	void testMultipleChunks();
+};
+
+
+
+
+
+void TestPhotoProcessor::testPerceptualHash()
+{
+	auto large = PhotoProcessor::perceptualHash(imageData(1024, 768, "PNG"));
+	auto small = PhotoProcessor::perceptualHash(imageData(200, 150, "JPG"));
+	auto inverted = PhotoProcessor::perceptualHash(imageData(200, 150, "PNG", true));
+	QVERIFY(large != 0);
+	QVERIFY(qPopulationCount(large ^ small) <= 4);
+	QVERIFY(qPopulationCount(large ^ inverted) > 16);
+	QCOMPARE(PhotoProcessor::perceptualHash("garbage"), static_cast<quint64>(0));
+}
+
+
+
+
+
+void TestPhotoProcessor::testDryRun()
+{
+	auto large = imageData(1024, 768, "PNG");
+	auto book = parseBook("test", vcards({
+		"FN:Large\r\n" + photoSentence(large),
+		"FN:Large copy\r\n" + photoSentence(large),
+		"FN:Small\r\n" + photoSentence(imageData(200, 150, "PNG")),
+		"FN:Different\r\n" + photoSentence(imageData(200, 150, "PNG", true)),
+		"FN:Broken\r\n" + photoSentence("garbage"),
+		"FN:None\r\n",
+	}, "2.1"));
+	auto contacts = book->contacts();
+
+	PhotoProcessor processor;
+	auto report = processor.process(*book, true);
+	QCOMPARE(report.m_NumPhotos, static_cast<size_t>(5));
+	QCOMPARE(report.m_NumUndecodable, static_cast<size_t>(1));
+	QCOMPARE(report.m_NumReencoded, static_cast<size_t>(2));
+	QVERIFY(report.bytesSaved() > 0);
+	QCOMPARE(report.m_IdenticalGroups.size(), static_cast<size_t>(1));
+	QCOMPARE(report.m_IdenticalGroups[0].size(), static_cast<size_t>(2));
+	QCOMPARE(report.m_SimilarGroups.size(), static_cast<size_t>(1));
+	QCOMPARE(report.m_SimilarGroups[0].size(), static_cast<size_t>(3));
+
+	// The book is left intact:
+	QVERIFY(book->contacts() == contacts);
+
+	// Without re-encoding, only the duplicates are reported:
+	processor.setShouldReencode(false);
+	report = processor.process(*book, false);
+	QCOMPARE(report.m_NumReencoded, static_cast<size_t>(0));
+	QCOMPARE(report.bytesSaved(), static_cast<qint64>(0));
+	QVERIFY(book->contacts() == contacts);
+}
+
+
+
+
+
+void TestPhotoProcessor::testReencode()
+{
+	auto book = parseBook("test", vcards({
+		"FN:Large v2.1\r\n" + photoSentence(imageData(1024, 768, "PNG")),
+		"FN:Large v3\r\nPHOTO;TYPE=PNG;ENCODING=b:" + imageData(768, 1024, "PNG").toBase64() + "\r\n",
+		"FN:Small\r\n" + photoSentence(imageData(200, 150, "PNG")),
+	}, "2.1"));
+	auto small = book->contacts()[2];
+
+	PhotoProcessor processor;
+	auto report = processor.process(*book, false);
+	QCOMPARE(report.m_NumReencoded, static_cast<size_t>(2));
+	QCOMPARE(book->contacts().size(), static_cast<size_t>(3));
+	QCOMPARE(book->contacts()[2], small);
+
+	// The re-encoded photos are downscaled JPEGs, and say so in their type parameter:
+	const auto & v21 = photoOf(*book->contacts()[0]);
+	QCOMPARE(QImage::fromData(v21.m_Value).size(), QSize(512, 384));
+	QCOMPARE(v21.m_Params.size(), static_cast<size_t>(2));
+	QCOMPARE(v21.m_Params[0].m_Name, QByteArray("jpeg"));
+	QVERIFY(v21.m_Params[0].m_Values.empty());
+	const auto & v3 = photoOf(*book->contacts()[1]);
+	QCOMPARE(QImage::fromData(v3.m_Value).size(), QSize(384, 512));
+	QCOMPARE(v3.m_Params[0].m_Values, std::vector<QByteArray>({"JPEG"}));
+
+	// The report refers to the contacts currently in the book:
+	for (const auto & group: report.m_SimilarGroups)
+	{
+		for (const auto & ref: group)
+		{
+			QVERIFY(containsContact(*book, ref.m_Contact));
+		}
+	}
+
+	// Nothing more to do:
+	QCOMPARE(processor.process(*book, false).m_NumReencoded, static_cast<size_t>(0));
+}
+
+
+
+
+
+void TestPhotoProcessor::testMultipleChunks()
+{
+	// Put a large photo into the first and the last snapshot chunk:
+	auto large = imageData(1024, 768, "PNG");
+	std::vector<QByteArray> contactsData;
+	auto numContacts = ContactBookSnapshot::CHUNK_SIZE * 2 + 1;
+	for (size_t i = 0; i < numContacts; ++i)
+	{
+		contactsData.push_back("FN:Contact " + QByteArray::number(static_cast<qulonglong>(i)) + "\r\n");
+	}
+	contactsData.front().append(photoSentence(large));
+	contactsData.back().append(photoSentence(large));
+	auto book = parseBook("test", vcards(contactsData, "2.1"));
+	auto contacts = book->contacts();
+
+	PhotoProcessor processor;
+	auto report = processor.process(*book, false);
+	QCOMPARE(report.m_NumReencoded, static_cast<size_t>(2));
+	QCOMPARE(report.m_IdenticalGroups.size(), static_cast<size_t>(1));
+	const auto & newContacts = book->contacts();
+	QCOMPARE(newContacts.size(), numContacts);
+	QVERIFY(newContacts.front() != contacts.front());
+	QVERIFY(newContacts.back() != contacts.back());
+	QCOMPARE(newContacts[1], contacts[1]);
+	for (const auto & ref: report.m_IdenticalGroups[0])
+	{
+		QVERIFY(containsContact(*book, ref.m_Contact));
+	}
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestPhotoProcessor)
+
+
+
+
+
+#include "TestPhotoProcessor.moc"
@@ -0,0 +1,38 @@
+#-------------------------------------------------
+#
+# Unit tests of PhotoProcessor
+#
+#-------------------------------------------------
+
+QT       += testlib concurrent
+
+TARGET = TestPhotoProcessor
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+SOURCES +=\
+	TestPhotoProcessor.cpp \
+	../../PhotoProcessor.cpp \
+	../../VCardParser.cpp \
+	../../Contact.cpp \
+	../../ContactBook.cpp \
+	../../ContactBookIndex.cpp \
+	../../ContactBookSnapshot.cpp \
+	../../Normalizer.cpp \
+	../../PhoneNumber.cpp
+
+HEADERS +=\
+	../../PhotoProcessor.h \
+	../../Contact.h \
+	../../ContactBook.h \
+	../../ContactBookIndex.h \
+	../../ContactBookSnapshot.h \
+	../../Normalizer.h \
+	../../PhoneNumber.h \
+	../TestHelpers.h
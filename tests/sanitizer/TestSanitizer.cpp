@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <QString>
+#include <QtTest>
+#include "../../Sanitizer.h"
+#include "../../SanitizerRules.h"
+#include "../../VCardParser.h"
+#include "../../PhoneNumber.h"
+#include "../TestHelpers.h"
+
+
+
+
+
+/** Returns the sentences of a single VCard consisting of the specified (already formatted) sentences. */
+static std::vector<Contact::Sentence> parseSentences(const QByteArray & a_Sentences)
+{
+	auto book = parseBook("test", vcard(a_Sentences, "2.1"));
+	return book->contacts()[0]->sentences();
+}
+
+
+
+
+
+/** Returns the value of the first sentence with the specified key, or an empty value if not present. */
+static QByteArray valueOf(const std::vector<Contact::Sentence> & a_Sentences, const QByteArray & a_Key)
+{
+	for (const auto & s: a_Sentences)
+	{
+		if (s.m_Key == a_Key)
+		{
+			return s.m_Value;
+		}
+	}
+	return QByteArray();
+}
+
+
+
+
+
+class TestSanitizer:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testTrimWhitespace();
+	void testFixMojibake();
+	void testNormalizeTypeCase();
+	void testSplitFnIntoN_data();
+	void testSplitFnIntoN();
+	void testSplitFnIntoNSkipsOrganizations();
+	void testRemoveDuplicateTel();
+	void testRun();
+};
+
+
+
+
+
+void TestSanitizer::testTrimWhitespace()
+{
+	SanitizerRuleTrimWhitespace rule;
+
+	// The quoted-printable value is text once decoded, so it gets trimmed:
+	auto sentences = parseSentences("FN;ENCODING=QUOTED-PRINTABLE:=20Jan Novak=20\r\n");
+	QVERIFY(rule.apply(sentences));
+	QCOMPARE(valueOf(sentences, "fn"), QByteArray("Jan Novak"));
+	QVERIFY(!rule.apply(sentences));
+
+	// The base64 value is binary, it is left intact ("ab " in base64):
+	sentences = parseSentences("PHOTO;ENCODING=BASE64:YWIg\r\n");
+	QCOMPARE(valueOf(sentences, "photo"), QByteArray("ab "));
+	QVERIFY(!rule.apply(sentences));
+	QCOMPARE(valueOf(sentences, "photo"), QByteArray("ab "));
+}
+
+
+
+
+
+void TestSanitizer::testFixMojibake()
+{
+	SanitizerRuleFixMojibake rule;
+
+	// "NovÃ¡k", both plain and quoted-printable:
+	auto sentences = parseSentences("FN:Nov\xc3\x83\xc2\xa1k\r\nNOTE;ENCODING=QUOTED-PRINTABLE:Nov=C3=83=C2=A1k\r\n");
+	QVERIFY(rule.apply(sentences));
+	QCOMPARE(valueOf(sentences, "fn"), QByteArray("Nov\xc3\xa1k"));
+	QCOMPARE(valueOf(sentences, "note"), QByteArray("Nov\xc3\xa1k"));
+
+	// Correct UTF-8 is left alone:
+	QVERIFY(!rule.apply(sentences));
+}
+
+
+
+
+
+void TestSanitizer::testNormalizeTypeCase()
+{
+	SanitizerRuleNormalizeTypeCase rule;
+	auto sentences = parseSentences("TEL;TYPE=Cell:+420603123456\r\n");
+	QVERIFY(rule.apply(sentences));
+	QCOMPARE(sentences.back().m_Params[0].m_Values[0], QByteArray("cell"));
+
+	// v2.1 value-less parameter:
+	Contact::Sentence tel;
+	tel.m_Key = "tel";
+	tel.m_Params.emplace_back("WORK");
+	tel.m_Value = "+420603123456";
+	sentences = {tel};
+	QVERIFY(rule.apply(sentences));
+	QCOMPARE(sentences[0].m_Params[0].m_Name, QByteArray("work"));
+	QVERIFY(!rule.apply(sentences));
+}
+
+
+
+
+
+void TestSanitizer::testSplitFnIntoN_data()
+{
+	QTest::addColumn<QByteArray>("fn");
+	QTest::addColumn<QByteArray>("n");
+
+	QTest::newRow("given family")        << QByteArray("Jan Novak")          << QByteArray("Novak;Jan;;;");
+	QTest::newRow("given middle family") << QByteArray("Jan  Karel Novak")   << QByteArray("Novak;Jan;Karel;;");
+	QTest::newRow("family, given")       << QByteArray("Novak, Jan")         << QByteArray("Novak;Jan;;;");
+	QTest::newRow("family, nothing")     << QByteArray("Novak, ")            << QByteArray("Novak;;;;");
+	QTest::newRow("single word")         << QByteArray("Jan")                << QByteArray(";Jan;;;");
+	QTest::newRow("escaped")             << QByteArray("Jan Novak\\;Dvorak") << QByteArray("Novak\\;Dvorak;Jan;;;");
+}
+
+
+
+
+
+void TestSanitizer::testSplitFnIntoN()
+{
+	QFETCH(QByteArray, fn);
+	QFETCH(QByteArray, n);
+
+	SanitizerRuleSplitFnIntoN rule;
+	auto sentences = parseSentences("FN:" + fn + "\r\n");
+	QVERIFY(rule.apply(sentences));
+	QCOMPARE(valueOf(sentences, "n"), n);
+
+	// Already has N:
+	QVERIFY(!rule.apply(sentences));
+}
+
+
+
+
+
+void TestSanitizer::testSplitFnIntoNSkipsOrganizations()
+{
+	SanitizerRuleSplitFnIntoN rule;
+	auto sentences = parseSentences("FN:Acme Widgets\r\nORG:Acme Widgets\r\n");
+	QVERIFY(!rule.apply(sentences));
+	QVERIFY(valueOf(sentences, "n").isEmpty());
+
+	sentences = parseSentences("FN:Acme Widgets\r\nKIND:org\r\n");
+	QVERIFY(!rule.apply(sentences));
+	QVERIFY(valueOf(sentences, "n").isEmpty());
+
+	// An empty ORG doesn't make an organization:
+	sentences = parseSentences("FN:Jan Novak\r\nORG:\r\n");
+	QVERIFY(rule.apply(sentences));
+	QCOMPARE(valueOf(sentences, "n"), QByteArray("Novak;Jan;;;"));
+}
+
+
+
+
+
+void TestSanitizer::testRemoveDuplicateTel()
+{
+	QVERIFY(PhoneNumber::setDefaultCountry("CZ"));
+	SanitizerRuleRemoveDuplicateTel rule;
+	auto sentences = parseSentences(
+		"TEL:+420 603 123 456\r\n"
+		"TEL:603123456\r\n"
+		"TEL:+420 777 000 111\r\n"
+		"EMAIL:jan@novak.cz\r\n"
+	);
+	QVERIFY(rule.apply(sentences));
+	QCOMPARE(sentences.size(), static_cast<size_t>(3));
+	QCOMPARE(sentences[0].m_Value, QByteArray("+420 603 123 456"));
+	QCOMPARE(sentences[1].m_Value, QByteArray("+420 777 000 111"));
+	QCOMPARE(sentences[2].m_Key, QByteArray("email"));
+	QVERIFY(!rule.apply(sentences));
+}
+
+
+
+
+
+void TestSanitizer::testRun()
+{
+	QVERIFY(PhoneNumber::setDefaultCountry("CZ"));
+	auto book = parseBook("test", vcard("FN: Jan Novak \r\nTEL:+420603123456\r\nTEL:603 123 456\r\n", "2.1"));
+	auto original = book->contacts()[0];
+	Sanitizer sanitizer;
+	sanitizer.addDefaultRules();
+
+	// Dry run doesn't change the book:
+	auto edits = sanitizer.run(*book, true);
+	QCOMPARE(edits.size(), static_cast<size_t>(1));
+	QCOMPARE(book->contacts()[0], original);
+	QVERIFY(!Sanitizer::diff(edits).isEmpty());
+
+	// Applying replaces the contact with the sanitized one:
+	edits = sanitizer.run(*book, false);
+	QCOMPARE(edits.size(), static_cast<size_t>(1));
+	QCOMPARE(book->contacts().size(), static_cast<size_t>(1));
+	QCOMPARE(book->contacts()[0], edits[0].m_Sanitized);
+	const auto & sentences = book->contacts()[0]->sentences();
+	QCOMPARE(valueOf(sentences, "fn"), QByteArray("Jan Novak"));
+	QCOMPARE(valueOf(sentences, "n"), QByteArray("Novak;Jan;;;"));
+	QCOMPARE(std::count_if(sentences.begin(), sentences.end(),
+		[](const Contact::Sentence & a_Sentence) { return (a_Sentence.m_Key == "tel"); }
+	), static_cast<std::ptrdiff_t>(1));
+
+	// Re-running finds nothing to do; applying stale edits does nothing:
+	QVERIFY(sanitizer.run(*book, true).empty());
+	QCOMPARE(Sanitizer::applyEdits(*book, edits), static_cast<size_t>(0));
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestSanitizer)
+
+
+
+
+
+#include "TestSanitizer.moc"
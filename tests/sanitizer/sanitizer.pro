@@ -0,0 +1,45 @@
+#-------------------------------------------------
+#
+# Unit tests of Sanitizer and SanitizerRules
+#
+#-------------------------------------------------
+
+QT       += testlib concurrent
+
+QT       -= gui
+
+TARGET = TestSanitizer
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+SOURCES +=\
+	TestSanitizer.cpp \
+	../../Sanitizer.cpp \
+	../../SanitizerRules.cpp \
+	../../VCardParser.cpp \
+	../../VCardSerializer.cpp \
+	../../Contact.cpp \
+	../../ContactBook.cpp \
+	../../ContactBookIndex.cpp \
+	../../ContactBookSnapshot.cpp \
+	../../Normalizer.cpp \
+	../../PhoneNumber.cpp
+
+HEADERS +=\
+	../../Sanitizer.h \
+	../../SanitizerRules.h \
+	../../VCardParser.h \
+	../../VCardSerializer.h \
+	../../Contact.h \
+	../../ContactBook.h \
+	../../ContactBookIndex.h \
+	../../ContactBookSnapshot.h \
+	../../Normalizer.h \
+	../../PhoneNumber.h \
+	../TestHelpers.h
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <QString>
+#include <QtTest>
+#include "../../SessionSearchIndex.h"
+#include "../../Session.h"
+#include "../../PhoneNumber.h"
+#include "../TestHelpers.h"
+
+
+
+
+
+/** Returns a contact book with the specified names (as FN), one contact per name. */
+static ContactBookPtr bookWithNames(const QString & a_DisplayName, const QStringList & a_Names)
+{
+	ContactBookPtr res(new ContactBook(a_DisplayName));
+	ContactBook::Batch batch(*res);
+	for (const auto & name: a_Names)
+	{
+		addContact(*res, {{"fn", name.toUtf8()}});
+	}
+	return res;
+}
+
+
+
+
+
+/** Returns the sorted FN values of the search hits. */
+static QStringList hitNames(const std::vector<SessionSearchIndex::Hit> & a_Hits)
+{
+	QStringList res;
+	for (const auto & h: a_Hits)
+	{
+		for (const auto & s: h.m_Contact->sentences())
+		{
+			if (s.m_Key == "fn")
+			{
+				res.append(QString::fromUtf8(s.m_Value));
+			}
+		}
+	}
+	res.sort();
+	return res;
+}
+
+
+
+
+
+class TestSessionSearchIndex:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testTokens();
+	void testSearch();
+	void testInsertRemoveReplace();
+	void testMixedBatch();
+	void testDevicesAndBooks();
+	void testCompaction();
+};
+
+
+
+
+
+void TestSessionSearchIndex::testTokens()
+{
+	QVERIFY(PhoneNumber::setDefaultCountry("CZ"));
+	ContactBook book("book");
+	ContactPtr contact;
+	{
+		ContactBook::Batch batch(book);
+		contact = addContact(book, {
+			{"fn", QString::fromUtf8("Jan Novák").toUtf8()},
+			{"tel", "603 123 456"},
+			{"email", "Jan.Novak@Example.com"},
+		});
+	}
+	auto tokens = SessionSearchIndex::contactTokens(*contact);
+	for (const auto & t: {"jan", "novak", "603123456", "420603123456", "jan.novak@example.com", "example", "com"})
+	{
+		QVERIFY2(std::binary_search(tokens.begin(), tokens.end(), QString(t)), t);
+	}
+
+	QCOMPARE(SessionSearchIndex::queryTokens(QString::fromUtf8("  NOVÁK jan ")), std::vector<QString>({"jan", "novak"}));
+	QCOMPARE(SessionSearchIndex::queryTokens("+420 (603) 123-456"), std::vector<QString>({"420603123456"}));
+	QVERIFY(SessionSearchIndex::queryTokens(" ,. ").empty());
+}
+
+
+
+
+
+void TestSessionSearchIndex::testSearch()
+{
+	QVERIFY(PhoneNumber::setDefaultCountry("CZ"));
+	Session session;
+	auto dev = new TestDevice;
+	session.addDevice(std::unique_ptr<Device>(dev));
+	ContactBookPtr book(new ContactBook("book"));
+	{
+		ContactBook::Batch batch(*book);
+		addContact(*book, {{"fn", "Jan Novak"}, {"tel", "603 123 456"}});
+		addContact(*book, {{"fn", "Jana Novotna"}, {"email", "jana@example.com"}});
+		addContact(*book, {{"fn", "Petr Svoboda"}, {"org", "Novak a syn"}});
+	}
+	dev->addBook(book);
+
+	SessionSearchIndex index(&session);
+	QCOMPARE(index.numContacts(), static_cast<size_t>(3));
+	QCOMPARE(hitNames(index.search("nov", 10)), QStringList({"Jan Novak", "Jana Novotna", "Petr Svoboda"}));
+	QCOMPARE(hitNames(index.search("jan nov", 10)), QStringList({"Jan Novak", "Jana Novotna"}));
+	QCOMPARE(hitNames(index.search("novak syn", 10)), QStringList({"Petr Svoboda"}));
+	QCOMPARE(hitNames(index.search("603 12", 10)), QStringList({"Jan Novak"}));
+	QCOMPARE(hitNames(index.search("+420603", 10)), QStringList({"Jan Novak"}));
+	QCOMPARE(hitNames(index.search("jana@ex", 10)), QStringList({"Jana Novotna"}));
+	QCOMPARE(index.search("nov", 2).size(), static_cast<size_t>(2));
+	QVERIFY(index.search("dvorak", 10).empty());
+	QVERIFY(index.search("", 10).empty());
+	QCOMPARE(index.search("novak", 10)[0].m_ContactBook, book);
+}
+
+
+
+
+
+void TestSessionSearchIndex::testInsertRemoveReplace()
+{
+	Session session;
+	auto dev = new TestDevice;
+	session.addDevice(std::unique_ptr<Device>(dev));
+	auto book = bookWithNames("book", {"Adam Alfa", "Bara Beta", "Cyril Gama"});
+	dev->addBook(book);
+	SessionSearchIndex index(&session);
+
+	// Insert:
+	{
+		ContactBook::Batch batch(*book);
+		addContact(*book, {{"fn", "Dana Delta"}});
+	}
+	QCOMPARE(index.numContacts(), static_cast<size_t>(4));
+	QCOMPARE(hitNames(index.search("delta", 10)), QStringList({"Dana Delta"}));
+
+	// Replace:
+	auto replacement = book->contacts()[1]->clone();
+	Contact::Sentence fn;
+	fn.m_Key = "fn";
+	fn.m_Value = "Bara Epsilon";
+	replacement->setSentences({fn});
+	book->replaceContact(book->contacts()[1].get(), replacement);
+	QCOMPARE(index.numContacts(), static_cast<size_t>(4));
+	QVERIFY(index.search("beta", 10).empty());
+	QCOMPARE(hitNames(index.search("bara", 10)), QStringList({"Bara Epsilon"}));
+	QCOMPARE(index.search("epsilon", 10)[0].m_Contact, replacement);
+
+	// Remove:
+	book->delContact(book->contacts()[0].get());
+	QCOMPARE(index.numContacts(), static_cast<size_t>(3));
+	QVERIFY(index.search("alfa", 10).empty());
+	QCOMPARE(hitNames(index.search("cyril", 10)), QStringList({"Cyril Gama"}));
+	QCOMPARE(hitNames(index.search("epsilon", 10)), QStringList({"Bara Epsilon"}));
+}
+
+
+
+
+
+void TestSessionSearchIndex::testMixedBatch()
+{
+	Session session;
+	auto dev = new TestDevice;
+	session.addDevice(std::unique_ptr<Device>(dev));
+	auto book = bookWithNames("book", {"A1 Name", "A2 Name", "A3 Name", "A4 Name", "A5 Name", "A6 Name"});
+	dev->addBook(book);
+	SessionSearchIndex index(&session);
+
+	// Remove two separate ranges, replace one contact and insert a new one, all in a single batch:
+	{
+		auto contacts = book->contacts();
+		ContactBook::Batch batch(*book);
+		book->delContact(contacts[1].get());
+		book->delContact(contacts[2].get());
+		book->delContact(contacts[4].get());
+		auto replacement = contacts[3]->clone();
+		Contact::Sentence fn;
+		fn.m_Key = "fn";
+		fn.m_Value = "A4 Renamed";
+		replacement->setSentences({fn});
+		book->replaceContact(contacts[3].get(), replacement);
+		addContact(*book, {{"fn", "A7 Name"}});
+	}
+	QCOMPARE(index.numContacts(), static_cast<size_t>(4));
+	QCOMPARE(hitNames(index.search("name", 10)), QStringList({"A1 Name", "A6 Name", "A7 Name"}));
+	QCOMPARE(hitNames(index.search("renamed", 10)), QStringList({"A4 Renamed"}));
+
+	// The index mirrors the book, further changes by position still hit the right contacts:
+	book->delContact(book->contacts()[1].get());
+	QCOMPARE(index.numContacts(), static_cast<size_t>(3));
+	QVERIFY(index.search("renamed", 10).empty());
+	QCOMPARE(hitNames(index.search("a", 10)), QStringList({"A1 Name", "A6 Name", "A7 Name"}));
+}
+
+
+
+
+
+void TestSessionSearchIndex::testDevicesAndBooks()
+{
+	Session session;
+	SessionSearchIndex index(&session);
+	QCOMPARE(index.numContacts(), static_cast<size_t>(0));
+
+	// A device added later, with a book added later:
+	auto dev = new TestDevice;
+	session.addDevice(std::unique_ptr<Device>(dev));
+	auto book1 = bookWithNames("book1", {"Jan Novak"});
+	auto book2 = bookWithNames("book2", {"Jan Dvorak", "Petr Novak"});
+	dev->addBook(book1);
+	dev->addBook(book2);
+	QCOMPARE(index.numContacts(), static_cast<size_t>(3));
+	QCOMPARE(hitNames(index.search("novak", 10)), QStringList({"Jan Novak", "Petr Novak"}));
+
+	// Removing a book:
+	dev->removeBook(book1.get());
+	QCOMPARE(index.numContacts(), static_cast<size_t>(2));
+	QCOMPARE(hitNames(index.search("jan", 10)), QStringList({"Jan Dvorak"}));
+
+	// The removed book's changes are no longer tracked:
+	{
+		ContactBook::Batch batch(*book1);
+		addContact(*book1, {{"fn", "Jan Novy"}});
+	}
+	QCOMPARE(index.numContacts(), static_cast<size_t>(2));
+
+	// Removing the device:
+	session.delDevice(dev);
+	QCOMPARE(index.numContacts(), static_cast<size_t>(0));
+	QVERIFY(index.search("jan", 10).empty());
+}
+
+
+
+
+
+void TestSessionSearchIndex::testCompaction()
+{
+	Session session;
+	auto dev = new TestDevice;
+	session.addDevice(std::unique_ptr<Device>(dev));
+	ContactBookPtr book(new ContactBook("book"));
+	dev->addBook(book);
+	SessionSearchIndex index(&session);
+
+	// Add and remove enough contacts to trigger the compaction, one by one:
+	for (int i = 0; i < 3000; ++i)
+	{
+		{
+			ContactBook::Batch batch(*book);
+			addContact(*book, {{"fn", "Temp " + QByteArray::number(i)}});
+		}
+		if (i % 3 != 0)
+		{
+			book->delContact(book->contacts().back().get());
+		}
+	}
+	QCOMPARE(index.numContacts(), static_cast<size_t>(1000));
+	QCOMPARE(index.numContacts(), book->contacts().size());
+	QCOMPARE(index.search("temp", 5000).size(), static_cast<size_t>(1000));
+	QCOMPARE(hitNames(index.search("2997", 10)), QStringList({"Temp 2997"}));
+	QVERIFY(index.search("2998", 10).empty());
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestSessionSearchIndex)
+
+
+
+
+
+#include "TestSessionSearchIndex.moc"
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <QString>
+#include <QtTest>
+#include "../../ContactBook.h"
+
+
+
+
+
+/** Returns a contact book with the specified number of contacts, each with a distinct FN. */
+static ContactBookPtr bookWithContacts(size_t a_NumContacts)
+{
+	ContactBookPtr res(new ContactBook("book"));
+	ContactBook::Batch batch(*res);
+	for (size_t i = 0; i < a_NumContacts; ++i)
+	{
+		Contact::Sentence fn;
+		fn.m_Key = "fn";
+		fn.m_Value = "Contact " + QByteArray::number(static_cast<qulonglong>(i));
+		res->createNewContact()->addSentence(fn);
+	}
+	return res;
+}
+
+
+
+
+
+/** Returns the number of chunks in a_Snapshot that are shared with a_Previous. */
+static size_t numSharedChunks(const ContactBookSnapshot & a_Snapshot, const ContactBookSnapshot & a_Previous)
+{
+	const auto & prevChunks = a_Previous.chunks();
+	size_t res = 0;
+	for (const auto & chunk: a_Snapshot.chunks())
+	{
+		if (std::find(prevChunks.begin(), prevChunks.end(), chunk) != prevChunks.end())
+		{
+			res += 1;
+		}
+	}
+	return res;
+}
+
+
+
+
+
+/** Returns true if the snapshot contains exactly the contacts of the book, in the same order. */
+static bool matchesBook(const ContactBookSnapshot & a_Snapshot, const ContactBook & a_ContactBook)
+{
+	const auto & contacts = a_ContactBook.contacts();
+	if (a_Snapshot.size() != contacts.size())
+	{
+		return false;
+	}
+	std::vector<ContactPtr> listed;
+	a_Snapshot.forEach([&listed](const ContactPtr & a_Contact)
+		{
+			listed.push_back(a_Contact);
+		}
+	);
+	if (listed.size() != contacts.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < contacts.size(); ++i)
+	{
+		if ((listed[i] != contacts[i]) || (a_Snapshot.at(i) != contacts[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+class TestContactBookSnapshot:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testRemoveAtFront();
+	void testReplaceAndAppend();
+	void testShrinkingChunks();
+};
+
+
+
+
+
+void TestContactBookSnapshot::testRemoveAtFront()
+{
+	auto book = bookWithContacts(ContactBookSnapshot::CHUNK_SIZE * 10);
+	auto prev = book->snapshot();
+	QCOMPARE(prev->chunks().size(), static_cast<size_t>(10));
+
+	// Removing the first contact shifts all the others, yet only the first chunk is rebuilt:
+	book->delContact(book->contacts()[0].get());
+	auto snapshot = book->snapshot();
+	QCOMPARE(snapshot->version(), prev->version() + 1);
+	QVERIFY(matchesBook(*snapshot, *book));
+	QCOMPARE(numSharedChunks(*snapshot, *prev), static_cast<size_t>(9));
+
+	// The previous snapshot is left intact:
+	QCOMPARE(prev->size(), ContactBookSnapshot::CHUNK_SIZE * 10);
+}
+
+
+
+
+
+void TestContactBookSnapshot::testReplaceAndAppend()
+{
+	auto book = bookWithContacts(ContactBookSnapshot::CHUNK_SIZE * 4 + 10);
+	auto prev = book->snapshot();
+
+	// Replacing a contact in the middle rebuilds only its chunk, appending touches only the last one:
+	{
+		ContactBook::Batch batch(*book);
+		auto old = book->contacts()[ContactBookSnapshot::CHUNK_SIZE * 2 + 5];
+		book->replaceContact(old.get(), old->clone());
+		Contact::Sentence fn;
+		fn.m_Key = "fn";
+		fn.m_Value = "Appended";
+		book->createNewContact()->addSentence(fn);
+	}
+	auto snapshot = book->snapshot();
+	QVERIFY(matchesBook(*snapshot, *book));
+	QCOMPARE(snapshot->chunks().size(), static_cast<size_t>(5));
+	QCOMPARE(numSharedChunks(*snapshot, *prev), static_cast<size_t>(3));
+}
+
+
+
+
+
+void TestContactBookSnapshot::testShrinkingChunks()
+{
+	// Remove most of the contacts, one batch at a time, spread over the whole book:
+	auto book = bookWithContacts(ContactBookSnapshot::CHUNK_SIZE * 20);
+	for (int round = 0; round < 6; ++round)
+	{
+		ContactBook::Batch batch(*book);
+		const auto & contacts = book->contacts();
+		for (size_t i = static_cast<size_t>(round) % 2; i < contacts.size(); i += 3)
+		{
+			book->delContact(contacts[i].get());
+		}
+	}
+	auto snapshot = book->snapshot();
+	QVERIFY(matchesBook(*snapshot, *book));
+
+	// The chunks that got small have been merged:
+	for (const auto & chunk: snapshot->chunks())
+	{
+		QVERIFY(!chunk->empty());
+		QVERIFY(chunk->size() <= ContactBookSnapshot::CHUNK_SIZE);
+	}
+	QVERIFY(snapshot->chunks().size() * ContactBookSnapshot::CHUNK_SIZE / 4 <= snapshot->size() + ContactBookSnapshot::CHUNK_SIZE);
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestContactBookSnapshot)
+
+
+
+
+
+#include "TestContactBookSnapshot.moc"
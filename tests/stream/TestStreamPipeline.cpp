@@ -0,0 +1,194 @@
+#include <stdexcept>
+#include <QString>
+#include <QtTest>
+#include "../../StreamPipeline.h"
+#include "../../StreamStages.h"
+#include "../../ContactBook.h"
+#include "../../VCardParser.h"
+#include "../TestHelpers.h"
+
+
+
+
+
+/** Runs the pipeline over the specified data, returns the output data. */
+static QByteArray runPipeline(const StreamPipeline & a_Pipeline, QByteArray a_Input, StreamPipeline::Stats & a_Stats)
+{
+	QByteArray res;
+	QBuffer src(&a_Input);
+	src.open(QIODevice::ReadOnly);
+	QBuffer dst(&res);
+	dst.open(QIODevice::WriteOnly);
+	a_Stats = a_Pipeline.run(src, dst);
+	return res;
+}
+
+
+
+
+
+/** Returns the FN values of all the contacts in the VCF data, in their order. */
+static QStringList fnValues(const QByteArray & a_Data)
+{
+	auto book = parseBook("test", a_Data);
+	QStringList res;
+	for (const auto & c: book->contacts())
+	{
+		for (const auto & s: c->sentences())
+		{
+			if (s.m_Key == "fn")
+			{
+				res.append(QString::fromUtf8(s.m_Value));
+			}
+		}
+	}
+	return res;
+}
+
+
+
+
+
+/** Returns the input data of a contact per each of the specified names. */
+static QByteArray contactsWithNames(const QStringList & a_Names)
+{
+	QByteArray res;
+	for (const auto & name: a_Names)
+	{
+		res.append(vcard("FN:" + name.toUtf8() + "\r\n"));
+	}
+	return res;
+}
+
+
+
+
+
+class TestStreamPipeline:
+	public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testOrderAndFilter();
+	void testParseErrors();
+	void testStageException();
+	void testAnonymize();
+};
+
+
+
+
+
+void TestStreamPipeline::testOrderAndFilter()
+{
+	QStringList names;
+	for (int i = 0; i < 500; ++i)
+	{
+		names.append(QString::fromUtf8("Contact %1").arg(i));
+	}
+	StreamPipeline pipeline;
+	pipeline.setNumWorkers(4);
+	pipeline.setQueueCapacity(8);
+	pipeline.addStage(std::make_shared<StreamStageFilter>([](const Contact & a_Contact)
+		{
+			return !a_Contact.sentences()[0].m_Value.endsWith('7');
+		}
+	));
+	StreamPipeline::Stats stats;
+	auto output = runPipeline(pipeline, contactsWithNames(names), stats);
+	QCOMPARE(stats.m_NumRead, static_cast<quint64>(500));
+	QCOMPARE(stats.m_NumDropped, static_cast<quint64>(50));
+	QCOMPARE(stats.m_NumWritten, static_cast<quint64>(450));
+	QCOMPARE(stats.m_NumErrors, static_cast<quint64>(0));
+	QStringList expected;
+	for (const auto & name: names)
+	{
+		if (!name.endsWith('7'))
+		{
+			expected.append(name);
+		}
+	}
+	QCOMPARE(fnValues(output), expected);
+}
+
+
+
+
+
+void TestStreamPipeline::testParseErrors()
+{
+	// Each broken contact is a single error, however many lines follow the error:
+	QByteArray input = vcard("FN:First\r\n");
+	input.append("BEGIN:VCARD\r\nFN:No version\r\nTEL:123\r\nEMAIL:a@b.c\r\nNOTE:x\r\nEND:VCARD\r\n");
+	input.append(vcard("FN:Second\r\n"));
+	input.append("BEGIN:VCARD\r\nFN:No version either\r\nEND:VCARD\r\n");
+	input.append(vcard("FN:Third\r\n"));
+	StreamPipeline pipeline;
+	StreamPipeline::Stats stats;
+	auto output = runPipeline(pipeline, input, stats);
+	QCOMPARE(stats.m_NumErrors, static_cast<quint64>(2));
+	QCOMPARE(stats.m_NumRead, static_cast<quint64>(3));
+	QCOMPARE(fnValues(output), QStringList({"First", "Second", "Third"}));
+}
+
+
+
+
+
+void TestStreamPipeline::testStageException()
+{
+	StreamPipeline pipeline;
+	pipeline.setNumWorkers(2);
+	pipeline.addStage(std::make_shared<StreamStageFilter>([](const Contact & a_Contact) -> bool
+		{
+			if (a_Contact.sentences()[0].m_Value == "Bad")
+			{
+				throw std::runtime_error("Test failure");
+			}
+			return true;
+		}
+	));
+	StreamPipeline::Stats stats;
+	auto output = runPipeline(pipeline, contactsWithNames({"One", "Bad", "Two", "Bad", "Three"}), stats);
+	QCOMPARE(stats.m_NumRead, static_cast<quint64>(5));
+	QCOMPARE(stats.m_NumDropped, static_cast<quint64>(2));
+	QCOMPARE(stats.m_NumWritten, static_cast<quint64>(3));
+	QCOMPARE(fnValues(output), QStringList({"One", "Two", "Three"}));
+}
+
+
+
+
+
+void TestStreamPipeline::testAnonymize()
+{
+	// The quoted-printable name is text and gets masked, the base64 photo is binary and gets emptied:
+	QByteArray input = vcard(
+		"FN;ENCODING=QUOTED-PRINTABLE:Jan=20Nov=C3=A1k 42\r\n"
+		"PHOTO;ENCODING=b;TYPE=JPEG:YWJj\r\n"
+	);
+	auto contact = std::make_shared<Contact>();
+	QBuffer buf(&input);
+	buf.open(QIODevice::ReadOnly);
+	VCardParser::parse(buf, contact);
+	QVERIFY(StreamStageAnonymize().process(*contact));
+	const auto & sentences = contact->sentences();
+	QCOMPARE(sentences.size(), static_cast<size_t>(2));
+	QCOMPARE(sentences[0].m_Value, QByteArray("Xxx Xxxxx 55"));
+	QVERIFY(!sentences[0].isBinary());
+	QVERIFY(sentences[1].isBinary());
+	QVERIFY(sentences[1].m_Value.isEmpty());
+}
+
+
+
+
+
+QTEST_GUILESS_MAIN(TestStreamPipeline)
+
+
+
+
+
+#include "TestStreamPipeline.moc"
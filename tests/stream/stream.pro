@@ -0,0 +1,49 @@
+#-------------------------------------------------
+#
+# Unit tests of StreamPipeline and StreamStages
+#
+#-------------------------------------------------
+
+QT       += testlib concurrent
+
+QT       -= gui
+
+TARGET = TestStreamPipeline
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+SOURCES +=\
+	TestStreamPipeline.cpp \
+	../../StreamPipeline.cpp \
+	../../StreamStages.cpp \
+	../../Sanitizer.cpp \
+	../../SanitizerRules.cpp \
+	../../VCardParser.cpp \
+	../../VCardSerializer.cpp \
+	../../Contact.cpp \
+	../../ContactBook.cpp \
+	../../ContactBookIndex.cpp \
+	../../ContactBookSnapshot.cpp \
+	../../Normalizer.cpp \
+	../../PhoneNumber.cpp
+
+HEADERS +=\
+	../../StreamPipeline.h \
+	../../StreamStages.h \
+	../../Sanitizer.h \
+	../../SanitizerRules.h \
+	../../VCardParser.h \
+	../../VCardSerializer.h \
+	../../Contact.h \
+	../../ContactBook.h \
+	../../ContactBookIndex.h \
+	../../ContactBookSnapshot.h \
+	../../Normalizer.h \
+	../../PhoneNumber.h \
+	../TestHelpers.h
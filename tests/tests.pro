@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += testlib
+QT       += testlib concurrent
 
 QT       -= gui
 
@@ -31,10 +31,18 @@ SOURCES +=\
 	TestVCardParser.cpp \
 	../VCardParser.cpp \
 	../Contact.cpp \
-	../ContactBook.cpp
+	../ContactBook.cpp \
+	../ContactBookIndex.cpp \
+	../ContactBookSnapshot.cpp \
+	../Normalizer.cpp \
+	../PhoneNumber.cpp
 
 HEADERS +=\
 	../Contact.h \
-	../ContactBook.h
+	../ContactBook.h \
+	../ContactBookIndex.h \
+	../ContactBookSnapshot.h \
+	../Normalizer.h \
+	../PhoneNumber.h
 
 DEFINES += SRCDIR=\\\"$$PWD/\\\"